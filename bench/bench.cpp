@@ -0,0 +1,967 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "assembler.hpp"
+#include "cpu_pool.hpp"
+#include "disassembler.hpp"
+#include "mos6502.hpp"
+#include "opcode.hpp"
+#include "profiler.hpp"
+#include "programs.hpp"
+#include "random_device.hpp"
+#include "scheduler.hpp"
+#include "state_hash.hpp"
+
+// Copies and increments a page of memory in an endless loop, touching 3 pages per iteration
+const std::vector<uint8_t> PAGE_WALK_PROGRAM = {
+	0xA2, 0x00, // LDX #$00
+	0xBD, 0x00, 0x02, // LDA $0200,X
+	0xFE, 0x00, 0x03, // INC $0300,X
+	0x9D, 0x00, 0x04, // STA $0400,X
+	0xE8, // INX
+	0xD0, 0xF4, // BNE $0602
+	0x4C, 0x00, 0x06, // JMP $0600
+};
+
+// Copies 4 pages from $1000 to $2000 through zero page pointers, the classic (zp),Y memcpy
+const std::vector<uint8_t> MEMCPY_INDIRECT_PROGRAM = {
+	0xA9, 0x00, // LDA #$00
+	0x85, 0x00, // STA $00
+	0x85, 0x02, // STA $02
+	0xA9, 0x10, // LDA #$10
+	0x85, 0x01, // STA $01
+	0xA9, 0x20, // LDA #$20
+	0x85, 0x03, // STA $03
+	0xA2, 0x04, // LDX #$04
+	0xA0, 0x00, // LDY #$00
+	0xB1, 0x00, // LDA ($00),Y
+	0x91, 0x02, // STA ($02),Y
+	0xC8, // INY
+	0xD0, 0xF9, // BNE $0612
+	0xE6, 0x01, // INC $01
+	0xE6, 0x03, // INC $03
+	0xCA, // DEX
+	0xD0, 0xF0, // BNE $0610
+	0x4C, 0x00, 0x06, // JMP $0600
+};
+
+// Copies 2 pages from $1000 to $2000 with absolute indexed addressing, unrolled twice
+const std::vector<uint8_t> MEMCPY_ABSOLUTE_PROGRAM = {
+	0xA2, 0x00, // LDX #$00
+	0xBD, 0x00, 0x10, // LDA $1000,X
+	0x9D, 0x00, 0x20, // STA $2000,X
+	0xBD, 0x00, 0x11, // LDA $1100,X
+	0x9D, 0x00, 0x21, // STA $2100,X
+	0xE8, // INX
+	0xD0, 0xF1, // BNE $0602
+	0x4C, 0x00, 0x06, // JMP $0600
+};
+
+// Snake-style frame loop: a short burst of work, then 256 rounds of the NOP, NOP, DEX, BNE delay loop
+const std::vector<uint8_t> DELAY_LOOP_PROGRAM = {
+	0xE6, 0x20, // INC $20
+	0xA5, 0x20, // LDA $20
+	0x85, 0x21, // STA $21
+	0xA2, 0x00, // LDX #$00
+	0xEA, // NOP
+	0xEA, // NOP
+	0xCA, // DEX
+	0xD0, 0xFB, // BNE $0608
+	0x4C, 0x00, 0x06, // JMP $0600
+};
+
+// Shift-and-add 8x8 -> 16 bit multiplication of $10 and $11 into $12/$13, with the inputs changing every round
+const std::vector<uint8_t> MULTIPLY_PROGRAM = {
+	0xA9, 0x00, // LDA #$00
+	0x85, 0x12, // STA $12
+	0x85, 0x13, // STA $13
+	0xA5, 0x10, // LDA $10
+	0x85, 0x14, // STA $14
+	0xA9, 0x00, // LDA #$00
+	0x85, 0x15, // STA $15
+	0xA5, 0x11, // LDA $11
+	0x85, 0x16, // STA $16
+	0xA2, 0x08, // LDX #$08
+	0x46, 0x16, // LSR $16
+	0x90, 0x0D, // BCC $0625
+	0x18, // CLC
+	0xA5, 0x12, // LDA $12
+	0x65, 0x14, // ADC $14
+	0x85, 0x12, // STA $12
+	0xA5, 0x13, // LDA $13
+	0x65, 0x15, // ADC $15
+	0x85, 0x13, // STA $13
+	0x06, 0x14, // ASL $14
+	0x26, 0x15, // ROL $15
+	0xCA, // DEX
+	0xD0, 0xE8, // BNE $0614
+	0xE6, 0x10, // INC $10
+	0xE6, 0x11, // INC $11
+	0x4C, 0x00, 0x06, // JMP $0600
+};
+
+// Name of an addressing mode as used in the benchmark names, `ZeroPageX` becomes `zero_page_x`
+std::string mode_benchmark_name(const AddressingMode mode) {
+	std::string name;
+	for (const char* c = MODE_NAMES[mode]; *c != '\0'; c++) {
+		if (std::isupper((unsigned char)*c) && !name.empty()) {
+			name += '_';
+		}
+		name += (char)std::tolower((unsigned char)*c);
+	}
+	return name;
+}
+
+// Copies of an instruction per opcode benchmark loop, the closing `JMP` adds 1 instruction per loop
+const int OPCODE_REPEAT = 64;
+
+/**
+ * Result of a single benchmark. `instructions` is 0 for benchmarks that can not count them, `dispatches` is only
+ * counted by the superinstruction benchmarks.
+ */
+struct BenchResult {
+	std::string name;
+	uint64_t instructions;
+	uint64_t cycles;
+	double seconds;
+	uint64_t dispatches;
+};
+
+double ns_per_instruction(const BenchResult& result) {
+	return (result.instructions == 0) ? 0 : result.seconds * 1e9 / result.instructions;
+}
+
+double emulated_mhz(const BenchResult& result) {
+	return (result.seconds == 0) ? 0 : result.cycles / result.seconds / 1e6;
+}
+
+struct BenchOptions {
+	uint64_t opcode_cycles;
+	uint64_t workload_cycles;
+	int repetitions;
+	std::string filter;
+};
+
+bool selected(const BenchOptions& options, const std::string& name) {
+	return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+/**
+ * Time a CPU prepared by `setup` for `cycle_budget` cycles, counting the executed instructions. Every instruction is
+ * run through `policy`, which the workloads use to feed devices and which measures the cost of a profiler. When the
+ * program hits a `BRK` it is set up again and continues until the budget is spent. The fastest of `repetitions` runs
+ * is reported.
+ */
+template <typename Policy>
+BenchResult measure(const std::string& name, const std::function<void(CPU&)>& setup, const uint64_t cycle_budget,
+					const int repetitions, Policy& policy) {
+	BenchResult best = {name, 0, 0, 0, 0};
+	for (int repetition = 0; repetition < repetitions; repetition++) {
+		CPU cpu = CPU();
+		setup(cpu);
+
+		uint64_t instructions = 0;
+		uint64_t cycles = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (cycles < cycle_budget) {
+			const uint64_t started_at = cpu.cycles;
+			const uint64_t deadline = started_at + (cycle_budget - cycles);
+			bool halted = false;
+			while (cpu.cycles < deadline) {
+				if (!cpu.step(policy)) {
+					halted = true;
+					break;
+				}
+				instructions += 1;
+			}
+			cycles += cpu.cycles - started_at;
+			if (halted) {
+				setup(cpu);
+			}
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (repetition == 0 || elapsed.count() < best.seconds) {
+			best = {name, instructions, cycles, elapsed.count(), 0};
+		}
+	}
+	return best;
+}
+
+BenchResult measure(const std::string& name, const std::function<void(CPU&)>& setup, const uint64_t cycle_budget,
+					const int repetitions) {
+	NullPolicy none;
+	return measure(name, setup, cycle_budget, repetitions, none);
+}
+
+/**
+ * Build a loop executing `OPCODE_REPEAT` copies of `opcode`. Operands point into scratch memory that does not overlap
+ * the program, indexed operands do not cross pages with X = Y = 1. Relative operands are 0, so a branch lands on the
+ * next instruction whether it is taken or not.
+ * ---
+ * @return `std::vector<uint8_t> program`, the loop, empty for opcodes that can not run in a loop on their own
+ * ---
+ */
+std::vector<uint8_t> opcode_program(const Opcode& opcode) {
+	std::vector<uint8_t> program;
+	switch (opcode.code) {
+		case 0x00: // BRK ends the program
+		case 0x40: // RTI needs a frame pushed by an interrupt
+		case 0x60: // RTS is measured together with JSR
+			return program;
+		case 0x4C: {
+			// Chain of jumps to the next instruction, the last one closes the loop
+			for (int i = 0; i < OPCODE_REPEAT; i++) {
+				const uint16_t target = (i == OPCODE_REPEAT - 1) ? 0x0600 : 0x0600 + 3 * (i + 1);
+				program.insert(program.end(), {0x4C, (uint8_t)(target & 0xFF), (uint8_t)(target >> 8)});
+			}
+			return program;
+		}
+		case 0x6C: {
+			// Jumps to itself through the pointer at $F0
+			return {0x6C, 0xF0, 0x00};
+		}
+		default:
+			break;
+	}
+
+	std::vector<uint8_t> operand;
+	switch (opcode.mode) {
+		case AddressingMode::Immediate: operand = {0x01}; break;
+		case AddressingMode::Relative: operand = {0x00}; break;
+		case AddressingMode::ZeroPage:
+		case AddressingMode::ZeroPageX:
+		case AddressingMode::ZeroPageY: operand = {0x80}; break;
+		case AddressingMode::Absolute:
+		case AddressingMode::AbsoluteX:
+		case AddressingMode::AbsoluteY: operand = {0x00, 0x03}; break;
+		case AddressingMode::IndirectX:
+		case AddressingMode::IndirectY: operand = {0x40}; break;
+		default: break;
+	}
+	if (opcode.code == 0x20) {
+		operand = {0x00, 0x07}; // JSR to the RTS at $0700
+	}
+
+	for (int i = 0; i < OPCODE_REPEAT; i++) {
+		program.push_back(opcode.code);
+		program.insert(program.end(), operand.begin(), operand.end());
+	}
+	program.insert(program.end(), {0x4C, 0x00, 0x06});
+	return program;
+}
+
+void bench_opcodes(const BenchOptions& options, std::vector<BenchResult>& results) {
+	// Per addressing mode totals, aggregated over every opcode using the mode
+	std::map<int, BenchResult> modes;
+
+	for (const Opcode& opcode : OPCODES) {
+		const std::vector<uint8_t> program = opcode_program(opcode);
+		if (opcode.size == 0 || program.empty()) {
+			continue;
+		}
+
+		const std::string mnemonic = (opcode.code == 0x20) ? "jsr_rts" : opcode.name;
+		std::vector<std::pair<std::string, uint8_t>> variants;
+		if (opcode.mode == AddressingMode::Relative) {
+			// Status 0 takes BCC/BNE/BPL/BVC, all flags set takes the others
+			variants.push_back({"opcode/" + mnemonic + "/relative_status_clear", 0x00});
+			variants.push_back({"opcode/" + mnemonic + "/relative_status_set", 0xC3});
+		} else {
+			variants.push_back({"opcode/" + mnemonic + "/" + mode_benchmark_name(opcode.mode), 0x00});
+		}
+
+		for (const std::pair<std::string, uint8_t>& variant : variants) {
+			if (!selected(options, variant.first)) {
+				continue;
+			}
+			const uint8_t status = variant.second;
+			const BenchResult result = measure(variant.first, [&program, status](CPU& cpu) {
+				cpu.load_program(program);
+				cpu.reset();
+				cpu.register_irx = 1;
+				cpu.register_iry = 1;
+				cpu.status = status;
+				// ($40),Y and ($40,X) both point into page 3, JMP ($F0) points back to the start, JSR returns from $0700
+				cpu.memory_write(0x0040, 0x00);
+				cpu.memory_write(0x0041, 0x03);
+				cpu.memory_write(0x0042, 0x03);
+				cpu.memory_write_uint16(0x00F0, 0x0600);
+				cpu.memory_write(0x0700, 0x60);
+			}, options.opcode_cycles, options.repetitions);
+			results.push_back(result);
+
+			BenchResult& mode = modes[opcode.mode];
+			mode.name = "mode/" + mode_benchmark_name(opcode.mode);
+			mode.instructions += result.instructions;
+			mode.cycles += result.cycles;
+			mode.seconds += result.seconds;
+		}
+	}
+
+	for (const std::pair<const int, BenchResult>& mode : modes) {
+		results.push_back(mode.second);
+	}
+}
+
+/**
+ * Run loop policy feeding the snake game: a fresh xorshift value in `$FE` before every instruction and a new
+ * direction in `$FF` every 16384 instructions (d, s, a, w).
+ */
+struct SnakeInput {
+	RandomDevice random;
+	uint64_t steps;
+
+	void restart() {
+		this->random.seed(RANDOM_DEVICE_DEFAULT_SEED);
+		this->steps = 0;
+	}
+
+	void before_instruction(CPU& cpu, uint16_t pc, uint8_t opcode) {
+		const uint8_t keys[] = {0x64, 0x73, 0x61, 0x77};
+		this->random.before_instruction(cpu, pc, opcode);
+		this->steps += 1;
+		if ((this->steps & 0x3FFF) == 0) {
+			cpu.memory[0x00FF] = keys[(this->steps >> 14) & 3];
+			cpu.mark_dirty(0x00FF);
+		}
+	}
+
+	void after_instruction(CPU&, uint16_t, uint8_t, uint64_t) {}
+	void after_interrupt(CPU&, uint64_t) {}
+};
+
+void bench_workloads(const BenchOptions& options, std::vector<BenchResult>& results) {
+	auto load = [](const std::vector<uint8_t>& program) {
+		return [&program](CPU& cpu) {
+			cpu.load_program(program);
+			cpu.reset();
+			cpu.memory_write(0x0010, 0x37);
+			cpu.memory_write(0x0011, 0xA5);
+		};
+	};
+
+	const std::vector<std::pair<std::string, const std::vector<uint8_t>*>> kernels = {
+		{"workload/memcpy_indirect", &MEMCPY_INDIRECT_PROGRAM},
+		{"workload/memcpy_absolute", &MEMCPY_ABSOLUTE_PROGRAM},
+		{"workload/multiply", &MULTIPLY_PROGRAM},
+		{"workload/page_walk", &PAGE_WALK_PROGRAM},
+	};
+	for (const std::pair<std::string, const std::vector<uint8_t>*>& kernel : kernels) {
+		if (selected(options, kernel.first)) {
+			results.push_back(measure(kernel.first, load(*kernel.second), options.workload_cycles, options.repetitions));
+		}
+	}
+
+	if (selected(options, "workload/page_walk_profiled")) {
+		Profiler profiler;
+		results.push_back(measure("workload/page_walk_profiled", load(PAGE_WALK_PROGRAM), options.workload_cycles,
+								  options.repetitions, profiler));
+	}
+
+	if (selected(options, "workload/snake")) {
+		// Fixed random sequence and a scripted player circling the screen, so every run executes the same
+		// instructions. The game restarts whenever the snake dies.
+		SnakeInput input;
+		results.push_back(measure("workload/snake", [&input](CPU& cpu) {
+			input.restart();
+			cpu.load_program(SNAKE_PROGRAM);
+			cpu.reset();
+			cpu.memory_write(0x00FF, 0x64);
+		}, options.workload_cycles, options.repetitions, input));
+	}
+}
+
+/**
+ * Run `instance_count` CPUs side by side in round-robin slices, as the farm and the fuzzer do.
+ * ---
+ * @param `const MemoryBacking backing`, the kind of pages to back the memory of each instance with
+ * @param `const int instance_count`, the amount of CPUs to interleave
+ * @param `const uint64_t cycles_per_instance`, the amount of cycles every instance executes in total
+ * ---
+ * @return `BenchResult result`, the aggregate over all instances
+ * ---
+ */
+BenchResult bench_multi_instance(const MemoryBacking backing, const int instance_count, const uint64_t cycles_per_instance) {
+	std::vector<std::unique_ptr<CPU>> cpus;
+	for (int i = 0; i < instance_count; i++) {
+		cpus.push_back(std::make_unique<CPU>(backing));
+		cpus.back()->load_program(PAGE_WALK_PROGRAM);
+		cpus.back()->reset();
+	}
+
+	const uint64_t slice = 2000;
+	uint64_t total_cycles = 0;
+	uint64_t instructions = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t done = 0; done < cycles_per_instance; done += slice) {
+		for (std::unique_ptr<CPU>& cpu : cpus) {
+			const uint64_t before = cpu->cycles;
+			const uint64_t deadline = before + slice;
+			while (cpu->cycles < deadline && cpu->step()) {
+				instructions += 1;
+			}
+			total_cycles += cpu->cycles - before;
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const std::string name = "instances/" + std::to_string(instance_count)
+		+ ((backing == MemoryBacking::HugePages) ? "/huge_pages" : "/standard_pages");
+	return {name, instructions, total_cycles, elapsed.count(), 0};
+}
+
+/**
+ * Run a single CPU under the `Scheduler` with `pending_events` periodic events in flight at all times. Every event
+ * re-arms itself, the periods are chosen such that on average one event fires every `average_gap` cycles regardless of
+ * how many are pending, so the numbers show the cost of the heap depth rather than of the dispatch rate.
+ * ---
+ * @param `const int pending_events`, the amount of events kept pending
+ * @param `const uint64_t average_gap`, average amount of cycles between two fired events
+ * @param `const uint64_t total_cycles`, the amount of cycles to run for
+ * ---
+ * @return `BenchResult result`, without an instruction count
+ * ---
+ */
+BenchResult bench_scheduler(const int pending_events, const uint64_t average_gap, const uint64_t total_cycles) {
+	CPU cpu = CPU();
+	cpu.load_program(PAGE_WALK_PROGRAM);
+	cpu.reset();
+
+	Scheduler scheduler;
+	uint64_t fired = 0;
+	const uint64_t period = average_gap * pending_events;
+	for (const DeviceEvent event : {NmiEvent, FrameIrqEvent, MapperIrqEvent, DmaEvent}) {
+		scheduler.set_handler(event, [&scheduler, &fired, period, event](CPU&, uint64_t timestamp, uint32_t payload) {
+			fired += 1;
+			scheduler.schedule(event, timestamp + period + (payload % 7), payload);
+		});
+	}
+	for (int i = 0; i < pending_events; i++) {
+		scheduler.schedule((DeviceEvent)(i % DEVICE_EVENT_COUNT), (uint64_t)i * average_gap, i);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	scheduler.run(cpu, total_cycles);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return {"scheduler/" + std::to_string(pending_events) + "_pending", 0, cpu.cycles, elapsed.count(), 0};
+}
+
+/**
+ * Run the delay loop program under the `Scheduler` with a vblank NMI every frame, either interpreting every
+ * iteration of the delay loop or fast-forwarding through it (`CPU::skip_idle_loops`).
+ * ---
+ * @param `const bool skip_idle_loops`, whether to fast-forward idle loops
+ * @param `const uint64_t total_cycles`, the amount of cycles to run for
+ * ---
+ * @return `BenchResult result`, without an instruction count
+ * ---
+ */
+BenchResult bench_idle(const bool skip_idle_loops, const uint64_t total_cycles) {
+	CPU cpu = CPU();
+	cpu.load_program(DELAY_LOOP_PROGRAM);
+	cpu.memory_write(0x0700, 0xE6); // INC $22
+	cpu.memory_write(0x0701, 0x22);
+	cpu.memory_write(0x0702, 0x40); // RTI
+	cpu.memory_write_uint16(0xFFFA, 0x0700);
+	cpu.reset();
+	cpu.skip_idle_loops = skip_idle_loops;
+
+	Scheduler scheduler;
+	scheduler.set_handler(NmiEvent, [&scheduler](CPU& cpu, uint64_t timestamp, uint32_t) {
+		cpu.set_nmi_line(true, timestamp);
+		cpu.set_nmi_line(false, timestamp);
+		scheduler.schedule(NmiEvent, timestamp + CYCLES_PER_FRAME);
+	});
+	scheduler.schedule(NmiEvent, CYCLES_PER_FRAME);
+
+	const auto start = std::chrono::steady_clock::now();
+	scheduler.run(cpu, total_cycles);
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return {skip_idle_loops ? "idle/skipped" : "idle/interpreted", 0, cpu.cycles, elapsed.count(), 0};
+}
+
+/**
+ * Run a tiny program (a handful of stores to the zero page, the stack and $0200) `runs` times, each time on an
+ * instance in its power-on state: a freshly constructed CPU, one reused CPU with its memory space cleared, or a CPU
+ * borrowed from a `CPUPool`, which only restores the pages the previous run wrote. Reported per run, so the ns/instr
+ * column is the time a reset plus a run take.
+ * ---
+ * @param `const std::string& kind`, `construct`, `clear` or `pool`
+ * @param `const uint64_t runs`, the amount of runs
+ * ---
+ * @return `BenchResult result`, with one "instruction" per run
+ * ---
+ */
+BenchResult bench_reset(const std::string& kind, const uint64_t runs) {
+	const std::vector<uint8_t> program = {
+		0xA9, 0x42, // LDA #$42
+		0x85, 0x10, // STA $10
+		0x8D, 0x00, 0x02, // STA $0200
+		0x48, // PHA
+		0x00
+	};
+
+	CPU reused = CPU();
+	CPUPool pool;
+	uint64_t cycles = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t run = 0; run < runs; run++) {
+		auto execute = [&program, &cycles](CPU& cpu) {
+			cpu.load_program(program);
+			cpu.reset();
+			cpu.run_for(100);
+			cycles += cpu.cycles;
+		};
+		if (kind == "construct") {
+			CPU cpu = CPU();
+			execute(cpu);
+		} else if (kind == "clear") {
+			reused.reset_memory_space();
+			execute(reused);
+		} else {
+			PooledCPU cpu = pool.acquire();
+			execute(*cpu);
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return {"reset/" + kind, runs, cycles, elapsed.count(), 0};
+}
+
+/**
+ * Hash the state of the snake game after every frame, the full memory space every time (`hash_cpu_state`) or only the
+ * pages the frame wrote (`CPU::state_hash`). Only the hashing is timed, reported per hash, so the ns/instr column is
+ * the time a single hash takes.
+ * ---
+ * @param `const bool incremental`, use `CPU::state_hash` instead of `hash_cpu_state`
+ * @param `const uint64_t frames`, the amount of frames to run and hash
+ * ---
+ * @return `BenchResult result`, with one "instruction" per hash
+ * ---
+ */
+BenchResult bench_state_hash(const bool incremental, const uint64_t frames) {
+	CPU cpu = CPU();
+	cpu.load_program(SNAKE_PROGRAM);
+	cpu.reset();
+	SnakeInput input;
+	input.restart();
+
+	uint64_t checksum = 0;
+	std::chrono::duration<double> hashing(0);
+	for (uint64_t frame = 0; frame < frames; frame++) {
+		if (cpu.run_until((frame + 1) * CYCLES_PER_FRAME, input) == StopReason::BreakInstruction) {
+			cpu.reset();
+		}
+		const auto start = std::chrono::steady_clock::now();
+		checksum ^= incremental ? cpu.state_hash() : hash_cpu_state(cpu);
+		hashing += std::chrono::steady_clock::now() - start;
+	}
+	// Keeps the hashing from being optimized away
+	if (checksum == 1) {
+		std::cout << std::endl;
+	}
+	return {incremental ? "hash/incremental" : "hash/full", frames, 0, hashing.count(), 0};
+}
+
+void bench_system(const BenchOptions& options, std::vector<BenchResult>& results) {
+	for (const int instances : {1, 16, 256}) {
+		const uint64_t cycles = options.workload_cycles / 5 / instances + 2000;
+		for (const MemoryBacking backing : {MemoryBacking::StandardPages, MemoryBacking::HugePages}) {
+			const std::string name = "instances/" + std::to_string(instances);
+			if (selected(options, name)) {
+				results.push_back(bench_multi_instance(backing, instances, cycles));
+			}
+		}
+	}
+
+	for (const int pending : {0, 1, 16, 1024, 65536}) {
+		if (selected(options, "scheduler/" + std::to_string(pending) + "_pending")) {
+			results.push_back(bench_scheduler(pending, (pending == 0) ? 1 : 100, options.workload_cycles));
+		}
+	}
+
+	for (const bool skip : {false, true}) {
+		if (selected(options, skip ? "idle/skipped" : "idle/interpreted")) {
+			results.push_back(bench_idle(skip, options.workload_cycles));
+		}
+	}
+
+	for (const char* kind : {"construct", "clear", "pool"}) {
+		if (selected(options, std::string("reset/") + kind)) {
+			results.push_back(bench_reset(kind, options.workload_cycles / 100));
+		}
+	}
+
+	for (const bool incremental : {false, true}) {
+		if (selected(options, incremental ? "hash/incremental" : "hash/full")) {
+			results.push_back(bench_state_hash(incremental, options.workload_cycles / 2000));
+		}
+	}
+}
+
+void write_text_report(std::ostream& out, const std::vector<BenchResult>& results) {
+	out << std::left << std::setw(44) << "benchmark" << std::right
+		<< std::setw(12) << "ns/instr" << std::setw(12) << "MHz" << std::setw(14) << "disp/instr" << std::endl;
+	for (const BenchResult& result : results) {
+		out << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(2);
+		if (result.instructions == 0) {
+			out << std::setw(12) << "-";
+		} else {
+			out << std::setw(12) << ns_per_instruction(result);
+		}
+		out << std::setw(12) << emulated_mhz(result);
+		if (result.dispatches == 0 || result.instructions == 0) {
+			out << std::setw(14) << "-";
+		} else {
+			out << std::setw(14) << (double)result.dispatches / result.instructions;
+		}
+		out << std::defaultfloat << std::endl;
+	}
+}
+
+/**
+ * Write the results as JSON, one benchmark object per line so that `read_baseline` can read it back without a JSON
+ * library. Benchmarks without cycles (hashing, disassembly, assembly) count other items in `instructions`, their
+ * `ns_per_instruction` is the time per item.
+ */
+void write_json_report(std::ostream& out, const std::vector<BenchResult>& results) {
+	out << "{" << std::endl << "  \"benchmarks\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		out << "    {\"name\": \"" << result.name << "\""
+			<< ", \"instructions\": " << result.instructions
+			<< ", \"cycles\": " << result.cycles
+			<< ", \"dispatches\": " << result.dispatches
+			<< std::setprecision(9) << ", \"seconds\": " << result.seconds
+			<< std::setprecision(6) << ", \"ns_per_instruction\": ";
+		if (result.instructions == 0) {
+			out << "null";
+		} else {
+			out << ns_per_instruction(result);
+		}
+		out << ", \"mhz\": " << emulated_mhz(result) << "}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl << "}" << std::endl;
+}
+
+struct BaselineEntry {
+	double mhz;
+	// 0 when the benchmark executed no items
+	double ns_per_item;
+};
+
+/**
+ * Read the emulated clock speed and the time per item of every benchmark from a file written by `write_json_report`
+ * ---
+ * @exception `std::runtime_error`, thrown when the file can not be opened
+ * ---
+ */
+std::map<std::string, BaselineEntry> read_baseline(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		throw std::runtime_error("Could not open baseline: " + path);
+	}
+
+	std::map<std::string, BaselineEntry> baseline;
+	std::string line;
+	while (std::getline(file, line)) {
+		const std::string name_key = "\"name\": \"";
+		const std::string ns_key = "\"ns_per_instruction\": ";
+		const std::string mhz_key = "\"mhz\": ";
+		const size_t name_at = line.find(name_key);
+		const size_t ns_at = line.find(ns_key);
+		const size_t mhz_at = line.find(mhz_key);
+		if (name_at == std::string::npos || ns_at == std::string::npos || mhz_at == std::string::npos) {
+			continue;
+		}
+		const size_t name_start = name_at + name_key.size();
+		const std::string name = line.substr(name_start, line.find('"', name_start) - name_start);
+		const std::string ns = line.substr(ns_at + ns_key.size());
+		baseline[name] = {std::stod(line.substr(mhz_at + mhz_key.size())), (ns.compare(0, 4, "null") == 0) ? 0 : std::stod(ns)};
+	}
+	return baseline;
+}
+
+/**
+ * Compare the results against a baseline and print every benchmark that moved by more than `tolerance` percent, on the
+ * emulated clock speed, or on the time per item for benchmarks that run no cycles
+ * ---
+ * @return `int regressions`, the amount of benchmarks that got slower by more than the tolerance
+ * ---
+ */
+int compare_with_baseline(std::ostream& out, const std::vector<BenchResult>& results,
+						  const std::map<std::string, BaselineEntry>& baseline, const double tolerance) {
+	int regressions = 0;
+	int compared = 0;
+	out << std::endl << "comparison against baseline (tolerance " << tolerance << "%):" << std::endl;
+	for (const BenchResult& result : results) {
+		const auto reference = baseline.find(result.name);
+		if (reference == baseline.end()) {
+			continue;
+		}
+		// Speed up in percent, positive when faster
+		const bool per_item = result.cycles == 0;
+		const double before = per_item ? reference->second.ns_per_item : reference->second.mhz;
+		const double after = per_item ? ns_per_instruction(result) : emulated_mhz(result);
+		if (before <= 0 || after <= 0) {
+			continue;
+		}
+		compared += 1;
+		const double change = (per_item ? before / after - 1 : after / before - 1) * 100;
+		if (change < -tolerance) {
+			regressions += 1;
+			out << "  REGRESSION  ";
+		} else if (change > tolerance) {
+			out << "  improvement ";
+		} else {
+			continue;
+		}
+		out << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(8) << before << " -> " << std::setw(8) << after << (per_item ? " ns  (" : " MHz (")
+			<< std::showpos << change << std::noshowpos << "%)" << std::defaultfloat << std::endl;
+	}
+	out << compared << " benchmarks compared, " << regressions << " regressions" << std::endl;
+	return regressions;
+}
+
+void print_usage(const char* program_name) {
+	std::cerr << "usage: " << program_name << " [--json <file>] [--baseline <file>] [--tolerance <percent>]" << std::endl
+			  << "       " << std::string(std::strlen(program_name), ' ')
+			  << " [--filter <substring>] [--quick]" << std::endl;
+}
+
+/**
+ * Run a program through `run_until` in slices of 1000 cycles, as the scheduler does, with or without
+ * superinstructions. `between_slices` plays the part of the devices, so both runs see the same inputs and execute the
+ * same instructions. The program is set up again whenever it hits a `BRK`.
+ * ---
+ * @return `BenchResult result`, with the instructions and dispatches counted by `CPU::run_fused`
+ * ---
+ */
+BenchResult measure_sliced(const std::string& name, const std::function<void(CPU&)>& setup,
+						   const std::function<void(CPU&)>& between_slices, const uint64_t cycle_budget,
+						   const int repetitions, const bool fuse) {
+	BenchResult best = {name, 0, 0, 0, 0};
+	for (int repetition = 0; repetition < repetitions; repetition++) {
+		CPU cpu = CPU();
+		setup(cpu);
+		cpu.fuse_instructions = true;
+
+		uint64_t cycles = 0;
+		const auto start = std::chrono::steady_clock::now();
+		while (cycles < cycle_budget) {
+			between_slices(cpu);
+			const uint64_t started_at = cpu.cycles;
+			// The plain run goes through the regular run loop, the fused one through `CPU::run_fused`
+			cpu.fuse_instructions = fuse;
+			const StopReason reason = cpu.run_until(started_at + std::min<uint64_t>(1000, cycle_budget - cycles));
+			cycles += cpu.cycles - started_at;
+			if (reason == StopReason::BreakInstruction) {
+				setup(cpu);
+			}
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		if (repetition == 0 || elapsed.count() < best.seconds) {
+			best = {name, cpu.cold->fusion_instructions, cycles, elapsed.count(), cpu.cold->fusion_dispatches};
+		}
+	}
+	return best;
+}
+
+void bench_fusion(const BenchOptions& options, std::vector<BenchResult>& results) {
+	auto load = [](const std::vector<uint8_t>& program) {
+		return [&program](CPU& cpu) {
+			cpu.load_program(program);
+			cpu.reset();
+			cpu.memory_write(0x0010, 0x37);
+			cpu.memory_write(0x0011, 0xA5);
+		};
+	};
+	auto no_input = [](CPU&) {};
+
+	// The snake gets a new random byte and, now and then, a new key between slices
+	RandomDevice random;
+	uint64_t slices = 0;
+	auto snake_setup = [&random, &slices](CPU& cpu) {
+		random.seed(RANDOM_DEVICE_DEFAULT_SEED);
+		slices = 0;
+		cpu.load_program(SNAKE_PROGRAM);
+		cpu.reset();
+		cpu.memory_write(0x00FF, 0x64);
+	};
+	auto snake_input = [&random, &slices](CPU& cpu) {
+		const uint8_t keys[] = {0x64, 0x73, 0x61, 0x77};
+		random.refresh(cpu);
+		slices += 1;
+		if ((slices & 0x3F) == 0) {
+			cpu.memory[0x00FF] = keys[(slices >> 6) & 3];
+			cpu.mark_dirty(0x00FF);
+		}
+	};
+
+	const std::vector<std::tuple<std::string, std::function<void(CPU&)>, std::function<void(CPU&)>>> programs = {
+		{"fusion/snake", snake_setup, snake_input},
+		{"fusion/memcpy_indirect", load(MEMCPY_INDIRECT_PROGRAM), no_input},
+		{"fusion/memcpy_absolute", load(MEMCPY_ABSOLUTE_PROGRAM), no_input},
+		{"fusion/multiply", load(MULTIPLY_PROGRAM), no_input},
+		{"fusion/delay_loop", load(DELAY_LOOP_PROGRAM), no_input},
+	};
+	for (const auto& program : programs) {
+		const std::string& name = std::get<0>(program);
+		if (!selected(options, name)) {
+			continue;
+		}
+		BenchResult fused = measure_sliced(name + "/fused", std::get<1>(program), std::get<2>(program),
+										   options.workload_cycles, options.repetitions, true);
+		BenchResult plain = measure_sliced(name + "/interpreted", std::get<1>(program), std::get<2>(program),
+										   options.workload_cycles, options.repetitions, false);
+		// Both runs execute the same instructions, only the fused run counts them
+		plain.instructions = fused.instructions;
+		plain.dispatches = fused.instructions;
+		results.push_back(plain);
+		results.push_back(fused);
+	}
+}
+
+/**
+ * Disassemble a 32 KiB PRG bank (`$8000` - `$FFFF`, filled with copies of the snake game) into listing lines, as a
+ * trace or a debugger would. Reported per disassembled instruction, the bank has no cycle count.
+ */
+void bench_disassembler(const BenchOptions& options, std::vector<BenchResult>& results) {
+	if (!selected(options, "disasm/prg_bank")) {
+		return;
+	}
+	CPU cpu = CPU();
+	for (uint32_t addr = 0x8000; addr < MEMORY_SIZE; addr++) {
+		cpu.memory[addr] = SNAKE_PROGRAM[(addr - 0x8000) % SNAKE_PROGRAM.size()];
+	}
+	cpu.mark_dirty(0x8000, MEMORY_SIZE - 1);
+
+	BenchResult best = {"disasm/prg_bank", 0, 0, 0, 0};
+	uint64_t checksum = 0;
+	for (int repetition = 0; repetition < options.repetitions; repetition++) {
+		char line[DISASSEMBLY_LINE_LENGTH];
+		uint64_t instructions = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t addr = 0x8000; addr < MEMORY_SIZE; instructions++) {
+			addr += disassemble_line(cpu.memory, addr, line);
+			checksum += line[20];
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (best.seconds == 0 || elapsed.count() < best.seconds) {
+			best.instructions = instructions;
+			best.seconds = elapsed.count();
+		}
+	}
+	// Keeps the formatting from being optimized away
+	if (checksum == 1) {
+		std::cout << std::endl;
+	}
+	results.push_back(best);
+}
+
+void bench_assembler(const BenchOptions& options, std::vector<BenchResult>& results) {
+	if (!selected(options, "assembler/snake")) {
+		return;
+	}
+	// The disassembly listing of the snake game, as a program source written by hand would look
+	CPU cpu = CPU();
+	cpu.load_program(SNAKE_PROGRAM);
+	std::string source;
+	char text[DISASSEMBLY_LENGTH];
+	uint64_t statements = 0;
+	for (uint32_t addr = 0x0600; addr < 0x0600 + SNAKE_PROGRAM.size(); statements++) {
+		addr += disassemble(cpu.memory, (uint16_t)addr, text);
+		source += text;
+		source += '\n';
+	}
+
+	BenchResult best = {"assembler/snake", 0, 0, 0, 0};
+	uint64_t checksum = 0;
+	for (int repetition = 0; repetition < options.repetitions; repetition++) {
+		const auto start = std::chrono::steady_clock::now();
+		checksum += assemble(source).bytes.size();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (best.seconds == 0 || elapsed.count() < best.seconds) {
+			best.instructions = statements;
+			best.seconds = elapsed.count();
+		}
+	}
+	if (checksum == 1) {
+		std::cout << std::endl;
+	}
+	results.push_back(best);
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options = {2000000, 20000000, 3, ""};
+	std::string json_path;
+	std::string baseline_path;
+	double tolerance = 10;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			tolerance = std::stod(argv[++i]);
+		} else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			options.filter = argv[++i];
+		} else if (std::strcmp(argv[i], "--quick") == 0) {
+			options = {200000, 2000000, 1, options.filter};
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::cout << "sizeof(CPU) = " << sizeof(CPU) << " B, memory space = " << MEMORY_SIZE << " B (separate)" << std::endl;
+
+	std::vector<BenchResult> results;
+	bench_opcodes(options, results);
+	bench_workloads(options, results);
+	bench_fusion(options, results);
+	bench_system(options, results);
+	bench_disassembler(options, results);
+	bench_assembler(options, results);
+	write_text_report(std::cout, results);
+
+	if (!json_path.empty()) {
+		std::ofstream json(json_path);
+		if (!json) {
+			std::cerr << "Could not write " << json_path << std::endl;
+			return 1;
+		}
+		write_json_report(json, results);
+	}
+
+	if (!baseline_path.empty()) {
+		try {
+			const std::map<std::string, BaselineEntry> baseline = read_baseline(baseline_path);
+			if (compare_with_baseline(std::cout, results, baseline, tolerance) > 0) {
+				return 2;
+			}
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
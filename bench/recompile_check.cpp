@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "mos6502.hpp"
+#include "programs.hpp"
+#include "random_device.hpp"
+#include "recompiler.hpp"
+
+// Emitted at build time by `nes-emu --recompile snake --name snake`
+void snake_run(CPU& cpu, const uint64_t deadline);
+bool snake_matches(const CPU& cpu);
+
+/**
+ * The snake game with a fixed random sequence and a scripted player, fed between slices like a frontend would
+ */
+struct SnakeSession {
+	RandomDevice random;
+	uint64_t slices;
+
+	void start(CPU& cpu) {
+		this->random.seed(RANDOM_DEVICE_DEFAULT_SEED);
+		this->slices = 0;
+		cpu.load_program(SNAKE_PROGRAM);
+		cpu.reset();
+		cpu.memory_write(0x00FF, 0x64);
+	}
+
+	void feed(CPU& cpu) {
+		const uint8_t keys[] = {0x64, 0x73, 0x61, 0x77};
+		this->random.refresh(cpu);
+		this->slices += 1;
+		if ((this->slices & 0x3F) == 0) {
+			cpu.memory[0x00FF] = keys[(this->slices >> 6) & 3];
+			cpu.mark_dirty(0x00FF);
+		}
+	}
+};
+
+bool same_state(const CPU& a, const CPU& b) {
+	return a.program_counter == b.program_counter && a.stack_pointer == b.stack_pointer &&
+		a.register_a == b.register_a && a.register_irx == b.register_irx && a.register_iry == b.register_iry &&
+		a.status == b.status && a.cycles == b.cycles && std::memcmp(a.memory, b.memory, MEMORY_SIZE) == 0;
+}
+
+/**
+ * Run the interpreter and the recompiled code side by side on the same inputs, in slices of varying length so runs
+ * end at every possible position within the blocks, and compare registers, master clock and memory after every slice
+ */
+bool differential_check(const uint64_t total_cycles) {
+	CPU interpreted;
+	CPU recompiled;
+	SnakeSession interpreted_session;
+	SnakeSession recompiled_session;
+	interpreted_session.start(interpreted);
+	recompiled_session.start(recompiled);
+	if (!snake_matches(recompiled)) {
+		std::cerr << "recompiled code does not match the loaded program" << std::endl;
+		return false;
+	}
+
+	uint32_t slice_rng = 0x1234567;
+	uint64_t games = 1;
+	while (interpreted.cycles < total_cycles) {
+		slice_rng ^= slice_rng << 13;
+		slice_rng ^= slice_rng >> 17;
+		slice_rng ^= slice_rng << 5;
+		const uint64_t deadline = interpreted.cycles + 1 + slice_rng % 3000;
+
+		interpreted_session.feed(interpreted);
+		recompiled_session.feed(recompiled);
+		const StopReason expected = interpreted.run_until(deadline);
+		const StopReason actual = run_recompiled(recompiled, deadline, snake_run);
+		if (expected != actual || !same_state(interpreted, recompiled)) {
+			std::cerr << "recompiled run diverged in game " << games << " at cycle " << interpreted.cycles
+					  << std::hex << ": pc $" << interpreted.program_counter << " / $" << recompiled.program_counter
+					  << std::dec << ", cycles " << recompiled.cycles << std::endl;
+			return false;
+		}
+
+		if (expected == StopReason::BreakInstruction) {
+			// The snake died, start a new game on both
+			const uint64_t played = interpreted.cycles;
+			interpreted_session.start(interpreted);
+			recompiled_session.start(recompiled);
+			interpreted.cycles = played;
+			recompiled.cycles = played;
+			games += 1;
+		}
+	}
+	std::cout << "differential check: " << total_cycles << " cycles, " << games << " games, no divergence" << std::endl;
+	return true;
+}
+
+/**
+ * Emulated MHz of a full run of frame sized slices
+ */
+double measure(const bool use_recompiled, const uint64_t total_cycles) {
+	CPU cpu;
+	SnakeSession session;
+	session.start(cpu);
+
+	const auto start = std::chrono::steady_clock::now();
+	while (cpu.cycles < total_cycles) {
+		session.feed(cpu);
+		const uint64_t deadline = cpu.cycles + CYCLES_PER_FRAME;
+		const StopReason reason = use_recompiled ? run_recompiled(cpu, deadline, snake_run) : cpu.run_until(deadline);
+		if (reason == StopReason::BreakInstruction) {
+			const uint64_t played = cpu.cycles;
+			session.start(cpu);
+			cpu.cycles = played;
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return cpu.cycles / elapsed.count() / 1e6;
+}
+
+int main() {
+	if (!differential_check(20000000)) {
+		return 1;
+	}
+
+	const uint64_t total_cycles = 200000000;
+	const double interpreted_mhz = measure(false, total_cycles);
+	const double recompiled_mhz = measure(true, total_cycles);
+	std::cout << std::fixed << std::setprecision(1)
+			  << "snake/interpreted  " << std::setw(10) << interpreted_mhz << " MHz" << std::endl
+			  << "snake/recompiled   " << std::setw(10) << recompiled_mhz << " MHz ("
+			  << recompiled_mhz / interpreted_mhz << "x)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * A program produced by `assemble`: the bytes from the lowest to the highest assembled address (gaps between `.org`
+ * sections are zero) and the address of every label.
+ */
+struct AssembledProgram {
+    uint16_t origin;
+    std::vector<uint8_t> bytes;
+    std::map<std::string, uint16_t> labels;
+};
+
+/**
+ * Two-pass 6502 assembler. The first pass sizes every statement and assigns addresses to labels, the second pass
+ * evaluates the operands and emits the bytes. Source lines look like:
+ *
+ *      - `label:`, optionally followed by a statement on the same line
+ *      - `name = expr`, a constant
+ *      - `mnemonic operand`, with the standard operand syntax: nothing (implied), `A`, `#expr`, `expr`, `expr,X`,
+ *        `expr,Y`, `(expr)`, `(expr,X)` and `(expr),Y`. Branches take their target address.
+ *      - `.org expr`, continue assembling at an address
+ *      - `.byte expr, "text", ...` and `.word expr, ...`, data (words are little endian)
+ *
+ * Everything after a `;` is a comment, mnemonics and register names are case insensitive. Expressions are sums and
+ * differences of numbers (`$hex`, `%binary`, decimal, `'c'`), labels, constants and `*` (the address of the
+ * statement), optionally prefixed by `<` (low byte) or `>` (high byte).
+ *
+ * Zero page addressing is chosen when the operand is known in the first pass and fits in a byte, unless it is
+ * written as a hex number of more than two digits (`$0010`). Operands referring to labels defined further down are
+ * assembled as absolute.
+ * ---
+ * @param `const std::string& source`, the assembly source
+ * @param `const uint16_t origin`, the address to assemble at until the first `.org`
+ * ---
+ * @return `AssembledProgram program`, the assembled image and labels
+ * ---
+ * @exception `std::runtime_error`, thrown on a syntax error, an unknown mnemonic or label, an addressing mode the
+ * instruction does not have, a value out of range or a branch that can not reach its target. The message starts
+ * with the line number.
+ * ---
+ */
+AssembledProgram assemble(const std::string& source, const uint16_t origin = 0x0600);
+
+/**
+ * Copy an assembled program into the memory space of a CPU at its origin. When the program does not cover the reset
+ * vector, the vector is pointed at the origin, the way `CPU::load_program` does.
+ * ---
+ * @param `CPU& cpu`, the CPU to load into
+ * @param `const AssembledProgram& program`, the program to load
+ * ---
+ * @exception `std::out_of_range`, thrown when the program is empty
+ * ---
+ */
+void load_assembled(CPU& cpu, const AssembledProgram& program);
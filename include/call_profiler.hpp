@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * FrameKind enum for the ways a frame on the shadow call stack can be entered
+ */
+enum FrameKind {
+    Subroutine, // JSR
+    Nmi,        // NMI sequence
+    Irq,        // IRQ sequence or BRK
+};
+
+/**
+ * Call graph profiler, a run loop policy (see `NullPolicy`) keeping a shadow call stack to attribute inclusive and
+ * exclusive cycles to every subroutine and interrupt handler.
+ *
+ * Frames are pushed on `JSR`, on interrupt sequences and on `BRK`. They are not popped by matching `RTS` / `RTI`, but
+ * by the stack pointer: a frame ends as soon as the stack pointer rises above the position it had right after the
+ * return address was pushed. This keeps the shadow stack in sync with programs that manipulate the stack by hand,
+ * e.g. dropping a return address with two `PLA`s (the frame ends there) or jumping through a pushed address with
+ * `RTS` (no frame ends). Stack pointer wrap-around is not tracked.
+ *
+ * Cycles are attributed to a calling context tree, so the same routine called from different places is kept apart.
+ * The `JSR` itself counts towards the caller, the `RTS` / `RTI` and the 7 cycle interrupt sequence towards the callee.
+ */
+class CallProfiler {
+public:
+    /**
+     * A node of the calling context tree. Node 0 is the top level of the program.
+     */
+    struct Node {
+        uint32_t parent;
+        uint16_t routine;
+        FrameKind kind;
+        uint64_t calls;
+        uint64_t inclusive_cycles;
+        uint64_t exclusive_cycles;
+    };
+
+    /**
+     * Totals of a single routine over all its calling contexts. Inclusive cycles of recursive calls are counted once.
+     */
+    struct RoutineTotals {
+        uint16_t routine;
+        FrameKind kind;
+        uint64_t calls;
+        uint64_t inclusive_cycles;
+        uint64_t exclusive_cycles;
+    };
+
+    /**
+     * Default constructor, creates a profiler with an empty shadow stack
+     */
+    CallProfiler();
+
+    void before_instruction(CPU& cpu, uint16_t, uint8_t) {
+        if (this->first_cycle == UINT64_MAX) {
+            this->first_cycle = cpu.cycles;
+        }
+    }
+
+    void after_instruction(CPU& cpu, uint16_t, const uint8_t opcode, const uint64_t cycles) {
+        if (opcode == 0x20) {
+            this->enter(cpu.program_counter, FrameKind::Subroutine, cpu.stack_pointer, cpu.cycles);
+        } else if (opcode == 0x00) {
+            this->enter(cpu.program_counter, FrameKind::Irq, cpu.stack_pointer, cpu.cycles - cycles);
+        } else if (!this->frames.empty() && cpu.stack_pointer > this->frames.back().return_sp) {
+            this->leave(cpu.stack_pointer, cpu.cycles);
+        }
+    }
+
+    void after_interrupt(CPU& cpu, const uint64_t cycles) {
+        if (this->first_cycle == UINT64_MAX) {
+            this->first_cycle = cpu.cycles - cycles;
+        }
+        const FrameKind kind = (cpu.program_counter == cpu.memory_read_uint16(0xFFFA)) ? FrameKind::Nmi : FrameKind::Irq;
+        this->enter(cpu.program_counter, kind, cpu.stack_pointer, cpu.cycles - cycles);
+    }
+
+    /**
+     * Close every open frame at the current master clock, to be called when the profiled run is over. Routines that
+     * never return (like a main loop) are only accounted for after this.
+     * ---
+     * @param `const CPU& cpu`, the profiled CPU
+     * ---
+     */
+    void finish(const CPU& cpu);
+
+    /**
+     * Name a routine in the reports instead of its address
+     * ---
+     * @param `const uint16_t routine`, the entry address of the routine
+     * @param `const std::string& name`, the name to use, must not contain `;` or spaces
+     * ---
+     */
+    void set_label(const uint16_t routine, const std::string& name);
+
+    /**
+     * The current depth of the shadow call stack
+     * ---
+     */
+    size_t depth() const;
+
+    /**
+     * The nodes of the calling context tree, node 0 being the top level of the program
+     * ---
+     */
+    const std::vector<Node>& nodes() const;
+
+    /**
+     * Per routine totals, ordered on exclusive cycles (descending)
+     * ---
+     */
+    std::vector<RoutineTotals> routines() const;
+
+    /**
+     * Write the calling context tree in the folded stack format (`program;outer;inner <cycles>` per line, exclusive
+     * cycles) read by flamegraph tools
+     * ---
+     * @param `std::ostream& out`, the stream to write to
+     * ---
+     */
+    void write_folded(std::ostream& out) const;
+
+    /**
+     * Write the `top` most expensive routines (by exclusive cycles) with their call counts and inclusive cycles
+     * ---
+     * @param `std::ostream& out`, the stream to write to
+     * @param `const size_t top`, the amount of routines to list
+     * ---
+     */
+    void write_report(std::ostream& out, const size_t top) const;
+
+private:
+    struct Frame {
+        uint32_t node;
+        uint8_t return_sp;
+        uint64_t entered_at;
+        uint64_t child_cycles;
+    };
+
+    void enter(const uint16_t routine, const FrameKind kind, const uint8_t return_sp, const uint64_t entered_at);
+    void leave(const uint8_t stack_pointer, const uint64_t now);
+    void pop_frame(const uint64_t now);
+    std::string frame_name(const Node& node) const;
+
+    std::vector<Frame> frames;
+    std::vector<Node> tree;
+    // Child lookup, keyed on parent node, kind and routine
+    std::map<uint64_t, uint32_t> children;
+    // Open frames per routine and kind, to count inclusive cycles of recursive routines once
+    std::map<uint32_t, uint32_t> active;
+    std::map<uint32_t, RoutineTotals> totals;
+    std::map<uint16_t, std::string> labels;
+    uint64_t first_cycle;
+    uint64_t last_cycle;
+    // Inclusive cycles of the frames entered from the top level
+    uint64_t top_level_child_cycles;
+};
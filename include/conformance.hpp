@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * Registers and memory of a single-step test case, before or after the instruction
+ */
+struct ConformanceState {
+    uint16_t pc;
+    uint8_t s;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    // The bytes of memory the case sets up or checks, as address / value pairs
+    std::vector<std::pair<uint16_t, uint8_t>> ram;
+};
+
+/**
+ * One cycle of bus activity recorded for a test case
+ */
+struct BusCycle {
+    uint16_t addr;
+    uint8_t value;
+    bool write;
+};
+
+/**
+ * A single-step test case: one instruction executed from `initial` has to arrive at `final`, taking one cycle per
+ * entry of `cycles`
+ */
+struct ConformanceCase {
+    std::string name;
+    ConformanceState initial;
+    ConformanceState final;
+    std::vector<BusCycle> cycles;
+};
+
+/**
+ * The outcome of running the test cases of one file
+ */
+struct ConformanceResult {
+    std::string path;
+    // The opcode the file tests, taken from its name (`a9.json`), -1 when the name is not an opcode
+    int opcode;
+    // Files of undocumented opcodes are not run
+    bool skipped;
+    uint64_t cases;
+    uint64_t failed;
+    // Name and mismatch of the first failing case, or why the file could not be read
+    std::string first_failure;
+};
+
+/**
+ * Stream the test cases of a document in the widely used per-opcode single-step JSON format, a top-level array of
+ * objects with `name`, `initial` and `final` states (`pc`, `s`, `a`, `x`, `y`, `p` and `ram` as `[address, value]`
+ * pairs) and `cycles` as `[address, value, "read" / "write"]` triples. Cases are parsed one at a time into the same
+ * `ConformanceCase`, so documents of any size are read in constant memory. Unknown members are ignored.
+ * ---
+ * @param `std::istream& in`, the stream holding the document
+ * @param `const std::function<void(const ConformanceCase&)>& visit`, called with every case
+ * ---
+ * @return `uint64_t cases`, the amount of cases visited
+ * ---
+ * @exception `std::runtime_error`, thrown when the document is malformed
+ * ---
+ */
+uint64_t for_each_conformance_case(std::istream& in, const std::function<void(const ConformanceCase&)>& visit);
+
+/**
+ * Execute the single instruction of a test case and compare the outcome. Only the memory the case names is touched,
+ * and cleared again afterwards, so a CPU can run any amount of cases without resetting its memory space.
+ *
+ * The bus activity is only checked by its length against `CPU::cycles`, the core does not model individual cycles.
+ * ---
+ * @param `CPU& cpu`, the CPU to run the case on
+ * @param `const ConformanceCase& test_case`, the case
+ * ---
+ * @return `std::string mismatch`, empty when the case passed, otherwise the first difference (e.g. `A $12, expected $13`)
+ * ---
+ */
+std::string run_conformance_case(CPU& cpu, const ConformanceCase& test_case);
+
+/**
+ * List the `*.json` files of a directory, sorted by name
+ * ---
+ * @param `const std::string& directory`, the directory holding the test files
+ * ---
+ * @return `std::vector<std::string> paths`, the paths of the files
+ * ---
+ * @exception `std::runtime_error`, thrown when the directory can not be read
+ * ---
+ */
+std::vector<std::string> conformance_files(const std::string& directory);
+
+/**
+ * Run test files in parallel, one file per task on a `WorkStealingPool` with one reused CPU per worker
+ * ---
+ * @param `const std::vector<std::string>& paths`, the test files
+ * @param `const unsigned int thread_count`, the amount of workers. 0 uses one worker per hardware thread
+ * ---
+ * @return `std::vector<ConformanceResult> results`, one result per file, in the same order as `paths`
+ * ---
+ */
+std::vector<ConformanceResult> run_conformance(const std::vector<std::string>& paths, const unsigned int thread_count = 0);
+
+/**
+ * Write a report with one line per failing, unreadable or skipped file followed by a summary of the run
+ * ---
+ * @param `std::ostream& out`, the stream to write the report to
+ * @param `const std::vector<ConformanceResult>& results`, the results to report on
+ * @param `const double wall_seconds`, wall clock time the run took
+ * ---
+ */
+void write_conformance_report(std::ostream& out, const std::vector<ConformanceResult>& results, const double wall_seconds);
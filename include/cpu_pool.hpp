@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "memory_storage.hpp"
+#include "mos6502.hpp"
+
+class CPUPool;
+
+/**
+ * Returns a `CPU` to the pool it was acquired from when its `PooledCPU` handle goes out of scope
+ */
+struct CPUPoolReturn {
+    CPUPool* pool;
+    void operator()(CPU* cpu) const;
+};
+
+/**
+ * Handle to a `CPU` borrowed from a `CPUPool`, used like a `std::unique_ptr<CPU>`
+ */
+typedef std::unique_ptr<CPU, CPUPoolReturn> PooledCPU;
+
+/**
+ * Pool of reusable `CPU` instances for running large amounts of short-lived programs (unit tests, fuzzing).
+ *
+ * Constructing a `CPU` maps a fresh memory space and allocates its cold state, which for tiny programs costs more than
+ * running them. The pool keeps returned instances around and hands them out again in the state of its template
+ * snapshot, restoring only the pages written by the previous user (see `CPU::restore_snapshot`). The template is the
+ * power-on state of a `CPU` until `set_template` replaces it, e.g. with a CPU that has a program loaded.
+ *
+ *      CPUPool pool;
+ *      for (const auto& program : programs) {
+ *          PooledCPU cpu = pool.acquire();
+ *          cpu->load_program(program);
+ *          cpu->reset();
+ *          cpu->run_for(budget);
+ *      }
+ *
+ * `acquire` and returns are thread safe, instances go back to the pool through their handle and must not outlive it.
+ */
+class CPUPool {
+public:
+    /**
+     * Constructor, the pool starts out empty with the power-on state as template
+     * ---
+     * @param `const MemoryBacking backing`, the kind of pages the memory spaces of new instances are allocated from
+     * ---
+     */
+    explicit CPUPool(const MemoryBacking backing = MemoryBacking::StandardPages);
+
+    CPUPool(const CPUPool&) = delete;
+    CPUPool& operator=(const CPUPool&) = delete;
+
+    /**
+     * Borrow a CPU in the template state, reusing a returned instance when there is one
+     * ---
+     * @return `PooledCPU cpu`, the CPU, returned to the pool when the handle is destroyed
+     * ---
+     */
+    PooledCPU acquire();
+
+    /**
+     * Make the current state of `cpu` the state handed out by `acquire` from now on. Instances already borrowed are
+     * not affected, returned instances copy their full memory space once on their next `acquire`.
+     * ---
+     * @param `CPU& cpu`, the CPU to take the state from, it is in sync with the new template afterwards
+     * ---
+     */
+    void set_template(CPU& cpu);
+
+    /**
+     * The amount of instances the pool constructed so far, borrowed ones included
+     * ---
+     */
+    size_t created() const;
+
+    /**
+     * The amount of returned instances waiting to be borrowed again
+     * ---
+     */
+    size_t idle() const;
+
+private:
+    friend struct CPUPoolReturn;
+    void release(CPU* cpu);
+
+    MemoryBacking backing;
+    mutable std::mutex lock;
+    std::vector<std::unique_ptr<CPU>> idle_cpus;
+    std::shared_ptr<const CPUSnapshot> snapshot;
+    size_t created_count;
+};
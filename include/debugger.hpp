@@ -0,0 +1,206 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "memory_storage.hpp"
+#include "mos6502.hpp"
+
+/**
+ * DebugRegister enum for the registers a break condition can test
+ */
+enum DebugRegister {
+    RegisterA,
+    RegisterX,
+    RegisterY,
+    RegisterSP,
+    RegisterStatus,
+};
+
+/**
+ * Break when a register holds a value, tested before an instruction executes
+ */
+struct BreakCondition {
+    DebugRegister reg;
+    uint8_t value;
+};
+
+/**
+ * Why and where the debugger last stopped a run
+ */
+struct DebugHit {
+    // `StopReason::Breakpoint` or `StopReason::Watchpoint`
+    StopReason reason;
+    // For breakpoints the address of the instruction that did not execute yet, for watchpoints the program counter
+    // after the instruction that made the access
+    uint16_t pc;
+    // The watched address that was accessed, the address of the instruction for breakpoints
+    uint16_t address;
+    DebugAccess access;
+    // The value read (before the instruction) or written (after it), 0 for breakpoints
+    uint8_t value;
+};
+
+/**
+ * Execute breakpoints, read / write watchpoints and break conditions on register values.
+ *
+ * Attach it to a CPU with `CPU::attach_debugger`, which hands `CPU::run_until` (and with it `CPU::run_for` and
+ * `Scheduler::run`) and `CPU::run` to `Debugger::step`. A CPU without a debugger runs exactly the code it ran
+ * before: neither the memory accessors nor the run loops carry a check, only the start of a run looks at the
+ * attached debugger. The optimized run loops (superinstructions, idle loop skipping, recompiled code) are given up
+ * while one is attached.
+ *
+ * The debugger keeps a table of 256 page flags (`DebugAccess` bits, one entry per page of 256 bytes). Before every
+ * instruction it looks up the page of the program counter and, from the addressing mode, the page of the data the
+ * instruction accesses (the effective address of the operand, the stack page for pushes and pulls), and only
+ * consults the exact breakpoints and watchpoints for flagged pages. Pointers read by the indirect modes and the
+ * operand bytes themselves are not watched.
+ *
+ * A breakpoint stops before the instruction executes, a watchpoint right after the instruction that made the access,
+ * so registers and `CPU::cycles` are exactly those at that instruction boundary. Runs return `StopReason::Breakpoint`
+ * or `StopReason::Watchpoint` and `hit` tells where. Running again continues past the breakpoint that stopped the run.
+ */
+class Debugger {
+public:
+    /**
+     * Default constructor, creates a debugger without breakpoints, watchpoints or conditions
+     */
+    Debugger();
+
+    /**
+     * Destructor, detaches from the CPU the debugger is attached to
+     */
+    ~Debugger();
+
+    Debugger(const Debugger&) = delete;
+    Debugger& operator=(const Debugger&) = delete;
+
+    /**
+     * Break before the instruction at `addr` executes
+     * ---
+     * @param `const uint16_t addr`, the address of the instruction
+     * ---
+     */
+    void add_breakpoint(const uint16_t addr);
+
+    /**
+     * Break before the instruction at `addr` executes, if a register holds a value at that point. Several conditions
+     * on the same address break when any of them holds.
+     * ---
+     * @param `const uint16_t addr`, the address of the instruction
+     * @param `const BreakCondition condition`, the register value to break on
+     * ---
+     */
+    void add_breakpoint(const uint16_t addr, const BreakCondition condition);
+
+    /**
+     * Remove the breakpoints, conditional or not, at `addr`
+     * ---
+     * @param `const uint16_t addr`, the address of the instruction
+     * ---
+     */
+    void remove_breakpoint(const uint16_t addr);
+
+    /**
+     * Break before any instruction at which a register holds a value. Has to test every instruction, so all pages
+     * are flagged while a condition is set.
+     * ---
+     * @param `const BreakCondition condition`, the register value to break on
+     * ---
+     */
+    void add_condition(const BreakCondition condition);
+
+    /**
+     * Break after an instruction reads and / or writes an address in `first` - `last` (inclusive)
+     * ---
+     * @param `const uint16_t first`, the first watched address
+     * @param `const uint16_t last`, the last watched address
+     * @param `const uint8_t access`, `DebugAccess::ReadAccess` and / or `DebugAccess::WriteAccess`
+     * ---
+     * @exception `std::invalid_argument`, thrown when `last` is before `first` or `access` has other bits
+     * ---
+     */
+    void add_watchpoint(const uint16_t first, const uint16_t last, const uint8_t access);
+
+    /**
+     * Stop watching accesses of a kind to the addresses `first` - `last` (inclusive)
+     * ---
+     * @param `const uint16_t first`, the first address
+     * @param `const uint16_t last`, the last address
+     * @param `const uint8_t access`, `DebugAccess::ReadAccess` and / or `DebugAccess::WriteAccess`
+     * ---
+     */
+    void remove_watchpoint(const uint16_t first, const uint16_t last, const uint8_t access);
+
+    /**
+     * Remove all breakpoints, watchpoints and conditions
+     * ---
+     */
+    void clear();
+
+    /**
+     * Execute a single instruction of the attached CPU (or service a pending interrupt), unless a breakpoint applies
+     * or the program counter points at a `BRK` that ends the program.
+     * ---
+     * @return `StopReason reason`, `StopReason::BudgetExhausted` when the instruction executed and the run may go on
+     * ---
+     * @exception `std::runtime_error`, thrown when the debugger is not attached to a CPU
+     * ---
+     */
+    StopReason step();
+
+    /**
+     * Run the attached CPU until the master clock reaches `deadline`, the program hits a `BRK` or a breakpoint or
+     * watchpoint applies. Called by `CPU::run_until` while the debugger is attached.
+     * ---
+     * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+     * ---
+     * @return `StopReason reason`, why the run ended
+     * ---
+     * @exception `std::runtime_error`, thrown when the debugger is not attached to a CPU
+     * ---
+     */
+    StopReason run_until(const uint64_t deadline);
+
+    // The CPU the debugger is attached to, set by `CPU::attach_debugger`
+    CPU* cpu;
+    // The last stop
+    DebugHit hit;
+
+private:
+    /**
+     * Recompute the flags of a page from the breakpoints and watchpoints on it
+     */
+    void update_page(const uint8_t page);
+
+    bool holds(const BreakCondition condition) const;
+
+    /**
+     * Whether a breakpoint or condition applies before the instruction at `pc`
+     */
+    bool breaks_at(const uint16_t pc);
+
+    /**
+     * Whether an access to `addr` is watched, recording it in `hit` if so
+     */
+    bool watched(const uint16_t addr, const DebugAccess access, const uint8_t value);
+
+    /**
+     * Whether the pushes or pulls that moved the stack pointer from `before` to its current value are watched
+     */
+    bool stack_watched(const uint8_t before, const uint8_t* pulled);
+
+    std::array<uint8_t, MEMORY_SIZE / 256> pages;
+    std::bitset<MEMORY_SIZE> breakpoints;
+    std::bitset<MEMORY_SIZE> read_watches;
+    std::bitset<MEMORY_SIZE> write_watches;
+    // Conditions of conditional breakpoints, breakpoints without an entry are unconditional
+    std::map<uint16_t, std::vector<BreakCondition>> breakpoint_conditions;
+    std::vector<BreakCondition> conditions;
+
+    // The breakpoint the last run stopped on, passed over when the run continues without executing anything else
+    uint16_t resume_pc;
+    uint64_t resume_cycles;
+};
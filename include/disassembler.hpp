@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Size of the buffer `disassemble` writes to, enough for the longest instruction (`jmp ($1234)`) and the terminator
+ */
+const size_t DISASSEMBLY_LENGTH = 16;
+
+/**
+ * Size of the buffer `disassemble_line` writes to, the address and instruction bytes take 17 characters
+ */
+const size_t DISASSEMBLY_LINE_LENGTH = 17 + DISASSEMBLY_LENGTH;
+
+/**
+ * Disassemble the instruction at `addr` into `buffer` (e.g. `lda ($10),Y` or `bne $0612`), without allocating.
+ *
+ * Operands are written in hex with the width of the addressing mode: 2 digits for immediate, zero page and the
+ * zero page pointers of the indirect indexed modes, 4 digits for absolute addresses and branch targets (resolved
+ * from the relative offset). Undocumented opcodes are written as `.byte $XX` and count as 1 byte. Operand bytes past
+ * `$FFFF` wrap around to `$0000`.
+ * ---
+ * @param `const uint8_t* memory`, the memory space holding the code, `MEMORY_SIZE` bytes
+ * @param `const uint16_t addr`, the address of the instruction
+ * @param `char* buffer`, receives the zero-terminated text, at least `DISASSEMBLY_LENGTH` bytes
+ * ---
+ * @return `size_t size`, the size of the instruction in bytes, to find the next one
+ * ---
+ */
+size_t disassemble(const uint8_t* memory, const uint16_t addr, char* buffer);
+
+/**
+ * Disassemble the instruction at `addr` into a listing line holding the address, the instruction bytes and the
+ * instruction, e.g. `$0600: B1 10     lda ($10),Y`. Used by the trace of `CPU::run` and the profiler report.
+ * ---
+ * @param `const uint8_t* memory`, the memory space holding the code, `MEMORY_SIZE` bytes
+ * @param `const uint16_t addr`, the address of the instruction
+ * @param `char* buffer`, receives the zero-terminated text, at least `DISASSEMBLY_LINE_LENGTH` bytes
+ * ---
+ * @return `size_t size`, the size of the instruction in bytes, to find the next one
+ * ---
+ */
+size_t disassemble_line(const uint8_t* memory, const uint16_t addr, char* buffer);
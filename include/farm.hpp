@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+#include "state_hash.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * A single program to be executed by the `Farm`, together with the amount of cycles it is allowed to run for.
+ */
+struct FarmJob {
+    std::string name;
+    std::vector<uint8_t> program;
+    uint64_t cycle_budget;
+};
+
+/**
+ * The outcome of running a single `FarmJob`.
+ */
+struct FarmResult {
+    std::string name;
+    // `hash_cpu_state` of the CPU when the program stopped
+    uint64_t state_hash;
+    uint16_t exit_pc;
+    uint64_t cycles;
+    StopReason stop_reason;
+};
+
+/**
+ * Instance farm running batches of programs headless across all cores.
+ *
+ * Jobs are scheduled over a `WorkStealingPool`. Every worker owns one `CPU` which is reused for every job it
+ * executes, so a batch of thousands of short programs does not allocate a fresh 64 KiB memory space per job, nor
+ * clear one: a job only restores the pages the previous job on its worker wrote.
+ */
+class Farm {
+public:
+    /**
+     * Constructor, spawn the worker pool and allocate one `CPU` per worker
+     * ---
+     * @param `const unsigned int thread_count`, the amount of workers. 0 uses one worker per hardware thread
+     * ---
+     */
+    explicit Farm(const unsigned int thread_count = 0);
+
+    /**
+     * Run every job in the batch and collect the results. Each program is loaded with `CPU::load_program` into a
+     * CPU in its power-on state and executed with `CPU::run_for` until it hits a `BRK` or exhausts its budget.
+     * ---
+     * @param `const std::vector<FarmJob>& jobs`, the batch of programs to execute
+     * ---
+     * @return `std::vector<FarmResult> results`, one result per job, in the same order as `jobs`
+     * ---
+     */
+    std::vector<FarmResult> run(const std::vector<FarmJob>& jobs);
+
+    /**
+     * The amount of workers the farm runs jobs on
+     * ---
+     */
+    unsigned int size() const;
+
+private:
+    WorkStealingPool pool;
+    std::vector<std::unique_ptr<CPU>> worker_cpus;
+    // State every job starts from, restored page by page
+    CPUSnapshot power_on;
+};
+
+/**
+ * Parse a job list. Every non-empty line that does not start with `#` holds the path of a raw program image
+ * (loaded like `CPU::load_program`) followed by a budget, either in cycles (`100000c` or `100000`) or in
+ * frames (`60f`). Relative paths are resolved against the directory of the job list.
+ * ---
+ * @param `const std::string& list_path`, path of the job list
+ * ---
+ * @return `std::vector<FarmJob> jobs`, the parsed jobs with their programs loaded
+ * ---
+ * @exception `std::runtime_error`, thrown when the list or one of the programs can not be read, or a line is malformed
+ * ---
+ */
+std::vector<FarmJob> load_farm_jobs(const std::string& list_path);
+
+/**
+ * Write a report with one line per result followed by a summary of the batch
+ * ---
+ * @param `std::ostream& out`, the stream to write the report to
+ * @param `const std::vector<FarmResult>& results`, the results to report on
+ * @param `const double wall_seconds`, wall clock time the batch took, used to report the aggregate emulated clock speed
+ * ---
+ */
+void write_farm_report(std::ostream& out, const std::vector<FarmResult>& results, const double wall_seconds);
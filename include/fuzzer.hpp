@@ -0,0 +1,195 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * Size of the edge coverage map of the `Fuzzer`, edges are hashed into it like AFL does
+ */
+const size_t FUZZ_MAP_SIZE = 0x10000;
+
+/**
+ * How a single fuzzing execution ended
+ */
+enum FuzzOutcome {
+    // The program reached a `BRK`
+    FuzzHalted,
+    // The cycle budget ran out, which is how a game normally ends its slice
+    FuzzBudgetExhausted,
+    // A jump or taken branch to its own address, which nothing but an interrupt can leave
+    FuzzInfiniteLoop,
+    // An opcode the core does not implement was about to execute
+    FuzzInvalidOpcode,
+    // The core threw an exception
+    FuzzException,
+};
+
+/**
+ * A single input of the fuzzer: the program loaded at `0x0600` (as by `CPU::load_program`), the values the `0x00FF`
+ * key byte takes over the run and the seed of the random values fed into `0x00FE`
+ */
+struct FuzzInput {
+    std::vector<uint8_t> program;
+    std::vector<uint8_t> keys;
+    uint32_t rng_seed;
+};
+
+/**
+ * An input that made the program crash or hang, the first one found per outcome and program counter
+ */
+struct FuzzFinding {
+    FuzzOutcome outcome;
+    uint16_t pc;
+    std::string message;
+    FuzzInput input;
+};
+
+/**
+ * Settings of a `Fuzzer`
+ */
+struct FuzzOptions {
+    // Cycles every execution may run for
+    uint64_t cycle_budget;
+    // Instructions between two changes of the key byte
+    uint64_t key_interval;
+    // Seed of the mutations, runs with the same seed and settings find the same inputs
+    uint64_t seed;
+};
+
+/**
+ * Coverage-guided fuzzer for 6502 programs.
+ *
+ * Every execution restores a snapshot of the CPU with the seed program loaded and reset (see `CPU::restore_snapshot`),
+ * writes the program bytes of the input over it and runs it under the cycle budget. Inputs are fed like the snake
+ * game expects them: a `RandomDevice` seeded from the input at `0x00FE` and the next key of the input in `0x00FF`
+ * every `key_interval` instructions.
+ *
+ * Coverage is recorded by a run loop policy from the control flow instructions (branches, jumps, subroutine calls and
+ * returns), as the hashed pair of the instruction address and the address it continued at, with AFL-style
+ * hit count buckets. An input reaching an edge or bucket no earlier input reached is added to the corpus, the corpus is
+ * what gets mutated: bit flips, random and interesting bytes, small arithmetic and block copies on the program, random
+ * keys and a new seed for the random values.
+ *
+ * Findings are executions that stop for another reason than a `BRK` or the budget running out: invalid opcodes,
+ * exceptions and jumps to self. Memory errors of the core itself show up when fuzzing with a sanitized build
+ * (`nes-emu-asan`).
+ */
+class Fuzzer {
+public:
+    /**
+     * Constructor, the seed program becomes the first entry of the corpus
+     * ---
+     * @param `const std::vector<uint8_t>& program`, the seed program, loaded at `0x0600`
+     * @param `const FuzzOptions& options`, the settings
+     * ---
+     * @exception `std::out_of_range`, thrown when the program is empty or does not fit the memory space
+     * ---
+     */
+    Fuzzer(const std::vector<uint8_t>& program, const FuzzOptions& options);
+
+    /**
+     * Execute a single input and update coverage, corpus and findings with it
+     * ---
+     * @param `const FuzzInput& input`, the input to run, its program has to be as long as the seed program
+     * ---
+     * @return `FuzzOutcome outcome`, how the execution ended
+     * ---
+     */
+    FuzzOutcome execute(const FuzzInput& input);
+
+    /**
+     * Mutate a corpus entry and execute it, `executions` times
+     * ---
+     * @param `const uint64_t executions`, the amount of executions
+     * ---
+     */
+    void run(const uint64_t executions);
+
+    /**
+     * The inputs that reached new coverage, the seed first
+     * ---
+     */
+    const std::vector<FuzzInput>& corpus() const;
+
+    /**
+     * The crashes and hangs found so far, in the order they were found
+     * ---
+     */
+    const std::vector<FuzzFinding>& findings() const;
+
+    /**
+     * The amount of distinct edges reached so far (hash collisions count as one)
+     * ---
+     */
+    size_t edges() const;
+
+    /**
+     * The amount of executions so far
+     * ---
+     */
+    uint64_t executions() const;
+
+    /**
+     * The amount of executions per outcome so far, indexed by `FuzzOutcome`
+     * ---
+     */
+    const std::vector<uint64_t>& outcomes() const;
+
+    /**
+     * The coverage map, per hashed edge the hit count buckets reached so far (0 for edges never reached)
+     * ---
+     */
+    const std::vector<uint8_t>& coverage() const;
+
+private:
+    FuzzInput mutate();
+    void mutate_program(std::vector<uint8_t>& program);
+
+    FuzzOptions options;
+    size_t program_size;
+    CPU cpu;
+    CPUSnapshot base;
+    std::mt19937_64 random;
+
+    // Hit counts of the current execution and the indices it touched, to clear it cheaply
+    std::vector<uint8_t> trace;
+    std::vector<uint16_t> touched;
+    // Per edge, the hit count buckets reached by any execution so far
+    std::vector<uint8_t> seen;
+    size_t edge_count;
+
+    std::vector<FuzzInput> inputs;
+    std::vector<FuzzFinding> found;
+    // Outcome and program counter of every finding, as `outcome << 16 | pc`
+    std::set<uint32_t> finding_keys;
+    std::vector<uint64_t> outcome_counts;
+    uint64_t execution_count;
+
+    friend struct FuzzPolicy;
+};
+
+/**
+ * Human readable name of an outcome (`infinite loop`, ...)
+ * ---
+ */
+const char* fuzz_outcome_name(const FuzzOutcome outcome);
+
+/**
+ * Write a report of a fuzzing run over one or more fuzzers running side by side: executions per outcome, combined
+ * coverage, corpus size, throughput and every finding with the input that triggered it (key bytes, seed and the program
+ * bytes that differ from `seed_program`), findings with the same outcome and program counter reported once
+ * ---
+ * @param `std::ostream& out`, the stream to write the report to
+ * @param `const std::vector<const Fuzzer*>& fuzzers`, the fuzzers after their run
+ * @param `const std::vector<uint8_t>& seed_program`, the program the fuzzers started from
+ * @param `const double wall_seconds`, wall clock time the run took
+ * ---
+ */
+void write_fuzz_report(std::ostream& out, const std::vector<const Fuzzer*>& fuzzers,
+                       const std::vector<uint8_t>& seed_program, const double wall_seconds);
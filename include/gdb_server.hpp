@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "debugger.hpp"
+#include "mos6502.hpp"
+#include "spsc_queue.hpp"
+
+// Cycles the target runs between two looks at the command queue while a client is connected
+const uint64_t GDB_POLL_CYCLES = 10000;
+
+/**
+ * Request passed from the server thread to the emulation thread
+ */
+struct GdbCommand {
+    enum Kind {
+        // A client connected
+        Attach,
+        // A packet with a valid checksum, `packet` holds its payload
+        Packet,
+        // The client sent a break (`Ctrl-C`) while the target runs
+        Interrupt,
+        // The client went away
+        Detach,
+    };
+    Kind kind;
+    std::string packet;
+};
+
+/**
+ * Reply passed from the emulation thread to the server thread
+ */
+struct GdbReply {
+    // Payload of the packet to send, nothing is sent when empty and `close` is set
+    std::string packet;
+    // Close the connection after sending the packet
+    bool close;
+};
+
+/**
+ * Stub for the GDB remote serial protocol, serving one client at a time on a Unix domain socket
+ * (`target remote /path/to/socket`).
+ *
+ * A server thread accepts the connection, frames and acknowledges packets and hands their payloads to the emulation
+ * thread through a lock-free `SpscQueue`; replies travel back through a second one. Only the emulation thread
+ * touches the CPU: it drives the emulation with `GdbServer::run_until` instead of `CPU::run_until` and answers the
+ * queued commands between slices of `GDB_POLL_CYCLES`. While no client is connected that is a single look at the
+ * command queue per call before handing over to `CPU::run_until`, the `Debugger` used for breakpoints, watchpoints
+ * and single steps is only attached for the duration of a session.
+ *
+ * Supported packets: `?`, `g` / `G`, `p` / `P`, `m` / `M`, `c`, `s`, `Z` / `z` 0 - 4 (breakpoints and write / read /
+ * access watchpoints), `D`, `k` and the `qSupported` / `qAttached` / `H` handshake. Registers are numbered
+ * A (0), X (1), Y (2), P (3) and SP (4), one byte each, followed by PC (5) as two little endian bytes. A `BRK` that
+ * ends the program is reported as the process exiting (`W00`) and ends the session.
+ */
+class GdbServer {
+public:
+    /**
+     * Constructor, listen on `socket_path` and spawn the server thread. An existing socket file at the path is replaced.
+     * ---
+     * @param `CPU& cpu`, the CPU to debug, it has to outlive the server
+     * @param `const std::string& socket_path`, the path of the Unix domain socket to create
+     * ---
+     * @exception `std::runtime_error`, thrown when the socket can not be created
+     * ---
+     */
+    GdbServer(CPU& cpu, const std::string& socket_path);
+
+    /**
+     * Destructor, closes the connection and the socket, joins the server thread and detaches from the CPU
+     */
+    ~GdbServer();
+
+    GdbServer(const GdbServer&) = delete;
+    GdbServer& operator=(const GdbServer&) = delete;
+
+    /**
+     * Run the CPU until the master clock reaches `deadline` or the program hits a `BRK`, answering the commands of a
+     * connected client on the way. A client that halts the target (on connecting, by a breakpoint, a watchpoint, a
+     * single step or a break) blocks the call until it continues or goes away. Emulation thread only.
+     * ---
+     * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+     * ---
+     * @return `StopReason reason`, `StopReason::BudgetExhausted` or `StopReason::BreakInstruction`
+     * ---
+     */
+    StopReason run_until(const uint64_t deadline);
+
+    /**
+     * Whether a client is connected to the socket
+     * ---
+     */
+    bool client_connected() const;
+
+private:
+    /**
+     * Main loop of the server thread, accepts clients and moves packets between the socket and the queues
+     */
+    void serve();
+
+    /**
+     * Answer the queued commands, emulation thread only
+     */
+    void process_commands();
+
+    /**
+     * Answer a single packet, emulation thread only
+     * ---
+     * @return `bool reply`, whether `reply` is to be sent now, `c` and `s` are answered once the target stops
+     * ---
+     */
+    bool handle_packet(const std::string& packet, std::string& reply);
+
+    /**
+     * Halt the target and report why to the client
+     */
+    void stop(const std::string& stop_reply);
+
+    /**
+     * Detach the debugger and resume free running, optionally telling the server thread to close the connection
+     */
+    void end_session(const std::string& last_reply, const bool close);
+
+    void send(const GdbReply reply);
+
+    CPU& cpu;
+    Debugger debugger;
+    std::string socket_path;
+    int listen_fd;
+
+    // Shared between the two threads
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<bool> connected;
+    SpscQueue<GdbCommand, 64> commands;
+    SpscQueue<GdbReply, 64> replies;
+
+    // Emulation thread state
+    bool session;
+    bool halted;
+    bool stepping;
+    std::string last_stop;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "memory_storage.hpp"
+
+/**
+ * Whether this build feeds an attached `MemoryHeatmap` from the memory accessors. Only the instrumented build variant
+ * (`nes-emu-heatmap`, compiled with `NES_MEMORY_HEATMAP`) has the hooks, the default build has no trace of them in
+ * `memory_read` / `memory_write`.
+ */
+#ifdef NES_MEMORY_HEATMAP
+const bool HEATMAP_SUPPORTED = true;
+#else
+const bool HEATMAP_SUPPORTED = false;
+#endif
+
+/**
+ * Per address read, write and execute counters for the whole address space.
+ *
+ * Attach it to a CPU with `CPU::attach_heatmap` in a build with `HEATMAP_SUPPORTED`. Opcode fetches count as
+ * executes, every other bus read (operand bytes, data, pointers, stack pulls) as a read. The counters are dense arrays
+ * indexed by address, a page being 256 consecutive entries. To get one heatmap per frame window, export and `clear`
+ * it every few frames.
+ */
+class MemoryHeatmap {
+public:
+    /**
+     * Default constructor, creates a heatmap with all counters at zero
+     */
+    MemoryHeatmap();
+
+    void record_read(const uint16_t addr) {
+        this->reads[addr] += 1;
+    }
+
+    void record_write(const uint16_t addr) {
+        this->writes[addr] += 1;
+    }
+
+    void record_execute(const uint16_t addr) {
+        this->executes[addr] += 1;
+    }
+
+    /**
+     * Set all counters back to zero
+     * ---
+     */
+    void clear();
+
+    /**
+     * Accesses of any kind to the 256 addresses of a page
+     * ---
+     * @param `const uint8_t page`, the high byte of the addresses
+     * ---
+     */
+    uint64_t page_accesses(const uint8_t page) const;
+
+    /**
+     * Write the counters as CSV, either one `address,reads,writes,executes` line per accessed address or one
+     * `page,reads,writes,executes` line per accessed page. Addresses and pages are written as hex (`$0010`, `$02`).
+     * ---
+     * @param `std::ostream& out`, the stream to write to
+     * @param `const bool per_page`, sum the counters per page
+     * ---
+     */
+    void write_csv(std::ostream& out, const bool per_page) const;
+
+    /**
+     * Write the counters as a 256 x 256 binary PPM image, one row per page. Writes are drawn in the red channel, reads
+     * in green and executes in blue, each on a logarithmic scale up to the largest counter of its kind.
+     * ---
+     * @param `std::ostream& out`, the stream to write to, opened in binary mode
+     * ---
+     */
+    void write_image(std::ostream& out) const;
+
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+    std::vector<uint64_t> executes;
+};
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * Streaming pull parser for JSON documents.
+ *
+ * The document is read through a fixed-size buffer and handed to the caller value by value, so files far larger than
+ * memory can be walked without building a tree. Containers are entered with `begin_array` / `begin_object` and their
+ * members iterated with `next_element` / `next_key`, which consume the separators and the closing bracket:
+ *
+ *      reader.begin_array();
+ *      while (reader.next_element()) {
+ *          const int64_t value = reader.read_integer();
+ *      }
+ *
+ * Values that are of no interest are passed over with `skip_value`. Malformed input throws a `std::runtime_error`
+ * naming the byte offset.
+ */
+class JsonReader {
+public:
+    /**
+     * Constructor, read the document from `in`
+     * ---
+     * @param `std::istream& in`, the stream holding the document, it has to outlive the reader
+     * ---
+     */
+    explicit JsonReader(std::istream& in);
+
+    /**
+     * Enter an array, its elements are iterated with `next_element`
+     * ---
+     * @exception `std::runtime_error`, thrown when the next value is not an array
+     * ---
+     */
+    void begin_array();
+
+    /**
+     * Move to the next element of the innermost array
+     * ---
+     * @return `bool element`, false when the array ended, its closing bracket is consumed
+     * ---
+     */
+    bool next_element();
+
+    /**
+     * Enter an object, its members are iterated with `next_key`
+     * ---
+     * @exception `std::runtime_error`, thrown when the next value is not an object
+     * ---
+     */
+    void begin_object();
+
+    /**
+     * Move to the next member of the innermost object, the value is to be read next
+     * ---
+     * @param `std::string& key`, set to the key of the member
+     * ---
+     * @return `bool member`, false when the object ended, its closing brace is consumed
+     * ---
+     */
+    bool next_key(std::string& key);
+
+    /**
+     * Read a string value, with its escapes resolved (`\uXXXX` is written as UTF-8)
+     * ---
+     * @exception `std::runtime_error`, thrown when the next value is not a string
+     * ---
+     */
+    std::string read_string();
+
+    /**
+     * Read an integral number value
+     * ---
+     * @exception `std::runtime_error`, thrown when the next value is not an integer or does not fit in 64 bits
+     * ---
+     */
+    int64_t read_integer();
+
+    /**
+     * Read a `true` / `false` value
+     * ---
+     * @exception `std::runtime_error`, thrown when the next value is not a boolean
+     * ---
+     */
+    bool read_bool();
+
+    /**
+     * Consume the next value if it is `null`
+     * ---
+     * @return `bool null`, whether a `null` was consumed
+     * ---
+     */
+    bool read_null();
+
+    /**
+     * Pass over the next value, containers included
+     * ---
+     */
+    void skip_value();
+
+    /**
+     * Whether only whitespace is left of the document
+     * ---
+     */
+    bool at_end();
+
+    /**
+     * Byte offset of the next character in the document
+     * ---
+     */
+    uint64_t offset() const;
+
+private:
+    char peek();
+    char get();
+    void expect(const char c);
+    void skip_whitespace();
+    void skip_literal(const char* literal);
+    [[noreturn]] void error(const std::string& message) const;
+
+    std::istream& in;
+    std::vector<char> buffer;
+    size_t position;
+    size_t filled;
+    uint64_t consumed;
+    // Per open container, whether no member was read from it yet
+    std::vector<bool> first_member;
+};
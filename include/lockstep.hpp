@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "farm.hpp"
+#include "mos6502.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * Amount of steps of each engine kept for the trace of a divergence
+ */
+const size_t LOCKSTEP_TRACE_WINDOW = 16;
+
+/**
+ * A way of executing programs on a `CPU`, compared against another one by `run_lockstep`
+ */
+struct LockstepEngine {
+    std::string name;
+    // Called once the program is loaded and the CPU reset, e.g. to enable `CPU::fuse_instructions`
+    std::function<void(CPU&)> prepare;
+    // Advance the CPU like `CPU::run_until`, however many instructions the engine executes at a time
+    std::function<StopReason(CPU&, uint64_t)> run_until;
+};
+
+/**
+ * The outcome of running one program on two engines in lockstep
+ */
+struct LockstepResult {
+    std::string name;
+    bool diverged;
+    // What differed at the first divergence (e.g. `X $05 != $06`), empty when the engines agreed
+    std::string divergence;
+    // The last `LOCKSTEP_TRACE_WINDOW` steps of both engines, up to and including the divergent one
+    std::vector<std::string> trace;
+    // Steps compared, cycles executed and how the reference engine stopped
+    uint64_t steps;
+    uint64_t cycles;
+    StopReason stop_reason;
+    // Rolling hash of the memory writes of the reference engine
+    uint64_t write_hash;
+};
+
+/**
+ * Look up one of the built-in engines:
+ *
+ *      - `interpreter`, `CPU::run_until` with every optimization off, the `switch` in `execute_instruction`
+ *      - `fused`, superinstructions (`CPU::fuse_instructions`)
+ *      - `idle`, idle loop skipping (`CPU::skip_idle_loops`)
+ *      - `fused-idle`, both
+ * ---
+ * @param `const std::string& name`, the name of the engine
+ * ---
+ * @return `LockstepEngine engine`, the engine
+ * ---
+ * @exception `std::invalid_argument`, thrown for an unknown name
+ * ---
+ */
+LockstepEngine lockstep_engine(const std::string& name);
+
+/**
+ * Run a program on two engines side by side and compare them after every step.
+ *
+ * A step of the candidate is a `run_until` with a deadline `step_cycles` ahead, which is a single instruction for
+ * an interpreter and a whole superinstruction, skipped loop or block for faster engines. The reference then executes
+ * single instructions until it caught up with the candidate's master clock. Both have to arrive at the same
+ * instruction boundary with the same registers, flags, cycle count and stop reason, and with the same memory writes:
+ * the bytes a step changed are found by comparing memory against a copy taken after the previous step and folded into
+ * a rolling hash per engine. The first difference ends the run, which is reported with a trace of the last steps.
+ * ---
+ * @param `const LockstepEngine& reference`, the engine trusted to be right, it has to be able to step single instructions
+ * @param `const LockstepEngine& candidate`, the engine under test
+ * @param `CPU& reference_cpu`, the CPU the reference runs on, brought to its power-on state first
+ * @param `CPU& candidate_cpu`, the CPU the candidate runs on, brought to its power-on state first
+ * @param `const FarmJob& job`, the program and its cycle budget
+ * @param `const uint64_t step_cycles`, cycles the candidate runs per step, at least 1
+ * ---
+ * @return `LockstepResult result`, whether and where the engines diverged
+ * ---
+ */
+LockstepResult run_lockstep(const LockstepEngine& reference, const LockstepEngine& candidate, CPU& reference_cpu,
+                            CPU& candidate_cpu, const FarmJob& job, const uint64_t step_cycles = 1);
+
+/**
+ * Lockstep comparison of two engines over batches of programs across all cores, scheduled like the `Farm` with one
+ * pair of reused CPUs per worker.
+ */
+class LockstepFarm {
+public:
+    /**
+     * Constructor, spawn the worker pool and allocate two CPUs per worker
+     * ---
+     * @param `const LockstepEngine& reference`, the engine trusted to be right
+     * @param `const LockstepEngine& candidate`, the engine under test
+     * @param `const unsigned int thread_count`, the amount of workers. 0 uses one worker per hardware thread
+     * ---
+     */
+    LockstepFarm(const LockstepEngine& reference, const LockstepEngine& candidate, const unsigned int thread_count = 0);
+
+    /**
+     * Compare the engines on every job of the batch with `run_lockstep`
+     * ---
+     * @param `const std::vector<FarmJob>& jobs`, the batch of programs
+     * @param `const uint64_t step_cycles`, cycles the candidate runs per step
+     * ---
+     * @return `std::vector<LockstepResult> results`, one result per job, in the same order as `jobs`
+     * ---
+     */
+    std::vector<LockstepResult> run(const std::vector<FarmJob>& jobs, const uint64_t step_cycles = 1);
+
+private:
+    LockstepEngine reference;
+    LockstepEngine candidate;
+    WorkStealingPool pool;
+    std::vector<std::unique_ptr<CPU>> reference_cpus;
+    std::vector<std::unique_ptr<CPU>> candidate_cpus;
+};
+
+/**
+ * Generate random programs of documented instructions. Jumps and branches land on instruction boundaries and stores
+ * stay below the program at `0x0600`, so the programs neither run into operand bytes nor overwrite themselves, but
+ * they do loop, call, push and pull freely. Every program ends with a `BRK`.
+ * ---
+ * @param `const size_t count`, the amount of programs
+ * @param `const uint64_t seed`, the seed, the same seed generates the same programs
+ * @param `const size_t instructions`, the amount of instructions per program
+ * @param `const uint64_t cycle_budget`, the budget of each job
+ * ---
+ * @return `std::vector<FarmJob> jobs`, the programs, named `random-<seed>-<index>`
+ * ---
+ */
+std::vector<FarmJob> random_lockstep_jobs(const size_t count, const uint64_t seed, const size_t instructions,
+                                          const uint64_t cycle_budget);
+
+/**
+ * Write a report with one line per result, the trace of every divergence and a summary of the batch
+ * ---
+ * @param `std::ostream& out`, the stream to write the report to
+ * @param `const std::vector<LockstepResult>& results`, the results to report on
+ * ---
+ */
+void write_lockstep_report(std::ostream& out, const std::vector<LockstepResult>& results);
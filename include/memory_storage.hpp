@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Size of the CPU address space in bytes (`0x0000` - `0xFFFF` inclusive)
+ */
+const size_t MEMORY_SIZE = 0x10000;
+
+/**
+ * Granularity of the write tracking of a memory space (`CPU::dirty_pages`), 64 pages of 1 KiB
+ */
+const size_t DIRTY_PAGE_SIZE = 0x400;
+const size_t DIRTY_PAGE_COUNT = MEMORY_SIZE / DIRTY_PAGE_SIZE;
+
+/**
+ * MemoryBacking enum for selecting how the memory space of a `CPU` is allocated
+ */
+enum MemoryBacking {
+    StandardPages,
+    HugePages,
+};
+
+/**
+ * Allocate a zero-initialized `MEMORY_SIZE` byte memory space.
+ *
+ * `StandardPages` maps the memory straight from the kernel, which hands out zeroed pages lazily so no explicit clear
+ * is needed. `HugePages` carves the memory out of shared 2 MiB slabs backed by huge pages (explicit `MAP_HUGETLB`
+ * pages when the system has them reserved, transparent huge pages otherwise), so that many CPU instances running
+ * side by side share a handful of TLB entries instead of 16 per instance.
+ * ---
+ * @param `const MemoryBacking backing`, the kind of pages to back the memory with
+ * ---
+ * @return `uint8_t* memory`, pointer to the zeroed memory space, 64 byte aligned
+ * ---
+ * @exception `std::bad_alloc`, thrown when the memory can not be mapped
+ * ---
+ */
+uint8_t* allocate_memory_space(const MemoryBacking backing);
+
+/**
+ * Release a memory space previously returned by `allocate_memory_space`.
+ * ---
+ * @param `uint8_t* memory`, the memory space to release
+ * @param `const MemoryBacking backing`, the backing it was allocated with
+ * ---
+ */
+void free_memory_space(uint8_t* memory, const MemoryBacking backing);
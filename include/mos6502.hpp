@@ -4,24 +4,9 @@
 #include <vector>
 #include <functional>
 
-/**
- * AddressingMode enum for code readability
- */
-enum AddressingMode {
-    Implied,
-    Immediate,
-    Relative,
-    Accumulator,
-    ZeroPage,
-    ZeroPageX,
-    ZeroPageY,
-    Absolute,
-    AbsoluteX,
-    AbsoluteY,
-    Indirect,
-    IndirectX,
-    IndirectY,
-};
+#include "memory_storage.hpp"
+#include "heatmap.hpp"
+#include "opcode.hpp"
 
 /**
  * Flag enum for easily accessing and updating specific status register flags
@@ -46,36 +31,155 @@ enum Mode {
 };
 
 /**
- * Structure for storing Opcodes and their associated meta-data.
+ * StopReason enum describing why a headless run of the CPU returned
  */
-struct Opcode {
-    short code;
-    short size;
-    short cycles;
-    AddressingMode mode;
-    std::string name;
+enum StopReason {
+    BudgetExhausted,
+    BreakInstruction,
+    // Stopped by an attached `Debugger`, see `Debugger::hit`
+    Breakpoint,
+    Watchpoint,
+};
 
-    /**
-     * Default Constructor
-     * ---
-     */
-    Opcode();
+/**
+ * DebugAccess enum for the kinds of accesses a breakpoint or watchpoint triggers on. Also used as the flags of the
+ * per-page table of a `Debugger`.
+ */
+enum DebugAccess {
+    ExecuteAccess = 0b00000001,
+    ReadAccess = 0b00000010,
+    WriteAccess = 0b00000100,
+};
 
-    /**
-     * Constructor, create an opcode with associated code, size, addressingmode, cycle count and name
-     * ---
-     * @param `const short code` the number (typically hex) associated with the opcode
-     * @param `const short size` the amount of bytes the opcode uses. This will be used to appropriately increase the program counter
-     * @param `const short cycles` the amount of cycles that the opcode uses to execute
-     * @param `const AddresssingMode mode` the addressingmode associated with the opcode
-     * @param `const std::string name` the mnemonic of the opcode
-     * ---
-     */
-    Opcode(short code,
-           short size,
-           short cycles,
-           AddressingMode mode,
-           std::string name);
+/**
+ * Amount of CPU cycles in a single NTSC frame (29780.5 cycles, rounded up). Used to express run budgets in frames.
+ */
+const uint32_t CYCLES_PER_FRAME = 29781;
+
+/**
+ * InterruptSource enum for the lines feeding `CPU::interrupt_pending`. Bit 0 is the latched NMI edge, the other bits
+ * are the IRQ sources which are wire-OR'ed into the level-triggered IRQ line.
+ */
+enum InterruptSource {
+    NmiLine = 0b00000001,
+    ApuFrameIrq = 0b00000010,
+    MapperIrq = 0b00000100,
+    ExternalIrq = 0b00001000,
+};
+
+/**
+ * Mask of the IRQ sources in `CPU::interrupt_pending`
+ */
+const uint8_t IRQ_SOURCES = ApuFrameIrq | MapperIrq | ExternalIrq;
+
+/**
+ * Outcome of analyzing the body of a loop closed by a backward branch, see `CPU::skip_idle_loop`
+ */
+struct IdleLoop {
+    // Whether iterations of the loop can be skipped
+    bool idle;
+    // The DEX / DEY / INX / INY counting the iterations of a counted loop, 0 for a spin or poll loop
+    uint8_t counter_opcode;
+    // Cycles of one taken iteration, branch included
+    uint32_t iteration_cycles;
+    // Instructions of one iteration, branch included
+    uint32_t iteration_instructions;
+};
+
+class Debugger;
+class RandomDevice;
+
+/**
+ * State that is only needed for debugging output, real-time pacing and the interrupt slow path, kept out of the hot
+ * part of `CPU`.
+ */
+struct CPUColdState {
+    // Duration of a single cycle in ns, used by `CPU::wait_cycle_count`
+    uint16_t cycle_duration;
+
+    // Master clock timestamps at which the NMI edge was latched and the IRQ line went low
+    uint64_t nmi_asserted_at;
+    uint64_t irq_asserted_at;
+    // Start of the last BRK / IRQ sequence, used to detect NMI hijacking
+    uint64_t interrupt_sequence_start;
+
+    // Attached access counters, only fed in builds with `HEATMAP_SUPPORTED`
+    MemoryHeatmap* heatmap;
+    // Attached breakpoints and watchpoints, see `CPU::attach_debugger`
+    Debugger* debugger;
+    // Attached random number register, see `CPU::attach_random_device`
+    RandomDevice* random_device;
+
+    // The last loop seen by `CPU::skip_idle_loop`, with the master clock at which its branch was last taken
+    uint16_t idle_branch_pc;
+    uint16_t idle_loop_start;
+    uint64_t idle_arrived_at;
+    IdleLoop idle_loop;
+    // Loop iterations fast-forwarded so far
+    uint64_t idle_iterations_skipped;
+
+    // Instructions executed and dispatches needed for them by `CPU::run_fused` so far
+    uint64_t fusion_instructions;
+    uint64_t fusion_dispatches;
+
+    // Serial of the snapshot the memory space matches outside of `CPU::dirty_pages` / `snapshot_pages`, 0 when it
+    // matches none
+    uint64_t snapshot_serial;
+
+    // `CPU::dirty_pages` is shared by snapshots and the state hash, whichever clears it first hands the pages over to
+    // the other one: pages written before the last state hash that snapshots still have to restore, and pages written
+    // before the last snapshot save / restore that the state hash still has to rehash
+    uint64_t snapshot_pages;
+    uint64_t unhashed_pages;
+    // `hash_memory_page` of every page as of the last `CPU::state_hash`
+    uint64_t page_hashes[DIRTY_PAGE_COUNT];
+};
+
+
+/**
+ * Saved registers and memory space of a `CPU`, see `CPU::save_snapshot` / `CPU::restore_snapshot`.
+ *
+ * Every save gets a new serial, a CPU restoring the snapshot it was last saved to or restored from only copies the pages
+ * it dirtied since, any other CPU copies the full memory space. The members are written by `CPU::save_snapshot` only,
+ * changing them in place would go unnoticed by CPUs already in sync with the snapshot.
+ */
+struct CPUSnapshot {
+    uint64_t serial;
+    uint64_t cycles;
+    uint16_t program_counter;
+    uint8_t stack_pointer;
+    uint8_t register_a;
+    uint8_t register_irx;
+    uint8_t register_iry;
+    uint8_t status;
+    bool halt_on_brk;
+    bool skip_idle_loops;
+    bool fuse_instructions;
+    // `MEMORY_SIZE` bytes
+    std::vector<uint8_t> memory;
+};
+
+
+class CPU;
+
+/**
+ * Run loop policy that does nothing.
+ *
+ * `CPU::step` and `CPU::run_until` take a policy that is notified around every executed instruction, which is how
+ * profilers and other instrumentation hook into the core. The policy is a template parameter, so the empty hooks of
+ * `NullPolicy` compile away and the plain run loop pays nothing for instrumentation it does not use. A policy
+ * provides:
+ *
+ *      - `void before_instruction(CPU& cpu, uint16_t pc, uint8_t opcode)`
+ *      - `void after_instruction(CPU& cpu, uint16_t pc, uint8_t opcode, uint64_t cycles)`, `cycles` being the
+ *        amount of cycles the instruction took
+ *      - `void after_interrupt(CPU& cpu, uint64_t cycles)`, called after a NMI / IRQ sequence was executed instead of
+ *        an instruction, with the program counter at the handler
+ */
+struct NullPolicy {
+    void before_instruction(CPU&, uint16_t, uint8_t) {}
+    void after_instruction(CPU&, uint16_t, uint8_t, uint64_t) {}
+    void after_interrupt(CPU&, uint64_t) {}
 };
 
 
@@ -106,36 +210,68 @@ struct Opcode {
  *
  *  TODO: Add more relevant values to the CPU memory map, including mirrors, PPU registers and APU registers
  *
- *  The memory is represented as a stack allocated array with `0xFFFF` elements. The following ranges are of special note:
+ *  The memory is a separately allocated block of `MEMORY_SIZE` (`0x10000`) bytes. The following ranges are of special note:
  *
  *      - `0x0000` - `0x0100` (256 B), The Zero-Page
  *      - `0x0100` - `0x01FF` (256 B), The stack
  *      - `0x6000` - `0x7FFF` (4 kB), Cartridge RAM (when present)
  *      - `0x8000` - `0xFFFF` (16 kB), The cartridge ROM and mapper registers
+ *
+ * ---
+ *
+ * The object itself only holds the state touched by every instruction and fits in a single cache line. Debug-only
+ * and slow-path state lives in a separately allocated `CPUColdState` and the memory space in a separately mapped block (optionally
+ * backed by huge pages), so that running many instances side by side does not drag 64 KiB of memory through the
+ * cache for every register access.
  */
-class CPU {
+class alignas(64) CPU {
 public:
+    // Hot execution state, kept together on the first cache line
+    uint8_t* memory;
+    // Master clock, counts CPU cycles since reset. 64-bit so it does not wrap within any realistic session
+    uint64_t cycles;
     uint16_t program_counter;
     uint8_t stack_pointer;
     uint8_t register_a;
     uint8_t register_irx;
     uint8_t register_iry;
     uint8_t status;
-    uint32_t cycles;
-
-    // These should be private
-    uint16_t fetched_data;
-    uint16_t cycle_duration;
 
-    // This might give a warning for some compilers as a large amount of data 
-    // is allocated on the stack. First 256 bytes (0x0100) reserved as the zero page
-    // Which has faster access times.
-    uint8_t memory[0xFFFF];
+    // Combined pending-interrupt word, see `InterruptSource`. Zero on the fast path.
+    uint8_t interrupt_pending;
+    // Current level of the NMI input, used for edge detection
+    bool nmi_line;
+    // Treat `BRK` as the end of the program (easy6502 convention) instead of a software interrupt
+    bool halt_on_brk;
+    // Set by `get_operand_address` when an indexed operand crossed a page, charged by read instructions
+    uint8_t page_crossed;
+    // Let `run_until` / `run_for` fast-forward through idle loops, see `CPU::skip_idle_loop`
+    bool skip_idle_loops;
+    // Let `run_until` / `run_for` execute common instruction sequences as superinstructions, see `CPU::run_fused`
+    bool fuse_instructions;
+    // One bit per `DIRTY_PAGE_SIZE` page of memory written since the last snapshot save / restore or state hash. Writes
+    // through `memory_write` mark their page, code writing to `memory` directly has to call `mark_dirty` itself
+    uint64_t dirty_pages;
+
+    // Cold state, only dereferenced for logging, pacing and interrupt handling
+    CPUColdState* cold;
+    MemoryBacking memory_backing;
 
     /**
      * Default constructor, initialize the PC, SP, registers, status register and memory space to all zeros
+     * ---
+     * @param `const MemoryBacking backing`, the kind of pages the memory space is allocated from
+     * ---
+     */
+    CPU(const MemoryBacking backing = MemoryBacking::StandardPages);
+
+    /**
+     * Destructor, releases the memory space and the cold state
      */
-    CPU();
+    ~CPU();
+
+    CPU(const CPU&) = delete;
+    CPU& operator=(const CPU&) = delete;
 
     /**
      * Read memory from a specified address.
@@ -179,6 +315,75 @@ public:
      */
     void memory_write_uint16(const uint16_t addr, const uint16_t data);
 
+    /**
+     * Mark the page holding `addr` as written, for code writing to `CPU::memory` directly
+     * ---
+     * @param `const uint16_t addr`, the address written to
+     * ---
+     */
+    void mark_dirty(const uint16_t addr) {
+        this->dirty_pages |= (uint64_t)1 << (addr / DIRTY_PAGE_SIZE);
+    }
+
+    /**
+     * Mark the pages of the address range `first` - `last` (inclusive) as written
+     * ---
+     * @param `const uint16_t first`, the first address written to
+     * @param `const uint16_t last`, the last address written to
+     * ---
+     */
+    void mark_dirty(const uint16_t first, const uint16_t last);
+
+    /**
+     * Fetch the opcode byte at `pc` for execution. Same as `memory_read`, except that an attached heatmap counts it
+     * as an execute instead of a read.
+     * ---
+     * @param `const uint16_t pc`, the address of the instruction
+     * ---
+     * @return `uint8_t opcode`, the opcode stored at `pc`
+     * ---
+     */
+    uint8_t fetch_opcode(const uint16_t pc) const {
+        #ifdef NES_MEMORY_HEATMAP
+        if (this->cold->heatmap != nullptr) {
+            this->cold->heatmap->record_execute(pc);
+        }
+        #endif
+        return this->memory[pc];
+    }
+
+    /**
+     * Attach a heatmap to be fed with every memory access from now on, or detach it by passing `nullptr`. The heatmap
+     * is not owned by the CPU and has to outlive the attachment.
+     * ---
+     * @param `MemoryHeatmap* heatmap`, the heatmap to feed, or `nullptr`
+     * ---
+     * @exception `std::runtime_error`, thrown when attaching to a build without `HEATMAP_SUPPORTED`
+     * ---
+     */
+    void attach_heatmap(MemoryHeatmap* heatmap);
+
+    /**
+     * Attach a debugger whose breakpoints and watchpoints stop `CPU::run`, `CPU::run_until` and `CPU::run_for` from
+     * now on, or detach it by passing `nullptr`. The debugger is not owned by the CPU, it detaches itself when
+     * destroyed.
+     * ---
+     * @param `Debugger* debugger`, the debugger to attach, or `nullptr`
+     * ---
+     */
+    void attach_debugger(Debugger* debugger);
+
+    /**
+     * Attach a random device that refreshes its register before every instruction of `CPU::run`, `CPU::run_until`,
+     * `CPU::run_for` and the engines built on them (`Scheduler::run`, `run_recompiled`, `Debugger`), or detach it by
+     * passing `nullptr`. The overloads taking a run loop policy leave it out, pass the device as (part of) the policy
+     * there, see `WithRandomDevice`. The device is not owned by the CPU and has to outlive the attachment.
+     * ---
+     * @param `RandomDevice* random_device`, the device to refresh, or `nullptr`
+     * ---
+     */
+    void attach_random_device(RandomDevice* random_device);
+
     /**
      * Load a program to the memory space reserved to cartridge ROM. The program gets written to the range
      * `0x8000` - `0xFFFF` of the `CPU.memory` array.
@@ -242,7 +447,7 @@ public:
 
     /**
      * A special subroutine that gets called when a cartridge is inserted (and hence when program gets loaded). Resets
-     * the state of the CPU registers and sets the program counter to `0xFFFC`.
+     * the state of the CPU registers and the stack pointer and sets the program counter to the address stored at `0xFFFC`.
      * ---
      */
     void reset();
@@ -252,9 +457,40 @@ public:
      * ---
      */
     void reset_memory_space();
+
+    /**
+     * Save the registers, the run loop switches and the memory space to `snapshot`, giving it a new serial. The CPU
+     * is in sync with the snapshot afterwards.
+     * ---
+     * @param `CPUSnapshot& snapshot`, the snapshot to overwrite
+     * ---
+     */
+    void save_snapshot(CPUSnapshot& snapshot);
+
+    /**
+     * Bring the CPU back to a saved state: registers, master clock and run loop switches are restored, pending
+     * interrupts and idle loop / fusion statistics are dropped and the memory space is restored. Only the dirty pages are copied when the CPU is in sync
+     * with `snapshot`, which makes resetting a CPU after a short run far cheaper than clearing 64 KiB.
+     * ---
+     * @param `const CPUSnapshot& snapshot`, the snapshot to restore, saved by any CPU
+     * ---
+     */
+    void restore_snapshot(const CPUSnapshot& snapshot);
+
+    /**
+     * Hash the registers and the memory space, incrementally: only the pages written since the last call are hashed
+     * again (see `hash_memory_page`), the hashes of the other pages are kept from earlier calls. Same value as
+     * `hash_cpu_state` as long as every write to `memory` was marked dirty, which is what makes hashing every frame
+     * of a game nearly free.
+     * ---
+     * @return `uint64_t hash`, the hash of the CPU state
+     * ---
+     */
+    uint64_t state_hash();
     
     /**
-     * Execute the OPCODE passed in.
+     * Execute the OPCODE passed in, with the program counter pointing past the opcode byte. The cycle cost is taken
+     * from `OPCODES`, including the page-cross penalty, branch penalties are added by `branch`.
      * ---
      *  @param `uint8_t opcode`, the numerical value corresponding to the opcode to be executed
      * ---
@@ -279,6 +515,178 @@ public:
      */
     void run();
 
+    /**
+     * Execute the single instruction the program counter points to, without logging or pacing. A `BRK` (`0x00`) is not
+     * executed and ends the program in the same way as `CPU::run`. An attached random device is refreshed first.
+     * ---
+     * @return `bool running`, false if the program counter points at a `BRK` instruction
+     * ---
+     */
+    bool step();
+
+    /**
+     * Overload of `CPU::step` notifying a run loop policy (see `NullPolicy`) around the executed instruction
+     * ---
+     * @param `Policy& policy`, the policy to notify
+     * ---
+     * @return `bool running`, false if the program counter points at a `BRK` instruction
+     * ---
+     */
+    template <typename Policy>
+    bool step(Policy& policy);
+
+    /**
+     * Drive the NMI input. NMI is edge-triggered: raising the line latches a pending NMI, which is serviced on the first
+     * instruction boundary at least 2 cycles after `timestamp` (the 6502 polls its interrupt inputs before the last
+     * cycle of an instruction). Keeping the line high does not trigger further NMIs. An NMI raised before the vector
+     * fetch of a `BRK` or IRQ sequence hijacks that sequence, which then jumps through the NMI vector instead.
+     * ---
+     * @param `const bool asserted`, the new level of the line
+     * @param `const uint64_t timestamp`, master clock timestamp of the change. Scheduler handlers pass the event timestamp
+     * ---
+     */
+    void set_nmi_line(const bool asserted, const uint64_t timestamp);
+
+    /**
+     * Overload of `CPU::set_nmi_line` changing the line at the current master clock timestamp
+     * ---
+     */
+    void set_nmi_line(const bool asserted);
+
+    /**
+     * Drive one of the IRQ sources. IRQ is level-triggered: it is serviced on every instruction boundary (at least 2
+     * cycles after the line went low) for as long as a source is asserted and the InteruptDisable flag is clear.
+     * ---
+     * @param `const InterruptSource source`, the IRQ source to change
+     * @param `const bool asserted`, the new level of the source
+     * @param `const uint64_t timestamp`, master clock timestamp of the change
+     * ---
+     */
+    void set_irq_line(const InterruptSource source, const bool asserted, const uint64_t timestamp);
+
+    /**
+     * Overload of `CPU::set_irq_line` changing the source at the current master clock timestamp
+     * ---
+     */
+    void set_irq_line(const InterruptSource source, const bool asserted);
+
+    /**
+     * Slow path of the instruction boundary, only called when `interrupt_pending` is non-zero. Services a pending NMI,
+     * or an unmasked IRQ, when the 6502 would have recognized it by now.
+     * ---
+     * @return `bool serviced`, true if an interrupt sequence was executed instead of the next instruction
+     * ---
+     */
+    bool poll_interrupts();
+
+    /**
+     * The 7 cycle interrupt sequence shared by `BRK`, IRQ and NMI. Pushes the program counter and the status register
+     * (with the Break flag set only for `BRK`), sets the InteruptDisable flag and loads the program counter from the
+     * vector. `BRK` and IRQ jump through the NMI vector instead when a pending NMI hijacks the sequence.
+     * ---
+     * @param `const uint16_t vector`, address of the interrupt vector (`0xFFFA` NMI, `0xFFFE` IRQ/BRK)
+     * @param `const bool software`, true when called for `BRK`
+     * ---
+     */
+    void interrupt_sequence(const uint16_t vector, const bool software);
+
+    /**
+     * Run the CPU headless (no logging, no pacing) until the program hits a `BRK` or at least `cycle_budget` cycles
+     * have been executed. The budget is checked on instruction boundaries so the run may overshoot it by the length
+     * of the last instruction.
+     * ---
+     * @param `const uint64_t cycle_budget`, the amount of cycles to run for
+     * ---
+     * @return `StopReason reason`, whether the run ended on the budget or on a `BRK`
+     * ---
+     */
+    StopReason run_for(const uint64_t cycle_budget);
+
+    /**
+     * Run the CPU headless until the program hits a `BRK` or the master clock reaches `deadline`. This is the inner
+     * loop used by the `Scheduler`, which passes the timestamp of the next pending device event, so no device is
+     * polled while instructions execute. The deadline is checked on instruction boundaries. With `skip_idle_loops`
+     * set, idle loops are fast-forwarded towards the deadline (see `CPU::skip_idle_loop`), with `fuse_instructions`
+     * set, common instruction sequences are executed as superinstructions (see `CPU::run_fused`). While a debugger is
+     * attached, the run is handed to `Debugger::run_until` instead, which stops on its breakpoints and watchpoints.
+     * While a random device is attached, instructions run one at a time with the device refreshing its register in
+     * front of each, so nothing is fused; idle loops are still skipped, the device is advanced past the skipped
+     * instructions.
+     * ---
+     * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+     * ---
+     * @return `StopReason reason`, whether the run ended on the deadline, on a `BRK` or on a breakpoint / watchpoint
+     * ---
+     */
+    StopReason run_until(const uint64_t deadline);
+
+    /**
+     * Overload of `CPU::run_until` notifying a run loop policy (see `NullPolicy`) around every executed instruction
+     * ---
+     * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+     * @param `Policy& policy`, the policy to notify
+     * ---
+     * @return `StopReason reason`, whether the run ended on the deadline or on a `BRK`
+     * ---
+     */
+    template <typename Policy>
+    StopReason run_until(const uint64_t deadline, Policy& policy);
+
+    /**
+     * Fast-forward through an idle loop, called by `run_until` / `run_for` when `skip_idle_loops` is set, right after
+     * the backward branch at `branch_pc` was taken.
+     *
+     * A loop qualifies when its body only holds `NOP`, flag instructions, non-indexed loads, compares and `BIT`, and at
+     * most one `DEX` / `DEY` / `INX` / `INY` counting the iterations of a `BNE` loop. Such a loop writes nothing to
+     * memory, and with a counter, only the counter changes from one iteration to the next. Spin and poll loops (no
+     * counter) end up in the same state after every iteration, counted loops in a state that follows from the counter.
+     *
+     * Iterations are only skipped once a full iteration ran uninterrupted within the same run, and only whole
+     * iterations that end at or before `deadline`, so the CPU ends up in exactly the state plain interpretation
+     * would have reached on the same instruction boundary. Nothing is skipped while an interrupt is pending or a
+     * heatmap is attached. With a random device attached, loops reading its register are not idle, and the device
+     * draws the values of the skipped instructions, so its sequence stays that of plain interpretation.
+     * ---
+     * @param `const uint16_t branch_pc`, the address of the taken backward branch
+     * @param `const uint64_t deadline`, the deadline of the run
+     * ---
+     */
+    void skip_idle_loop(const uint16_t branch_pc, const uint64_t deadline);
+
+    /**
+     * The run loop behind `run_until` when `fuse_instructions` is set. Common instruction sequences are executed as a
+     * single superinstruction, with one dispatch instead of one per instruction:
+     *
+     *      - `LDA` (any mode) followed by `STA` (any mode)
+     *      - `LDA zp`, `CLC`, `ADC` (immediate, zero page or absolute)
+     *      - `CMP #imm`, `BNE`
+     *      - `DEX` / `DEY`, `BNE`
+     *      - `INX` / `INY`, `CPX #imm` / `CPY #imm`, optionally followed by `BNE`
+     *
+     * The parts of a superinstruction run through the same instruction functions as `execute_instruction`, so flags
+     * and cycles are exactly those of plain interpretation. The deadline is still checked after every part, and
+     * nothing is fused while an interrupt is pending, so runs stop on and service interrupts at the same
+     * instruction boundaries. A sequence is decoded every time it is executed, so self-modifying code is handled too.
+     * ---
+     * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+     * ---
+     * @return `StopReason reason`, whether the run ended on the deadline or on a `BRK`
+     * ---
+     */
+    template <bool skip_idle>
+    StopReason run_fused(const uint64_t deadline);
+
+    /**
+     * Decode the loop body from `loop_start` up to the branch at `branch_pc` and decide whether it can be skipped
+     * ---
+     * @param `const uint16_t loop_start`, the branch target
+     * @param `const uint16_t branch_pc`, the address of the backward branch closing the loop
+     * ---
+     * @return `IdleLoop loop`, the outcome of the analysis
+     * ---
+     */
+    IdleLoop analyze_loop(const uint16_t loop_start, const uint16_t branch_pc) const;
+
 
     void wait_cycle_count(uint8_t cycles);
 
@@ -365,7 +773,8 @@ public:
 
     /**
      * BReaK, forces the generation of an interupt request. Program counter and processor status are pushed to the stack,
-     * then the IRQ interrupt vector at 0xFFFE/F is loaded into the PC and the break flag is set.
+     * then the IRQ interrupt vector at 0xFFFE/F is loaded into the PC and the break flag is set. Only executed when
+     * `halt_on_brk` is false, otherwise the run loops stop at the `BRK`.
      * ---
      */
     void BRK();
@@ -590,8 +999,6 @@ public:
 
     /**
      * ReTurn from Interrupt, pulls processor status and program counter from the stack
-     *
-     * TODO
      * ---
      */
     void RTI();
@@ -701,12 +1108,13 @@ public:
     void NOP();
 
     /**
-     * Branch to a new location. Fetch the address to branch to.
+     * Fetch the relative operand and branch to it when the condition holds. A taken branch costs one extra cycle,
+     * and another one when the target lies on a different page than the next instruction.
      * ---
-     * @return `uint16_t jmp_addr`, address to jump to
+     * @param `const bool condition`, whether the branch is taken
      * ---
      */
-    uint16_t branch();
+    void branch(const bool condition);
 
     /**
      * Compare an operand and register value, setting zero, negative and overflow flags
@@ -751,7 +1159,8 @@ public:
     void update_flag(const Flag flag, const Mode mode);
 
     /**
-     * Get the address of some operand in memory based on the addressingmode,
+     * Get the address of some operand in memory based on the addressingmode. Advances the program counter past the
+     * operand bytes and sets `page_crossed` when indexing moved the address to another page.
      * ---
      * @param `const AddressingMode mode`, the addressing mode to be used for fetching the operand.
      * ---
@@ -794,15 +1203,51 @@ public:
     void hex_dump_rom();
 
     /**
-    * Function for debugging and printing purposes. Does a formatted print fo the opcode
-    * and it's operand.
+    * Function for debugging and printing purposes. Prints the instruction at `pc` as a listing line (see
+    * `disassemble_line`).
     * ---
-    * @param `const Opcode opc`, the 1 byte value to be printed as a binary string
+    * @param `const uint16_t pc`, the address of the instruction to print
     * ---
     */
-    void log_instruction(const uint16_t pc, const Opcode opc) const;
+    void log_instruction(const uint16_t pc) const;
 };
 
+template <typename Policy>
+bool CPU::step(Policy& policy) {
+    // The only interrupt cost on the fast path is this single, almost never taken, branch
+    if (this->interrupt_pending != 0) {
+        const uint64_t interrupted_at = this->cycles;
+        if (this->poll_interrupts()) {
+            policy.after_interrupt(*this, this->cycles - interrupted_at);
+            return true;
+        }
+    }
+
+    const uint16_t pc = this->program_counter;
+    const uint8_t opcode = this->fetch_opcode(pc);
+    if (opcode == 0x00 && this->halt_on_brk) {
+        return false;
+    }
+    const uint64_t started_at = this->cycles;
+    policy.before_instruction(*this, pc, opcode);
+    this->program_counter += 1;
+    this->execute_instruction(opcode);
+    policy.after_instruction(*this, pc, opcode, this->cycles - started_at);
+    return true;
+}
+
+
+template <typename Policy>
+StopReason CPU::run_until(const uint64_t deadline, Policy& policy) {
+    while (this->cycles < deadline) {
+        if (!this->step(policy)) {
+            return StopReason::BreakInstruction;
+        }
+    }
+    return StopReason::BudgetExhausted;
+}
+
+
 /**
 * Function for debugging and printing purposes. Prints a uint8_t variable as the bitstring representation
 * ---
@@ -0,0 +1,324 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+#include "random_device.hpp"
+
+/**
+ * Version of the movie file format written by `write_movie`, files of other versions are rejected
+ */
+const uint32_t MOVIE_VERSION = 1;
+
+/**
+ * Save state embedded in a movie, the state of the machine right before a frame was emulated
+ */
+struct MovieKeyframe {
+    // The frame emulated next from this state
+    uint32_t frame;
+    // State of the `RandomDevice`
+    uint32_t rng;
+    CPUSnapshot state;
+};
+
+/**
+ * An input movie: everything that went into a run of a program, enough to reproduce it bit for bit.
+ *
+ * A frame is `CYCLES_PER_FRAME` cycles, frame `n` runs until `CPU::cycles` reaches `(n + 1) * CYCLES_PER_FRAME`. The
+ * key pressed during a frame is written to `0x00FF` before it is emulated, and a `RandomDevice` feeds `0x00FE` (what
+ * the snake game expects). The state hash of the machine is stored every
+ * `hash_interval` frames to verify playback against, and a keyframe every `keyframe_interval` frames to start
+ * playback from.
+ */
+struct Movie {
+    // The program loaded at `0x0600` before the reset
+    std::vector<uint8_t> program;
+    // Seed of the `RandomDevice`, never zero
+    uint32_t rng_seed;
+    uint32_t hash_interval;
+    uint32_t keyframe_interval;
+    // Key pressed per frame, 0 for frames without a key press (`0x00FF` keeps the last key then)
+    std::vector<uint8_t> keys;
+    // State hash after every `hash_interval` frames, `hashes[i]` after frame `(i + 1) * hash_interval - 1`
+    std::vector<uint64_t> hashes;
+    // Keyframe `i` is the state before frame `i * keyframe_interval`, the first one the state after the reset
+    std::vector<MovieKeyframe> keyframes;
+};
+
+/**
+ * Hash of the state a movie is verified against: `hash_cpu_state` with the state of the random value generator mixed in
+ * ---
+ * @param `const CPU& cpu`, the CPU to hash
+ * @param `const uint32_t rng`, the state of the random value generator
+ * ---
+ * @return `uint64_t hash`, the hash of the state
+ * ---
+ */
+uint64_t movie_state_hash(const CPU& cpu, const uint32_t rng);
+
+/**
+ * The machine a movie is recorded and played back on: a CPU running a program frame by frame with the inputs of the
+ * movie
+ */
+class MovieMachine {
+public:
+    /**
+     * Load the program and reset the CPU, the machine is then about to emulate frame 0
+     * ---
+     * @param `const std::vector<uint8_t>& program`, the program, loaded at `0x0600`
+     * @param `const uint32_t rng_seed`, the initial state of the random value generator
+     * ---
+     * @exception `std::invalid_argument`, thrown when the seed is zero, which xorshift never leaves
+     * ---
+     */
+    void start(const std::vector<uint8_t>& program, const uint32_t rng_seed);
+
+    /**
+     * Emulate the next frame, with the key pressed at its start. After a `BRK` every frame leaves the state as it is.
+     * ---
+     * @param `const uint8_t key`, the key written to `0x00FF`, 0 to leave it as it is
+     * ---
+     */
+    void run_frame(const uint8_t key);
+
+    /**
+     * Save the state before the next frame to a keyframe
+     * ---
+     */
+    void save_keyframe(MovieKeyframe& keyframe);
+
+    /**
+     * Restore the state of a keyframe, the machine is then about to emulate its frame
+     * ---
+     */
+    void restore_keyframe(const MovieKeyframe& keyframe);
+
+    /**
+     * `movie_state_hash` of the current state, with the memory hashed incrementally (see `CPU::state_hash`)
+     * ---
+     */
+    uint64_t state_hash();
+
+    /**
+     * Compare the current state with a keyframe: frame, random value generator, registers, cycles and memory
+     * ---
+     * @return `bool matches`, true when the state is exactly that of the keyframe
+     * ---
+     */
+    bool matches_keyframe(const MovieKeyframe& keyframe) const;
+
+    /**
+     * The frame emulated next
+     * ---
+     */
+    uint32_t frame() const;
+
+    CPU cpu;
+
+private:
+    RandomDevice random;
+    uint32_t next_frame;
+};
+
+/**
+ * Records a movie while a program runs. The caller decides the key of every frame, e.g. from the keyboard.
+ */
+class MovieRecorder {
+public:
+    /**
+     * Constructor, starts the program and saves the first keyframe
+     * ---
+     * @param `const std::vector<uint8_t>& program`, the program, loaded at `0x0600`
+     * @param `const uint32_t rng_seed`, the initial state of the random value generator, not zero
+     * @param `const uint32_t hash_interval`, frames between two state hashes
+     * @param `const uint32_t keyframe_interval`, frames between two keyframes
+     * ---
+     * @exception `std::invalid_argument`, thrown when the seed or one of the intervals is zero
+     * ---
+     */
+    MovieRecorder(const std::vector<uint8_t>& program, const uint32_t rng_seed, const uint32_t hash_interval = 60,
+                  const uint32_t keyframe_interval = 600);
+
+    /**
+     * Emulate and record the next frame
+     * ---
+     * @param `const uint8_t key`, the key pressed during the frame, 0 for none
+     * ---
+     */
+    void frame(const uint8_t key);
+
+    /**
+     * The movie recorded so far
+     * ---
+     */
+    const Movie& movie() const;
+
+    /**
+     * The CPU the movie is recorded on, to show the state of the game
+     * ---
+     */
+    const CPU& cpu() const;
+
+private:
+    MovieMachine machine;
+    Movie recorded;
+};
+
+/**
+ * Outcome of playing a movie back
+ */
+struct MovieCheck {
+    // Frames emulated and state hashes compared
+    uint32_t frames;
+    uint32_t hashes;
+    // The first state hash that did not match, after frame `desync_frame`
+    bool desynced;
+    uint32_t desync_frame;
+    uint64_t expected_hash;
+    uint64_t actual_hash;
+};
+
+/**
+ * Plays a movie back headless, as fast as the CPU runs, and verifies the state against the hashes of the movie along
+ * the way. `seek` jumps to any frame by restoring the keyframe before it and emulating the frames in between.
+ */
+class MoviePlayer {
+public:
+    /**
+     * Constructor, the player starts at frame 0. The movie is not copied and has to outlive the player.
+     * ---
+     * @param `const Movie& movie`, the movie to play
+     * ---
+     * @exception `std::invalid_argument`, thrown when the movie has no first keyframe
+     * ---
+     */
+    explicit MoviePlayer(const Movie& movie);
+
+    /**
+     * Emulate the next frame and compare the state hash when the movie has one for it
+     * ---
+     * @return `bool playing`, false once the movie ended or went out of sync, without emulating anything
+     * ---
+     */
+    bool frame();
+
+    /**
+     * Play the remaining frames, stopping on the first state hash that does not match
+     * ---
+     * @return `const MovieCheck& check`, the outcome of the playback
+     * ---
+     */
+    const MovieCheck& play();
+
+    /**
+     * Play the segment of the movie from a keyframe up to the next one (or the end of the movie), always starting from
+     * the keyframe itself. Besides the state hashes on the way, the state reached has to be exactly that of the next
+     * keyframe, a mismatch there counts as a desync after the last frame of the segment.
+     * ---
+     * @param `const size_t keyframe`, index of the keyframe the segment starts at
+     * ---
+     * @return `const MovieCheck& check`, the outcome of the segment alone
+     * ---
+     * @exception `std::out_of_range`, thrown when the movie has no such keyframe
+     * ---
+     */
+    const MovieCheck& play_segment(const size_t keyframe);
+
+    /**
+     * Move to a frame, forward or backward, from the closest keyframe before it or the current frame when that is closer.
+     * State hashes on the way are verified, the seek stops early on one that does not match.
+     * ---
+     * @param `const uint32_t frame`, the frame to emulate next, up to the amount of frames in the movie
+     * ---
+     * @exception `std::out_of_range`, thrown when the movie is shorter
+     * ---
+     */
+    void seek(const uint32_t frame);
+
+    /**
+     * The frame emulated next
+     * ---
+     */
+    uint32_t position() const;
+
+    /**
+     * The outcome of the playback since the start, or since `seek` last restored a keyframe
+     * ---
+     */
+    const MovieCheck& check() const;
+
+    /**
+     * The CPU the movie plays on
+     * ---
+     */
+    const CPU& cpu() const;
+
+private:
+    const Movie& movie;
+    MovieMachine machine;
+    MovieCheck result;
+};
+
+/**
+ * Play a movie from start to end and verify it against its state hashes
+ * ---
+ * @param `const Movie& movie`, the movie to verify
+ * ---
+ * @return `MovieCheck check`, the outcome of the playback
+ * ---
+ */
+MovieCheck verify_movie(const Movie& movie);
+
+/**
+ * Verify a movie segment by segment in parallel (see `MoviePlayer::play_segment`), one segment per task on a
+ * `WorkStealingPool` with one player per worker. Segments are independent, so the time taken goes down with the
+ * amount of workers as long as there are segments left, and a desync is pinned to the segment it happened in.
+ * ---
+ * @param `const Movie& movie`, the movie to verify
+ * @param `const unsigned int thread_count`, the amount of workers. 0 uses one worker per hardware thread
+ * ---
+ * @return `std::vector<MovieCheck> segments`, the outcome per segment, in the order of the keyframes
+ * ---
+ */
+std::vector<MovieCheck> verify_movie_segments(const Movie& movie, const unsigned int thread_count = 0);
+
+/**
+ * Write a movie in its binary file format: a header with the program and the settings, the keys as run lengths, the
+ * state hashes and the keyframes with their memory run-length encoded. All numbers are little-endian.
+ * ---
+ * @param `std::ostream& out`, the stream to write to, opened in binary mode
+ * @param `const Movie& movie`, the movie to write
+ * ---
+ */
+void write_movie(std::ostream& out, const Movie& movie);
+
+/**
+ * Read a movie written by `write_movie`
+ * ---
+ * @param `std::istream& in`, the stream to read from, opened in binary mode
+ * ---
+ * @return `Movie movie`, the movie
+ * ---
+ * @exception `std::runtime_error`, thrown when the stream does not hold a movie of this version or is cut short
+ * ---
+ */
+Movie read_movie(std::istream& in);
+
+/**
+ * `write_movie` to a file
+ * ---
+ * @exception `std::runtime_error`, thrown when the file can not be written
+ * ---
+ */
+void save_movie(const std::string& path, const Movie& movie);
+
+/**
+ * `read_movie` from a file
+ * ---
+ * @exception `std::runtime_error`, thrown when the file can not be opened or does not hold a movie
+ * ---
+ */
+Movie load_movie(const std::string& path);
@@ -1,34 +1,86 @@
 #pragma once
-#include <map>
-#include <string>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * AddressingMode enum for code readability
+ */
+enum AddressingMode {
+    Implied,
+    Immediate,
+    Relative,
+    Accumulator,
+    ZeroPage,
+    ZeroPageX,
+    ZeroPageY,
+    Absolute,
+    AbsoluteX,
+    AbsoluteY,
+    Indirect,
+    IndirectX,
+    IndirectY,
+};
+
+/**
+ * Amount of addressing modes
+ */
+const size_t ADDRESSING_MODE_COUNT = 13;
+
+/**
+ * Names of the addressing modes as spelled in `AddressingMode`, indexed by it
+ */
+extern const char* const MODE_NAMES[ADDRESSING_MODE_COUNT];
 
 /**
  * Structure for storing Opcodes and their associated meta-data.
+ *
+ * The base cycle count excludes the penalties that depend on the operand: one extra cycle when `page_penalty` is set
+ * and the indexed address crosses a page, and for branches one extra cycle when taken plus another one when the
+ * target lies on a different page than the next instruction.
  */
-class Opcode {
-    short code;
-    short size;
-    short cycles;
+struct Opcode {
+    uint8_t code;
+    uint8_t size;
+    uint8_t cycles;
+    bool page_penalty;
     AddressingMode mode;
-    std::string name;
+    const char* name;
+
+    /**
+     * Default Constructor, describes an opcode that is not part of the documented instruction set
+     * ---
+     */
+    constexpr Opcode()
+        : code(0), size(0), cycles(2), page_penalty(false), mode(AddressingMode::Implied), name("???") {}
 
     /**
      * Constructor, create an opcode with associated code, size, addressingmode, cycle count and name
      * ---
-     * @param `const short code` the number (typically hex) associated with the opcode
-     * @param `const short size` the amount of bytes the opcode uses. This will be used to appropriately increase the program counter
-     * @param `const short cycles` the amount of cycles that the opcode uses to execute
+     * @param `const uint8_t code` the number (typically hex) associated with the opcode
+     * @param `const uint8_t size` the amount of bytes the opcode uses, including the opcode itself
+     * @param `const uint8_t cycles` the amount of cycles that the opcode uses to execute without penalties
      * @param `const AddresssingMode mode` the addressingmode associated with the opcode
-     * @param `const std::string name` the mnemonic of the opcode
+     * @param `const char* name` the mnemonic of the opcode
+     * @param `const bool page_penalty` whether an indexed operand crossing a page costs an extra cycle
      * ---
      */
-    Opcode(short code,
-           short size,
-           short cycles,
-           AddressingMode mode,
-           std::string name);
+    constexpr Opcode(const uint8_t code,
+                     const uint8_t size,
+                     const uint8_t cycles,
+                     const AddressingMode mode,
+                     const char* name,
+                     const bool page_penalty)
+        : code(code), size(size), cycles(cycles), page_penalty(page_penalty), mode(mode), name(name) {}
 };
 
-const std::map<int, Opcode> create_opcode_table();
-
+/**
+ * Amount of entries in the opcode table, one for every possible opcode byte
+ */
+const size_t OPCODE_COUNT = 0x100;
 
+/**
+ * Authoritative opcode table, indexed by the opcode byte. Undocumented opcodes keep the default `Opcode` with a size
+ * of 0.
+ */
+extern const std::array<Opcode, OPCODE_COUNT> OPCODES;
@@ -0,0 +1,100 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "memory_storage.hpp"
+#include "mos6502.hpp"
+#include "opcode.hpp"
+
+/**
+ * Execution profiler, a run loop policy (see `NullPolicy`) counting executions and cycles per opcode and per program
+ * counter.
+ *
+ * The per-instruction cost is four counter increments, everything else (per addressing mode totals, rankings) is
+ * derived when the report is written. Pass it to `CPU::run_until` / `CPU::step` to profile a run:
+ *
+ *      Profiler profiler;
+ *      cpu.run_until(deadline, profiler);
+ *      profiler.write_report(std::cout, 20);
+ */
+class Profiler {
+public:
+    /**
+     * Default constructor, creates a profiler with all counters at zero
+     */
+    Profiler();
+
+    void before_instruction(CPU&, uint16_t, uint8_t) {}
+
+    void after_instruction(CPU&, const uint16_t pc, const uint8_t opcode, const uint64_t cycles) {
+        this->opcode_count[opcode] += 1;
+        this->opcode_cycles[opcode] += cycles;
+        this->pc_count[pc] += 1;
+        this->pc_cycles[pc] += cycles;
+    }
+
+    void after_interrupt(CPU&, uint64_t) {}
+
+    /**
+     * Set all counters back to zero
+     * ---
+     */
+    void clear();
+
+    /**
+     * The amount of instructions counted so far
+     * ---
+     */
+    uint64_t instructions() const;
+
+    /**
+     * The amount of cycles spent in the counted instructions
+     * ---
+     */
+    uint64_t cycles() const;
+
+    /**
+     * Executions of the instructions using an addressing mode, summed over the opcodes using it
+     * ---
+     * @param `const AddressingMode mode`, the addressing mode
+     * ---
+     */
+    uint64_t mode_count(const AddressingMode mode) const;
+
+    /**
+     * Cycles spent in the instructions using an addressing mode
+     * ---
+     * @param `const AddressingMode mode`, the addressing mode
+     * ---
+     */
+    uint64_t mode_cycles(const AddressingMode mode) const;
+
+    /**
+     * Program counters of the `count` most expensive instructions, ordered on cycles spent (descending)
+     * ---
+     * @param `const size_t count`, the maximum amount of addresses to return
+     * ---
+     */
+    std::vector<uint16_t> hottest_pcs(const size_t count) const;
+
+    /**
+     * Write a report with the per opcode and per addressing mode histograms, the `top` hottest instructions and the
+     * share of cycles spent in instructions that access a memory operand. A program spending most of its cycles in
+     * register-only instructions (implied, immediate, accumulator, relative, jumps) is bound by instruction
+     * dispatch, otherwise by operand memory accesses.
+     * ---
+     * @param `std::ostream& out`, the stream to write to
+     * @param `const CPU& cpu`, the profiled CPU, used to disassemble the hot instructions
+     * @param `const size_t top`, the amount of hot instructions to list
+     * ---
+     */
+    void write_report(std::ostream& out, const CPU& cpu, const size_t top) const;
+
+    std::array<uint64_t, OPCODE_COUNT> opcode_count;
+    std::array<uint64_t, OPCODE_COUNT> opcode_cycles;
+    std::vector<uint64_t> pc_count;
+    std::vector<uint64_t> pc_cycles;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The snake game from the easy6502 tutorial, to be loaded at `0x0600` with `CPU::load_program`.
+ *
+ * The game reads a random byte from `0x00FE` and the last pressed key (`w`, `a`, `s`, `d`) from `0x00FF`, and draws
+ * to the 32x32 screen at `0x0200` - `0x05FF`. It ends with a `BRK` when the snake hits a wall or itself.
+ */
+extern const std::vector<uint8_t> SNAKE_PROGRAM;
+
+/**
+ * Read a raw program image (no header, loaded at `0x0600`) from disk
+ * ---
+ * @param `const std::string& path`, path of the file to read
+ * ---
+ * @return `std::vector<uint8_t> program`, the contents of the file
+ * ---
+ * @exception `std::runtime_error`, thrown when the file can not be opened
+ * ---
+ */
+std::vector<uint8_t> read_program_file(const std::string& path);
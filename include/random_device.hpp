@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+
+#include "mos6502.hpp"
+
+/**
+ * Address of the random number register of easy6502 programs
+ */
+const uint16_t RANDOM_DEVICE_ADDRESS = 0x00FE;
+
+/**
+ * Seed of a `RandomDevice` constructed without one
+ */
+const uint32_t RANDOM_DEVICE_DEFAULT_SEED = 0x2545F491;
+
+/**
+ * The random number register of easy6502 programs at `0x00FE`, a 32-bit xorshift generator (13, 17, 5) whose low byte
+ * shows up in memory.
+ *
+ * Checking every memory read for the address of the register would cost every read of every program, so the device
+ * writes a fresh value to the register before every instruction instead, and every instruction reading it sees a new
+ * value. Reads stay plain loads from `CPU::memory`, and runs without the device do not pay anything for it. The
+ * sequence only depends on the seed and the amount of instructions executed, so runs with the same seed are
+ * reproducible; save `state()` along with a snapshot to continue one later.
+ *
+ * Attach it to a CPU to have every run of the CPU refresh it (`CPU::run`, `CPU::run_until` and everything built on
+ * them), or pass it as the run loop policy (see `NullPolicy`), alone or in front of another one:
+ *
+ *      RandomDevice random(seed);
+ *      cpu.attach_random_device(&random);
+ *      cpu.run_until(deadline);
+ *
+ *      WithRandomDevice<Profiler> policy = {random, profiler};
+ *      cpu.run_until(deadline, policy);
+ */
+class RandomDevice {
+public:
+    /**
+     * Constructor
+     * ---
+     * @param `const uint32_t seed`, the initial state of the generator, not zero
+     * ---
+     * @exception `std::invalid_argument`, thrown when the seed is zero, which xorshift never leaves
+     * ---
+     */
+    explicit RandomDevice(const uint32_t seed = RANDOM_DEVICE_DEFAULT_SEED) {
+        this->seed(seed);
+    }
+
+    /**
+     * Restart the sequence, or continue one from a saved `state()`
+     * ---
+     * @param `const uint32_t seed`, the new state of the generator, not zero
+     * ---
+     * @exception `std::invalid_argument`, thrown when the seed is zero
+     * ---
+     */
+    void seed(const uint32_t seed) {
+        if (seed == 0) {
+            throw std::invalid_argument("Random device seed can not be zero");
+        }
+        this->value = seed;
+    }
+
+    /**
+     * The current state of the generator, the low byte of which is the last value written
+     * ---
+     */
+    uint32_t state() const {
+        return this->value;
+    }
+
+    /**
+     * Advance the generator
+     * ---
+     * @return `uint8_t value`, the next random byte
+     * ---
+     */
+    uint8_t next() {
+        this->value ^= this->value << 13;
+        this->value ^= this->value >> 17;
+        this->value ^= this->value << 5;
+        return (uint8_t)this->value;
+    }
+
+    /**
+     * Write the next random byte to the register
+     * ---
+     * @param `CPU& cpu`, the CPU whose memory holds the register
+     * ---
+     */
+    void refresh(CPU& cpu) {
+        cpu.memory[RANDOM_DEVICE_ADDRESS] = this->next();
+        cpu.mark_dirty(RANDOM_DEVICE_ADDRESS);
+    }
+
+    /**
+     * Draw the values of instructions that were not executed one by one, like the iterations of an idle loop, leaving
+     * the register as if they had been
+     * ---
+     * @param `CPU& cpu`, the CPU whose memory holds the register
+     * @param `const uint64_t instructions`, the amount of skipped instructions
+     * ---
+     */
+    void skip(CPU& cpu, const uint64_t instructions) {
+        if (instructions == 0) {
+            return;
+        }
+        for (uint64_t i = 1; i < instructions; i++) {
+            this->next();
+        }
+        this->refresh(cpu);
+    }
+
+    void before_instruction(CPU& cpu, uint16_t, uint8_t) {
+        this->refresh(cpu);
+    }
+
+    void after_instruction(CPU&, uint16_t, uint8_t, uint64_t) {}
+    void after_interrupt(CPU&, uint64_t) {}
+
+private:
+    uint32_t value;
+};
+
+/**
+ * Run loop policy refreshing a `RandomDevice` in front of another policy, for profiling or tracing a program that reads
+ * random values
+ */
+template <typename Policy>
+struct WithRandomDevice {
+    RandomDevice& random;
+    Policy& policy;
+
+    void before_instruction(CPU& cpu, uint16_t pc, uint8_t opcode) {
+        this->random.refresh(cpu);
+        this->policy.before_instruction(cpu, pc, opcode);
+    }
+
+    void after_instruction(CPU& cpu, uint16_t pc, uint8_t opcode, uint64_t cycles) {
+        this->policy.after_instruction(cpu, pc, opcode, cycles);
+    }
+
+    void after_interrupt(CPU& cpu, uint64_t cycles) {
+        this->policy.after_interrupt(cpu, cycles);
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * Entry point of a recompiled program, as emitted by `StaticRecompiler::emit`. Runs recompiled basic blocks for as
+ * long as the program counter points at the start of one and the whole block fits before `deadline`, then returns
+ * so the caller can interpret the next instruction (see `run_recompiled`).
+ */
+typedef void (*RecompiledProgram)(CPU& cpu, const uint64_t deadline);
+
+/**
+ * A straight-line run of instructions that is only entered at its first instruction
+ */
+struct BasicBlock {
+    // Address of the first instruction, and of the first byte past the last instruction
+    uint16_t start;
+    uint32_t end;
+    // Addresses of the instructions, in program order
+    std::vector<uint16_t> instructions;
+    // Worst case cycles of all instructions but the last. The block may run when the master clock is below
+    // `deadline - budget`, as every instruction then starts before the deadline, like it would when interpreted.
+    uint32_t budget;
+};
+
+/**
+ * Ahead-of-time recompiler translating the code of a fixed memory image to a C++ translation unit.
+ *
+ * The reachable code is found by walking the instructions from the reset, NMI and IRQ vectors (and any extra entry
+ * points), following fallthroughs, branches, `JMP` and `JSR` targets, the return address of every `JSR` and the
+ * instruction after every `BRK`. Indirect jumps, `RTS` and `RTI` end a path, their targets are only known at run
+ * time. The code is split into basic blocks at every jump target and after every control flow instruction. A `BRK`
+ * or an undocumented opcode ends a block without being part of it.
+ *
+ * Every block becomes one C++ function working on `CPU` directly: the registers are cached in locals, operand
+ * addresses of all modes are computed inline from the operand bytes, and loads, stores, logic, increments, compares,
+ * transfers, flag instructions, branches, `JMP` and `JSR` are emitted inline, with the same flag and cycle effects.
+ * The remaining instructions (arithmetic, shifts, `BIT`, stack instructions, `RTS`, `RTI`, indirect `JMP`) call the
+ * instruction functions of `CPU`, so quirks of the interpreter carry over unchanged. Generated code accesses
+ * `CPU::memory` directly and does not feed an attached heatmap.
+ *
+ * The recompiled code assumes the code bytes of the image do not change while it runs: self-modifying code, or code
+ * loaded after recompilation, is not supported. The emitted `<name>_matches` function checks a CPU still holds the
+ * recompiled code.
+ */
+class StaticRecompiler {
+public:
+    /**
+     * Constructor, takes the memory image to recompile. The reset, NMI and IRQ vectors of the image are entry points.
+     * ---
+     * @param `const uint8_t* image`, the memory space holding the program, `MEMORY_SIZE` bytes (e.g. `CPU::memory`
+     * after `CPU::load_program`)
+     * ---
+     */
+    StaticRecompiler(const uint8_t* image);
+
+    /**
+     * Add an entry point that is not reachable from the vectors, e.g. a routine only reached through a jump table
+     * ---
+     * @param `const uint16_t address`, the address of the first instruction
+     * ---
+     */
+    void add_entry(const uint16_t address);
+
+    /**
+     * Walk the reachable code from the entry points and split it into basic blocks
+     * ---
+     * @return `const std::vector<BasicBlock>& blocks`, the blocks ordered on start address
+     * ---
+     */
+    const std::vector<BasicBlock>& discover();
+
+    /**
+     * Write the C++ translation unit of the discovered blocks. It defines `void <name>_run(CPU&, uint64_t)`, a
+     * `RecompiledProgram`, and `bool <name>_matches(const CPU&)`, and includes `recompiler.hpp`. Calls `discover`
+     * when that did not happen yet.
+     * ---
+     * @param `std::ostream& out`, the stream to write the source to
+     * @param `const std::string& name`, prefix of the emitted functions, a valid C++ identifier
+     * ---
+     */
+    void emit(std::ostream& out, const std::string& name);
+
+private:
+    void emit_block(std::ostream& out, const BasicBlock& block) const;
+    void emit_instruction(std::ostream& out, const uint16_t pc, const bool last) const;
+    uint16_t operand_uint16(const uint16_t pc) const;
+
+    std::vector<uint8_t> image;
+    std::vector<uint16_t> entries;
+    std::vector<BasicBlock> blocks;
+    bool discovered;
+};
+
+/**
+ * Run a recompiled program headless until it hits a `BRK` or the master clock reaches `deadline`, with the same
+ * outcome as `CPU::run_until`. Recompiled blocks only run on the fast path: whenever the program counter is not at
+ * the start of a block (e.g. after an indirect jump into code that was not found statically), the next block does
+ * not fit before the deadline, or an interrupt is pending, a single instruction is interpreted with `CPU::step`.
+ * While a heatmap, a debugger or a random device is attached every instruction is interpreted.
+ * ---
+ * @param `CPU& cpu`, the CPU holding the recompiled code
+ * @param `const uint64_t deadline`, the value of `CPU::cycles` to run until
+ * @param `RecompiledProgram program`, the `<name>_run` function emitted by `StaticRecompiler::emit`
+ * ---
+ * @return `StopReason reason`, whether the run ended on the deadline or on a `BRK`
+ * ---
+ */
+StopReason run_recompiled(CPU& cpu, const uint64_t deadline, RecompiledProgram program);
@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "mos6502.hpp"
+
+/**
+ * DeviceEvent enum for the kinds of events devices can schedule against the master clock
+ */
+enum DeviceEvent {
+    NmiEvent,       // PPU vblank NMI
+    FrameIrqEvent,  // APU frame counter IRQ
+    MapperIrqEvent, // Cartridge mapper IRQ (e.g. scanline counters)
+    DmaEvent,       // OAM / DMC DMA transfers
+};
+
+/**
+ * Amount of different `DeviceEvent` kinds
+ */
+const size_t DEVICE_EVENT_COUNT = 4;
+
+/**
+ * Global event scheduler driving all devices from the 64-bit master clock (`CPU::cycles`).
+ *
+ * Devices schedule events at absolute timestamps. Pending events are kept in a binary min-heap ordered on timestamp
+ * (events with equal timestamps fire in the order they were scheduled). The CPU runs uninterrupted until the
+ * timestamp of the earliest event, after which every due event is dispatched to the handler registered for its kind.
+ * Handlers are free to schedule new events, e.g. to re-arm a periodic interrupt.
+ */
+class Scheduler {
+public:
+    /**
+     * Callback invoked when an event fires. Receives the CPU, the timestamp the event was scheduled at and the
+     * payload it was scheduled with.
+     */
+    using Handler = std::function<void(CPU&, uint64_t, uint32_t)>;
+
+    /**
+     * Default constructor, creates a scheduler without pending events or handlers
+     */
+    Scheduler();
+
+    /**
+     * Register the handler that is invoked for every event of a kind. Events without a handler are dropped.
+     * ---
+     * @param `const DeviceEvent event`, the kind of event to handle
+     * @param `Handler handler`, the callback to invoke
+     * ---
+     */
+    void set_handler(const DeviceEvent event, Handler handler);
+
+    /**
+     * Schedule an event at an absolute master clock timestamp. Timestamps in the past fire on the next dispatch.
+     * ---
+     * @param `const DeviceEvent event`, the kind of event
+     * @param `const uint64_t timestamp`, the value of `CPU::cycles` at which the event fires
+     * @param `const uint32_t payload`, device specific data handed to the handler
+     * ---
+     */
+    void schedule(const DeviceEvent event, const uint64_t timestamp, const uint32_t payload = 0);
+
+    /**
+     * Remove all pending events of a kind
+     * ---
+     * @param `const DeviceEvent event`, the kind of event to cancel
+     * ---
+     */
+    void cancel(const DeviceEvent event);
+
+    /**
+     * Timestamp of the earliest pending event
+     * ---
+     * @return `uint64_t deadline`, the earliest timestamp, `UINT64_MAX` when nothing is pending
+     * ---
+     */
+    uint64_t next_deadline() const;
+
+    /**
+     * The amount of pending events
+     * ---
+     */
+    size_t pending() const;
+
+    /**
+     * Fire every pending event whose timestamp is at or before the current master clock, in timestamp order
+     * ---
+     * @param `CPU& cpu`, the CPU whose clock is the master clock
+     * ---
+     * @return `size_t fired`, the amount of events dispatched
+     * ---
+     */
+    size_t dispatch_due(CPU& cpu);
+
+    /**
+     * Run the CPU until the master clock reaches `until`, the program hits a `BRK` or an attached debugger stops it,
+     * running the CPU in bursts up to the next event deadline and dispatching events in between.
+     * ---
+     * @param `CPU& cpu`, the CPU to run
+     * @param `const uint64_t until`, the master clock timestamp to stop at
+     * ---
+     * @return `StopReason reason`, whether the run ended on `until`, on a `BRK` or on a breakpoint / watchpoint
+     * ---
+     */
+    StopReason run(CPU& cpu, const uint64_t until);
+
+private:
+    struct PendingEvent {
+        uint64_t timestamp;
+        uint64_t sequence;
+        uint32_t payload;
+        DeviceEvent event;
+    };
+
+    /**
+     * Heap ordering, true when `a` should fire after `b`
+     */
+    static bool fires_after(const PendingEvent& a, const PendingEvent& b);
+
+    std::vector<PendingEvent> heap;
+    std::array<Handler, DEVICE_EVENT_COUNT> handlers;
+    uint64_t next_sequence;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * The producer only writes `tail` and the consumer only writes `head`, each index is read by the other side with
+ * acquire / release ordering, so neither `push` nor `pop` ever takes a lock or blocks. The indices live on separate
+ * cache lines to keep the two threads from invalidating each other's line on every operation.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "The capacity has to be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * Append a value, producer thread only
+     * ---
+     * @param `T value`, the value to move into the queue
+     * ---
+     * @return `bool pushed`, false when the queue is full and the value was not queued
+     * ---
+     */
+    bool push(T value) {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - this->head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        this->slots[tail & (Capacity - 1)] = std::move(value);
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove the oldest value, consumer thread only
+     * ---
+     * @param `T& value`, set to the removed value
+     * ---
+     * @return `bool popped`, false when the queue is empty
+     * ---
+     */
+    bool pop(T& value) {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == this->tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(this->slots[head & (Capacity - 1)]);
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Whether the queue holds no values, exact on the consumer thread
+     * ---
+     */
+    bool empty() const {
+        return this->head.load(std::memory_order_relaxed) == this->tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) std::array<T, Capacity> slots;
+};
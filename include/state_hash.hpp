@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+#include "memory_storage.hpp"
+
+class CPU;
+
+/**
+ * Hash a single `DIRTY_PAGE_SIZE` page of memory.
+ *
+ * The page is read as 64-bit little-endian words in stripes of 8 words, accumulated into 8 lanes the way XXH3 does it:
+ * every word, mixed with a per-position key, adds the product of its two halves to its own lane and itself to the
+ * neighbouring lane. The lanes map onto SSE2 registers (`_mm_mul_epu32` for the 32x32 bit products), builds without
+ * SSE2 run the same arithmetic one lane at a time and produce the same hashes.
+ * ---
+ * @param `const uint8_t* page`, the first byte of the page
+ * ---
+ * @return `uint64_t hash`, the hash of the page
+ * ---
+ */
+uint64_t hash_memory_page(const uint8_t* page);
+
+/**
+ * Hash of the state of a CPU from the hashes of its memory pages: registers and master clock followed by the page
+ * hashes in address order
+ * ---
+ * @param `const CPU& cpu`, the CPU whose registers to hash
+ * @param `const uint64_t* page_hashes`, `DIRTY_PAGE_COUNT` hashes from `hash_memory_page`
+ * ---
+ * @return `uint64_t hash`, the hash of the CPU state
+ * ---
+ */
+uint64_t combine_state_hash(const CPU& cpu, const uint64_t* page_hashes);
+
+/**
+ * Hash the registers and the full memory space of the CPU. Two runs that end in the same state produce the same hash,
+ * also across builds and runs of the emulator, so hashes can be stored (golden tests, movies). Same value as
+ * `CPU::state_hash`, which only rehashes the pages written since its last call.
+ * ---
+ * @param `const CPU& cpu`, the CPU to hash
+ * ---
+ * @return `uint64_t hash`, the hash of the CPU state
+ * ---
+ */
+uint64_t hash_cpu_state(const CPU& cpu);
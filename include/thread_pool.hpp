@@ -0,0 +1,97 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent pool of worker threads executing batches of indexed tasks with a work-stealing scheduler.
+ *
+ * Every worker owns a deque of task indices. A batch is dealt round-robin over the deques, after which each worker
+ * pops from the back of its own deque and, once that runs dry, steals from the front of the other deques. This keeps
+ * workers busy when tasks have very different run times (e.g. ROMs with different cycle budgets) without a single
+ * shared queue becoming a point of contention.
+ *
+ * Tasks receive the index of the worker executing them, which allows callers to keep per-worker state (such as a
+ * reusable `CPU` instance) without any locking.
+ */
+class WorkStealingPool {
+public:
+    /**
+     * Constructor, spawn the worker threads
+     * ---
+     * @param `const unsigned int thread_count`, the amount of workers to spawn. 0 uses one worker per hardware thread
+     * ---
+     */
+    explicit WorkStealingPool(const unsigned int thread_count = 0);
+
+    /**
+     * Destructor, signals all workers to stop and joins them
+     * ---
+     */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * The amount of worker threads in the pool
+     * ---
+     * @return `unsigned int size`, the number of workers
+     * ---
+     */
+    unsigned int size() const;
+
+    /**
+     * Execute `task(index, worker)` for every index in `[0, task_count)` and block until all tasks have finished.
+     * Only one batch can be in flight at a time; `run` must not be called from inside a task.
+     * ---
+     * @param `const size_t task_count`, the amount of tasks in the batch
+     * @param `const std::function<void(size_t, unsigned int)>& task`, callable receiving the task index and the worker index
+     * ---
+     * @exception rethrows the first exception thrown by any of the tasks once the whole batch has completed
+     * ---
+     */
+    void run(const size_t task_count, const std::function<void(size_t, unsigned int)>& task);
+
+private:
+    struct WorkerQueue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    /**
+     * Fetch the next task for a worker, popping from the back of its own queue before stealing from the front of
+     * the queues of the other workers.
+     * ---
+     * @param `const unsigned int worker`, index of the worker looking for work
+     * @param `size_t& task`, set to the index of the task to execute when one was found
+     * ---
+     * @return `bool found`, false when every queue is empty
+     * ---
+     */
+    bool next_task(const unsigned int worker, size_t& task);
+
+    /**
+     * Main loop of a worker thread, waits for a batch, drains the queues and signals completion
+     * ---
+     */
+    void worker_loop(const unsigned int worker);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    std::mutex batch_lock;
+    std::condition_variable batch_start;
+    std::condition_variable batch_done;
+    const std::function<void(size_t, unsigned int)>* batch_task;
+    std::exception_ptr batch_error;
+    size_t batch_id;
+    unsigned int workers_busy;
+    bool stopping;
+};
@@ -0,0 +1,585 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "assembler.hpp"
+#include "opcode.hpp"
+
+namespace {
+
+const int MODE_COUNT = 13;
+
+/**
+ * Operand syntax of an instruction, before the addressing mode is chosen
+ */
+enum OperandSyntax {
+	NoOperand,   // nop
+	Register,    // asl A
+	Hash,        // lda #expr
+	Plain,       // lda expr
+	PlainX,      // lda expr,X
+	PlainY,      // lda expr,Y
+	Parens,      // jmp (expr)
+	ParensX,     // lda (expr,X)
+	ParensY,     // lda (expr),Y
+};
+
+enum StatementKind {
+	Empty,
+	Instruction,
+	Org,
+	Byte,
+	Word,
+	Constant,
+};
+
+struct Statement {
+	StatementKind kind;
+	int line;
+	std::string label;
+	// Lowercase mnemonic or directive, or the name of a constant
+	std::string name;
+	std::string operand;
+	OperandSyntax syntax;
+	AddressingMode mode;
+	uint16_t address;
+	uint32_t size;
+};
+
+/**
+ * Result of evaluating an expression. `known` is false when it refers to a symbol that is not defined (yet), `wide`
+ * when it contains a hex number of more than two digits.
+ */
+struct Value {
+	int32_t number;
+	bool known;
+	bool wide;
+};
+
+[[noreturn]] void fail(const int line, const std::string& message) {
+	throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
+
+// Opcode per mnemonic and addressing mode, -1 where the combination does not exist
+const std::unordered_map<std::string, std::array<int, MODE_COUNT>>& opcode_lookup() {
+	static const std::unordered_map<std::string, std::array<int, MODE_COUNT>> lookup = [] {
+		std::unordered_map<std::string, std::array<int, MODE_COUNT>> table;
+		for (const Opcode& opcode : OPCODES) {
+			if (opcode.size == 0) {
+				continue;
+			}
+			auto entry = table.find(opcode.name);
+			if (entry == table.end()) {
+				std::array<int, MODE_COUNT> modes;
+				modes.fill(-1);
+				entry = table.emplace(opcode.name, modes).first;
+			}
+			entry->second[opcode.mode] = opcode.code;
+		}
+		return table;
+	}();
+	return lookup;
+}
+
+bool is_identifier_start(const char c) {
+	return std::isalpha((unsigned char)c) || c == '_';
+}
+
+bool is_identifier_char(const char c) {
+	return std::isalnum((unsigned char)c) || c == '_';
+}
+
+std::string trim(const std::string& text) {
+	size_t start = 0;
+	size_t end = text.size();
+	while (start < end && std::isspace((unsigned char)text[start])) {
+		start++;
+	}
+	while (end > start && std::isspace((unsigned char)text[end - 1])) {
+		end--;
+	}
+	return text.substr(start, end - start);
+}
+
+std::string lowercase(std::string text) {
+	for (char& c : text) {
+		c = (char)std::tolower((unsigned char)c);
+	}
+	return text;
+}
+
+// Whether an operand ends in a suffix like `,x` or `),y`, ignoring case and spaces
+bool ends_with_register(const std::string& text, const char* suffix) {
+	size_t i = text.size();
+	for (size_t j = std::char_traits<char>::length(suffix); j > 0; j--) {
+		while (i > 0 && std::isspace((unsigned char)text[i - 1])) {
+			i--;
+		}
+		if (i == 0 || std::tolower((unsigned char)text[i - 1]) != suffix[j - 1]) {
+			return false;
+		}
+		i--;
+	}
+	return true;
+}
+
+// Strip an operand suffix like `,x` or `),y`, allowing spaces around the comma
+std::string strip_suffix(const std::string& operand, const char last) {
+	const size_t comma = operand.rfind(',');
+	return trim(operand.substr(0, comma)) + ((last == ')') ? ")" : "");
+}
+
+// Split a list of directive arguments on commas outside of quotes
+std::vector<std::string> split_list(const std::string& text) {
+	std::vector<std::string> items;
+	std::string current;
+	bool quoted = false;
+	for (const char c : text) {
+		if (c == '"') {
+			quoted = !quoted;
+		}
+		if (c == ',' && !quoted) {
+			items.push_back(trim(current));
+			current.clear();
+		} else {
+			current += c;
+		}
+	}
+	items.push_back(trim(current));
+	return items;
+}
+
+Value evaluate(const std::string& expression, const std::unordered_map<std::string, int32_t>& symbols,
+			   const uint16_t pc, const int line) {
+	Value result = {0, true, false};
+	size_t i = 0;
+	int sign = 1;
+	bool expect_term = true;
+	auto skip_spaces = [&]() {
+		while (i < expression.size() && std::isspace((unsigned char)expression[i])) {
+			i++;
+		}
+	};
+
+	while (true) {
+		skip_spaces();
+		if (!expect_term) {
+			if (i == expression.size()) {
+				break;
+			}
+			if (expression[i] != '+' && expression[i] != '-') {
+				fail(line, "unexpected `" + expression.substr(i) + "` in expression");
+			}
+			sign = (expression[i] == '+') ? 1 : -1;
+			i++;
+			expect_term = true;
+			continue;
+		}
+		if (i == expression.size()) {
+			fail(line, "missing value in expression `" + expression + "`");
+		}
+
+		// Optional negation and byte selection, apply to this term only
+		if (expression[i] == '-') {
+			sign = -sign;
+			i++;
+			skip_spaces();
+		}
+		char select = 0;
+		if (expression[i] == '<' || expression[i] == '>') {
+			select = expression[i++];
+			skip_spaces();
+		}
+
+		int32_t term = 0;
+		const size_t term_start = i;
+		if (i < expression.size() && (expression[i] == '$' || expression[i] == '%')) {
+			const int base = (expression[i] == '$') ? 16 : 2;
+			i++;
+			const size_t digits_start = i;
+			while (i < expression.size() && std::isxdigit((unsigned char)expression[i])) {
+				const int digit = std::isdigit((unsigned char)expression[i])
+					? expression[i] - '0' : std::tolower((unsigned char)expression[i]) - 'a' + 10;
+				if (digit >= base) {
+					fail(line, "invalid digit in `" + expression + "`");
+				}
+				term = term * base + digit;
+				if (term > 0xFFFF) {
+					fail(line, "value out of range in `" + expression + "`");
+				}
+				i++;
+			}
+			if (i == digits_start) {
+				fail(line, "missing digits in `" + expression + "`");
+			}
+			if (base == 16 && i - digits_start > 2 && select == 0) {
+				result.wide = true;
+			}
+		} else if (i < expression.size() && std::isdigit((unsigned char)expression[i])) {
+			while (i < expression.size() && std::isdigit((unsigned char)expression[i])) {
+				term = term * 10 + (expression[i] - '0');
+				if (term > 0xFFFF) {
+					fail(line, "value out of range in `" + expression + "`");
+				}
+				i++;
+			}
+		} else if (expression[i] == '\'' && i + 2 < expression.size() && expression[i + 2] == '\'') {
+			term = (uint8_t)expression[i + 1];
+			i += 3;
+		} else if (expression[i] == '*') {
+			term = pc;
+			i++;
+		} else if (is_identifier_start(expression[i])) {
+			while (i < expression.size() && is_identifier_char(expression[i])) {
+				i++;
+			}
+			const auto symbol = symbols.find(expression.substr(term_start, i - term_start));
+			if (symbol == symbols.end()) {
+				result.known = false;
+			} else {
+				term = symbol->second;
+			}
+		} else {
+			fail(line, "unexpected `" + expression.substr(i) + "` in expression");
+		}
+
+		if (select == '<') {
+			term = term & 0xFF;
+		} else if (select == '>') {
+			term = (term >> 8) & 0xFF;
+		}
+		result.number += sign * term;
+		expect_term = false;
+	}
+	return result;
+}
+
+Statement parse_line(const std::string& text, const int line) {
+	Statement statement = {StatementKind::Empty, line, "", "", "", OperandSyntax::NoOperand,
+						   AddressingMode::Implied, 0, 0};
+
+	// Drop the comment, a `;` inside a string or character literal is kept
+	std::string code;
+	bool quoted = false;
+	for (size_t i = 0; i < text.size(); i++) {
+		if (text[i] == '"') {
+			quoted = !quoted;
+		} else if (text[i] == '\'' && i + 2 < text.size() && text[i + 2] == '\'') {
+			code += text.substr(i, 3);
+			i += 2;
+			continue;
+		}
+		if (text[i] == ';' && !quoted) {
+			break;
+		}
+		code += text[i];
+	}
+	code = trim(code);
+
+	// Leading label
+	size_t end = 0;
+	while (end < code.size() && is_identifier_char(code[end])) {
+		end++;
+	}
+	if (end > 0 && is_identifier_start(code[0]) && end < code.size() && code[end] == ':') {
+		statement.label = code.substr(0, end);
+		code = trim(code.substr(end + 1));
+	}
+	if (code.empty()) {
+		return statement;
+	}
+
+	// Split off the first word
+	size_t word_end = 0;
+	while (word_end < code.size() && !std::isspace((unsigned char)code[word_end]) && code[word_end] != '=') {
+		word_end++;
+	}
+	const std::string word = code.substr(0, word_end);
+	std::string rest = trim(code.substr(word_end));
+
+	if (!rest.empty() && rest[0] == '=') {
+		statement.kind = StatementKind::Constant;
+		statement.name = word;
+		statement.operand = trim(rest.substr(1));
+		if (!is_identifier_start(word[0])) {
+			fail(line, "invalid constant name `" + word + "`");
+		}
+		return statement;
+	}
+
+	statement.name = lowercase(word);
+	statement.operand = rest;
+	if (statement.name == ".org") {
+		statement.kind = StatementKind::Org;
+	} else if (statement.name == ".byte") {
+		statement.kind = StatementKind::Byte;
+	} else if (statement.name == ".word") {
+		statement.kind = StatementKind::Word;
+	} else if (statement.name[0] == '.') {
+		fail(line, "unknown directive `" + word + "`");
+	} else {
+		statement.kind = StatementKind::Instruction;
+		if (opcode_lookup().count(statement.name) == 0) {
+			fail(line, "unknown instruction `" + word + "`");
+		}
+
+		if (rest.empty()) {
+			statement.syntax = OperandSyntax::NoOperand;
+		} else if (lowercase(rest) == "a") {
+			statement.syntax = OperandSyntax::Register;
+		} else if (rest[0] == '#') {
+			statement.syntax = OperandSyntax::Hash;
+			statement.operand = trim(rest.substr(1));
+		} else if (rest[0] == '(' && ends_with_register(rest, ",x)")) {
+			statement.syntax = OperandSyntax::ParensX;
+			statement.operand = trim(strip_suffix(rest, 'x').substr(1));
+		} else if (rest[0] == '(' && ends_with_register(rest, "),y")) {
+			statement.syntax = OperandSyntax::ParensY;
+			const std::string inner = strip_suffix(rest, 'y');
+			statement.operand = trim(inner.substr(1, inner.size() - 2));
+		} else if (rest[0] == '(' && rest.back() == ')') {
+			statement.syntax = OperandSyntax::Parens;
+			statement.operand = trim(rest.substr(1, rest.size() - 2));
+		} else if (ends_with_register(rest, ",x")) {
+			statement.syntax = OperandSyntax::PlainX;
+			statement.operand = strip_suffix(rest, 'x');
+		} else if (ends_with_register(rest, ",y")) {
+			statement.syntax = OperandSyntax::PlainY;
+			statement.operand = strip_suffix(rest, 'y');
+		} else {
+			statement.syntax = OperandSyntax::Plain;
+		}
+	}
+	return statement;
+}
+
+// Pick the addressing mode in the first pass, preferring zero page for small operands that are already known
+AddressingMode choose_mode(const Statement& statement, const Value& value) {
+	const std::array<int, MODE_COUNT>& modes = opcode_lookup().at(statement.name);
+	auto pick = [&modes, &value](const AddressingMode zero_page, const AddressingMode absolute) {
+		const bool small = value.known && !value.wide && value.number >= 0 && value.number <= 0xFF;
+		if (modes[zero_page] >= 0 && (small || modes[absolute] < 0)) {
+			return zero_page;
+		}
+		return absolute;
+	};
+
+	AddressingMode mode = AddressingMode::Implied;
+	switch (statement.syntax) {
+		case OperandSyntax::NoOperand:
+			mode = (modes[AddressingMode::Implied] >= 0) ? AddressingMode::Implied : AddressingMode::Accumulator;
+			break;
+		case OperandSyntax::Register:
+			mode = AddressingMode::Accumulator;
+			break;
+		case OperandSyntax::Hash:
+			mode = AddressingMode::Immediate;
+			break;
+		case OperandSyntax::Plain:
+			mode = (modes[AddressingMode::Relative] >= 0)
+				? AddressingMode::Relative : pick(AddressingMode::ZeroPage, AddressingMode::Absolute);
+			break;
+		case OperandSyntax::PlainX:
+			mode = pick(AddressingMode::ZeroPageX, AddressingMode::AbsoluteX);
+			break;
+		case OperandSyntax::PlainY:
+			mode = pick(AddressingMode::ZeroPageY, AddressingMode::AbsoluteY);
+			break;
+		case OperandSyntax::Parens:
+			mode = AddressingMode::Indirect;
+			break;
+		case OperandSyntax::ParensX:
+			mode = AddressingMode::IndirectX;
+			break;
+		case OperandSyntax::ParensY:
+			mode = AddressingMode::IndirectY;
+			break;
+	}
+	if (modes[mode] < 0) {
+		fail(statement.line, "`" + statement.name + "` does not support this addressing mode");
+	}
+	return mode;
+}
+
+} // namespace
+
+
+AssembledProgram assemble(const std::string& source, const uint16_t origin) {
+	std::vector<Statement> statements;
+	int line = 1;
+	for (size_t start = 0; start <= source.size(); line++) {
+		size_t end = source.find('\n', start);
+		if (end == std::string::npos) {
+			end = source.size();
+		}
+		statements.push_back(parse_line(source.substr(start, end - start), line));
+		start = end + 1;
+	}
+
+	// First pass: addresses of all statements and labels
+	std::unordered_map<std::string, int32_t> symbols;
+	auto define = [&symbols](const std::string& name, const int32_t value, const int line) {
+		if (!symbols.emplace(name, value).second) {
+			fail(line, "`" + name + "` is already defined");
+		}
+	};
+	auto known = [&symbols](const Statement& statement, const uint32_t pc) {
+		const Value value = evaluate(statement.operand, symbols, pc, statement.line);
+		if (!value.known) {
+			fail(statement.line, "`" + statement.operand + "` has to be defined before it is used here");
+		}
+		return value.number;
+	};
+
+	uint32_t pc = origin;
+	for (Statement& statement : statements) {
+		if (!statement.label.empty()) {
+			define(statement.label, pc, statement.line);
+		}
+		statement.address = pc;
+		switch (statement.kind) {
+			case StatementKind::Empty:
+				break;
+			case StatementKind::Constant:
+				define(statement.name, known(statement, pc), statement.line);
+				break;
+			case StatementKind::Org: {
+				const int32_t address = known(statement, pc);
+				if (address < 0 || address > 0xFFFF) {
+					fail(statement.line, "address out of range");
+				}
+				pc = address;
+				statement.address = pc;
+				break;
+			}
+			case StatementKind::Byte:
+			case StatementKind::Word:
+				for (const std::string& item : split_list(statement.operand)) {
+					if (statement.kind == StatementKind::Byte && item.size() >= 2 && item[0] == '"') {
+						statement.size += item.size() - 2;
+					} else {
+						statement.size += (statement.kind == StatementKind::Byte) ? 1 : 2;
+					}
+				}
+				break;
+			case StatementKind::Instruction: {
+				Value value = {0, false, false};
+				if (statement.syntax != OperandSyntax::NoOperand && statement.syntax != OperandSyntax::Register) {
+					value = evaluate(statement.operand, symbols, pc, statement.line);
+				}
+				statement.mode = choose_mode(statement, value);
+				statement.size = OPCODES[opcode_lookup().at(statement.name)[statement.mode]].size;
+				break;
+			}
+		}
+		pc += statement.size;
+		if (pc > MEMORY_SIZE) {
+			fail(statement.line, "program runs past $FFFF");
+		}
+	}
+
+	// Second pass: emit the bytes, every symbol is known now
+	std::vector<uint8_t> image(MEMORY_SIZE, 0);
+	uint32_t lowest = MEMORY_SIZE;
+	uint32_t highest = 0;
+	auto emit = [&image, &lowest, &highest](const uint32_t address, const uint8_t byte) {
+		image[address] = byte;
+		lowest = std::min(lowest, address);
+		highest = std::max(highest, address + 1);
+	};
+	auto resolve = [&symbols](const std::string& expression, const uint16_t pc, const int line) {
+		const Value value = evaluate(expression, symbols, pc, line);
+		if (!value.known) {
+			fail(line, "undefined label in `" + expression + "`");
+		}
+		return value.number;
+	};
+	auto check_range = [](const int32_t value, const int32_t low, const int32_t high, const int line) {
+		if (value < low || value > high) {
+			fail(line, "value " + std::to_string(value) + " out of range");
+		}
+	};
+
+	for (const Statement& statement : statements) {
+		uint32_t address = statement.address;
+		if (statement.kind == StatementKind::Byte || statement.kind == StatementKind::Word) {
+			for (const std::string& item : split_list(statement.operand)) {
+				if (statement.kind == StatementKind::Byte && item.size() >= 2 && item[0] == '"') {
+					for (size_t i = 1; i + 1 < item.size(); i++) {
+						emit(address++, (uint8_t)item[i]);
+					}
+					continue;
+				}
+				const int32_t value = resolve(item, statement.address, statement.line);
+				if (statement.kind == StatementKind::Byte) {
+					check_range(value, -128, 0xFF, statement.line);
+					emit(address++, (uint8_t)value);
+				} else {
+					check_range(value, -0x8000, 0xFFFF, statement.line);
+					emit(address++, (uint8_t)value);
+					emit(address++, (uint8_t)(value >> 8));
+				}
+			}
+			continue;
+		}
+		if (statement.kind != StatementKind::Instruction) {
+			continue;
+		}
+
+		emit(address, (uint8_t)opcode_lookup().at(statement.name)[statement.mode]);
+		if (statement.size == 1) {
+			continue;
+		}
+		int32_t value = resolve(statement.operand, statement.address, statement.line);
+		if (statement.mode == AddressingMode::Relative) {
+			value -= statement.address + 2;
+			if (value < -128 || value > 127) {
+				fail(statement.line, "branch target out of reach (" + std::to_string(value) + " bytes)");
+			}
+		} else if (statement.mode == AddressingMode::Immediate) {
+			check_range(value, -128, 0xFF, statement.line);
+		} else if (statement.size == 2) {
+			check_range(value, 0, 0xFF, statement.line);
+		} else {
+			check_range(value, 0, 0xFFFF, statement.line);
+		}
+		emit(address + 1, (uint8_t)value);
+		if (statement.size == 3) {
+			emit(address + 2, (uint8_t)(value >> 8));
+		}
+	}
+
+	AssembledProgram program;
+	program.origin = (lowest == MEMORY_SIZE) ? origin : (uint16_t)lowest;
+	if (lowest < highest) {
+		program.bytes.assign(image.begin() + lowest, image.begin() + highest);
+	}
+	for (const Statement& statement : statements) {
+		if (!statement.label.empty()) {
+			program.labels[statement.label] = (uint16_t)symbols[statement.label];
+		}
+	}
+	return program;
+}
+
+
+void load_assembled(CPU& cpu, const AssembledProgram& program) {
+	if (program.bytes.empty()) {
+		throw std::out_of_range("Program does not contain any instructions...");
+	}
+	for (size_t i = 0; i < program.bytes.size(); i++) {
+		cpu.memory[program.origin + i] = program.bytes[i];
+	}
+	cpu.mark_dirty(program.origin, program.origin + program.bytes.size() - 1);
+	const uint32_t end = program.origin + program.bytes.size();
+	if (program.origin > 0xFFFC || end < 0xFFFE) {
+		cpu.memory_write_uint16(0xFFFC, program.origin);
+	}
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "call_profiler.hpp"
+
+namespace {
+
+uint32_t routine_key(const uint16_t routine, const FrameKind kind) {
+	return ((uint32_t)kind << 16) | routine;
+}
+
+} // namespace
+
+
+CallProfiler::CallProfiler() {
+	this->tree.push_back({0, 0, FrameKind::Subroutine, 1, 0, 0});
+	this->frames.reserve(64);
+	this->first_cycle = UINT64_MAX;
+	this->last_cycle = 0;
+	this->top_level_child_cycles = 0;
+}
+
+
+void CallProfiler::enter(const uint16_t routine, const FrameKind kind, const uint8_t return_sp, const uint64_t entered_at) {
+	const uint32_t parent = this->frames.empty() ? 0 : this->frames.back().node;
+	const uint64_t child_key = ((uint64_t)parent << 32) | routine_key(routine, kind);
+
+	uint32_t node;
+	const auto existing = this->children.find(child_key);
+	if (existing == this->children.end()) {
+		node = (uint32_t)this->tree.size();
+		this->tree.push_back({parent, routine, kind, 0, 0, 0});
+		this->children[child_key] = node;
+	} else {
+		node = existing->second;
+	}
+	this->tree[node].calls += 1;
+
+	RoutineTotals& totals = this->totals[routine_key(routine, kind)];
+	totals.routine = routine;
+	totals.kind = kind;
+	totals.calls += 1;
+	this->active[routine_key(routine, kind)] += 1;
+
+	this->frames.push_back({node, return_sp, entered_at, 0});
+}
+
+
+void CallProfiler::leave(const uint8_t stack_pointer, const uint64_t now) {
+	while (!this->frames.empty() && stack_pointer > this->frames.back().return_sp) {
+		this->pop_frame(now);
+	}
+}
+
+
+void CallProfiler::pop_frame(const uint64_t now) {
+	const Frame frame = this->frames.back();
+	this->frames.pop_back();
+
+	const uint64_t inclusive = now - frame.entered_at;
+	const uint64_t exclusive = inclusive - frame.child_cycles;
+	Node& node = this->tree[frame.node];
+	node.inclusive_cycles += inclusive;
+	node.exclusive_cycles += exclusive;
+
+	if (this->frames.empty()) {
+		this->top_level_child_cycles += inclusive;
+	} else {
+		this->frames.back().child_cycles += inclusive;
+	}
+
+	const uint32_t key = routine_key(node.routine, node.kind);
+	RoutineTotals& totals = this->totals[key];
+	totals.exclusive_cycles += exclusive;
+	// Only the outermost activation of a recursive routine adds to its inclusive cycles
+	this->active[key] -= 1;
+	if (this->active[key] == 0) {
+		totals.inclusive_cycles += inclusive;
+	}
+}
+
+
+void CallProfiler::finish(const CPU& cpu) {
+	while (!this->frames.empty()) {
+		this->pop_frame(cpu.cycles);
+	}
+	if (this->first_cycle == UINT64_MAX) {
+		return;
+	}
+	this->last_cycle = cpu.cycles;
+
+	Node& top_level = this->tree[0];
+	top_level.inclusive_cycles = this->last_cycle - this->first_cycle;
+	top_level.exclusive_cycles = top_level.inclusive_cycles - this->top_level_child_cycles;
+}
+
+
+void CallProfiler::set_label(const uint16_t routine, const std::string& name) {
+	this->labels[routine] = name;
+}
+
+
+size_t CallProfiler::depth() const {
+	return this->frames.size();
+}
+
+
+const std::vector<CallProfiler::Node>& CallProfiler::nodes() const {
+	return this->tree;
+}
+
+
+std::vector<CallProfiler::RoutineTotals> CallProfiler::routines() const {
+	std::vector<RoutineTotals> result;
+	for (const std::pair<const uint32_t, RoutineTotals>& entry : this->totals) {
+		result.push_back(entry.second);
+	}
+	std::stable_sort(result.begin(), result.end(), [](const RoutineTotals& a, const RoutineTotals& b) {
+		return a.exclusive_cycles > b.exclusive_cycles;
+	});
+	return result;
+}
+
+
+std::string CallProfiler::frame_name(const Node& node) const {
+	const auto label = this->labels.find(node.routine);
+	if (label != this->labels.end()) {
+		return label->second;
+	}
+
+	const char* prefix = "sub_";
+	if (node.kind == FrameKind::Nmi) {
+		prefix = "nmi_";
+	} else if (node.kind == FrameKind::Irq) {
+		prefix = "irq_";
+	}
+	std::ostringstream name;
+	name << prefix << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << node.routine;
+	return name.str();
+}
+
+
+void CallProfiler::write_folded(std::ostream& out) const {
+	for (size_t i = 0; i < this->tree.size(); i++) {
+		if (this->tree[i].exclusive_cycles == 0) {
+			continue;
+		}
+
+		// Walk up to the top level, then print the path outermost first
+		std::vector<std::string> path;
+		for (uint32_t node = (uint32_t)i; node != 0; node = this->tree[node].parent) {
+			path.push_back(this->frame_name(this->tree[node]));
+		}
+		out << "program";
+		for (auto name = path.rbegin(); name != path.rend(); name++) {
+			out << ";" << *name;
+		}
+		out << " " << this->tree[i].exclusive_cycles << std::endl;
+	}
+}
+
+
+void CallProfiler::write_report(std::ostream& out, const size_t top) const {
+	const uint64_t total = this->tree[0].inclusive_cycles;
+	auto percentage = [total](const uint64_t part) {
+		return (total == 0) ? 0 : 100.0 * part / total;
+	};
+
+	out << std::left << std::setw(24) << "routine" << std::right << std::setw(10) << "calls"
+		<< std::setw(16) << "exclusive" << std::setw(8) << "" << std::setw(16) << "inclusive" << std::endl;
+	out << std::left << std::setw(24) << "program" << std::right << std::setw(10) << 1
+		<< std::setw(16) << this->tree[0].exclusive_cycles << std::fixed << std::setprecision(1) << std::setw(7)
+		<< percentage(this->tree[0].exclusive_cycles) << "%" << std::setw(16) << total << std::defaultfloat << std::endl;
+
+	const std::vector<RoutineTotals> totals = this->routines();
+	for (size_t i = 0; i < totals.size() && i < top; i++) {
+		const RoutineTotals& routine = totals[i];
+		const Node node = {0, routine.routine, routine.kind, 0, 0, 0};
+		out << std::left << std::setw(24) << this->frame_name(node) << std::right << std::setw(10) << routine.calls
+			<< std::setw(16) << routine.exclusive_cycles << std::fixed << std::setprecision(1) << std::setw(7)
+			<< percentage(routine.exclusive_cycles) << "%" << std::setw(16) << routine.inclusive_cycles
+			<< std::defaultfloat << std::endl;
+	}
+}
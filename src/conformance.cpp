@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "conformance.hpp"
+#include "json_reader.hpp"
+#include "opcode.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+uint8_t read_byte(JsonReader& reader) {
+	const int64_t value = reader.read_integer();
+	if (value < 0 || value > 0xFF) {
+		throw std::runtime_error("JSON error at byte " + std::to_string(reader.offset()) + ": byte out of range");
+	}
+	return value;
+}
+
+uint16_t read_address(JsonReader& reader) {
+	const int64_t value = reader.read_integer();
+	if (value < 0 || value > 0xFFFF) {
+		throw std::runtime_error("JSON error at byte " + std::to_string(reader.offset()) + ": address out of range");
+	}
+	return value;
+}
+
+void read_state(JsonReader& reader, ConformanceState& state) {
+	state.ram.clear();
+	std::string key;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		if (key == "pc") {
+			state.pc = read_address(reader);
+		} else if (key == "s") {
+			state.s = read_byte(reader);
+		} else if (key == "a") {
+			state.a = read_byte(reader);
+		} else if (key == "x") {
+			state.x = read_byte(reader);
+		} else if (key == "y") {
+			state.y = read_byte(reader);
+		} else if (key == "p") {
+			state.p = read_byte(reader);
+		} else if (key == "ram") {
+			reader.begin_array();
+			while (reader.next_element()) {
+				reader.begin_array();
+				reader.next_element();
+				const uint16_t addr = read_address(reader);
+				reader.next_element();
+				state.ram.push_back({addr, read_byte(reader)});
+				while (reader.next_element()) {
+					reader.skip_value();
+				}
+			}
+		} else {
+			reader.skip_value();
+		}
+	}
+}
+
+void read_cycles(JsonReader& reader, std::vector<BusCycle>& cycles) {
+	cycles.clear();
+	reader.begin_array();
+	while (reader.next_element()) {
+		BusCycle cycle = {0, 0, false};
+		reader.begin_array();
+		for (int field = 0; reader.next_element(); field++) {
+			if (field == 0) {
+				cycle.addr = read_address(reader);
+			} else if (field == 1) {
+				// Some variants of the format record an open data bus as `null`
+				if (!reader.read_null()) {
+					cycle.value = read_byte(reader);
+				}
+			} else if (field == 2) {
+				cycle.write = (reader.read_string() == "write");
+			} else {
+				reader.skip_value();
+			}
+		}
+		cycles.push_back(cycle);
+	}
+}
+
+std::string hex(const uint32_t value, const int digits) {
+	std::ostringstream text;
+	text << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value;
+	return text.str();
+}
+
+} // namespace
+
+
+uint64_t for_each_conformance_case(std::istream& in, const std::function<void(const ConformanceCase&)>& visit) {
+	JsonReader reader(in);
+	ConformanceCase test_case;
+	uint64_t cases = 0;
+	std::string key;
+
+	reader.begin_array();
+	while (reader.next_element()) {
+		test_case.name.clear();
+		test_case.initial = {0, 0, 0, 0, 0, 0, {}};
+		test_case.final = {0, 0, 0, 0, 0, 0, {}};
+		test_case.cycles.clear();
+		reader.begin_object();
+		while (reader.next_key(key)) {
+			if (key == "name") {
+				test_case.name = reader.read_string();
+			} else if (key == "initial") {
+				read_state(reader, test_case.initial);
+			} else if (key == "final") {
+				read_state(reader, test_case.final);
+			} else if (key == "cycles") {
+				read_cycles(reader, test_case.cycles);
+			} else {
+				reader.skip_value();
+			}
+		}
+		visit(test_case);
+		cases += 1;
+	}
+	if (!reader.at_end()) {
+		throw std::runtime_error("JSON error at byte " + std::to_string(reader.offset()) + ": trailing data");
+	}
+	return cases;
+}
+
+
+std::string run_conformance_case(CPU& cpu, const ConformanceCase& test_case) {
+	const ConformanceState& initial = test_case.initial;
+	for (const auto& byte : initial.ram) {
+		cpu.memory[byte.first] = byte.second;
+		cpu.mark_dirty(byte.first);
+	}
+	cpu.program_counter = initial.pc;
+	cpu.stack_pointer = initial.s;
+	cpu.register_a = initial.a;
+	cpu.register_irx = initial.x;
+	cpu.register_iry = initial.y;
+	cpu.status = initial.p;
+	cpu.cycles = 0;
+	cpu.interrupt_pending = 0;
+	// `BRK` is a test case like any other
+	cpu.halt_on_brk = false;
+
+	cpu.step();
+
+	const ConformanceState& expected = test_case.final;
+	std::string mismatch;
+	const struct {
+		const char* name;
+		uint8_t actual;
+		uint8_t expected;
+	} registers[] = {
+		{"A", cpu.register_a, expected.a},
+		{"X", cpu.register_irx, expected.x},
+		{"Y", cpu.register_iry, expected.y},
+		{"P", cpu.status, expected.p},
+		{"S", cpu.stack_pointer, expected.s},
+	};
+	if (cpu.program_counter != expected.pc) {
+		mismatch = "PC " + hex(cpu.program_counter, 4) + ", expected " + hex(expected.pc, 4);
+	}
+	for (const auto& reg : registers) {
+		if (mismatch.empty() && reg.actual != reg.expected) {
+			mismatch = std::string(reg.name) + " " + hex(reg.actual, 2) + ", expected " + hex(reg.expected, 2);
+		}
+	}
+	for (const auto& byte : expected.ram) {
+		if (mismatch.empty() && cpu.memory[byte.first] != byte.second) {
+			mismatch = "memory " + hex(byte.first, 4) + " " + hex(cpu.memory[byte.first], 2) + ", expected "
+				+ hex(byte.second, 2);
+		}
+	}
+	if (mismatch.empty() && cpu.cycles != test_case.cycles.size()) {
+		mismatch = std::to_string(cpu.cycles) + " cycles, expected " + std::to_string(test_case.cycles.size());
+	}
+
+	// Leave the memory space as clean as it was
+	for (const auto& byte : initial.ram) {
+		cpu.memory[byte.first] = 0;
+		cpu.mark_dirty(byte.first);
+	}
+	for (const auto& byte : expected.ram) {
+		cpu.memory[byte.first] = 0;
+		cpu.mark_dirty(byte.first);
+	}
+	return mismatch;
+}
+
+
+std::vector<std::string> conformance_files(const std::string& directory) {
+	std::vector<std::string> paths;
+	try {
+		for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".json") {
+				paths.push_back(entry.path().string());
+			}
+		}
+	} catch (const std::filesystem::filesystem_error& e) {
+		throw std::runtime_error("Could not read test directory " + directory + ": " + e.what());
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+
+std::vector<ConformanceResult> run_conformance(const std::vector<std::string>& paths, const unsigned int thread_count) {
+	WorkStealingPool pool(thread_count);
+	std::vector<std::unique_ptr<CPU>> worker_cpus;
+	for (unsigned int i = 0; i < pool.size(); i++) {
+		worker_cpus.push_back(std::make_unique<CPU>());
+	}
+
+	std::vector<ConformanceResult> results(paths.size());
+	pool.run(paths.size(), [&paths, &results, &worker_cpus](size_t index, unsigned int worker) {
+		ConformanceResult& result = results[index];
+		result.path = paths[index];
+		result.cases = 0;
+		result.failed = 0;
+		result.skipped = false;
+
+		const std::string stem = std::filesystem::path(result.path).stem().string();
+		result.opcode = -1;
+		if (stem.size() == 2 && std::isxdigit((unsigned char)stem[0]) && std::isxdigit((unsigned char)stem[1])) {
+			result.opcode = std::stoi(stem, nullptr, 16);
+			if (OPCODES[result.opcode].size == 0) {
+				result.skipped = true;
+				return;
+			}
+		}
+
+		std::ifstream file(result.path, std::ios::binary);
+		if (!file) {
+			result.first_failure = "could not open the file";
+			return;
+		}
+		CPU& cpu = *worker_cpus[worker];
+		cpu.reset_memory_space();
+		try {
+			result.cases = for_each_conformance_case(file, [&cpu, &result](const ConformanceCase& test_case) {
+				const std::string mismatch = run_conformance_case(cpu, test_case);
+				if (!mismatch.empty()) {
+					if (result.failed == 0) {
+						result.first_failure = "\"" + test_case.name + "\": " + mismatch;
+					}
+					result.failed += 1;
+				}
+			});
+		} catch (const std::exception& e) {
+			result.first_failure = e.what();
+		}
+	});
+	return results;
+}
+
+
+void write_conformance_report(std::ostream& out, const std::vector<ConformanceResult>& results, const double wall_seconds) {
+	uint64_t cases = 0;
+	uint64_t failed = 0;
+	int failed_opcodes = 0;
+	int skipped = 0;
+	for (const ConformanceResult& result : results) {
+		cases += result.cases;
+		failed += result.failed;
+		std::string name = std::filesystem::path(result.path).filename().string();
+		if (result.opcode >= 0) {
+			name += " (" + std::string(OPCODES[result.opcode].name) + ")";
+		}
+		if (result.skipped) {
+			skipped += 1;
+		} else if (result.failed > 0 || !result.first_failure.empty()) {
+			failed_opcodes += 1;
+			out << std::left << std::setw(20) << name << std::right << std::setw(8) << result.failed << " / "
+				<< std::setw(6) << result.cases << " failed, first " << result.first_failure << std::endl;
+		}
+	}
+	out << std::endl << results.size() << " files, " << skipped << " skipped, " << failed_opcodes << " failing, "
+		<< (cases - failed) << " / " << cases << " cases passed in " << std::fixed << std::setprecision(3)
+		<< wall_seconds << " s" << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,76 @@
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cpu_pool.hpp"
+
+
+void CPUPoolReturn::operator()(CPU* cpu) const {
+	this->pool->release(cpu);
+}
+
+
+CPUPool::CPUPool(const MemoryBacking backing) {
+	this->backing = backing;
+	this->created_count = 0;
+
+	CPU power_on(backing);
+	std::shared_ptr<CPUSnapshot> snapshot = std::make_shared<CPUSnapshot>();
+	power_on.save_snapshot(*snapshot);
+	this->snapshot = snapshot;
+}
+
+
+PooledCPU CPUPool::acquire() {
+	std::unique_ptr<CPU> cpu;
+	std::shared_ptr<const CPUSnapshot> snapshot;
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		if (!this->idle_cpus.empty()) {
+			cpu = std::move(this->idle_cpus.back());
+			this->idle_cpus.pop_back();
+		}
+		snapshot = this->snapshot;
+	}
+	if (!cpu) {
+		cpu = std::make_unique<CPU>(this->backing);
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->created_count += 1;
+	}
+
+	// Outside of the lock, the snapshot is kept alive by the local reference even if the template is replaced
+	cpu->restore_snapshot(*snapshot);
+	return PooledCPU(cpu.release(), CPUPoolReturn{this});
+}
+
+
+void CPUPool::set_template(CPU& cpu) {
+	std::shared_ptr<CPUSnapshot> snapshot = std::make_shared<CPUSnapshot>();
+	cpu.save_snapshot(*snapshot);
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->snapshot = snapshot;
+}
+
+
+size_t CPUPool::created() const {
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->created_count;
+}
+
+
+size_t CPUPool::idle() const {
+	std::lock_guard<std::mutex> guard(this->lock);
+	return this->idle_cpus.size();
+}
+
+
+void CPUPool::release(CPU* cpu) {
+	// Instrumentation belongs to the borrower, it must not see the next user's accesses
+	cpu->attach_debugger(nullptr);
+	cpu->attach_heatmap(nullptr);
+	cpu->attach_random_device(nullptr);
+
+	std::lock_guard<std::mutex> guard(this->lock);
+	this->idle_cpus.emplace_back(cpu);
+}
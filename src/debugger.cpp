@@ -0,0 +1,344 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+#include "debugger.hpp"
+#include "opcode.hpp"
+#include "random_device.hpp"
+
+namespace {
+
+// Most bytes an instruction pulls from the stack (`RTI`)
+const uint8_t MAX_PULLED = 3;
+
+// `DebugAccess` bits of the data access each opcode makes through its operand
+const std::array<uint8_t, 256> OPERAND_ACCESS = [] {
+	std::array<uint8_t, 256> access;
+	for (const Opcode& opcode : OPCODES) {
+		const std::string name = opcode.name;
+		if (opcode.size == 0 || name == "jmp" || name == "jsr") {
+			access[opcode.code] = 0;
+		} else if (name == "sta" || name == "stx" || name == "sty") {
+			access[opcode.code] = DebugAccess::WriteAccess;
+		} else if (name == "asl" || name == "lsr" || name == "rol" || name == "ror" || name == "inc" || name == "dec") {
+			access[opcode.code] = DebugAccess::ReadAccess | DebugAccess::WriteAccess;
+		} else {
+			access[opcode.code] = DebugAccess::ReadAccess;
+		}
+	}
+	return access;
+}();
+
+/**
+ * The address `CPU::get_operand_address` will resolve for the instruction at `pc`, without its side effects. Only
+ * meaningful for the modes that address data in memory.
+ */
+bool effective_address(const CPU& cpu, const uint16_t pc, const AddressingMode mode, uint16_t& addr) {
+	const uint8_t* memory = cpu.memory;
+	const uint8_t lo = memory[(uint16_t)(pc + 1)];
+	const uint16_t word = (memory[(uint16_t)(pc + 2)] << 8) | lo;
+	switch (mode) {
+		case AddressingMode::ZeroPage:
+			addr = lo;
+			return true;
+		case AddressingMode::ZeroPageX:
+			addr = (uint8_t)(lo + cpu.register_irx);
+			return true;
+		case AddressingMode::ZeroPageY:
+			addr = (uint8_t)(lo + cpu.register_iry);
+			return true;
+		case AddressingMode::Absolute:
+			addr = word;
+			return true;
+		case AddressingMode::AbsoluteX:
+			addr = word + cpu.register_irx;
+			return true;
+		case AddressingMode::AbsoluteY:
+			addr = word + cpu.register_iry;
+			return true;
+		case AddressingMode::IndirectX: {
+			const uint8_t ptr = lo + cpu.register_irx;
+			addr = (memory[(uint8_t)(ptr + 1)] << 8) | memory[ptr];
+			return true;
+		}
+		case AddressingMode::IndirectY:
+			addr = ((memory[(uint8_t)(lo + 1)] << 8) | memory[lo]) + cpu.register_iry;
+			return true;
+		default:
+			return false;
+	}
+}
+
+} // namespace
+
+
+Debugger::Debugger() {
+	this->cpu = nullptr;
+	this->hit = {StopReason::Breakpoint, 0, 0, DebugAccess::ExecuteAccess, 0};
+	this->pages.fill(0);
+	this->resume_pc = 0;
+	this->resume_cycles = UINT64_MAX;
+}
+
+
+Debugger::~Debugger() {
+	if (this->cpu != nullptr) {
+		this->cpu->attach_debugger(nullptr);
+	}
+}
+
+
+void Debugger::add_breakpoint(const uint16_t addr) {
+	// An unconditional breakpoint overrides the conditions at the same address
+	this->breakpoints.set(addr);
+	this->breakpoint_conditions.erase(addr);
+	this->update_page(addr >> 8);
+}
+
+
+void Debugger::add_breakpoint(const uint16_t addr, const BreakCondition condition) {
+	const bool unconditional = this->breakpoints.test(addr) && this->breakpoint_conditions.count(addr) == 0;
+	if (!unconditional) {
+		this->breakpoints.set(addr);
+		this->breakpoint_conditions[addr].push_back(condition);
+		this->update_page(addr >> 8);
+	}
+}
+
+
+void Debugger::remove_breakpoint(const uint16_t addr) {
+	this->breakpoints.reset(addr);
+	this->breakpoint_conditions.erase(addr);
+	this->update_page(addr >> 8);
+}
+
+
+void Debugger::add_condition(const BreakCondition condition) {
+	this->conditions.push_back(condition);
+	for (uint32_t page = 0; page < this->pages.size(); page++) {
+		this->update_page(page);
+	}
+}
+
+
+void Debugger::add_watchpoint(const uint16_t first, const uint16_t last, const uint8_t access) {
+	if (last < first || (access & ~(DebugAccess::ReadAccess | DebugAccess::WriteAccess)) != 0) {
+		throw std::invalid_argument("Watchpoints need a valid address range and read and / or write access");
+	}
+	for (uint32_t addr = first; addr <= last; addr++) {
+		if ((access & DebugAccess::ReadAccess) != 0) {
+			this->read_watches.set(addr);
+		}
+		if ((access & DebugAccess::WriteAccess) != 0) {
+			this->write_watches.set(addr);
+		}
+	}
+	for (uint32_t page = first >> 8; page <= (uint32_t)(last >> 8); page++) {
+		this->update_page(page);
+	}
+}
+
+
+void Debugger::remove_watchpoint(const uint16_t first, const uint16_t last, const uint8_t access) {
+	for (uint32_t addr = first; addr <= last; addr++) {
+		if ((access & DebugAccess::ReadAccess) != 0) {
+			this->read_watches.reset(addr);
+		}
+		if ((access & DebugAccess::WriteAccess) != 0) {
+			this->write_watches.reset(addr);
+		}
+	}
+	for (uint32_t page = first >> 8; page <= (uint32_t)(last >> 8); page++) {
+		this->update_page(page);
+	}
+}
+
+
+void Debugger::clear() {
+	this->breakpoints.reset();
+	this->read_watches.reset();
+	this->write_watches.reset();
+	this->breakpoint_conditions.clear();
+	this->conditions.clear();
+	this->pages.fill(0);
+}
+
+
+StopReason Debugger::step() {
+	if (this->cpu == nullptr) {
+		throw std::runtime_error("The debugger is not attached to a CPU");
+	}
+	CPU& cpu = *this->cpu;
+	const uint8_t stack_pointer = cpu.stack_pointer;
+	const bool stack_flagged = (this->pages[0x01] & (DebugAccess::ReadAccess | DebugAccess::WriteAccess)) != 0;
+	uint8_t pulled[MAX_PULLED] = {0, 0, 0};
+	if (stack_flagged) {
+		// Pulls clear the stack slots, keep the values that are about to be read
+		for (uint8_t i = 0; i < MAX_PULLED; i++) {
+			pulled[i] = cpu.memory[0x0100 + (uint8_t)(stack_pointer + 1 + i)];
+		}
+	}
+
+	if (cpu.interrupt_pending != 0 && cpu.poll_interrupts()) {
+		if (stack_flagged && this->stack_watched(stack_pointer, pulled)) {
+			this->hit.pc = cpu.program_counter;
+			return StopReason::Watchpoint;
+		}
+		return StopReason::BudgetExhausted;
+	}
+
+	const uint16_t pc = cpu.program_counter;
+	if ((this->pages[pc >> 8] & DebugAccess::ExecuteAccess) != 0 && this->breaks_at(pc)) {
+		return StopReason::Breakpoint;
+	}
+	const uint8_t opcode = cpu.fetch_opcode(pc);
+	if (opcode == 0x00 && cpu.halt_on_brk) {
+		return StopReason::BreakInstruction;
+	}
+	if (cpu.cold->random_device != nullptr) {
+		cpu.cold->random_device->refresh(cpu);
+	}
+
+	// Only instructions whose data lies on a flagged page take a closer look
+	uint16_t addr = 0;
+	uint8_t access = OPERAND_ACCESS[opcode];
+	if (access != 0 && effective_address(cpu, pc, OPCODES[opcode].mode, addr)) {
+		access &= this->pages[addr >> 8];
+	} else {
+		access = 0;
+	}
+	const bool read_watched = (access & DebugAccess::ReadAccess) != 0
+		&& this->watched(addr, DebugAccess::ReadAccess, cpu.memory[addr]);
+
+	cpu.program_counter = pc + 1;
+	cpu.execute_instruction(opcode);
+
+	bool stop = read_watched;
+	if (!stop && (access & DebugAccess::WriteAccess) != 0) {
+		stop = this->watched(addr, DebugAccess::WriteAccess, cpu.memory[addr]);
+	}
+	// `TXS` moves the stack pointer without accessing the stack
+	if (!stop && stack_flagged && opcode != 0x9A) {
+		stop = this->stack_watched(stack_pointer, pulled);
+	}
+	if (stop) {
+		this->hit.pc = cpu.program_counter;
+		return StopReason::Watchpoint;
+	}
+	return StopReason::BudgetExhausted;
+}
+
+
+StopReason Debugger::run_until(const uint64_t deadline) {
+	if (this->cpu == nullptr) {
+		throw std::runtime_error("The debugger is not attached to a CPU");
+	}
+	while (this->cpu->cycles < deadline) {
+		const StopReason reason = this->step();
+		if (reason != StopReason::BudgetExhausted) {
+			return reason;
+		}
+	}
+	return StopReason::BudgetExhausted;
+}
+
+
+void Debugger::update_page(const uint8_t page) {
+	uint8_t flags = this->conditions.empty() ? 0 : DebugAccess::ExecuteAccess;
+	const uint32_t first = page << 8;
+	for (uint32_t addr = first; addr < first + 256; addr++) {
+		if (this->breakpoints.test(addr)) {
+			flags |= DebugAccess::ExecuteAccess;
+		}
+		if (this->read_watches.test(addr)) {
+			flags |= DebugAccess::ReadAccess;
+		}
+		if (this->write_watches.test(addr)) {
+			flags |= DebugAccess::WriteAccess;
+		}
+	}
+	this->pages[page] = flags;
+}
+
+
+bool Debugger::holds(const BreakCondition condition) const {
+	switch (condition.reg) {
+		case DebugRegister::RegisterA:
+			return this->cpu->register_a == condition.value;
+		case DebugRegister::RegisterX:
+			return this->cpu->register_irx == condition.value;
+		case DebugRegister::RegisterY:
+			return this->cpu->register_iry == condition.value;
+		case DebugRegister::RegisterSP:
+			return this->cpu->stack_pointer == condition.value;
+		case DebugRegister::RegisterStatus:
+			return this->cpu->status == condition.value;
+	}
+	return false;
+}
+
+
+bool Debugger::breaks_at(const uint16_t pc) {
+	// Continuing from a breakpoint, nothing executed since the stop
+	if (pc == this->resume_pc && this->cpu->cycles == this->resume_cycles) {
+		return false;
+	}
+
+	bool stop = false;
+	if (this->breakpoints.test(pc)) {
+		const auto entry = this->breakpoint_conditions.find(pc);
+		if (entry == this->breakpoint_conditions.end()) {
+			stop = true;
+		} else {
+			for (const BreakCondition& condition : entry->second) {
+				stop |= this->holds(condition);
+			}
+		}
+	}
+	for (const BreakCondition& condition : this->conditions) {
+		stop |= this->holds(condition);
+	}
+	if (!stop) {
+		return false;
+	}
+
+	this->hit = {StopReason::Breakpoint, pc, pc, DebugAccess::ExecuteAccess, 0};
+	this->resume_pc = pc;
+	this->resume_cycles = this->cpu->cycles;
+	return true;
+}
+
+
+bool Debugger::watched(const uint16_t addr, const DebugAccess access, const uint8_t value) {
+	const bool watched = (access == DebugAccess::ReadAccess) ? this->read_watches.test(addr)
+		: this->write_watches.test(addr);
+	if (watched) {
+		// The program counter is filled in after the instruction
+		this->hit = {StopReason::Watchpoint, 0, addr, access, value};
+	}
+	return watched;
+}
+
+
+bool Debugger::stack_watched(const uint8_t before, const uint8_t* pulled) {
+	const uint8_t after = this->cpu->stack_pointer;
+	const int8_t moved = (int8_t)(after - before);
+	if (moved < 0) {
+		// Pushes wrote the slots from `before` down to `after + 1`
+		for (uint8_t slot = before; slot != after; slot--) {
+			if (this->watched(0x0100 + slot, DebugAccess::WriteAccess, this->cpu->memory[0x0100 + slot])) {
+				return true;
+			}
+		}
+	} else {
+		// Pulls read the slots from `before + 1` up to `after`
+		for (uint8_t i = 0; i < moved && i < MAX_PULLED; i++) {
+			const uint16_t slot = 0x0100 + (uint8_t)(before + 1 + i);
+			if (this->watched(slot, DebugAccess::ReadAccess, pulled[i])) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
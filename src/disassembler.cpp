@@ -0,0 +1,108 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "disassembler.hpp"
+#include "opcode.hpp"
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * Text around the operand of an addressing mode, and the amount of hex digits of the operand (0 for none)
+ */
+struct OperandFormat {
+	const char* prefix;
+	const char* suffix;
+	uint8_t digits;
+};
+
+// Indexed by `AddressingMode`
+constexpr OperandFormat OPERAND_FORMATS[] = {
+	{"", "", 0},          // Implied
+	{" #$", "", 2},       // Immediate
+	{" $", "", 4},        // Relative, written as the branch target
+	{" A", "", 0},        // Accumulator
+	{" $", "", 2},        // ZeroPage
+	{" $", ",X", 2},      // ZeroPageX
+	{" $", ",Y", 2},      // ZeroPageY
+	{" $", "", 4},        // Absolute
+	{" $", ",X", 4},      // AbsoluteX
+	{" $", ",Y", 4},      // AbsoluteY
+	{" ($", ")", 4},      // Indirect
+	{" ($", ",X)", 2},    // IndirectX
+	{" ($", "),Y", 2},    // IndirectY
+};
+
+char* put_text(char* out, const char* text) {
+	while (*text != '\0') {
+		*out++ = *text++;
+	}
+	return out;
+}
+
+char* put_hex(char* out, const uint16_t value, const uint8_t digits) {
+	for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+		*out++ = HEX_DIGITS[(value >> shift) & 0xF];
+	}
+	return out;
+}
+
+} // namespace
+
+
+size_t disassemble(const uint8_t* memory, const uint16_t addr, char* buffer) {
+	const Opcode& opcode = OPCODES[memory[addr]];
+	char* out = buffer;
+	if (opcode.size == 0) {
+		out = put_text(out, ".byte $");
+		out = put_hex(out, memory[addr], 2);
+		*out = '\0';
+		return 1;
+	}
+
+	const OperandFormat& format = OPERAND_FORMATS[opcode.mode];
+	const uint16_t lo = memory[(uint16_t)(addr + 1)];
+	const uint16_t hi = memory[(uint16_t)(addr + 2)];
+	uint16_t operand = (format.digits == 4) ? (uint16_t)((hi << 8) | lo) : lo;
+	if (opcode.mode == AddressingMode::Relative) {
+		operand = addr + 2 + (int8_t)lo;
+	}
+
+	// Every documented mnemonic has 3 letters
+	out[0] = opcode.name[0];
+	out[1] = opcode.name[1];
+	out[2] = opcode.name[2];
+	out += 3;
+	out = put_text(out, format.prefix);
+	if (format.digits != 0) {
+		out = put_hex(out, operand, format.digits);
+	}
+	out = put_text(out, format.suffix);
+	*out = '\0';
+	return opcode.size;
+}
+
+
+size_t disassemble_line(const uint8_t* memory, const uint16_t addr, char* buffer) {
+	const Opcode& opcode = OPCODES[memory[addr]];
+	const size_t size = (opcode.size == 0) ? 1 : opcode.size;
+
+	char* out = buffer;
+	*out++ = '$';
+	out = put_hex(out, addr, 4);
+	*out++ = ':';
+	for (size_t i = 0; i < 3; i++) {
+		*out++ = ' ';
+		if (i < size) {
+			out = put_hex(out, memory[(uint16_t)(addr + i)], 2);
+		} else {
+			*out++ = ' ';
+			*out++ = ' ';
+		}
+	}
+	*out++ = ' ';
+	*out++ = ' ';
+	disassemble(memory, addr, out);
+	return size;
+}
@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "farm.hpp"
+#include "mos6502.hpp"
+#include "programs.hpp"
+
+
+Farm::Farm(const unsigned int thread_count) : pool(thread_count) {
+	for (unsigned int i = 0; i < this->pool.size(); i++) {
+		this->worker_cpus.push_back(std::make_unique<CPU>());
+	}
+	this->worker_cpus[0]->save_snapshot(this->power_on);
+}
+
+
+unsigned int Farm::size() const {
+	return this->pool.size();
+}
+
+
+std::vector<FarmResult> Farm::run(const std::vector<FarmJob>& jobs) {
+	std::vector<FarmResult> results(jobs.size());
+
+	this->pool.run(jobs.size(), [this, &jobs, &results](size_t index, unsigned int worker) {
+		const FarmJob& job = jobs[index];
+		CPU& cpu = *this->worker_cpus[worker];
+
+		// Bring the reused CPU back to its power-on state before loading the next program, only the pages the
+		// previous job wrote are cleared
+		cpu.restore_snapshot(this->power_on);
+		cpu.load_program(job.program);
+		cpu.reset();
+
+		FarmResult& result = results[index];
+		result.name = job.name;
+		result.stop_reason = cpu.run_for(job.cycle_budget);
+		result.exit_pc = cpu.program_counter;
+		result.cycles = cpu.cycles;
+		result.state_hash = cpu.state_hash();
+	});
+
+	return results;
+}
+
+
+std::vector<FarmJob> load_farm_jobs(const std::string& list_path) {
+	std::ifstream list(list_path);
+	if (!list) {
+		throw std::runtime_error("Could not open job list: " + list_path);
+	}
+
+	std::string base_dir;
+	const size_t separator = list_path.find_last_of('/');
+	if (separator != std::string::npos) {
+		base_dir = list_path.substr(0, separator + 1);
+	}
+
+	std::vector<FarmJob> jobs;
+	std::string line;
+	int line_number = 0;
+	while (std::getline(list, line)) {
+		line_number += 1;
+		std::istringstream fields(line);
+		std::string path;
+		std::string budget;
+		if (!(fields >> path) || path[0] == '#') {
+			continue; // Empty line or comment
+		}
+		if (!(fields >> budget)) {
+			throw std::runtime_error(list_path + ":" + std::to_string(line_number) + ": missing budget");
+		}
+
+		// Budgets are cycles by default, a trailing `f` counts frames instead
+		uint64_t multiplier = 1;
+		const char unit = budget.back();
+		if (unit == 'f' || unit == 'F') {
+			multiplier = CYCLES_PER_FRAME;
+			budget.pop_back();
+		} else if (unit == 'c' || unit == 'C') {
+			budget.pop_back();
+		}
+
+		FarmJob job;
+		try {
+			job.cycle_budget = std::stoull(budget) * multiplier;
+		} catch (const std::exception&) {
+			throw std::runtime_error(list_path + ":" + std::to_string(line_number) + ": invalid budget");
+		}
+
+		job.name = path;
+		job.program = read_program_file((path[0] == '/') ? path : base_dir + path);
+		jobs.push_back(job);
+	}
+
+	return jobs;
+}
+
+
+void write_farm_report(std::ostream& out, const std::vector<FarmResult>& results, const double wall_seconds) {
+	uint64_t total_cycles = 0;
+	int completed = 0;
+	std::set<uint64_t> end_states;
+
+	out << std::left << std::setw(32) << "program" << std::right
+		<< std::setw(18) << "state hash"
+		<< std::setw(8) << "pc"
+		<< std::setw(14) << "cycles"
+		<< "  stop" << std::endl;
+
+	for (const FarmResult& result : results) {
+		total_cycles += result.cycles;
+		if (result.stop_reason == StopReason::BreakInstruction) {
+			completed += 1;
+		}
+		end_states.insert(result.state_hash);
+
+		out << std::left << std::setw(32) << result.name << std::right
+			<< "  " << std::hex << std::setfill('0') << std::setw(16) << result.state_hash
+			<< "   $" << std::setw(4) << std::uppercase << result.exit_pc << std::nouppercase
+			<< std::dec << std::setfill(' ') << std::setw(14) << result.cycles
+			<< "  " << ((result.stop_reason == StopReason::BreakInstruction) ? "brk" : "budget")
+			<< std::endl;
+	}
+
+	out << std::endl << results.size() << " programs, " << completed << " ran to BRK, " << end_states.size()
+		<< " distinct end states, " << total_cycles << " cycles in " << std::fixed << std::setprecision(3) << wall_seconds << " s";
+	if (wall_seconds > 0) {
+		out << " (" << std::setprecision(2) << (total_cycles / wall_seconds / 1e6) << " MHz aggregate)";
+	}
+	out << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <ostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fuzzer.hpp"
+#include "opcode.hpp"
+#include "random_device.hpp"
+
+namespace {
+
+const uint16_t PROGRAM_START = 0x0600;
+
+// Bytes that tend to hit edge cases: zero, sign boundaries, all ones and the control flow opcodes
+const uint8_t INTERESTING_BYTES[] = {0x00, 0x01, 0x7F, 0x80, 0xFF, 0x20, 0x4C, 0x60, 0xD0, 0xF0};
+
+// The keys the snake game reacts to (w, a, s, d)
+const uint8_t DIRECTION_KEYS[] = {0x77, 0x61, 0x73, 0x64};
+
+const size_t MAX_KEYS = 64;
+
+bool is_control_flow(const uint8_t opcode) {
+	return OPCODES[opcode].mode == AddressingMode::Relative || opcode == 0x4C || opcode == 0x6C || opcode == 0x20
+		|| opcode == 0x60 || opcode == 0x40;
+}
+
+// AFL's hit count buckets: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+uint8_t hit_bucket(const uint8_t hits) {
+	if (hits <= 2) {
+		return hits;
+	}
+	if (hits == 3) {
+		return 4;
+	}
+	if (hits < 8) {
+		return 8;
+	}
+	if (hits < 16) {
+		return 16;
+	}
+	if (hits < 32) {
+		return 32;
+	}
+	return (hits < 128) ? 64 : 128;
+}
+
+std::string hex(const uint32_t value, const int digits) {
+	std::ostringstream text;
+	text << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value;
+	return text.str();
+}
+
+} // namespace
+
+
+/**
+ * Run loop policy of the fuzzer, feeds the inputs and records the edges of the execution
+ */
+struct FuzzPolicy {
+	Fuzzer& fuzzer;
+	const FuzzInput& input;
+	RandomDevice random;
+	uint64_t steps;
+	bool looping;
+
+	void before_instruction(CPU& cpu, uint16_t, uint8_t) {
+		this->random.refresh(cpu);
+		if (!this->input.keys.empty() && this->steps % this->fuzzer.options.key_interval == 0) {
+			const size_t key = std::min<size_t>(this->steps / this->fuzzer.options.key_interval, this->input.keys.size() - 1);
+			cpu.memory[0x00FF] = this->input.keys[key];
+			cpu.mark_dirty(0x00FF);
+		}
+		this->steps += 1;
+	}
+
+	void after_instruction(CPU& cpu, uint16_t pc, uint8_t opcode, uint64_t) {
+		if (!is_control_flow(opcode)) {
+			return;
+		}
+		const uint16_t target = cpu.program_counter;
+		const uint16_t edge = (uint16_t)(pc * 0x9E37) ^ target;
+		uint8_t& hits = this->fuzzer.trace[edge];
+		if (hits == 0) {
+			this->fuzzer.touched.push_back(edge);
+		}
+		if (hits != 0xFF) {
+			hits += 1;
+		}
+		// Calls and returns to their own address still change the stack, everything else is stuck for good
+		if (target == pc && opcode != 0x20 && opcode != 0x60 && opcode != 0x40) {
+			this->looping = true;
+		}
+	}
+
+	void after_interrupt(CPU&, uint64_t) {}
+};
+
+
+Fuzzer::Fuzzer(const std::vector<uint8_t>& program, const FuzzOptions& options) : random(options.seed) {
+	if (program.empty() || program.size() > MEMORY_SIZE - PROGRAM_START) {
+		throw std::out_of_range("Program does not fit the memory space");
+	}
+	if (options.key_interval == 0) {
+		throw std::invalid_argument("Key interval has to be at least one instruction");
+	}
+	this->options = options;
+	this->program_size = program.size();
+	this->trace.assign(FUZZ_MAP_SIZE, 0);
+	this->seen.assign(FUZZ_MAP_SIZE, 0);
+	this->edge_count = 0;
+	this->outcome_counts.assign(FuzzException + 1, 0);
+	this->execution_count = 0;
+
+	this->cpu.load_program(program);
+	this->cpu.reset();
+	this->cpu.save_snapshot(this->base);
+
+	this->execute({program, {}, RANDOM_DEVICE_DEFAULT_SEED});
+	if (this->inputs.empty()) {
+		// The seed stays the root of the corpus even when it reaches no control flow at all
+		this->inputs.push_back({program, {}, RANDOM_DEVICE_DEFAULT_SEED});
+	}
+}
+
+
+FuzzOutcome Fuzzer::execute(const FuzzInput& input) {
+	if (input.program.size() != this->program_size) {
+		throw std::invalid_argument("Fuzz input program has to be as long as the seed program");
+	}
+
+	CPU& cpu = this->cpu;
+	cpu.restore_snapshot(this->base);
+	std::memcpy(cpu.memory + PROGRAM_START, input.program.data(), input.program.size());
+	cpu.mark_dirty(PROGRAM_START, PROGRAM_START + input.program.size() - 1);
+
+	const uint32_t seed = (input.rng_seed != 0) ? input.rng_seed : RANDOM_DEVICE_DEFAULT_SEED;
+	FuzzPolicy policy = {*this, input, RandomDevice(seed), 0, false};
+	const uint64_t deadline = this->options.cycle_budget;
+	FuzzOutcome outcome = FuzzBudgetExhausted;
+	uint16_t pc = cpu.program_counter;
+	std::string message;
+	try {
+		while (cpu.cycles < deadline) {
+			pc = cpu.program_counter;
+			const uint8_t opcode = cpu.memory[pc];
+			if (OPCODES[opcode].size == 0) {
+				outcome = FuzzInvalidOpcode;
+				message = "invalid opcode " + hex(opcode, 2);
+				break;
+			}
+			if (!cpu.step(policy)) {
+				outcome = FuzzHalted;
+				break;
+			}
+			if (policy.looping) {
+				outcome = FuzzInfiniteLoop;
+				message = OPCODES[opcode].name + std::string(" to itself");
+				break;
+			}
+		}
+	} catch (const std::exception& e) {
+		outcome = FuzzException;
+		message = e.what();
+	}
+
+	// Fold the hit counts of this execution into the coverage map
+	bool new_coverage = false;
+	for (const uint16_t edge : this->touched) {
+		const uint8_t bucket = hit_bucket(this->trace[edge]);
+		if ((this->seen[edge] & bucket) == 0) {
+			if (this->seen[edge] == 0) {
+				this->edge_count += 1;
+			}
+			this->seen[edge] |= bucket;
+			new_coverage = true;
+		}
+		this->trace[edge] = 0;
+	}
+	this->touched.clear();
+
+	if (new_coverage) {
+		this->inputs.push_back(input);
+	}
+	if (outcome == FuzzInfiniteLoop || outcome == FuzzInvalidOpcode || outcome == FuzzException) {
+		if (this->finding_keys.insert(((uint32_t)outcome << 16) | pc).second) {
+			this->found.push_back({outcome, pc, message, input});
+		}
+	}
+	this->outcome_counts[outcome] += 1;
+	this->execution_count += 1;
+	return outcome;
+}
+
+
+void Fuzzer::run(const uint64_t executions) {
+	for (uint64_t i = 0; i < executions; i++) {
+		this->execute(this->mutate());
+	}
+}
+
+
+FuzzInput Fuzzer::mutate() {
+	FuzzInput input = this->inputs[this->random() % this->inputs.size()];
+	const int mutations = 1 + this->random() % 4;
+	for (int i = 0; i < mutations; i++) {
+		switch (this->random() % 8) {
+			case 0:
+				input.keys.resize(std::max<size_t>(input.keys.size(), 1));
+				input.keys[this->random() % input.keys.size()] = DIRECTION_KEYS[this->random() % 4];
+				break;
+			case 1:
+				if (input.keys.size() < MAX_KEYS) {
+					input.keys.push_back((this->random() % 4 == 0) ? (uint8_t)this->random()
+						: DIRECTION_KEYS[this->random() % 4]);
+				}
+				break;
+			case 2:
+				input.rng_seed = (uint32_t)this->random();
+				break;
+			default:
+				this->mutate_program(input.program);
+		}
+	}
+	return input;
+}
+
+
+void Fuzzer::mutate_program(std::vector<uint8_t>& program) {
+	const size_t at = this->random() % program.size();
+	switch (this->random() % 5) {
+		case 0:
+			program[at] ^= 1 << (this->random() % 8);
+			break;
+		case 1:
+			program[at] = (uint8_t)this->random();
+			break;
+		case 2:
+			program[at] = INTERESTING_BYTES[this->random() % sizeof(INTERESTING_BYTES)];
+			break;
+		case 3: {
+			const int delta = 1 + this->random() % 16;
+			program[at] += (this->random() % 2 == 0) ? delta : -delta;
+			break;
+		}
+		default: {
+			// Copy a block of up to 8 bytes within the program, overlapping blocks included
+			const size_t from = this->random() % program.size();
+			const size_t length = std::min<size_t>({1 + this->random() % 8, program.size() - at, program.size() - from});
+			std::memmove(program.data() + at, program.data() + from, length);
+		}
+	}
+}
+
+
+const std::vector<FuzzInput>& Fuzzer::corpus() const {
+	return this->inputs;
+}
+
+
+const std::vector<FuzzFinding>& Fuzzer::findings() const {
+	return this->found;
+}
+
+
+size_t Fuzzer::edges() const {
+	return this->edge_count;
+}
+
+
+uint64_t Fuzzer::executions() const {
+	return this->execution_count;
+}
+
+
+const std::vector<uint64_t>& Fuzzer::outcomes() const {
+	return this->outcome_counts;
+}
+
+
+const std::vector<uint8_t>& Fuzzer::coverage() const {
+	return this->seen;
+}
+
+
+const char* fuzz_outcome_name(const FuzzOutcome outcome) {
+	switch (outcome) {
+		case FuzzHalted:
+			return "halted";
+		case FuzzBudgetExhausted:
+			return "budget exhausted";
+		case FuzzInfiniteLoop:
+			return "infinite loop";
+		case FuzzInvalidOpcode:
+			return "invalid opcode";
+		case FuzzException:
+			return "exception";
+	}
+	return "unknown";
+}
+
+
+void write_fuzz_report(std::ostream& out, const std::vector<const Fuzzer*>& fuzzers,
+					   const std::vector<uint8_t>& seed_program, const double wall_seconds) {
+	uint64_t executions = 0;
+	size_t corpus = 0;
+	std::vector<uint64_t> outcomes(FuzzException + 1, 0);
+	std::vector<uint8_t> coverage(FUZZ_MAP_SIZE, 0);
+	std::set<uint32_t> reported;
+	std::vector<const FuzzFinding*> findings;
+	for (const Fuzzer* fuzzer : fuzzers) {
+		executions += fuzzer->executions();
+		corpus += fuzzer->corpus().size();
+		for (size_t i = 0; i < outcomes.size(); i++) {
+			outcomes[i] += fuzzer->outcomes()[i];
+		}
+		for (size_t i = 0; i < FUZZ_MAP_SIZE; i++) {
+			coverage[i] |= fuzzer->coverage()[i];
+		}
+		for (const FuzzFinding& finding : fuzzer->findings()) {
+			if (reported.insert(((uint32_t)finding.outcome << 16) | finding.pc).second) {
+				findings.push_back(&finding);
+			}
+		}
+	}
+	const size_t edges = FUZZ_MAP_SIZE - std::count(coverage.begin(), coverage.end(), 0);
+
+	out << executions << " executions on " << fuzzers.size() << " fuzzers in " << std::fixed << std::setprecision(3)
+		<< wall_seconds << " s (" << std::setprecision(0) << ((wall_seconds > 0) ? executions / wall_seconds : 0)
+		<< " execs/s)" << std::defaultfloat << std::endl;
+	out << edges << " edges, " << corpus << " corpus entries" << std::endl;
+	for (size_t i = 0; i < outcomes.size(); i++) {
+		out << "  " << std::left << std::setw(18) << fuzz_outcome_name((FuzzOutcome)i) << std::right
+			<< std::setw(12) << outcomes[i] << std::endl;
+	}
+
+	out << std::endl << findings.size() << " findings" << std::endl;
+	for (const FuzzFinding* finding : findings) {
+		const FuzzInput& input = finding->input;
+		out << fuzz_outcome_name(finding->outcome) << " at " << hex(finding->pc, 4) << ": " << finding->message
+			<< std::endl << "  seed " << hex(input.rng_seed, 8) << ", keys";
+		for (const uint8_t key : input.keys) {
+			out << " " << hex(key, 2);
+		}
+		out << std::endl << "  program";
+		for (size_t i = 0; i < input.program.size() && i < seed_program.size(); i++) {
+			if (input.program[i] != seed_program[i]) {
+				out << " " << hex(PROGRAM_START + i, 4) << "=" << hex(input.program[i], 2);
+			}
+		}
+		out << std::endl;
+	}
+}
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "gdb_server.hpp"
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+// How long the server thread waits for a client or for bytes from it before it looks at the replies again, in ms
+const int ACCEPT_POLL_MS = 50;
+const int CLIENT_POLL_MS = 1;
+
+// How long a halted target sleeps between two looks at the command queue
+const std::chrono::microseconds HALTED_POLL(100);
+
+// Registers in the order of the `g` packet, see `GdbServer`
+const int REGISTER_COUNT = 6;
+
+void put_hex_byte(std::string& out, const uint8_t value) {
+	out += HEX_DIGITS[value >> 4];
+	out += HEX_DIGITS[value & 0xF];
+}
+
+uint8_t parse_hex_byte(const std::string& text, const size_t at) {
+	if (at + 2 > text.size()) {
+		throw std::invalid_argument("Truncated hex data");
+	}
+	return std::stoul(text.substr(at, 2), nullptr, 16);
+}
+
+uint8_t& register_slot(CPU& cpu, const int reg) {
+	switch (reg) {
+		case 0:
+			return cpu.register_a;
+		case 1:
+			return cpu.register_irx;
+		case 2:
+			return cpu.register_iry;
+		case 3:
+			return cpu.status;
+		case 4:
+			return cpu.stack_pointer;
+		default:
+			throw std::out_of_range("No 8-bit register " + std::to_string(reg));
+	}
+}
+
+std::string read_register(CPU& cpu, const int reg) {
+	std::string out;
+	if (reg == 5) {
+		put_hex_byte(out, cpu.program_counter & 0xFF);
+		put_hex_byte(out, cpu.program_counter >> 8);
+	} else {
+		put_hex_byte(out, register_slot(cpu, reg));
+	}
+	return out;
+}
+
+// Parse the value of register `reg` at `at`, returns the amount of hex digits consumed
+size_t write_register(CPU& cpu, const int reg, const std::string& text, const size_t at) {
+	if (reg == 5) {
+		cpu.program_counter = parse_hex_byte(text, at) | (parse_hex_byte(text, at + 2) << 8);
+		return 4;
+	}
+	register_slot(cpu, reg) = parse_hex_byte(text, at);
+	return 2;
+}
+
+std::string frame_packet(const std::string& payload) {
+	uint8_t checksum = 0;
+	for (const char c : payload) {
+		checksum += c;
+	}
+	std::string packet = "$" + payload + "#";
+	put_hex_byte(packet, checksum);
+	return packet;
+}
+
+bool send_all(const int fd, const std::string& data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		const ssize_t count = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (count <= 0) {
+			return false;
+		}
+		sent += count;
+	}
+	return true;
+}
+
+// Close a client connection without losing the last reply. Linux resets a Unix socket that is closed with unread
+// data (such as the acknowledgement of the previous reply), so the input is drained until the client hangs up
+void close_client(const int fd) {
+	::shutdown(fd, SHUT_WR);
+	pollfd client = {fd, POLLIN, 0};
+	char buffer[256];
+	while (::poll(&client, 1, ACCEPT_POLL_MS) > 0 && ::recv(fd, buffer, sizeof(buffer), 0) > 0) {
+	}
+	::close(fd);
+}
+
+} // namespace
+
+
+GdbServer::GdbServer(CPU& cpu, const std::string& socket_path) : cpu(cpu), socket_path(socket_path) {
+	sockaddr_un address;
+	if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Invalid socket path '" + socket_path + "'");
+	}
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+
+	this->listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (this->listen_fd < 0) {
+		throw std::runtime_error("Could not create a socket for '" + socket_path + "'");
+	}
+	::unlink(socket_path.c_str());
+	if (::bind(this->listen_fd, (const sockaddr*)&address, sizeof(address)) != 0
+		|| ::listen(this->listen_fd, 1) != 0) {
+		::close(this->listen_fd);
+		throw std::runtime_error("Could not listen on '" + socket_path + "'");
+	}
+
+	this->stopping = false;
+	this->connected = false;
+	this->session = false;
+	this->halted = false;
+	this->stepping = false;
+	this->last_stop = "S05";
+	this->thread = std::thread(&GdbServer::serve, this);
+}
+
+
+GdbServer::~GdbServer() {
+	this->stopping = true;
+	this->thread.join();
+	::close(this->listen_fd);
+	::unlink(this->socket_path.c_str());
+	this->cpu.attach_debugger(nullptr);
+}
+
+
+bool GdbServer::client_connected() const {
+	return this->connected.load(std::memory_order_acquire);
+}
+
+
+StopReason GdbServer::run_until(const uint64_t deadline) {
+	// Without a client the CPU runs undisturbed
+	if (!this->session && this->commands.empty()) {
+		return this->cpu.run_until(deadline);
+	}
+
+	while (true) {
+		this->process_commands();
+		if (!this->session) {
+			return this->cpu.run_until(deadline);
+		}
+		if (this->halted) {
+			std::this_thread::sleep_for(HALTED_POLL);
+			continue;
+		}
+		if (this->cpu.cycles >= deadline) {
+			return StopReason::BudgetExhausted;
+		}
+
+		StopReason reason;
+		if (this->stepping) {
+			reason = this->debugger.step();
+			if (reason == StopReason::Breakpoint) {
+				// Stepping off a breakpoint, the debugger passes over it the second time
+				reason = this->debugger.step();
+			}
+		} else {
+			reason = this->debugger.run_until(std::min(deadline, this->cpu.cycles + GDB_POLL_CYCLES));
+		}
+
+		if (reason == StopReason::BreakInstruction) {
+			this->end_session("W00", true);
+			return StopReason::BreakInstruction;
+		}
+		if (reason == StopReason::Watchpoint) {
+			std::string stop_reply = "T05";
+			if (this->debugger.hit.access == DebugAccess::WriteAccess) {
+				stop_reply += "watch:";
+			} else {
+				stop_reply += "rwatch:";
+			}
+			put_hex_byte(stop_reply, this->debugger.hit.address >> 8);
+			put_hex_byte(stop_reply, this->debugger.hit.address & 0xFF);
+			this->stop(stop_reply + ";");
+		} else if (reason == StopReason::Breakpoint || this->stepping) {
+			this->stop("S05");
+		}
+	}
+}
+
+
+void GdbServer::serve() {
+	int client_fd = -1;
+	std::string received;
+	bool close = false;
+
+	// Send the queued replies, or drop them once the client is gone
+	auto send_replies = [this, &client_fd, &close]() {
+		GdbReply reply;
+		while (this->replies.pop(reply)) {
+			if (!close && client_fd >= 0 && !reply.packet.empty()
+				&& !send_all(client_fd, frame_packet(reply.packet))) {
+				close = true;
+			}
+			close |= reply.close;
+		}
+	};
+	// The emulation thread may itself wait on a full reply queue while the command queue is full, so keep draining
+	// the replies until the command fits, or a client pipelining many packets deadlocks both threads
+	auto push_command = [this, &send_replies](const GdbCommand& command) {
+		while (!this->commands.push(command) && !this->stopping) {
+			send_replies();
+			std::this_thread::yield();
+		}
+	};
+
+	while (!this->stopping) {
+		if (client_fd < 0) {
+			pollfd listener = {this->listen_fd, POLLIN, 0};
+			if (::poll(&listener, 1, ACCEPT_POLL_MS) > 0) {
+				client_fd = ::accept(this->listen_fd, nullptr, nullptr);
+				if (client_fd >= 0) {
+					received.clear();
+					close = false;
+					this->connected = true;
+					push_command({GdbCommand::Attach, ""});
+				}
+			}
+			continue;
+		}
+
+		send_replies();
+
+		pollfd client = {client_fd, POLLIN, 0};
+		if (!close && ::poll(&client, 1, CLIENT_POLL_MS) > 0) {
+			char buffer[4096];
+			const ssize_t count = ::recv(client_fd, buffer, sizeof(buffer), 0);
+			if (count <= 0) {
+				close = true;
+			} else {
+				received.append(buffer, count);
+			}
+		}
+
+		// Frame the packets received so far: `$<payload>#<checksum>`, acknowledgements in between are dropped
+		while (!close && !received.empty()) {
+			if (received[0] == '\x03') {
+				received.erase(0, 1);
+				push_command({GdbCommand::Interrupt, ""});
+				continue;
+			}
+			if (received[0] != '$') {
+				received.erase(0, 1);
+				continue;
+			}
+			const size_t end = received.find('#');
+			if (end == std::string::npos || end + 3 > received.size()) {
+				break;
+			}
+			const std::string payload = received.substr(1, end - 1);
+			const bool valid = received.compare(end + 1, 2, frame_packet(payload), end + 1, 2) == 0;
+			received.erase(0, end + 3);
+			if (!send_all(client_fd, valid ? "+" : "-")) {
+				close = true;
+			} else if (valid) {
+				push_command({GdbCommand::Packet, payload});
+			}
+		}
+
+		if (close) {
+			close_client(client_fd);
+			client_fd = -1;
+			this->connected = false;
+			push_command({GdbCommand::Detach, ""});
+		}
+	}
+
+	// Replies queued before the server was stopped, such as the exit of the program, still reach the client
+	if (client_fd >= 0) {
+		GdbReply reply;
+		while (this->replies.pop(reply) && (reply.packet.empty() || send_all(client_fd, frame_packet(reply.packet)))) {
+		}
+		close_client(client_fd);
+		this->connected = false;
+	}
+}
+
+
+void GdbServer::process_commands() {
+	GdbCommand command;
+	while (this->commands.pop(command)) {
+		switch (command.kind) {
+			case GdbCommand::Attach:
+				// GDB expects the target to be halted when it connects
+				this->debugger.clear();
+				this->cpu.attach_debugger(&this->debugger);
+				this->session = true;
+				this->halted = true;
+				this->stepping = false;
+				this->last_stop = "S05";
+				break;
+			case GdbCommand::Interrupt:
+				if (this->session && !this->halted) {
+					this->stop("S02");
+				}
+				break;
+			case GdbCommand::Detach:
+				if (this->session) {
+					this->end_session("", false);
+				}
+				break;
+			case GdbCommand::Packet: {
+				if (!this->session) {
+					break;
+				}
+				std::string reply;
+				bool answer;
+				try {
+					answer = this->handle_packet(command.packet, reply);
+				} catch (const std::exception&) {
+					answer = true;
+					reply = "E01";
+				}
+				if (answer && this->session) {
+					this->send({reply, false});
+				}
+				break;
+			}
+		}
+	}
+}
+
+
+bool GdbServer::handle_packet(const std::string& packet, std::string& reply) {
+	CPU& cpu = this->cpu;
+	const char kind = packet.empty() ? '\0' : packet[0];
+	switch (kind) {
+		case '?':
+			reply = this->last_stop;
+			return true;
+		case 'g':
+			for (int reg = 0; reg < REGISTER_COUNT; reg++) {
+				reply += read_register(cpu, reg);
+			}
+			return true;
+		case 'G': {
+			size_t at = 1;
+			for (int reg = 0; reg < REGISTER_COUNT; reg++) {
+				at += write_register(cpu, reg, packet, at);
+			}
+			reply = "OK";
+			return true;
+		}
+		case 'p':
+			reply = read_register(cpu, std::stoi(packet.substr(1), nullptr, 16));
+			return true;
+		case 'P': {
+			const size_t equals = packet.find('=');
+			write_register(cpu, std::stoi(packet.substr(1, equals - 1), nullptr, 16), packet, equals + 1);
+			reply = "OK";
+			return true;
+		}
+		case 'm':
+		case 'M': {
+			const size_t comma = packet.find(',');
+			const uint32_t addr = std::stoul(packet.substr(1, comma - 1), nullptr, 16);
+			const uint32_t length = std::stoul(packet.substr(comma + 1), nullptr, 16);
+			if (addr + length > MEMORY_SIZE) {
+				reply = "E14";
+				return true;
+			}
+			if (kind == 'm') {
+				for (uint32_t i = 0; i < length; i++) {
+					put_hex_byte(reply, cpu.memory[addr + i]);
+				}
+				return true;
+			}
+			const size_t data = packet.find(':') + 1;
+			for (uint32_t i = 0; i < length; i++) {
+				cpu.memory_write(addr + i, parse_hex_byte(packet, data + 2 * i));
+			}
+			reply = "OK";
+			return true;
+		}
+		case 'c':
+		case 's':
+			if (packet.size() > 1) {
+				cpu.program_counter = std::stoul(packet.substr(1), nullptr, 16);
+			}
+			this->halted = false;
+			this->stepping = (kind == 's');
+			return false;
+		case 'Z':
+		case 'z': {
+			// `Z<type>,<addr>,<kind>`, the kind of a watchpoint is its length
+			const size_t first = packet.find(',');
+			const size_t second = packet.find(',', first + 1);
+			const int type = std::stoi(packet.substr(1, first - 1));
+			const uint16_t addr = std::stoul(packet.substr(first + 1, second - first - 1), nullptr, 16);
+			const uint32_t length = std::max<uint32_t>(1, std::stoul(packet.substr(second + 1), nullptr, 16));
+			const uint16_t last = std::min<uint32_t>(addr + length - 1, MEMORY_SIZE - 1);
+			uint8_t access;
+			switch (type) {
+				case 0:
+				case 1:
+					if (kind == 'Z') {
+						this->debugger.add_breakpoint(addr);
+					} else {
+						this->debugger.remove_breakpoint(addr);
+					}
+					reply = "OK";
+					return true;
+				case 2:
+					access = DebugAccess::WriteAccess;
+					break;
+				case 3:
+					access = DebugAccess::ReadAccess;
+					break;
+				case 4:
+					access = DebugAccess::ReadAccess | DebugAccess::WriteAccess;
+					break;
+				default:
+					// Empty reply, not supported
+					return true;
+			}
+			if (kind == 'Z') {
+				this->debugger.add_watchpoint(addr, last, access);
+			} else {
+				this->debugger.remove_watchpoint(addr, last, access);
+			}
+			reply = "OK";
+			return true;
+		}
+		case 'D':
+			this->end_session("OK", true);
+			return false;
+		case 'k':
+			this->end_session("", true);
+			return false;
+		case 'H':
+			reply = "OK";
+			return true;
+		case 'q':
+			if (packet.compare(0, 10, "qSupported") == 0) {
+				reply = "PacketSize=1000";
+			} else if (packet.compare(0, 9, "qAttached") == 0) {
+				reply = "1";
+			}
+			return true;
+		default:
+			// Anything else is answered with an empty packet, telling the client it is not supported
+			return true;
+	}
+}
+
+
+void GdbServer::stop(const std::string& stop_reply) {
+	this->halted = true;
+	this->stepping = false;
+	this->last_stop = stop_reply;
+	this->send({stop_reply, false});
+}
+
+
+void GdbServer::end_session(const std::string& last_reply, const bool close) {
+	this->cpu.attach_debugger(nullptr);
+	this->debugger.clear();
+	this->session = false;
+	this->halted = false;
+	this->stepping = false;
+	if (close || !last_reply.empty()) {
+		this->send({last_reply, close});
+	}
+}
+
+
+void GdbServer::send(const GdbReply reply) {
+	while (!this->replies.push(reply)) {
+		std::this_thread::yield();
+	}
+}
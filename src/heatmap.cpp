@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "heatmap.hpp"
+
+namespace {
+
+const size_t PAGE_SIZE = 0x100;
+
+// Brightness of a counter on a logarithmic scale, so a handful of accesses still shows next to a hot loop
+uint8_t intensity(const uint64_t count, const uint64_t max) {
+	if (count == 0) {
+		return 0;
+	}
+	return (uint8_t)(32 + 223 * std::log1p((double)count) / std::log1p((double)max));
+}
+
+} // namespace
+
+
+MemoryHeatmap::MemoryHeatmap() : reads(MEMORY_SIZE, 0), writes(MEMORY_SIZE, 0), executes(MEMORY_SIZE, 0) {}
+
+
+void MemoryHeatmap::clear() {
+	std::fill(this->reads.begin(), this->reads.end(), 0);
+	std::fill(this->writes.begin(), this->writes.end(), 0);
+	std::fill(this->executes.begin(), this->executes.end(), 0);
+}
+
+
+uint64_t MemoryHeatmap::page_accesses(const uint8_t page) const {
+	uint64_t total = 0;
+	for (size_t addr = page * PAGE_SIZE; addr < (page + 1) * PAGE_SIZE; addr++) {
+		total += this->reads[addr] + this->writes[addr] + this->executes[addr];
+	}
+	return total;
+}
+
+
+void MemoryHeatmap::write_csv(std::ostream& out, const bool per_page) const {
+	const size_t step = per_page ? PAGE_SIZE : 1;
+	out << (per_page ? "page" : "address") << ",reads,writes,executes" << std::endl;
+	for (size_t start = 0; start < MEMORY_SIZE; start += step) {
+		uint64_t reads = 0, writes = 0, executes = 0;
+		for (size_t addr = start; addr < start + step; addr++) {
+			reads += this->reads[addr];
+			writes += this->writes[addr];
+			executes += this->executes[addr];
+		}
+		if (reads == 0 && writes == 0 && executes == 0) {
+			continue;
+		}
+		out << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(per_page ? 2 : 4)
+			<< (per_page ? start / PAGE_SIZE : start) << std::dec << std::nouppercase << std::setfill(' ')
+			<< "," << reads << "," << writes << "," << executes << std::endl;
+	}
+}
+
+
+void MemoryHeatmap::write_image(std::ostream& out) const {
+	const uint64_t max_reads = *std::max_element(this->reads.begin(), this->reads.end());
+	const uint64_t max_writes = *std::max_element(this->writes.begin(), this->writes.end());
+	const uint64_t max_executes = *std::max_element(this->executes.begin(), this->executes.end());
+
+	out << "P6\n" << PAGE_SIZE << " " << MEMORY_SIZE / PAGE_SIZE << "\n255\n";
+	std::vector<uint8_t> pixels(MEMORY_SIZE * 3);
+	for (size_t addr = 0; addr < MEMORY_SIZE; addr++) {
+		pixels[3 * addr] = intensity(this->writes[addr], max_writes);
+		pixels[3 * addr + 1] = intensity(this->reads[addr], max_reads);
+		pixels[3 * addr + 2] = intensity(this->executes[addr], max_executes);
+	}
+	out.write((const char*)pixels.data(), pixels.size());
+}
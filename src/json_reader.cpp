@@ -0,0 +1,307 @@
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json_reader.hpp"
+
+namespace {
+
+// Size of the window the document is read through
+const size_t READ_BUFFER_SIZE = 1 << 16;
+
+} // namespace
+
+
+JsonReader::JsonReader(std::istream& in) : in(in), buffer(READ_BUFFER_SIZE) {
+	this->position = 0;
+	this->filled = 0;
+	this->consumed = 0;
+}
+
+
+char JsonReader::peek() {
+	if (this->position == this->filled) {
+		this->consumed += this->filled;
+		this->in.read(this->buffer.data(), this->buffer.size());
+		this->filled = this->in.gcount();
+		this->position = 0;
+		if (this->filled == 0) {
+			return '\0';
+		}
+	}
+	return this->buffer[this->position];
+}
+
+
+char JsonReader::get() {
+	const char c = this->peek();
+	if (this->position == this->filled) {
+		this->error("unexpected end of the document");
+	}
+	this->position += 1;
+	return c;
+}
+
+
+void JsonReader::expect(const char c) {
+	this->skip_whitespace();
+	if (this->get() != c) {
+		this->position -= 1;
+		this->error(std::string("expected '") + c + "'");
+	}
+}
+
+
+void JsonReader::skip_whitespace() {
+	while (true) {
+		const char c = this->peek();
+		if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+			return;
+		}
+		this->position += 1;
+	}
+}
+
+
+void JsonReader::skip_literal(const char* literal) {
+	for (const char* c = literal; *c != '\0'; c++) {
+		if (this->get() != *c) {
+			this->error(std::string("expected '") + literal + "'");
+		}
+	}
+}
+
+
+void JsonReader::error(const std::string& message) const {
+	throw std::runtime_error("JSON error at byte " + std::to_string(this->offset()) + ": " + message);
+}
+
+
+uint64_t JsonReader::offset() const {
+	return this->consumed + this->position;
+}
+
+
+void JsonReader::begin_array() {
+	this->expect('[');
+	this->first_member.push_back(true);
+}
+
+
+bool JsonReader::next_element() {
+	this->skip_whitespace();
+	if (this->first_member.empty()) {
+		this->error("not inside an array");
+	}
+	if (this->peek() == ']') {
+		this->position += 1;
+		this->first_member.pop_back();
+		return false;
+	}
+	if (!this->first_member.back()) {
+		this->expect(',');
+	}
+	this->first_member.back() = false;
+	return true;
+}
+
+
+void JsonReader::begin_object() {
+	this->expect('{');
+	this->first_member.push_back(true);
+}
+
+
+bool JsonReader::next_key(std::string& key) {
+	this->skip_whitespace();
+	if (this->first_member.empty()) {
+		this->error("not inside an object");
+	}
+	if (this->peek() == '}') {
+		this->position += 1;
+		this->first_member.pop_back();
+		return false;
+	}
+	if (!this->first_member.back()) {
+		this->expect(',');
+	}
+	this->first_member.back() = false;
+	key = this->read_string();
+	this->expect(':');
+	return true;
+}
+
+
+std::string JsonReader::read_string() {
+	this->expect('"');
+	std::string value;
+	while (true) {
+		const char c = this->get();
+		if (c == '"') {
+			return value;
+		}
+		if (c != '\\') {
+			value += c;
+			continue;
+		}
+		const char escaped = this->get();
+		switch (escaped) {
+			case '"':
+			case '\\':
+			case '/':
+				value += escaped;
+				break;
+			case 'b':
+				value += '\b';
+				break;
+			case 'f':
+				value += '\f';
+				break;
+			case 'n':
+				value += '\n';
+				break;
+			case 'r':
+				value += '\r';
+				break;
+			case 't':
+				value += '\t';
+				break;
+			case 'u': {
+				uint32_t code = 0;
+				for (int i = 0; i < 4; i++) {
+					const char digit = this->get();
+					code <<= 4;
+					if (digit >= '0' && digit <= '9') {
+						code |= digit - '0';
+					} else if ((digit | 0x20) >= 'a' && (digit | 0x20) <= 'f') {
+						code |= (digit | 0x20) - 'a' + 10;
+					} else {
+						this->error("invalid \\u escape");
+					}
+				}
+				// Surrogate halves are written as they come, JSON test data does not need more
+				if (code < 0x80) {
+					value += (char)code;
+				} else if (code < 0x800) {
+					value += (char)(0xC0 | (code >> 6));
+					value += (char)(0x80 | (code & 0x3F));
+				} else {
+					value += (char)(0xE0 | (code >> 12));
+					value += (char)(0x80 | ((code >> 6) & 0x3F));
+					value += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default:
+				this->error("invalid escape");
+		}
+	}
+}
+
+
+int64_t JsonReader::read_integer() {
+	this->skip_whitespace();
+	const bool negative = (this->peek() == '-');
+	if (negative) {
+		this->position += 1;
+	}
+	char c = this->peek();
+	if (c < '0' || c > '9') {
+		this->error("expected an integer");
+	}
+	uint64_t magnitude = 0;
+	while (c >= '0' && c <= '9') {
+		if (magnitude > (std::numeric_limits<uint64_t>::max() - (c - '0')) / 10) {
+			this->error("integer out of range");
+		}
+		magnitude = magnitude * 10 + (c - '0');
+		this->position += 1;
+		c = this->peek();
+	}
+	if (c == '.' || c == 'e' || c == 'E') {
+		this->error("expected an integer");
+	}
+	const uint64_t limit = (uint64_t)std::numeric_limits<int64_t>::max() + (negative ? 1 : 0);
+	if (magnitude > limit) {
+		this->error("integer out of range");
+	}
+	return negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+}
+
+
+bool JsonReader::read_bool() {
+	this->skip_whitespace();
+	if (this->peek() == 't') {
+		this->skip_literal("true");
+		return true;
+	}
+	if (this->peek() == 'f') {
+		this->skip_literal("false");
+		return false;
+	}
+	this->error("expected a boolean");
+}
+
+
+bool JsonReader::read_null() {
+	this->skip_whitespace();
+	if (this->peek() != 'n') {
+		return false;
+	}
+	this->skip_literal("null");
+	return true;
+}
+
+
+void JsonReader::skip_value() {
+	this->skip_whitespace();
+	std::string key;
+	switch (this->peek()) {
+		case '[':
+			this->begin_array();
+			while (this->next_element()) {
+				this->skip_value();
+			}
+			return;
+		case '{':
+			this->begin_object();
+			while (this->next_key(key)) {
+				this->skip_value();
+			}
+			return;
+		case '"':
+			this->read_string();
+			return;
+		case 't':
+			this->skip_literal("true");
+			return;
+		case 'f':
+			this->skip_literal("false");
+			return;
+		case 'n':
+			this->skip_literal("null");
+			return;
+		default: {
+			// Any number, fractions and exponents included
+			const char first = this->peek();
+			if (first != '-' && (first < '0' || first > '9')) {
+				this->error("expected a value");
+			}
+			char c = first;
+			while ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+				this->position += 1;
+				c = this->peek();
+			}
+			return;
+		}
+	}
+}
+
+
+bool JsonReader::at_end() {
+	this->skip_whitespace();
+	return this->peek() == '\0' && this->position == this->filled;
+}
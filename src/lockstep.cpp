@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "lockstep.hpp"
+#include "opcode.hpp"
+
+namespace {
+
+const uint64_t FNV_OFFSET = 0xCBF29CE484222325;
+const uint64_t FNV_PRIME = 0x00000100000001B3;
+
+/**
+ * One of the two engines of a lockstep run with the CPU it drives
+ */
+struct LockstepSide {
+	const LockstepEngine& engine;
+	CPU& cpu;
+	// Memory as of the end of the previous step
+	std::vector<uint8_t> shadow;
+	uint64_t write_hash;
+	std::deque<std::string> trace;
+};
+
+void mix(uint64_t& hash, const uint8_t byte) {
+	hash = (hash ^ byte) * FNV_PRIME;
+}
+
+/**
+ * Fold the bytes changed since the previous step into the write hash of the side
+ */
+void collect_writes(LockstepSide& side) {
+	for (size_t page = 0; page < MEMORY_SIZE; page += 0x100) {
+		if (std::memcmp(side.cpu.memory + page, side.shadow.data() + page, 0x100) == 0) {
+			continue;
+		}
+		for (size_t addr = page; addr < page + 0x100; addr++) {
+			const uint8_t value = side.cpu.memory[addr];
+			if (value != side.shadow[addr]) {
+				mix(side.write_hash, addr & 0xFF);
+				mix(side.write_hash, addr >> 8);
+				mix(side.write_hash, value);
+				side.shadow[addr] = value;
+			}
+		}
+	}
+}
+
+/**
+ * Add a line for the instruction (or step) that started at `pc` to the trace of the side
+ */
+void record(LockstepSide& side, const uint16_t pc) {
+	const CPU& cpu = side.cpu;
+	char line[DISASSEMBLY_LINE_LENGTH];
+	disassemble_line(cpu.memory, pc, line);
+
+	std::ostringstream entry;
+	entry << std::left << std::setw(12) << side.engine.name << std::setw(DISASSEMBLY_LINE_LENGTH) << line << std::right
+		  << std::hex << std::uppercase << std::setfill('0')
+		  << " A=" << std::setw(2) << (int)cpu.register_a
+		  << " X=" << std::setw(2) << (int)cpu.register_irx
+		  << " Y=" << std::setw(2) << (int)cpu.register_iry
+		  << " P=" << std::setw(2) << (int)cpu.status
+		  << " SP=" << std::setw(2) << (int)cpu.stack_pointer
+		  << std::dec << " cycles " << cpu.cycles;
+	side.trace.push_back(entry.str());
+	if (side.trace.size() > LOCKSTEP_TRACE_WINDOW) {
+		side.trace.pop_front();
+	}
+}
+
+std::string stop_name(const StopReason reason) {
+	switch (reason) {
+		case StopReason::BudgetExhausted:
+			return "budget";
+		case StopReason::BreakInstruction:
+			return "brk";
+		case StopReason::Breakpoint:
+			return "breakpoint";
+		case StopReason::Watchpoint:
+			return "watchpoint";
+	}
+	return "?";
+}
+
+std::string hex_byte(const uint8_t value) {
+	std::ostringstream text;
+	text << "$" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << (int)value;
+	return text.str();
+}
+
+/**
+ * Describe the first difference between the two sides, empty when they agree
+ */
+std::string compare_sides(const LockstepSide& reference, const StopReason reference_reason,
+						  const LockstepSide& candidate, const StopReason candidate_reason) {
+	const CPU& a = reference.cpu;
+	const CPU& b = candidate.cpu;
+	if (reference_reason != candidate_reason) {
+		return "stop " + stop_name(reference_reason) + " != " + stop_name(candidate_reason);
+	}
+	if (a.cycles != b.cycles) {
+		return "cycles " + std::to_string(a.cycles) + " != " + std::to_string(b.cycles);
+	}
+	if (a.program_counter != b.program_counter) {
+		std::ostringstream text;
+		text << "PC $" << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << a.program_counter
+			 << " != $" << std::setw(4) << b.program_counter;
+		return text.str();
+	}
+	const struct {
+		const char* name;
+		uint8_t reference;
+		uint8_t candidate;
+	} registers[] = {
+		{"A", a.register_a, b.register_a},
+		{"X", a.register_irx, b.register_irx},
+		{"Y", a.register_iry, b.register_iry},
+		{"P", a.status, b.status},
+		{"SP", a.stack_pointer, b.stack_pointer},
+	};
+	for (const auto& reg : registers) {
+		if (reg.reference != reg.candidate) {
+			return std::string(reg.name) + " " + hex_byte(reg.reference) + " != " + hex_byte(reg.candidate);
+		}
+	}
+	if (reference.write_hash != candidate.write_hash) {
+		for (size_t addr = 0; addr < MEMORY_SIZE; addr++) {
+			if (a.memory[addr] != b.memory[addr]) {
+				std::ostringstream text;
+				text << "memory $" << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << addr << " "
+					 << hex_byte(a.memory[addr]) << " != " << hex_byte(b.memory[addr]);
+				return text.str();
+			}
+		}
+		return "memory writes";
+	}
+	return "";
+}
+
+} // namespace
+
+
+LockstepEngine lockstep_engine(const std::string& name) {
+	const bool fuse = (name == "fused" || name == "fused-idle");
+	const bool skip_idle = (name == "idle" || name == "fused-idle");
+	if (name != "interpreter" && !fuse && !skip_idle) {
+		throw std::invalid_argument("Unknown engine '" + name + "'");
+	}
+	LockstepEngine engine;
+	engine.name = name;
+	engine.prepare = [fuse, skip_idle](CPU& cpu) {
+		cpu.fuse_instructions = fuse;
+		cpu.skip_idle_loops = skip_idle;
+	};
+	engine.run_until = [](CPU& cpu, const uint64_t deadline) {
+		return cpu.run_until(deadline);
+	};
+	return engine;
+}
+
+
+LockstepResult run_lockstep(const LockstepEngine& reference, const LockstepEngine& candidate, CPU& reference_cpu,
+							CPU& candidate_cpu, const FarmJob& job, const uint64_t step_cycles) {
+	const uint64_t step = std::max<uint64_t>(step_cycles, 1);
+	LockstepSide ref = {reference, reference_cpu, {}, FNV_OFFSET, {}};
+	LockstepSide cand = {candidate, candidate_cpu, {}, FNV_OFFSET, {}};
+	for (LockstepSide* side : {&ref, &cand}) {
+		side->cpu.reset_memory_space();
+		side->cpu.load_program(job.program);
+		side->cpu.reset();
+		if (side->engine.prepare) {
+			side->engine.prepare(side->cpu);
+		}
+		side->shadow.assign(side->cpu.memory, side->cpu.memory + MEMORY_SIZE);
+	}
+
+	LockstepResult result;
+	result.name = job.name;
+	result.diverged = false;
+	result.steps = 0;
+	StopReason reference_reason = StopReason::BudgetExhausted;
+	while (true) {
+		const uint16_t pc = cand.cpu.program_counter;
+		const StopReason candidate_reason = candidate.run_until(cand.cpu, std::min(cand.cpu.cycles + step, job.cycle_budget));
+		record(cand, pc);
+
+		// The reference catches up one instruction at a time, and has to stop on the same `BRK`
+		do {
+			const uint16_t reference_pc = ref.cpu.program_counter;
+			reference_reason = reference.run_until(ref.cpu, ref.cpu.cycles + 1);
+			if (reference_reason == StopReason::BudgetExhausted) {
+				record(ref, reference_pc);
+			}
+		} while (reference_reason == StopReason::BudgetExhausted && (ref.cpu.cycles < cand.cpu.cycles
+			|| (ref.cpu.cycles == cand.cpu.cycles && candidate_reason == StopReason::BreakInstruction)));
+
+		collect_writes(ref);
+		collect_writes(cand);
+		result.steps += 1;
+		result.divergence = compare_sides(ref, reference_reason, cand, candidate_reason);
+		if (!result.divergence.empty()) {
+			result.diverged = true;
+			break;
+		}
+		if (reference_reason != StopReason::BudgetExhausted || cand.cpu.cycles >= job.cycle_budget) {
+			break;
+		}
+	}
+
+	if (result.diverged) {
+		result.trace.assign(ref.trace.begin(), ref.trace.end());
+		result.trace.insert(result.trace.end(), cand.trace.begin(), cand.trace.end());
+	}
+	result.cycles = ref.cpu.cycles;
+	result.stop_reason = reference_reason;
+	result.write_hash = ref.write_hash;
+	return result;
+}
+
+
+LockstepFarm::LockstepFarm(const LockstepEngine& reference, const LockstepEngine& candidate,
+						   const unsigned int thread_count)
+	: reference(reference), candidate(candidate), pool(thread_count) {
+	for (unsigned int i = 0; i < this->pool.size(); i++) {
+		this->reference_cpus.push_back(std::make_unique<CPU>());
+		this->candidate_cpus.push_back(std::make_unique<CPU>());
+	}
+}
+
+
+std::vector<LockstepResult> LockstepFarm::run(const std::vector<FarmJob>& jobs, const uint64_t step_cycles) {
+	std::vector<LockstepResult> results(jobs.size());
+	this->pool.run(jobs.size(), [this, &jobs, &results, step_cycles](size_t index, unsigned int worker) {
+		results[index] = run_lockstep(this->reference, this->candidate, *this->reference_cpus[worker],
+									  *this->candidate_cpus[worker], jobs[index], step_cycles);
+	});
+	return results;
+}
+
+
+std::vector<FarmJob> random_lockstep_jobs(const size_t count, const uint64_t seed, const size_t instructions,
+										  const uint64_t cycle_budget) {
+	// Everything documented except `BRK`, `RTI`, `RTS` and `JMP (ind)`, which would leave the generated code, and the
+	// indirect stores, which could overwrite it
+	std::vector<uint8_t> candidates;
+	for (const Opcode& opcode : OPCODES) {
+		if (opcode.size != 0 && opcode.code != 0x00 && opcode.code != 0x40 && opcode.code != 0x60 && opcode.code != 0x6C
+			&& opcode.code != 0x81 && opcode.code != 0x91) {
+			candidates.push_back(opcode.code);
+		}
+	}
+
+	std::vector<FarmJob> jobs;
+	for (size_t index = 0; index < count; index++) {
+		std::mt19937_64 random(seed * 0x9E3779B97F4A7C15 + index);
+		std::vector<uint8_t> opcodes(instructions);
+		std::vector<uint16_t> starts(instructions + 1);
+		uint16_t addr = 0x0600;
+		for (size_t i = 0; i < instructions; i++) {
+			opcodes[i] = candidates[random() % candidates.size()];
+			starts[i] = addr;
+			addr += OPCODES[opcodes[i]].size;
+		}
+		starts[instructions] = addr;
+
+		FarmJob job;
+		job.name = "random-" + std::to_string(seed) + "-" + std::to_string(index);
+		job.cycle_budget = cycle_budget;
+		for (size_t i = 0; i < instructions; i++) {
+			const Opcode& opcode = OPCODES[opcodes[i]];
+			job.program.push_back(opcode.code);
+			if (opcode.mode == AddressingMode::Relative) {
+				// A boundary within reach of the branch, the final `BRK` included
+				const uint16_t next = starts[i] + 2;
+				std::vector<uint16_t> targets;
+				for (const uint16_t start : starts) {
+					if ((int)start - next >= -128 && (int)start - next <= 127) {
+						targets.push_back(start);
+					}
+				}
+				job.program.push_back((uint8_t)(targets[random() % targets.size()] - next));
+			} else if (opcode.code == 0x4C || opcode.code == 0x20) {
+				const uint16_t target = starts[random() % starts.size()];
+				job.program.push_back(target & 0xFF);
+				job.program.push_back(target >> 8);
+			} else if (opcode.size == 3) {
+				// Data below the program, indexing included: `$0000` - `$05FE`
+				const uint16_t operand = random() % 0x0500;
+				job.program.push_back(operand & 0xFF);
+				job.program.push_back(operand >> 8);
+			} else if (opcode.size == 2) {
+				job.program.push_back(random() & 0xFF);
+			}
+		}
+		job.program.push_back(0x00);
+		jobs.push_back(job);
+	}
+	return jobs;
+}
+
+
+void write_lockstep_report(std::ostream& out, const std::vector<LockstepResult>& results) {
+	int diverged = 0;
+	uint64_t steps = 0;
+	for (const LockstepResult& result : results) {
+		steps += result.steps;
+		out << std::left << std::setw(32) << result.name << std::right
+			<< std::setw(10) << result.steps << " steps"
+			<< std::setw(12) << result.cycles << " cycles  "
+			<< (result.diverged ? "DIVERGED: " + result.divergence : stop_name(result.stop_reason))
+			<< std::endl;
+		if (result.diverged) {
+			diverged += 1;
+			for (const std::string& line : result.trace) {
+				out << "    " << line << std::endl;
+			}
+		}
+	}
+	out << std::endl << results.size() << " programs, " << steps << " steps compared, " << diverged << " diverged"
+		<< std::endl;
+}
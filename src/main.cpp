@@ -1,84 +1,31 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 #include <curses.h>
 #include <termios.h>
 
+#include "call_profiler.hpp"
+#include "conformance.hpp"
+#include "disassembler.hpp"
+#include "farm.hpp"
+#include "fuzzer.hpp"
+#include "gdb_server.hpp"
+#include "heatmap.hpp"
+#include "lockstep.hpp"
 #include "mos6502.hpp"
+#include "movie.hpp"
+#include "profiler.hpp"
+#include "programs.hpp"
+#include "random_device.hpp"
+#include "recompiler.hpp"
 
-// #define TEST
-
-#ifdef TEST
-#include <cstdint>
-#include <iostream>
-#include "../test/test.hpp"
-
-#define DEFAULT         "\033[0m"
-#define RED             "\033[31m"
-#define GREEN           "\033[32m"
-#define YELLOW          "\033[33m"
-
-void run_tests() {
-    int total_tests = 0;
-    int tests_succeeded = 0;
-    std::cout << "lda tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_lda_immediate_load_state();
-    tests_succeeded += test_lda_zero_flag();
-    total_tests += 2;
-
-    std::cout << std::endl << "tax tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_tax_load_state();
-    tests_succeeded += test_tax_zero_flag();
-    total_tests += 2;
-
-    std::cout << std::endl << "inx tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_inx();
-    tests_succeeded += test_inx_overflow();
-    total_tests += 2;
-
-    std::cout << std::endl << "iny tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_iny();
-    tests_succeeded += test_iny_overflow();
-    total_tests += 2;
-
-    std::cout << std::endl << "adc tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_adc();
-    tests_succeeded += test_adc_status_updates();
-    total_tests += 2;
-
-    std::cout << std::endl << "sbc tests:" << std::endl << "----------" << std::endl;
-    tests_succeeded += test_sbc_status_updates();
-    total_tests += 1;
-
-    std::cout << YELLOW << "[INFO] " << DEFAULT 
-              << tests_succeeded << "/" << total_tests 
-              << " ran succesfully." << std::endl;
-}
-#endif
-
-int run_game() {
-    std::vector<uint8_t> game = {
-        0x20, 0x06, 0x06, 0x20, 0x38, 0x06, 0x20, 0x0d, 0x06, 0x20, 0x2a, 0x06, 0x60, 0xa9, 0x02, 0x85,
-        0x02, 0xa9, 0x04, 0x85, 0x03, 0xa9, 0x11, 0x85, 0x10, 0xa9, 0x10, 0x85, 0x12, 0xa9, 0x0f, 0x85,
-        0x14, 0xa9, 0x04, 0x85, 0x11, 0x85, 0x13, 0x85, 0x15, 0x60, 0xa5, 0xfe, 0x85, 0x00, 0xa5, 0xfe,
-        0x29, 0x03, 0x18, 0x69, 0x02, 0x85, 0x01, 0x60, 0x20, 0x4d, 0x06, 0x20, 0x8d, 0x06, 0x20, 0xc3,
-        0x06, 0x20, 0x19, 0x07, 0x20, 0x20, 0x07, 0x20, 0x2d, 0x07, 0x4c, 0x38, 0x06, 0xa5, 0xff, 0xc9,
-        0x77, 0xf0, 0x0d, 0xc9, 0x64, 0xf0, 0x14, 0xc9, 0x73, 0xf0, 0x1b, 0xc9, 0x61, 0xf0, 0x22, 0x60,
-        0xa9, 0x04, 0x24, 0x02, 0xd0, 0x26, 0xa9, 0x01, 0x85, 0x02, 0x60, 0xa9, 0x08, 0x24, 0x02, 0xd0,
-        0x1b, 0xa9, 0x02, 0x85, 0x02, 0x60, 0xa9, 0x01, 0x24, 0x02, 0xd0, 0x10, 0xa9, 0x04, 0x85, 0x02,
-        0x60, 0xa9, 0x02, 0x24, 0x02, 0xd0, 0x05, 0xa9, 0x08, 0x85, 0x02, 0x60, 0x60, 0x20, 0x94, 0x06,
-        0x20, 0xa8, 0x06, 0x60, 0xa5, 0x00, 0xc5, 0x10, 0xd0, 0x0d, 0xa5, 0x01, 0xc5, 0x11, 0xd0, 0x07,
-        0xe6, 0x03, 0xe6, 0x03, 0x20, 0x2a, 0x06, 0x60, 0xa2, 0x02, 0xb5, 0x10, 0xc5, 0x10, 0xd0, 0x06,
-        0xb5, 0x11, 0xc5, 0x11, 0xf0, 0x09, 0xe8, 0xe8, 0xe4, 0x03, 0xf0, 0x06, 0x4c, 0xaa, 0x06, 0x4c,
-        0x35, 0x07, 0x60, 0xa6, 0x03, 0xca, 0x8a, 0xb5, 0x10, 0x95, 0x12, 0xca, 0x10, 0xf9, 0xa5, 0x02,
-        0x4a, 0xb0, 0x09, 0x4a, 0xb0, 0x19, 0x4a, 0xb0, 0x1f, 0x4a, 0xb0, 0x2f, 0xa5, 0x10, 0x38, 0xe9,
-        0x20, 0x85, 0x10, 0x90, 0x01, 0x60, 0xc6, 0x11, 0xa9, 0x01, 0xc5, 0x11, 0xf0, 0x28, 0x60, 0xe6,
-        0x10, 0xa9, 0x1f, 0x24, 0x10, 0xf0, 0x1f, 0x60, 0xa5, 0x10, 0x18, 0x69, 0x20, 0x85, 0x10, 0xb0,
-        0x01, 0x60, 0xe6, 0x11, 0xa9, 0x06, 0xc5, 0x11, 0xf0, 0x0c, 0x60, 0xc6, 0x10, 0xa5, 0x10, 0x29,
-        0x1f, 0xc9, 0x1f, 0xf0, 0x01, 0x60, 0x4c, 0x35, 0x07, 0xa0, 0x00, 0xa5, 0xfe, 0x91, 0x00, 0x60,
-        0xa6, 0x03, 0xa9, 0x00, 0x81, 0x10, 0xa2, 0x00, 0xa9, 0x01, 0x81, 0x10, 0x60, 0xa2, 0x00, 0xea,
-        0xea, 0xca, 0xd0, 0xfb, 0x60
-    };
-
+int run_game(const uint32_t seed) {
     // std::vector<uint8_t> program = {
     //     0xA9, 0x10, // lda #$10
     //     0x85, 0x17, // sta $17
@@ -118,21 +65,579 @@ int run_game() {
         std::cout << "\033[2J\033[1;1H";
     };
 
+    RandomDevice random(seed);
     CPU nes_6502 = CPU();
-    nes_6502.load_program(game);
+    nes_6502.load_program(SNAKE_PROGRAM);
     nes_6502.reset();
-    nes_6502.memory_write(0x00FE, 3);
+    nes_6502.attach_random_device(&random);
     nes_6502.memory_write(0x00FF, 0x61);
     // nes_6502.run_callback(callback);
     nes_6502.run();
+    nes_6502.attach_random_device(nullptr);
+
+    return 0;
+}
+
+int run_farm(const std::string& list_path, const unsigned int thread_count) {
+    std::vector<FarmJob> jobs;
+    try {
+        jobs = load_farm_jobs(list_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    Farm farm(thread_count);
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<FarmResult> results = farm.run(jobs);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    write_farm_report(std::cout, results, elapsed.count());
+    return 0;
+}
+
+int run_conformance_tests(const std::string& directory, const unsigned int thread_count) {
+    std::vector<std::string> paths;
+    try {
+        paths = conformance_files(directory);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<ConformanceResult> results = run_conformance(paths, thread_count);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    write_conformance_report(std::cout, results, elapsed.count());
+    for (const ConformanceResult& result : results) {
+        if (result.failed > 0 || !result.first_failure.empty()) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int run_fuzz(const std::string& program_path, const uint64_t executions, const uint64_t cycle_budget,
+             const uint64_t seed, const unsigned int thread_count) {
+    std::vector<uint8_t> program;
+    try {
+        program = (program_path == "snake") ? SNAKE_PROGRAM : read_program_file(program_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // One independent fuzzer per worker, each with its own seed
+    WorkStealingPool pool(thread_count);
+    std::vector<std::unique_ptr<Fuzzer>> fuzzers;
+    for (unsigned int i = 0; i < pool.size(); i++) {
+        fuzzers.push_back(std::make_unique<Fuzzer>(program, FuzzOptions{cycle_budget, 64, seed + i}));
+    }
 
+    const auto start = std::chrono::steady_clock::now();
+    pool.run(fuzzers.size(), [&fuzzers, executions](size_t index, unsigned int) {
+        fuzzers[index]->run(executions / fuzzers.size() + ((index < executions % fuzzers.size()) ? 1 : 0));
+    });
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<const Fuzzer*> finished;
+    bool found = false;
+    for (const std::unique_ptr<Fuzzer>& fuzzer : fuzzers) {
+        finished.push_back(fuzzer.get());
+        found = found || !fuzzer->findings().empty();
+    }
+    write_fuzz_report(std::cout, finished, program, elapsed.count());
+    return found ? 1 : 0;
+}
+
+int run_record(const std::string& movie_path, const std::string& program_path, const uint32_t frames,
+               const uint64_t seed) {
+    try {
+        const std::vector<uint8_t> program = (program_path == "snake") ? SNAKE_PROGRAM : read_program_file(program_path);
+        MovieRecorder recorder(program, (uint32_t)(seed * 0x9E3779B9) | 1);
+
+        // The game loop has no keyboard input to record yet, a scripted player presses a direction every 8 - 63 frames
+        const uint8_t keys[] = {0x77, 0x61, 0x73, 0x64};
+        std::mt19937 random(seed);
+        uint32_t next_press = 0;
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            uint8_t key = 0;
+            if (frame == next_press) {
+                key = keys[random() % 4];
+                next_press += 8 + random() % 56;
+            }
+            recorder.frame(key);
+        }
+        save_movie(movie_path, recorder.movie());
+        std::cout << movie_path << ": " << frames << " frames, " << recorder.movie().hashes.size() << " state hashes, "
+                  << recorder.movie().keyframes.size() << " keyframes" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
 
-int main() {
-    #ifdef TEST
-    run_tests();
-    #endif
+int run_play(const std::string& movie_path, const int64_t seek_frame) {
+    Movie movie;
+    try {
+        movie = load_movie(movie_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    MoviePlayer player(movie);
+    if (seek_frame >= 0) {
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            player.seek(seek_frame);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "seeked to frame " << player.position() << " in " << elapsed.count() << " ms ("
+                  << player.check().frames << " frames emulated)" << std::endl;
+    }
+
+    // Headless and uncapped, as fast as the core runs
+    const uint32_t from = player.position();
+    const auto start = std::chrono::steady_clock::now();
+    const MovieCheck& check = player.play();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const uint32_t played = player.position() - from;
+    std::cout << movie_path << ": played frames " << from << " - " << player.position() << " in " << elapsed.count()
+              << " s (" << ((elapsed.count() > 0) ? played / elapsed.count() / 60 : 0) << "x real time), "
+              << check.hashes << " state hashes verified" << std::endl;
+    if (check.desynced) {
+        std::cout << "desync after frame " << check.desync_frame << ": state hash " << std::hex << check.actual_hash
+                  << ", movie has " << check.expected_hash << std::dec << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    run_game();
+int run_verify(const std::string& movie_path, const unsigned int thread_count) {
+    Movie movie;
+    try {
+        movie = load_movie(movie_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<MovieCheck> segments = verify_movie_segments(movie, thread_count);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    uint64_t hashes = 0;
+    size_t desynced = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const MovieCheck& check = segments[i];
+        hashes += check.hashes;
+        if (check.desynced) {
+            const size_t end = (i + 1 < segments.size()) ? movie.keyframes[i + 1].frame : movie.keys.size();
+            std::cout << "segment " << i << " (frames " << movie.keyframes[i].frame << " - " << end - 1
+                      << "): desync after frame " << check.desync_frame << ": state hash " << std::hex
+                      << check.actual_hash << ", movie has " << check.expected_hash << std::dec << std::endl;
+            desynced += 1;
+        }
+    }
+    std::cout << movie_path << ": " << movie.keys.size() << " frames in " << segments.size() << " segments verified in "
+              << elapsed.count() << " s (" << ((elapsed.count() > 0) ? movie.keys.size() / elapsed.count() / 60 : 0)
+              << "x real time), " << hashes << " state hashes, " << desynced << " segments out of sync" << std::endl;
+    return (desynced == 0) ? 0 : 1;
+}
+
+int run_lockstep_batch(const std::string& engine_name, const std::string& list_path, const size_t random_count,
+                       const uint64_t seed, const uint64_t cycle_budget, const uint64_t step_cycles,
+                       const unsigned int thread_count) {
+    std::vector<FarmJob> jobs;
+    LockstepEngine candidate;
+    try {
+        candidate = lockstep_engine(engine_name);
+        if (!list_path.empty()) {
+            jobs = load_farm_jobs(list_path);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    const std::vector<FarmJob> random_jobs = random_lockstep_jobs(random_count, seed, 256, cycle_budget);
+    jobs.insert(jobs.end(), random_jobs.begin(), random_jobs.end());
+
+    LockstepFarm farm(lockstep_engine("interpreter"), candidate, thread_count);
+    const std::vector<LockstepResult> results = farm.run(jobs, step_cycles);
+    write_lockstep_report(std::cout, results);
+    for (const LockstepResult& result : results) {
+        if (result.diverged) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int run_profile(const std::string& program_path, const uint64_t cycle_budget, const size_t top,
+                const std::string& callgraph_path) {
+    std::vector<uint8_t> program;
+    try {
+        program = read_program_file(program_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CPU cpu = CPU();
+    cpu.load_program(program);
+    cpu.reset();
+
+    // Programs reading random values from $FE get them, as in the game
+    RandomDevice random;
+    if (callgraph_path.empty()) {
+        Profiler profiler;
+        WithRandomDevice<Profiler> policy = {random, profiler};
+        const StopReason reason = cpu.run_until(cycle_budget, policy);
+        std::cout << program_path << ": " << ((reason == StopReason::BreakInstruction) ? "ran to BRK" : "budget exhausted")
+                  << " at $" << std::hex << cpu.program_counter << std::dec << std::endl;
+        profiler.write_report(std::cout, cpu, top);
+        return 0;
+    }
+
+    std::ofstream folded(callgraph_path);
+    if (!folded) {
+        std::cerr << "Could not open " << callgraph_path << std::endl;
+        return 1;
+    }
+    CallProfiler profiler;
+    WithRandomDevice<CallProfiler> policy = {random, profiler};
+    const StopReason reason = cpu.run_until(cycle_budget, policy);
+    profiler.finish(cpu);
+    std::cout << program_path << ": " << ((reason == StopReason::BreakInstruction) ? "ran to BRK" : "budget exhausted")
+              << " at $" << std::hex << cpu.program_counter << std::dec << std::endl;
+    profiler.write_report(std::cout, top);
+    profiler.write_folded(folded);
+    return 0;
+}
+
+int run_heatmap(const std::string& program_path, const uint64_t cycle_budget, const std::string& prefix,
+                const uint32_t window_frames) {
+    if (window_frames == 0) {
+        std::cerr << "The heatmap window has to be at least one frame" << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> program;
+    try {
+        program = read_program_file(program_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CPU cpu = CPU();
+    cpu.load_program(program);
+    cpu.reset();
+
+    RandomDevice random;
+    cpu.attach_random_device(&random);
+    MemoryHeatmap heatmap;
+    try {
+        cpu.attach_heatmap(&heatmap);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // One CSV and one image per window of frames
+    const uint64_t window_cycles = (uint64_t)window_frames * CYCLES_PER_FRAME;
+    StopReason reason = StopReason::BudgetExhausted;
+    for (int window = 0; reason == StopReason::BudgetExhausted && cpu.cycles < cycle_budget; window++) {
+        reason = cpu.run_until(std::min(cpu.cycles + window_cycles, cycle_budget));
+
+        const std::string name = prefix + "-" + std::to_string(window);
+        std::ofstream csv(name + ".csv");
+        std::ofstream image(name + ".ppm", std::ios::binary);
+        if (!csv || !image) {
+            std::cerr << "Could not write " << name << ".csv / .ppm" << std::endl;
+            return 1;
+        }
+        heatmap.write_csv(csv, false);
+        heatmap.write_image(image);
+
+        int hottest_page = 0;
+        for (int page = 1; page < 0x100; page++) {
+            if (heatmap.page_accesses(page) > heatmap.page_accesses(hottest_page)) {
+                hottest_page = page;
+            }
+        }
+        std::cout << name << ": hottest page $" << std::hex << hottest_page << std::dec << " ("
+                  << heatmap.page_accesses(hottest_page) << " accesses)" << std::endl;
+        heatmap.clear();
+    }
+    cpu.attach_heatmap(nullptr);
+    cpu.attach_random_device(nullptr);
+    return 0;
+}
+
+int run_disassemble(const std::string& program_path) {
+    std::vector<uint8_t> program;
+    try {
+        program = read_program_file(program_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CPU cpu = CPU();
+    cpu.load_program(program);
+    char line[DISASSEMBLY_LINE_LENGTH];
+    for (uint32_t addr = 0x0600; addr < 0x0600 + program.size();) {
+        addr += disassemble_line(cpu.memory, addr, line);
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
+
+int run_recompile(const std::string& program_path, const std::string& output_path, const std::string& name) {
+    std::vector<uint8_t> program;
+    if (program_path == "snake") {
+        program = SNAKE_PROGRAM;
+    } else {
+        try {
+            program = read_program_file(program_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    CPU cpu = CPU();
+    cpu.load_program(program);
+
+    std::ofstream out(output_path);
+    if (!out) {
+        std::cerr << "Could not open " << output_path << std::endl;
+        return 1;
+    }
+    StaticRecompiler recompiler(cpu.memory);
+    const std::vector<BasicBlock>& blocks = recompiler.discover();
+    recompiler.emit(out, name);
+
+    size_t instructions = 0;
+    for (const BasicBlock& block : blocks) {
+        instructions += block.instructions.size();
+    }
+    std::cout << program_path << ": " << blocks.size() << " blocks, " << instructions << " instructions recompiled to "
+              << output_path << std::endl;
+    return 0;
+}
+
+int run_gdb(const std::string& socket_path, const std::string& program_path) {
+    std::vector<uint8_t> program;
+    try {
+        program = read_program_file(program_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CPU cpu = CPU();
+    cpu.load_program(program);
+    cpu.reset();
+    RandomDevice random;
+    cpu.attach_random_device(&random);
+
+    try {
+        GdbServer server(cpu, socket_path);
+        std::cout << "Waiting for a client on " << socket_path << " (target remote " << socket_path << ")" << std::endl;
+        while (!server.client_connected()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        // Frame by frame until the program ends, the client halts the target in between as it likes
+        while (server.run_until(cpu.cycles + CYCLES_PER_FRAME) == StopReason::BudgetExhausted) {
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << program_path << ": ran to BRK at $" << std::hex << cpu.program_counter << std::dec << std::endl;
+    return 0;
+}
+
+void print_usage(const char* program_name) {
+    std::cerr << "usage: " << program_name << " [--seed N]                   run the snake game" << std::endl
+              << "       " << program_name << " --farm <job list> [--threads N]  run a batch of programs headless" << std::endl
+              << "       " << program_name << " --profile <program> [--cycles N] [--top N] [--callgraph <out>]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              profile a program headless, optionally" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              writing its call graph as folded stacks" << std::endl
+              << "       " << program_name << " --profile <program> --heatmap <prefix> [--window N] [--cycles N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              write memory heatmaps every N frames" << std::endl
+              << "       " << program_name << " --disassemble <program>      list the instructions of a program" << std::endl
+              << "       " << program_name << " --gdb <socket> <program>     debug a program with a GDB remote client" << std::endl
+              << "       " << program_name << " --conformance <directory> [--threads N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              run single-step JSON tests (one file per opcode)" << std::endl
+              << "       " << program_name << " --lockstep <engine> [--farm <job list>] [--random N] [--seed N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "          [--cycles N] [--step N] [--threads N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              compare an engine (fused, idle, fused-idle)" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              against the interpreter in lockstep" << std::endl
+              << "       " << program_name << " --fuzz <program> [--execs N] [--cycles N] [--seed N] [--threads N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              fuzz a program (or `snake`) for invalid" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              opcodes, hangs and crashes" << std::endl
+              << "       " << program_name << " --record <movie> <program> [--frames N] [--seed N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              record a movie of a program (or `snake`)" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              played by a scripted player" << std::endl
+              << "       " << program_name << " --play <movie> [--seek F]    play a movie back headless and verify it," << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              starting at frame F" << std::endl
+              << "       " << program_name << " --verify <movie> [--threads N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              verify a movie, the segments between its" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              keyframes in parallel" << std::endl
+              << "       " << program_name << " --recompile <program> --output <file> [--name N]" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              recompile a program (or the built-in" << std::endl
+              << "       " << std::string(std::strlen(program_name), ' ') << "                              `snake`) to a C++ translation unit" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        return run_game(RANDOM_DEVICE_DEFAULT_SEED);
+    }
+    if (argc == 3 && std::strcmp(argv[1], "--seed") == 0) {
+        const uint64_t game_seed = std::stoull(argv[2]);
+        if (game_seed == 0 || game_seed > UINT32_MAX) {
+            std::cerr << "--seed of the snake game must be between 1 and " << UINT32_MAX << std::endl;
+            return 1;
+        }
+        return run_game((uint32_t)game_seed);
+    }
+
+    std::string farm_list;
+    std::string profile_program;
+    unsigned int thread_count = 0;
+    uint64_t profile_cycles = 60 * (uint64_t)CYCLES_PER_FRAME;
+    size_t profile_top = 20;
+    std::string callgraph_path;
+    std::string heatmap_prefix;
+    uint32_t heatmap_window = 60;
+    std::string disassemble_program;
+    std::string recompile_program;
+    std::string recompile_output;
+    std::string recompile_name = "recompiled";
+    std::string conformance_directory;
+    std::string fuzz_program;
+    uint64_t fuzz_executions = 1000000;
+    std::string lockstep_engine_name;
+    size_t lockstep_random = 0;
+    uint64_t lockstep_seed = 1;
+    uint64_t lockstep_step = 1;
+    bool cycles_given = false;
+    std::string gdb_socket;
+    std::string gdb_program;
+    std::string record_movie;
+    std::string record_program;
+    uint32_t record_frames = 3600;
+    std::string play_movie;
+    std::string verify_movie_path;
+    int64_t seek_frame = -1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--farm") == 0 && i + 1 < argc) {
+            farm_list = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            profile_cycles = std::stoull(argv[++i]);
+            cycles_given = true;
+        } else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            profile_top = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--callgraph") == 0 && i + 1 < argc) {
+            callgraph_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmap_prefix = argv[++i];
+        } else if (std::strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            heatmap_window = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            fuzz_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--execs") == 0 && i + 1 < argc) {
+            fuzz_executions = std::stoull(argv[++i]);
+        } else if (std::strcmp(argv[i], "--conformance") == 0 && i + 1 < argc) {
+            conformance_directory = argv[++i];
+        } else if (std::strcmp(argv[i], "--lockstep") == 0 && i + 1 < argc) {
+            lockstep_engine_name = argv[++i];
+        } else if (std::strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            lockstep_random = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            lockstep_seed = std::stoull(argv[++i]);
+        } else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            lockstep_step = std::stoull(argv[++i]);
+        } else if (std::strcmp(argv[i], "--gdb") == 0 && i + 2 < argc) {
+            gdb_socket = argv[++i];
+            gdb_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 2 < argc) {
+            record_movie = argv[++i];
+            record_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            record_frames = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            play_movie = argv[++i];
+        } else if (std::strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+            verify_movie_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+            seek_frame = std::stoul(argv[++i]);
+        } else if (std::strcmp(argv[i], "--disassemble") == 0 && i + 1 < argc) {
+            disassemble_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--recompile") == 0 && i + 1 < argc) {
+            recompile_program = argv[++i];
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            recompile_output = argv[++i];
+        } else if (std::strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            recompile_name = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!fuzz_program.empty()) {
+        // Short executions keep the throughput up, inputs that need more can be replayed with a larger budget
+        return run_fuzz(fuzz_program, fuzz_executions, cycles_given ? profile_cycles : 2000, lockstep_seed,
+                        thread_count);
+    }
+    if (!record_movie.empty()) {
+        return run_record(record_movie, record_program, record_frames, lockstep_seed);
+    }
+    if (!verify_movie_path.empty()) {
+        return run_verify(verify_movie_path, thread_count);
+    }
+    if (!play_movie.empty()) {
+        return run_play(play_movie, seek_frame);
+    }
+    if (!conformance_directory.empty()) {
+        return run_conformance_tests(conformance_directory, thread_count);
+    }
+    if (!lockstep_engine_name.empty()) {
+        // Random programs mostly end early, a frame is plenty
+        const uint64_t budget = cycles_given ? profile_cycles : (uint64_t)CYCLES_PER_FRAME;
+        return run_lockstep_batch(lockstep_engine_name, farm_list, lockstep_random, lockstep_seed, budget,
+                                  lockstep_step, thread_count);
+    }
+    if (!gdb_socket.empty()) {
+        return run_gdb(gdb_socket, gdb_program);
+    }
+    if (!disassemble_program.empty()) {
+        return run_disassemble(disassemble_program);
+    }
+    if (!recompile_program.empty() && !recompile_output.empty()) {
+        return run_recompile(recompile_program, recompile_output, recompile_name);
+    }
+    if (!profile_program.empty() && !heatmap_prefix.empty()) {
+        return run_heatmap(profile_program, profile_cycles, heatmap_prefix, heatmap_window);
+    }
+    if (!profile_program.empty()) {
+        return run_profile(profile_program, profile_cycles, profile_top, callgraph_path);
+    }
+    if (farm_list.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    return run_farm(farm_list, thread_count);
 }
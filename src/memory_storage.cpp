@@ -0,0 +1,116 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+#include "memory_storage.hpp"
+
+namespace {
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const size_t SLOTS_PER_SLAB = HUGE_PAGE_SIZE / MEMORY_SIZE;
+
+/**
+ * Allocator handing out `MEMORY_SIZE` slots from 2 MiB huge-page slabs. Slabs are never returned to the kernel,
+ * released slots are kept on a free list and cleared when they are handed out again.
+ */
+class HugePageSlabs {
+public:
+	uint8_t* allocate() {
+		std::lock_guard<std::mutex> guard(this->lock);
+
+		// Untouched slots of a mapped slab are still zero, prefer those over clearing a released slot
+		if (!this->fresh_slots.empty()) {
+			uint8_t* slot = this->fresh_slots.back();
+			this->fresh_slots.pop_back();
+			return slot;
+		}
+		if (!this->free_slots.empty()) {
+			uint8_t* slot = this->free_slots.back();
+			this->free_slots.pop_back();
+			std::memset(slot, 0, MEMORY_SIZE);
+			return slot;
+		}
+
+		uint8_t* slab = map_slab();
+		for (size_t i = SLOTS_PER_SLAB - 1; i > 0; i--) {
+			this->fresh_slots.push_back(slab + i * MEMORY_SIZE);
+		}
+		return slab;
+	}
+
+	void release(uint8_t* slot) {
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->free_slots.push_back(slot);
+	}
+
+private:
+	static uint8_t* map_slab() {
+		// Explicit huge pages only succeed when the administrator reserved some (vm.nr_hugepages)
+		void* slab = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+						  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (slab != MAP_FAILED) {
+			return static_cast<uint8_t*>(slab);
+		}
+
+		// Fall back to a 2 MiB aligned region and ask for transparent huge pages. Over-allocate to be able to align
+		// the slab and unmap the slack on either side.
+		void* region = mmap(nullptr, 2 * HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (region == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		const uintptr_t start = reinterpret_cast<uintptr_t>(region);
+		const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+		if (aligned > start) {
+			munmap(region, aligned - start);
+		}
+		const uintptr_t end = start + 2 * HUGE_PAGE_SIZE;
+		if (end > aligned + HUGE_PAGE_SIZE) {
+			munmap(reinterpret_cast<void*>(aligned + HUGE_PAGE_SIZE), end - (aligned + HUGE_PAGE_SIZE));
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(reinterpret_cast<void*>(aligned), HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+#endif
+		return reinterpret_cast<uint8_t*>(aligned);
+	}
+
+	std::mutex lock;
+	std::vector<uint8_t*> free_slots;
+	std::vector<uint8_t*> fresh_slots;
+};
+
+HugePageSlabs& huge_page_slabs() {
+	static HugePageSlabs slabs;
+	return slabs;
+}
+
+} // namespace
+
+
+uint8_t* allocate_memory_space(const MemoryBacking backing) {
+	if (backing == MemoryBacking::HugePages) {
+		return huge_page_slabs().allocate();
+	}
+
+	void* memory = mmap(nullptr, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+	return static_cast<uint8_t*>(memory);
+}
+
+
+void free_memory_space(uint8_t* memory, const MemoryBacking backing) {
+	if (memory == nullptr) {
+		return;
+	}
+	if (backing == MemoryBacking::HugePages) {
+		huge_page_slabs().release(memory);
+		return;
+	}
+	munmap(memory, MEMORY_SIZE);
+}
@@ -1,5 +1,9 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <chrono>
+#include <cstring>
 #include <cstdint>
 #include <functional>
 #include <ios>
@@ -7,228 +11,255 @@
 #include <stdexcept>
 #include <thread>
 #include <vector>
-#include <map>
 #include <iostream>
 #include <iomanip>
 
+#include "debugger.hpp"
+#include "disassembler.hpp"
 #include "mos6502.hpp"
+#include "random_device.hpp"
+#include "state_hash.hpp"
 
-// Implement the OPCODE table later and integrate this
-// I think this warrants the use of a new, seperate cpp file.
-// Either that or move this to the bottom of the file
-std::map<int, Opcode> OPCODES = {
-	// {id, Opcode(id, bytes, cycles, addressingmode, mnenomic}
-	{0x69, Opcode(0x69, 2, 3, AddressingMode::Immediate, "adc")},
-	{0x65, Opcode(0x65, 2, 3, AddressingMode::ZeroPage, "adc")},
-	{0x75, Opcode(0x75, 2, 4, AddressingMode::ZeroPageX, "adc")},
-	{0x6D, Opcode(0x6D, 3, 4, AddressingMode::Absolute, "adc")},
-	{0x7D, Opcode(0x7D, 3, 4, AddressingMode::AbsoluteX, "adc")}, // cycles + 1 if page crossed
-	{0x79, Opcode(0x79, 3, 4, AddressingMode::AbsoluteY, "adc")}, // cycles + 1 if page crossed
-	{0x61, Opcode(0x61, 2, 6, AddressingMode::IndirectX, "adc")},
-	{0x71, Opcode(0x79, 2, 5, AddressingMode::IndirectY, "adc")}, // cycles + 1 if page crossed
-
-	{0x29, Opcode(0x29, 2, 2, AddressingMode::Immediate, "and")},
-	{0x25, Opcode(0x25, 2, 3, AddressingMode::ZeroPage, "and")},
-	{0x35, Opcode(0x35, 2, 4, AddressingMode::ZeroPageX, "and")},
-	{0x2D, Opcode(0x2D, 3, 4, AddressingMode::Absolute, "and")},
-	{0x3D, Opcode(0x3D, 3, 4, AddressingMode::AbsoluteX, "and")}, // cycles + 1 if page crossed
-	{0x39, Opcode(0x39, 3, 4, AddressingMode::AbsoluteY, "and")}, // cycles + 1 if page crossed
-	{0x21, Opcode(0x21, 2, 6, AddressingMode::IndirectX, "and")},
-	{0x31, Opcode(0x31, 2, 5, AddressingMode::IndirectY, "and")}, // cycles + 1 if page crossed
-
-	{0x0A, Opcode(0x0A, 1, 2, AddressingMode::Accumulator, "asl")},
-	{0x06, Opcode(0x06, 2, 5, AddressingMode::ZeroPage, "asl")},
-	{0x16, Opcode(0x16, 2, 6, AddressingMode::ZeroPageX, "asl")},
-	{0x0E, Opcode(0x0E, 3, 6, AddressingMode::Absolute, "asl")},
-	{0x1E, Opcode(0x1E, 3, 7, AddressingMode::AbsoluteX, "asl")},
-
-	{0x24, Opcode(0x24, 2, 3, AddressingMode::ZeroPage, "bit")},
-	{0x2C, Opcode(0x2C, 3, 4, AddressingMode::Absolute, "bit")},
-
-	{0x00, Opcode(0x00, 1, 7, AddressingMode::Implied, "brk")},
-
-	{0xC9, Opcode(0xC9, 2, 2, AddressingMode::Immediate, "cmp")},
-	{0xC5, Opcode(0xC5, 2, 3, AddressingMode::ZeroPage, "cmp")},
-	{0xD5, Opcode(0xD5, 2, 4, AddressingMode::ZeroPageX, "cmp")},
-	{0xCD, Opcode(0xCD, 3, 4, AddressingMode::Absolute, "cmp")},
-	{0xDD, Opcode(0xDD, 3, 4, AddressingMode::AbsoluteX, "cmp")}, // cycles + 1 if page crossed
-	{0xD9, Opcode(0xD9, 3, 4, AddressingMode::AbsoluteY, "cmp")}, // cycles + 1 if page crossed
-	{0xC1, Opcode(0xC1, 2, 6, AddressingMode::IndirectX, "cmp")},
-	{0xD1, Opcode(0xD1, 2, 5, AddressingMode::IndirectY, "cmp")}, // cycles + 1 if page crossed
-
-	{0xE0, Opcode(0xE0, 2, 2, AddressingMode::Immediate, "cpx")},
-	{0xE4, Opcode(0xE4, 2, 3, AddressingMode::ZeroPage, "cpx")},
-	{0xEC, Opcode(0xEC, 3, 4, AddressingMode::Absolute, "cpx")},
-
-	{0xC0, Opcode(0xC0, 2, 2, AddressingMode::Immediate, "cpy")},
-	{0xC4, Opcode(0xC4, 2, 3, AddressingMode::ZeroPage, "cpy")},
-	{0xCC, Opcode(0xCC, 3, 4, AddressingMode::Absolute, "cpy")},
-
-	{0xC6, Opcode(0xC6, 2, 5, AddressingMode::ZeroPage, "dec")},
-	{0xD6, Opcode(0xD6, 2, 6, AddressingMode::ZeroPageX, "dec")},
-	{0xCE, Opcode(0xCE, 3, 6, AddressingMode::Absolute, "dec")},
-	{0xDE, Opcode(0xDE, 3, 7, AddressingMode::AbsoluteX, "dec")},
-
-	{0xCA, Opcode(0xCA, 1, 2, AddressingMode::Implied, "dex")},
-	{0x88, Opcode(0x88, 1, 2, AddressingMode::Implied, "dey")},
-
-	{0x49, Opcode(0x49, 2, 2, AddressingMode::Immediate, "eor")},
-	{0x45, Opcode(0x45, 2, 3, AddressingMode::ZeroPage, "eor")},
-	{0x55, Opcode(0x55, 2, 4, AddressingMode::ZeroPageX, "eor")},
-	{0x4D, Opcode(0x4D, 3, 4, AddressingMode::Absolute, "eor")},
-	{0x5D, Opcode(0x5D, 3, 4, AddressingMode::AbsoluteX, "eor")}, // cycles + 1 if page crossed
-	{0x59, Opcode(0x59, 3, 4, AddressingMode::AbsoluteY, "eor")}, // cycles + 1 if page crossed
-	{0x41, Opcode(0x41, 2, 6, AddressingMode::IndirectX, "eor")},
-	{0x51, Opcode(0x51, 2, 5, AddressingMode::IndirectY, "eor")}, // cycles + 1 if page crossed
-	
-	{0xE6, Opcode(0xE6, 2, 5, AddressingMode::ZeroPage, "inc")},
-	{0xF6, Opcode(0xF6, 2, 6, AddressingMode::ZeroPageX, "inc")},
-	{0xEE, Opcode(0xEE, 3, 6, AddressingMode::Absolute, "inc")},
-	{0xFE, Opcode(0xFE, 3, 7, AddressingMode::AbsoluteX, "inc")},
-
-	{0xE8, Opcode(0xE8, 1, 2, AddressingMode::Implied, "inx")},
-	{0xC8, Opcode(0xC8, 1, 2, AddressingMode::Implied, "iny")},
-
-	{0x4C, Opcode(0x4C, 3, 3, AddressingMode::Absolute, "jmp")},
-	{0x6C, Opcode(0x6C, 3, 3, AddressingMode::Indirect, "jmp")},
-
-	{0x20, Opcode(0x20, 3, 6, AddressingMode::Absolute, "jsr")},
-
-	{0xA9, Opcode(0xA9, 2, 2, AddressingMode::Immediate, "lda")},
-	{0xA5, Opcode(0xA5, 2, 3, AddressingMode::ZeroPage, "lda")},
-	{0xB5, Opcode(0xB5, 2, 4, AddressingMode::ZeroPageX, "lda")},
-	{0xAD, Opcode(0xAD, 3, 4, AddressingMode::Absolute, "lda")},
-	{0xBD, Opcode(0xBD, 3, 4, AddressingMode::AbsoluteX, "lda")}, // cycles + 1 if page crossed
-	{0xB9, Opcode(0xB9, 3, 4, AddressingMode::AbsoluteY, "lda")}, // cycles + 1 if page crossed
-	{0xA1, Opcode(0xA1, 2, 6, AddressingMode::IndirectX, "lda")},
-	{0xB1, Opcode(0xB1, 2, 5, AddressingMode::IndirectY, "lda")}, // cycles + 1 if page crossed
-
-	{0xA2, Opcode(0xA2, 2, 2, AddressingMode::Immediate, "ldx")},
-	{0xA6, Opcode(0xA6, 2, 3, AddressingMode::ZeroPage, "ldx")},
-	{0xB6, Opcode(0xB6, 2, 4, AddressingMode::ZeroPageY, "ldx")},
-	{0xAE, Opcode(0xAE, 3, 4, AddressingMode::Absolute, "ldx")},
-	{0xBE, Opcode(0xBE, 3, 4, AddressingMode::AbsoluteY, "ldx")}, // cycles + 1 if page crossed
-
-	{0xA0, Opcode(0xA0, 2, 2, AddressingMode::Immediate, "ldy")},
-	{0xA4, Opcode(0xA4, 2, 3, AddressingMode::ZeroPage, "ldy")},
-	{0xB4, Opcode(0xB4, 2, 4, AddressingMode::ZeroPageX, "ldy")},
-	{0xAC, Opcode(0xAC, 3, 4, AddressingMode::Absolute, "ldy")},
-	{0xBC, Opcode(0xBC, 3, 4, AddressingMode::AbsoluteX, "ldy")}, // cycles + 1 if page crossed
-
-	{0x4A, Opcode(0x4A, 1, 2, AddressingMode::Accumulator, "lsr")},
-	{0x46, Opcode(0x46, 2, 5, AddressingMode::ZeroPage, "lsr")},
-	{0x56, Opcode(0x56, 2, 6, AddressingMode::ZeroPageX, "lsr")},
-	{0x4E, Opcode(0x4E, 3, 6, AddressingMode::Absolute, "lsr")},
-	{0x5E, Opcode(0x5E, 3, 7, AddressingMode::AbsoluteX, "lsr")},
-
-	{0xEA, Opcode(0xEA, 1, 2, AddressingMode::Implied, "nop")},
-	
-	{0x09, Opcode(0x09, 2, 2, AddressingMode::Immediate, "ora")},
-	{0x05, Opcode(0x05, 2, 3, AddressingMode::ZeroPage, "ora")},
-	{0x15, Opcode(0x15, 2, 4, AddressingMode::ZeroPageX, "ora")},
-	{0x0D, Opcode(0x0D, 3, 4, AddressingMode::Absolute, "ora")},
-	{0x1D, Opcode(0x1D, 3, 4, AddressingMode::AbsoluteX, "ora")}, // cycles + 1 if page crossed
-	{0x19, Opcode(0x19, 3, 4, AddressingMode::AbsoluteY, "ora")}, // cycles + 1 if page crossed
-	{0x01, Opcode(0x01, 2, 6, AddressingMode::IndirectX, "ora")},
-	{0x11, Opcode(0x11, 2, 5, AddressingMode::IndirectY, "ora")}, // cycles + 1 if page crossed
-	
-	{0x2A, Opcode(0x2A, 1, 2, AddressingMode::Accumulator, "rol")},
-	{0x26, Opcode(0x26, 2, 5, AddressingMode::ZeroPage, "rol")},
-	{0x36, Opcode(0x36, 2, 6, AddressingMode::ZeroPageX, "rol")},
-	{0x2E, Opcode(0x2E, 3, 6, AddressingMode::Absolute, "rol")},
-	{0x3E, Opcode(0x3E, 3, 7, AddressingMode::AbsoluteX, "rol")},
-
-	{0x6A, Opcode(0x6A, 1, 2, AddressingMode::Accumulator, "ror")},
-	{0x66, Opcode(0x66, 2, 5, AddressingMode::ZeroPage, "ror")},
-	{0x76, Opcode(0x76, 2, 6, AddressingMode::ZeroPageX, "ror")},
-	{0x6E, Opcode(0x6E, 3, 6, AddressingMode::Absolute, "ror")},
-	{0x7E, Opcode(0x7E, 3, 7, AddressingMode::AbsoluteX, "ror")},
-
-	{0x40, Opcode(0x40, 1, 6, AddressingMode::Implied, "rti")},
-	{0x60, Opcode(0x60, 1, 6, AddressingMode::Implied, "rts")},
-
-	{0xE9, Opcode(0xE9, 2, 2, AddressingMode::Immediate, "sbc")},
-	{0xE5, Opcode(0xE5, 2, 3, AddressingMode::ZeroPage, "sbc")},
-	{0xF5, Opcode(0xF5, 2, 4, AddressingMode::ZeroPageX, "sbc")},
-	{0xED, Opcode(0xED, 3, 4, AddressingMode::Absolute, "sbc")},
-	{0xFD, Opcode(0xFD, 3, 4, AddressingMode::AbsoluteX, "sbc")}, // cycles + 1 if page crossed
-	{0xF9, Opcode(0xF9, 3, 4, AddressingMode::AbsoluteY, "sbc")}, // cycles + 1 if page crossed
-	{0xE1, Opcode(0xE1, 2, 6, AddressingMode::IndirectX, "sbc")},
-	{0xF1, Opcode(0xF1, 2, 5, AddressingMode::IndirectY, "sbc")}, // cycles + 1 if page crossed
-
-	{0x85, Opcode(0x85, 2, 3, AddressingMode::ZeroPage, "sta")},
-	{0x95, Opcode(0x95, 2, 4, AddressingMode::ZeroPageX, "sta")},
-	{0x8D, Opcode(0x8D, 3, 4, AddressingMode::Absolute, "sta")},
-	{0x9D, Opcode(0x9D, 3, 4, AddressingMode::AbsoluteX, "sta")},
-	{0x99, Opcode(0x99, 3, 5, AddressingMode::AbsoluteY, "sta")},
-	{0x81, Opcode(0x81, 3, 5, AddressingMode::IndirectX, "sta")},
-	{0x91, Opcode(0x91, 2, 6, AddressingMode::IndirectY, "sta")},
-
-	{0x86, Opcode(0x86, 2, 3, AddressingMode::ZeroPage, "stx")},
-	{0x96, Opcode(0x96, 2, 4, AddressingMode::ZeroPageY, "stx")},
-	{0x8E, Opcode(0x8E, 3, 4, AddressingMode::Absolute, "stx")},
-
-	{0x84, Opcode(0x84, 2, 3, AddressingMode::ZeroPage, "sty")},
-	{0x94, Opcode(0x94, 2, 4, AddressingMode::ZeroPageX, "sty")},
-	{0x8C, Opcode(0x8C, 3, 4, AddressingMode::Absolute, "sty")},
-
-	{0xAA, Opcode(0xAA, 1, 2, AddressingMode::Implied, "tax")},
-	{0xA8, Opcode(0xA8, 1, 2, AddressingMode::Implied, "tay")},
-	{0xBA, Opcode(0xBA, 1, 2, AddressingMode::Implied, "tsx")},
-	{0x8A, Opcode(0x8A, 1, 2, AddressingMode::Implied, "txa")},
-	{0x9A, Opcode(0x9A, 1, 2, AddressingMode::Implied, "txs")},
-	{0x98, Opcode(0x98, 1, 2, AddressingMode::Implied, "tya")},
-
-	// Stack Instructions
-	{0x48, Opcode(0x48, 1, 3, AddressingMode::Implied, "pha")},
-	{0x08, Opcode(0x08, 1, 3, AddressingMode::Implied, "php")},
-	{0x68, Opcode(0x68, 1, 4, AddressingMode::Implied, "pla")},
-	{0x28, Opcode(0x28, 1, 4, AddressingMode::Implied, "plp")},
-
-	// Flag instructions
-	{0x18, Opcode(0x18, 1, 2, AddressingMode::Implied, "clc")},
-	{0xD8, Opcode(0xD8, 1, 2, AddressingMode::Implied, "cld")},
-	{0x58, Opcode(0x58, 1, 2, AddressingMode::Implied, "cli")},
-	{0xB8, Opcode(0xB8, 1, 2, AddressingMode::Implied, "clv")},
-	{0x38, Opcode(0x38, 1, 2, AddressingMode::Implied, "sec")},
-	{0xF8, Opcode(0xF8, 1, 2, AddressingMode::Implied, "sed")},
-	{0x78, Opcode(0x78, 1, 2, AddressingMode::Implied, "sei")},
-
-	// Branch instructions
-	{0x90, Opcode(0x90, 2, 2, AddressingMode::Relative, "bcc")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0xB0, Opcode(0xB0, 2, 2, AddressingMode::Relative, "bcs")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0xF0, Opcode(0xF0, 2, 2, AddressingMode::Relative, "beq")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0x30, Opcode(0x30, 2, 2, AddressingMode::Relative, "bmi")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0xD0, Opcode(0xD0, 2, 2, AddressingMode::Relative, "bne")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0x10, Opcode(0x10, 2, 2, AddressingMode::Relative, "bpl")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0x50, Opcode(0x50, 2, 2, AddressingMode::Relative, "bvc")}, // + 1 if branch succeeds, +2 if branch to new page
-	{0x70, Opcode(0x70, 2, 2, AddressingMode::Relative, "bvs")}, // + 1 if branch succeeds, +2 if branch to new page
+namespace {
+
+// Longest loop body, in bytes, that `CPU::analyze_loop` looks at
+const int IDLE_LOOP_MAX_LENGTH = 32;
+
+// Run loop policy handing every taken backward branch to `CPU::skip_idle_loop`
+struct IdleLoopSkipper {
+	uint64_t deadline;
+
+	void before_instruction(CPU&, uint16_t, uint8_t) {}
+
+	void after_instruction(CPU& cpu, const uint16_t pc, const uint8_t opcode, uint64_t) {
+		// The conditional branches are $10, $30, ..., $F0
+		if ((opcode & 0x1F) == 0x10 && cpu.program_counter <= pc) {
+			cpu.skip_idle_loop(pc, this->deadline);
+		}
+	}
+
+	void after_interrupt(CPU&, uint64_t) {}
 };
 
+// `IdleLoopSkipper` behind an attached random device
+struct RandomIdleLoopSkipper {
+	RandomDevice& random;
+	IdleLoopSkipper skipper;
 
-Opcode::Opcode() {
-	this->code = 0;
-	this->size = 0;
-	this->cycles = 0;
-	this->mode = AddressingMode::Implied;
-	this->name = "";
+	void before_instruction(CPU& cpu, const uint16_t pc, const uint8_t opcode) {
+		this->random.before_instruction(cpu, pc, opcode);
+	}
+
+	void after_instruction(CPU& cpu, const uint16_t pc, const uint8_t opcode, const uint64_t cycles) {
+		this->skipper.after_instruction(cpu, pc, opcode, cycles);
+	}
+
+	void after_interrupt(CPU&, uint64_t) {}
+};
+
+// Opcodes that can start a superinstruction, see `CPU::run_fused`
+constexpr std::array<bool, OPCODE_COUNT> build_fusion_heads() {
+	std::array<bool, OPCODE_COUNT> heads = {};
+	for (const uint8_t opcode : {0xA9, 0xA5, 0xAD, 0xB5, 0xBD, 0xB9, 0xA1, 0xB1, 0xC9, 0xCA, 0x88, 0xE8, 0xC8}) {
+		heads[opcode] = true;
+	}
+	return heads;
 }
+constexpr std::array<bool, OPCODE_COUNT> FUSION_HEADS = build_fusion_heads();
 
+// Charge the cycles of one part of a superinstruction, the same way `execute_instruction` does
+inline void charge(CPU& cpu, const uint8_t opcode) {
+	cpu.cycles += OPCODES[opcode].cycles + (cpu.page_crossed & OPCODES[opcode].page_penalty);
+	cpu.page_crossed = 0;
+}
 
-Opcode::Opcode(short code,
-			   short size,
-			   short cycles,
-			   AddressingMode mode,
-			   std::string name) {
-	this->code = code;
-	this->size = size;
-	this->cycles = cycles;
-	this->mode = mode;
-	this->name = name;
+// Move on to the next part of a superinstruction, which starts at `pc`
+inline void next_part(CPU& cpu, const uint16_t pc) {
+	cpu.fetch_opcode(pc);
+	cpu.program_counter = pc + 1;
+}
+
+// Hand a taken backward branch to the idle loop detection, as `IdleLoopSkipper` does for plain runs
+template <bool skip_idle>
+inline void after_branch(CPU& cpu, const uint16_t branch_pc, const uint64_t deadline) {
+	if constexpr (skip_idle) {
+		if (cpu.program_counter <= branch_pc) {
+			cpu.skip_idle_loop(branch_pc, deadline);
+		}
+	}
+}
+
+// STA in the addressing mode of `opcode`, false if `opcode` is not a STA
+inline bool store_accumulator(CPU& cpu, const uint8_t opcode) {
+	if (opcode == 0x85) {
+		cpu.STA(AddressingMode::ZeroPage);
+	} else if (opcode == 0x8D) {
+		cpu.STA(AddressingMode::Absolute);
+	} else if (opcode == 0x9D) {
+		cpu.STA(AddressingMode::AbsoluteX);
+	} else if (opcode == 0x91) {
+		cpu.STA(AddressingMode::IndirectY);
+	} else if (opcode == 0x95) {
+		cpu.STA(AddressingMode::ZeroPageX);
+	} else if (opcode == 0x99) {
+		cpu.STA(AddressingMode::AbsoluteY);
+	} else if (opcode == 0x81) {
+		cpu.STA(AddressingMode::IndirectX);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+inline bool is_store_accumulator(const uint8_t opcode) {
+	return opcode == 0x85 || opcode == 0x8D || opcode == 0x9D || opcode == 0x91 || opcode == 0x95 || opcode == 0x99
+		|| opcode == 0x81;
+}
+
+// LDA, STA
+template <AddressingMode load>
+inline uint32_t load_store(CPU& cpu, const uint8_t opcode, const uint16_t next_pc, const uint8_t next,
+						   const uint64_t deadline) {
+	cpu.page_crossed = 0;
+	cpu.LDA(load);
+	charge(cpu, opcode);
+	if (cpu.cycles >= deadline) {
+		return 1;
+	}
+	next_part(cpu, next_pc);
+	store_accumulator(cpu, next);
+	charge(cpu, next);
+	return 2;
+}
+
+// DEX / DEY / CMP #imm, then BNE
+template <bool skip_idle>
+inline uint32_t then_bne(CPU& cpu, const uint8_t opcode, const uint16_t next_pc, const uint64_t deadline) {
+	charge(cpu, opcode);
+	if (cpu.cycles >= deadline) {
+		return 1;
+	}
+	next_part(cpu, next_pc);
+	cpu.BNE();
+	charge(cpu, 0xD0);
+	after_branch<skip_idle>(cpu, next_pc, deadline);
+	return 2;
+}
+
+/**
+ * Execute the superinstruction starting with `opcode` at `pc`, with the program counter already past the opcode
+ * ---
+ * @return `uint32_t instructions`, the amount of instructions executed, 0 if no superinstruction starts at `pc`
+ * ---
+ */
+template <bool skip_idle>
+uint32_t execute_superinstruction(CPU& cpu, const uint8_t opcode, const uint16_t pc, const uint64_t deadline) {
+	const uint16_t next_pc = pc + OPCODES[opcode].size;
+	const uint8_t next = cpu.memory[next_pc];
+	switch (opcode) {
+		case 0xA5: {
+			// LDA zp, CLC, ADC
+			const uint8_t third = cpu.memory[(uint16_t)(next_pc + 1)];
+			if (next == 0x18 && (third == 0x65 || third == 0x69 || third == 0x6D)) {
+				cpu.LDA(AddressingMode::ZeroPage);
+				charge(cpu, opcode);
+				if (cpu.cycles >= deadline) {
+					return 1;
+				}
+				next_part(cpu, next_pc);
+				cpu.CLC();
+				charge(cpu, next);
+				if (cpu.cycles >= deadline) {
+					return 2;
+				}
+				next_part(cpu, next_pc + 1);
+				if (third == 0x65) {
+					cpu.ADC(AddressingMode::ZeroPage);
+				} else if (third == 0x69) {
+					cpu.ADC(AddressingMode::Immediate);
+				} else {
+					cpu.ADC(AddressingMode::Absolute);
+				}
+				charge(cpu, third);
+				return 3;
+			}
+			return is_store_accumulator(next) ? load_store<AddressingMode::ZeroPage>(cpu, opcode, next_pc, next, deadline) : 0;
+		}
+		case 0xA9:
+			return is_store_accumulator(next) ? load_store<AddressingMode::Immediate>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xAD:
+			return is_store_accumulator(next) ? load_store<AddressingMode::Absolute>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xB5:
+			return is_store_accumulator(next) ? load_store<AddressingMode::ZeroPageX>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xBD:
+			return is_store_accumulator(next) ? load_store<AddressingMode::AbsoluteX>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xB9:
+			return is_store_accumulator(next) ? load_store<AddressingMode::AbsoluteY>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xA1:
+			return is_store_accumulator(next) ? load_store<AddressingMode::IndirectX>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xB1:
+			return is_store_accumulator(next) ? load_store<AddressingMode::IndirectY>(cpu, opcode, next_pc, next, deadline) : 0;
+		case 0xC9: {
+			// CMP #imm, BNE
+			if (next != 0xD0) {
+				return 0;
+			}
+			cpu.CMP(AddressingMode::Immediate);
+			return then_bne<skip_idle>(cpu, opcode, next_pc, deadline);
+		}
+		case 0xCA: {
+			// DEX, BNE
+			if (next != 0xD0) {
+				return 0;
+			}
+			cpu.DEX();
+			return then_bne<skip_idle>(cpu, opcode, next_pc, deadline);
+		}
+		case 0x88: {
+			// DEY, BNE
+			if (next != 0xD0) {
+				return 0;
+			}
+			cpu.DEY();
+			return then_bne<skip_idle>(cpu, opcode, next_pc, deadline);
+		}
+		case 0xE8:
+		case 0xC8: {
+			// INX / INY, CPX #imm / CPY #imm, optionally BNE
+			const bool x = opcode == 0xE8;
+			if (next != (x ? 0xE0 : 0xC0)) {
+				return 0;
+			}
+			if (x) {
+				cpu.INX();
+			} else {
+				cpu.INY();
+			}
+			charge(cpu, opcode);
+			if (cpu.cycles >= deadline) {
+				return 1;
+			}
+			next_part(cpu, next_pc);
+			if (x) {
+				cpu.CPX(AddressingMode::Immediate);
+			} else {
+				cpu.CPY(AddressingMode::Immediate);
+			}
+			const uint16_t branch_pc = next_pc + 2;
+			if (cpu.memory[branch_pc] != 0xD0) {
+				charge(cpu, next);
+				return 2;
+			}
+			return 1 + then_bne<skip_idle>(cpu, next, branch_pc, deadline);
+		}
+		default:
+			return 0;
+	}
 }
 
+} // namespace
 
-CPU::CPU() {
+CPU::CPU(const MemoryBacking backing) {
 	this->register_a = 0;
 	this->register_irx = 0;
 	this->register_iry = 0;
@@ -236,16 +267,53 @@ CPU::CPU() {
 	this->stack_pointer = 0xFF;
 	this->status = 0;
 	this->cycles = 0;
-	this->cycle_duration = 559; // ns
-
-	// Initialize memory space to 0
-	for (int i = 0; i < 0xFFFF; i++) {
-		this->memory[i] = 0;
-	}
+	this->interrupt_pending = 0;
+	this->nmi_line = false;
+	this->halt_on_brk = true;
+	this->page_crossed = 0;
+	this->skip_idle_loops = false;
+	this->fuse_instructions = false;
+	this->dirty_pages = 0;
+
+	this->cold = new CPUColdState();
+	this->cold->cycle_duration = 559; // ns
+	this->cold->nmi_asserted_at = 0;
+	this->cold->irq_asserted_at = 0;
+	this->cold->interrupt_sequence_start = UINT64_MAX;
+	this->cold->heatmap = nullptr;
+	this->cold->debugger = nullptr;
+	this->cold->random_device = nullptr;
+	this->cold->idle_branch_pc = 0;
+	this->cold->idle_loop_start = 0;
+	this->cold->idle_arrived_at = 0;
+	this->cold->idle_loop = {false, 0, 0, 0};
+	this->cold->idle_iterations_skipped = 0;
+	this->cold->fusion_instructions = 0;
+	this->cold->fusion_dispatches = 0;
+	this->cold->snapshot_serial = 0;
+	this->cold->snapshot_pages = 0;
+	// No page hashed yet
+	this->cold->unhashed_pages = UINT64_MAX;
+
+	// Freshly allocated memory spaces are already zeroed
+	this->memory_backing = backing;
+	this->memory = allocate_memory_space(backing);
+}
+
+
+CPU::~CPU() {
+	this->attach_debugger(nullptr);
+	free_memory_space(this->memory, this->memory_backing);
+	delete this->cold;
 }
 
 
 uint8_t CPU::memory_read(const uint16_t addr) const {
+	#ifdef NES_MEMORY_HEATMAP
+	if (this->cold->heatmap != nullptr) {
+		this->cold->heatmap->record_read(addr);
+	}
+	#endif
 	return this->memory[addr];
 }
 
@@ -263,7 +331,47 @@ uint16_t CPU::memory_read_uint16(const uint16_t addr) const {
 
 
 void CPU::memory_write(const uint16_t addr, const uint8_t data) {
+	#ifdef NES_MEMORY_HEATMAP
+	if (this->cold->heatmap != nullptr) {
+		this->cold->heatmap->record_write(addr);
+	}
+	#endif
 	this->memory[addr] = data;
+	this->mark_dirty(addr);
+}
+
+
+void CPU::mark_dirty(const uint16_t first, const uint16_t last) {
+	for (uint32_t page = first / DIRTY_PAGE_SIZE; page <= last / DIRTY_PAGE_SIZE; page++) {
+		this->dirty_pages |= (uint64_t)1 << page;
+	}
+}
+
+
+void CPU::attach_heatmap(MemoryHeatmap* heatmap) {
+	if (heatmap != nullptr && !HEATMAP_SUPPORTED) {
+		throw std::runtime_error("Memory heatmaps need a build with NES_MEMORY_HEATMAP (nes-emu-heatmap)");
+	}
+	this->cold->heatmap = heatmap;
+}
+
+
+void CPU::attach_random_device(RandomDevice* random_device) {
+	this->cold->random_device = random_device;
+}
+
+
+void CPU::attach_debugger(Debugger* debugger) {
+	if (this->cold->debugger != nullptr) {
+		this->cold->debugger->cpu = nullptr;
+	}
+	if (debugger != nullptr && debugger->cpu != nullptr) {
+		debugger->cpu->attach_debugger(nullptr);
+	}
+	this->cold->debugger = debugger;
+	if (debugger != nullptr) {
+		debugger->cpu = this;
+	}
 }
 
 
@@ -365,9 +473,10 @@ void CPU::load_program(const std::vector<uint8_t> program) {
 
 	// Updated for snake game
 	const uint16_t program_length = program.size(); 
-	for (int i = 0; i <= program_length; i++) {
+	for (int i = 0; i < program_length; i++) {
 		this->memory[0x0600+i] = program[i]; // load the program into memory
 	}
+	this->mark_dirty(0x0600, 0x0600 + program_length - 1);
 	// Write location of the first byte
 	this->memory_write_uint16(0xFFFC, 0x0600);
 }
@@ -384,8 +493,12 @@ void CPU::reset() {
 	this->register_a = 0;
 	this->register_irx = 0;
 	this->register_iry = 0;
+	this->stack_pointer = 0xFF;
 	this->status = 0;
 	this->cycles = 0;
+	this->interrupt_pending = 0;
+	this->nmi_line = false;
+	this->cold->interrupt_sequence_start = UINT64_MAX;
 
 	uint16_t first_instruction_address = 0xFFFC;
 	this->program_counter = memory_read_uint16(first_instruction_address);
@@ -393,915 +506,706 @@ void CPU::reset() {
 
 
 void CPU::reset_memory_space() {
-	for (int i = 0; i < 0xFFFF; i++) {
-		this->memory[i] = 0;
+	std::memset(this->memory, 0, MEMORY_SIZE);
+	this->dirty_pages = 0;
+	this->cold->snapshot_serial = 0;
+	this->cold->snapshot_pages = 0;
+	this->cold->unhashed_pages = UINT64_MAX;
+}
+
+
+void CPU::save_snapshot(CPUSnapshot& snapshot) {
+	// Serials are unique across all snapshots of the process, 0 stays reserved for "in sync with none"
+	static std::atomic<uint64_t> next_serial(1);
+
+	snapshot.serial = next_serial.fetch_add(1, std::memory_order_relaxed);
+	snapshot.cycles = this->cycles;
+	snapshot.program_counter = this->program_counter;
+	snapshot.stack_pointer = this->stack_pointer;
+	snapshot.register_a = this->register_a;
+	snapshot.register_irx = this->register_irx;
+	snapshot.register_iry = this->register_iry;
+	snapshot.status = this->status;
+	snapshot.halt_on_brk = this->halt_on_brk;
+	snapshot.skip_idle_loops = this->skip_idle_loops;
+	snapshot.fuse_instructions = this->fuse_instructions;
+	snapshot.memory.assign(this->memory, this->memory + MEMORY_SIZE);
+
+	this->cold->unhashed_pages |= this->dirty_pages;
+	this->dirty_pages = 0;
+	this->cold->snapshot_pages = 0;
+	this->cold->snapshot_serial = snapshot.serial;
+}
+
+
+void CPU::restore_snapshot(const CPUSnapshot& snapshot) {
+	if (snapshot.memory.size() != MEMORY_SIZE) {
+		throw std::invalid_argument("Snapshot was never saved");
+	}
+
+	if (this->cold->snapshot_serial == snapshot.serial) {
+		const uint64_t restored = this->dirty_pages | this->cold->snapshot_pages;
+		uint64_t dirty = restored;
+		while (dirty != 0) {
+			const size_t offset = __builtin_ctzll(dirty) * DIRTY_PAGE_SIZE;
+			std::memcpy(this->memory + offset, snapshot.memory.data() + offset, DIRTY_PAGE_SIZE);
+			dirty &= dirty - 1;
+		}
+		this->cold->unhashed_pages |= restored;
+	} else {
+		std::memcpy(this->memory, snapshot.memory.data(), MEMORY_SIZE);
+		this->cold->unhashed_pages = UINT64_MAX;
 	}
+	this->dirty_pages = 0;
+	this->cold->snapshot_pages = 0;
+	this->cold->snapshot_serial = snapshot.serial;
+
+	this->cycles = snapshot.cycles;
+	this->program_counter = snapshot.program_counter;
+	this->stack_pointer = snapshot.stack_pointer;
+	this->register_a = snapshot.register_a;
+	this->register_irx = snapshot.register_irx;
+	this->register_iry = snapshot.register_iry;
+	this->status = snapshot.status;
+	this->halt_on_brk = snapshot.halt_on_brk;
+	this->skip_idle_loops = snapshot.skip_idle_loops;
+	this->fuse_instructions = snapshot.fuse_instructions;
+	this->page_crossed = 0;
+	this->interrupt_pending = 0;
+	this->nmi_line = false;
+	this->cold->interrupt_sequence_start = UINT64_MAX;
+	this->cold->idle_loop = {false, 0, 0, 0};
+	this->cold->idle_branch_pc = 0;
+	this->cold->idle_loop_start = 0;
+	this->cold->idle_arrived_at = 0;
+	this->cold->idle_iterations_skipped = 0;
+	this->cold->fusion_instructions = 0;
+	this->cold->fusion_dispatches = 0;
+}
+
+
+uint64_t CPU::state_hash() {
+	CPUColdState* cold = this->cold;
+	uint64_t dirty = this->dirty_pages | cold->unhashed_pages;
+	while (dirty != 0) {
+		const size_t page = __builtin_ctzll(dirty);
+		cold->page_hashes[page] = hash_memory_page(this->memory + page * DIRTY_PAGE_SIZE);
+		dirty &= dirty - 1;
+	}
+	cold->snapshot_pages |= this->dirty_pages;
+	this->dirty_pages = 0;
+	cold->unhashed_pages = 0;
+	return combine_state_hash(*this, cold->page_hashes);
 }
 
 
 void CPU::execute_instruction(const uint8_t opcode) {
-	// [TODO]: Wrap the instruction in an enum for better matching
-	// Move updating the program counter to the get_operand_address function?
+	const Opcode& instruction = OPCODES[opcode];
+	this->page_crossed = 0;
+
 	switch(opcode) {
 		case 0x69: {
 			ADC(AddressingMode::Immediate);
-			this->program_counter += 1;
 			break;
 		}
 		case 0x65: {
 			ADC(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x75: {
 			ADC(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0x6D: {
 			ADC(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x7D: {
 			ADC(AddressingMode::AbsoluteX);
-			this->cycles += 4;
 			break;
 		}
 		case 0x79: {
 			ADC(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x61: {
 			ADC(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x71: {
 			ADC(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0x29: {
 			AND(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0x25: {
 			AND(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x35: {
 			AND(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0x2D: {
 			AND(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x3D: {
 			AND(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x39: {
 			AND(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x21: {
 			AND(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x31: {
 			AND(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
-		// ASL
 		case 0x0A: {
 			ASL(AddressingMode::Accumulator);
-			this->cycles += 2;
 			break;
 		}
 		case 0x06: {
 			ASL(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0x16: {
 			ASL(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x0E: {
 			ASL(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0x1E: {
 			ASL(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
-			break;
-		}
-		case 0x90: {
-			BCC();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0xB0: {
-			BCS();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0xF0: {
-			BEQ();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
 			break;
 		}
 		case 0x24: {
 			BIT(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x2C: {
 			BIT(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
-			break;
-		}
-		case 0x30: {
-			BIT(AddressingMode::Relative);
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0xD0: {
-			BNE();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0x10: {
-			BPL();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
 			break;
 		}
 		case 0x00: {
 			BRK();
-			this->cycles += 7;
-			return;
-			// break;
-		}
-		case 0x50: {
-			BRK();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0x70: {
-			BVS();
-			// Cycles should be +1 if the branch succeeds
-			// and +2 if it is to a new page
-			this->cycles += 2;
-			break;
-		}
-		case 0x18: {
-			CLC();
-			this->cycles += 2;
-			break;
-		}
-		case 0xD8: {
-			CLD();
-			this->cycles += 2;
-			break;
-		}
-		case 0x58: {
-			CLI();
-			this->cycles += 2;
-			break;
-		}
-		case 0xB8: {
-			CLV();
-			this->cycles += 2;
 			break;
 		}
 		case 0xC9: {
 			CMP(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xC5: {
 			CMP(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xD5: {
 			CMP(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xCD: {
 			CMP(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xDD: {
 			CMP(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0xD9: {
 			CMP(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 2;
 			break;
 		}
 		case 0xC1: {
 			CMP(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0xD1: {
 			CMP(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			// +1 if page crossed
-			this->cycles += 2;
 			break;
 		}
 		case 0xE0: {
 			CPX(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xE4: {
 			CPX(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xEC: {
-			CPX(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 4;
+			CPX(AddressingMode::Absolute);
 			break;
 		}
 		case 0xC0: {
 			CPY(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xC4: {
 			CPY(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xCC: {
 			CPY(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xC6: {
 			DEC(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0xD6: {
 			DEC(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0xCE: {
 			DEC(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0xDE: {
 			DEC(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
 			break;
 		}
 		case 0xCA: {
 			DEX();
-			this->cycles += 2;
 			break;
 		}
 		case 0x88: {
 			DEY();
-			this->cycles += 2;
 			break;
 		}
 		case 0x49: {
 			EOR(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0x45: {
 			EOR(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x55: {
 			EOR(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0x4D: {
 			EOR(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x5D: {
 			EOR(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0x59: {
 			EOR(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0x41: {
 			EOR(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x51: {
 			EOR(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			// +1 if page crossed
-			this->cycles += 5;
 			break;
 		}
 		case 0xE6: {
 			INC(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			// +1 if page crossed
-			this->cycles += 5;
 			break;
 		}
 		case 0xF6: {
 			INC(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0xEE: {
 			INC(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0xFE: {
 			INC(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
 			break;
 		}
 		case 0xE8: {
 			INX();
-			this->cycles += 2;
 			break;
 		}
 		case 0xC8: {
 			INY();
-			this->cycles += 2;
 			break;
 		}
 		case 0x4C: {
 			JMP(AddressingMode::Absolute);
-			// Modifies the program counter, no increment
-			this->cycles += 3;
 			break;
 		}
 		case 0x6C: {
 			JMP(AddressingMode::Indirect);
-			this->cycles += 5;
 			break;
 		}
 		case 0x20: {
 			JSR();
-			this->cycles += 6;
 			break;
 		}
 		case 0xA9: {
 			LDA(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xA5: {
 			LDA(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xB5: {
 			LDA(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xAD: {
 			LDA(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xBD: {
 			LDA(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0xB9: {
 			LDA(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0xA1: {
 			LDA(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0xB1: {
 			LDA(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			// +1 if page crossed
-			this->cycles += 5;
 			break;
 		}
 		case 0xA2: {
 			LDX(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xA6: {
 			LDX(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xB6: {
 			LDX(AddressingMode::ZeroPageY);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xAE: {
 			LDX(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xBE: {
 			LDX(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
-
 		case 0xA0: {
 			LDY(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xA4: {
 			LDY(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xB4: {
 			LDY(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xAC: {
 			LDY(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xBC: {
 			LDY(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0x4A: {
 			LSR(AddressingMode::Accumulator);
-			this->cycles += 2;
 			break;
 		}
 		case 0x46: {
 			LSR(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0x56: {
 			LSR(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x4E: {
 			LSR(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0x5E: {
 			LSR(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
 			break;
 		}
 		case 0xEA: {
 			NOP();
-			this->cycles += 2;
 			break;
 		}
 		case 0x09: {
 			ORA(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0x05: {
 			ORA(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x15: {
 			ORA(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0x0D: {
 			ORA(AddressingMode::Absolute);
-			this->program_counter += 2; // Look for D0
-			this->cycles += 4;
 			break;
 		}
 		case 0x1D: {
 			ORA(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0x19: {
 			ORA(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// +1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0x01: {
 			ORA(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x11: {
 			ORA(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			// +1 if page crossed
-			this->cycles += 5;
-			break;
-		}
-		case 0x48: {
-			PHA();
-			this->cycles += 3;
-			break;
-		}
-		case 0x08: {
-			PHP();
-			this->cycles += 3;
-			break;
-		}
-		case 0x68: {
-			PLA();
-			this->cycles += 3;
-			break;
-		}
-		case 0x28: {
-			PLP();
-			this->cycles += 4;
 			break;
 		}
 		case 0x2A: {
 			ROL(AddressingMode::Accumulator);
-			this->cycles += 2;
 			break;
 		}
 		case 0x26: {
 			ROL(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0x36: {
 			ROL(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x2E: {
 			ROL(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0x3E: {
 			ROL(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
 			break;
 		}
 		case 0x6A: {
 			ROR(AddressingMode::Accumulator);
-			this->cycles += 2;
 			break;
 		}
 		case 0x66: {
 			ROR(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 5;
 			break;
 		}
 		case 0x76: {
 			ROR(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0x6E: {
 			ROR(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 6;
 			break;
 		}
 		case 0x7E: {
 			ROR(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 7;
 			break;
 		}
 		case 0x40: {
 			RTI();
-			this->cycles += 6;
 			break;
 		}
 		case 0x60: {
 			RTS();
-			this->cycles += 6;
 			break;
 		}
 		case 0xE9: {
 			SBC(AddressingMode::Immediate);
-			this->program_counter += 1;
-			this->cycles += 2;
 			break;
 		}
 		case 0xE5: {
 			SBC(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0xF5: {
 			SBC(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0xED: {
 			SBC(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0xFD: {
 			SBC(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			// + 1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0xF9: {
 			SBC(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			// + 1 if page crossed
-			this->cycles += 4;
 			break;
 		}
 		case 0xE1: {
 			SBC(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
 			break;
 		}
 		case 0xF1: {
 			SBC(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			this->cycles += 5;
-			break;
-		}
-		case 0x38: {
-			SEC();
-			this->cycles += 2;
-			break;
-		}
-		case 0xF8: {
-			SED();
-			this->cycles += 2;
-			break;
-		}
-		case 0x78: {
-			SEI();
-			this->cycles += 2;
 			break;
 		}
 		case 0x85: {
 			STA(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
 			break;
 		}
 		case 0x95: {
 			STA(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
 			break;
 		}
 		case 0x8D: {
 			STA(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
 			break;
 		}
 		case 0x9D: {
 			STA(AddressingMode::AbsoluteX);
-			this->program_counter += 2;
-			this->cycles += 5;
 			break;
 		}
-		case 0x99: {
-			STA(AddressingMode::AbsoluteY);
-			this->program_counter += 2;
-			this->cycles += 5;
+		case 0x99: {
+			STA(AddressingMode::AbsoluteY);
+			break;
+		}
+		case 0x81: {
+			STA(AddressingMode::IndirectX);
+			break;
+		}
+		case 0x91: {
+			STA(AddressingMode::IndirectY);
+			break;
+		}
+		case 0x86: {
+			STX(AddressingMode::ZeroPage);
+			break;
+		}
+		case 0x96: {
+			STX(AddressingMode::ZeroPageY);
+			break;
+		}
+		case 0x8E: {
+			STX(AddressingMode::Absolute);
+			break;
+		}
+		case 0x84: {
+			STY(AddressingMode::ZeroPage);
+			break;
+		}
+		case 0x94: {
+			STY(AddressingMode::ZeroPageX);
+			break;
+		}
+		case 0x8C: {
+			STY(AddressingMode::Absolute);
+			break;
+		}
+		case 0xAA: {
+			TAX();
+			break;
+		}
+		case 0xA8: {
+			TAY();
+			break;
+		}
+		case 0xBA: {
+			TSX();
+			break;
+		}
+		case 0x8A: {
+			TXA();
+			break;
+		}
+		case 0x9A: {
+			TXS();
+			break;
+		}
+		case 0x98: {
+			TYA();
+			break;
+		}
+		case 0x48: {
+			PHA();
+			break;
+		}
+		case 0x08: {
+			PHP();
+			break;
+		}
+		case 0x68: {
+			PLA();
+			break;
+		}
+		case 0x28: {
+			PLP();
+			break;
+		}
+		case 0x18: {
+			CLC();
 			break;
 		}
-		case 0x81: {
-			STA(AddressingMode::IndirectX);
-			this->program_counter += 1;
-			this->cycles += 6;
+		case 0xD8: {
+			CLD();
 			break;
 		}
-		case 0x91: {
-			STA(AddressingMode::IndirectY);
-			this->program_counter += 1;
-			this->cycles += 6;
+		case 0x58: {
+			CLI();
 			break;
 		}
-		case 0x86: {
-			STX(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
+		case 0xB8: {
+			CLV();
 			break;
 		}
-		case 0x96: {
-			STX(AddressingMode::ZeroPageY);
-			this->program_counter += 1;
-			this->cycles += 4;
+		case 0x38: {
+			SEC();
 			break;
 		}
-		case 0x8E: {
-			STX(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
+		case 0xF8: {
+			SED();
 			break;
 		}
-		case 0x84: {
-			STY(AddressingMode::ZeroPage);
-			this->program_counter += 1;
-			this->cycles += 3;
+		case 0x78: {
+			SEI();
 			break;
 		}
-		case 0x94: {
-			STY(AddressingMode::ZeroPageX);
-			this->program_counter += 1;
-			this->cycles += 4;
+		case 0x90: {
+			BCC();
 			break;
 		}
-		case 0x8C: {
-			STY(AddressingMode::Absolute);
-			this->program_counter += 2;
-			this->cycles += 4;
+		case 0xB0: {
+			BCS();
 			break;
 		}
-		case 0xAA: {
-			TAX();
-			this->cycles += 2;
+		case 0xF0: {
+			BEQ();
 			break;
 		}
-		case 0xA8: {
-			TAY();
-			this->cycles += 2;
+		case 0x30: {
+			BMI();
 			break;
 		}
-		case 0xBA: {
-			TSX();
-			this->cycles += 2;
+		case 0xD0: {
+			BNE();
 			break;
 		}
-		case 0x8A: {
-			TXA();
-			this->cycles += 2;
+		case 0x10: {
+			BPL();
 			break;
 		}
-		case 0x9A: {
-			TXS();
-			this->cycles += 2;
+		case 0x50: {
+			BVC();
 			break;
 		}
-		case 0x98: {
-			TYA();
-			this->cycles += 2;
+		case 0x70: {
+			BVS();
 			break;
 		}
 		default: {
@@ -1314,6 +1218,9 @@ void CPU::execute_instruction(const uint8_t opcode) {
 			break;
 		}
 	}
+
+	// Base cost plus the page-cross penalty of read instructions, branch penalties are charged by `branch`
+	this->cycles += instruction.cycles + (this->page_crossed & instruction.page_penalty);
 }
 
 
@@ -1329,33 +1236,264 @@ int CPU::interpret(std::vector<uint8_t> program) {
 
 void CPU::run() {
 	while (true) {
-		uint8_t opcode = memory_read(this->program_counter);
 		uint16_t pc = this->program_counter;
-		uint32_t starting_cycles = this->cycles;
+		uint64_t starting_cycles = this->cycles;
+
+		if (this->cold->debugger != nullptr) {
+			// Breakpoints and watchpoints end the run like a `BRK` does, see `Debugger::hit`
+			const StopReason reason = this->cold->debugger->step();
+			if (reason == StopReason::BreakInstruction || reason == StopReason::Breakpoint) {
+				this->log_instruction(pc);
+				break;
+			}
+			this->log_instruction(pc);
+			this->wait_cycle_count(this->cycles - starting_cycles);
+			if (reason == StopReason::Watchpoint) {
+				break;
+			}
+			continue;
+		}
 
-		if (opcode == 0x00) {
-			this->log_instruction(pc, OPCODES[0x00]);
+		if (this->interrupt_pending != 0 && this->poll_interrupts()) {
+			this->wait_cycle_count(this->cycles - starting_cycles);
+			continue;
+		}
+		uint8_t opcode = this->fetch_opcode(pc);
+		if (opcode == 0x00 && this->halt_on_brk) {
+			this->log_instruction(pc);
 			break; // Exit if opcode is 0x00
 		}
+		if (this->cold->random_device != nullptr) {
+			this->cold->random_device->refresh(*this);
+		}
 		this->program_counter += 1;
 		this->execute_instruction(opcode);
 
 		// Debug info
-		Opcode opcode_data = OPCODES[opcode];
-		this->log_instruction(pc, opcode_data);
+		this->log_instruction(pc);
 
 		this->wait_cycle_count(this->cycles - starting_cycles);
 	}
 }
 
 
+bool CPU::step() {
+	if (this->cold->random_device != nullptr) {
+		return this->step(*this->cold->random_device);
+	}
+	NullPolicy none;
+	return this->step(none);
+}
+
+
+StopReason CPU::run_for(const uint64_t cycle_budget) {
+	return this->run_until(this->cycles + cycle_budget);
+}
+
+
+StopReason CPU::run_until(const uint64_t deadline) {
+	if (this->cold->debugger != nullptr) {
+		return this->cold->debugger->run_until(deadline);
+	}
+	if (this->skip_idle_loops) {
+		// Devices may have changed memory since the last run, every loop has to run a full iteration again first
+		this->cold->idle_loop = {false, 0, 0, 0};
+	}
+	if (this->cold->random_device != nullptr) {
+		// Superinstructions would read the register several times without a refresh, run one instruction at a time
+		RandomDevice& random = *this->cold->random_device;
+		if (this->skip_idle_loops) {
+			RandomIdleLoopSkipper skipper = {random, {deadline}};
+			return this->run_until(deadline, skipper);
+		}
+		return this->run_until(deadline, random);
+	}
+	if (this->fuse_instructions) {
+		return this->skip_idle_loops ? this->run_fused<true>(deadline) : this->run_fused<false>(deadline);
+	}
+	if (this->skip_idle_loops) {
+		IdleLoopSkipper skipper = {deadline};
+		return this->run_until(deadline, skipper);
+	}
+	NullPolicy none;
+	return this->run_until(deadline, none);
+}
+
+
+void CPU::skip_idle_loop(const uint16_t branch_pc, const uint64_t deadline) {
+	CPUColdState* cold = this->cold;
+	const uint16_t loop_start = this->program_counter;
+
+	// Only trust the last analysis when exactly one uninterrupted iteration ran since the branch was last taken
+	const bool consecutive = cold->idle_branch_pc == branch_pc && cold->idle_loop_start == loop_start
+		&& this->cycles - cold->idle_arrived_at == cold->idle_loop.iteration_cycles;
+	cold->idle_arrived_at = this->cycles;
+	if (!consecutive) {
+		cold->idle_branch_pc = branch_pc;
+		cold->idle_loop_start = loop_start;
+		cold->idle_loop = this->analyze_loop(loop_start, branch_pc);
+		return;
+	}
+	if (!cold->idle_loop.idle || this->interrupt_pending != 0 || cold->heatmap != nullptr || this->cycles >= deadline) {
+		return;
+	}
+
+	// Whole iterations ending at or before the deadline
+	uint64_t iterations = (deadline - this->cycles) / cold->idle_loop.iteration_cycles;
+	const uint8_t counter_opcode = cold->idle_loop.counter_opcode;
+	if (counter_opcode != 0) {
+		// The counter is non-zero here, skip up to the last iteration, which falls through the BNE
+		uint8_t& counter = (counter_opcode == 0xCA || counter_opcode == 0xE8) ? this->register_irx : this->register_iry;
+		const bool decrement = counter_opcode == 0xCA || counter_opcode == 0x88;
+		const uint64_t taken = decrement ? counter - 1 : 0xFF - counter;
+		iterations = std::min(iterations, taken);
+		if (iterations == 0) {
+			return;
+		}
+		counter = decrement ? counter - iterations : counter + iterations;
+		update_zero_and_negative_flags(counter);
+	}
+
+	this->cycles += iterations * cold->idle_loop.iteration_cycles;
+	cold->idle_arrived_at = this->cycles;
+	if (cold->random_device != nullptr) {
+		cold->random_device->skip(*this, iterations * cold->idle_loop.iteration_instructions);
+	}
+	cold->idle_iterations_skipped += iterations;
+}
+
+
+template <bool skip_idle>
+StopReason CPU::run_fused(const uint64_t deadline) {
+	uint64_t instructions = 0;
+	uint64_t dispatches = 0;
+	StopReason reason = StopReason::BudgetExhausted;
+
+	while (this->cycles < deadline) {
+		// A pending interrupt may become due on any boundary, so only single instructions run until it is serviced
+		const bool pending = this->interrupt_pending != 0;
+		if (pending && this->poll_interrupts()) {
+			continue;
+		}
+
+		const uint16_t pc = this->program_counter;
+		const uint8_t opcode = this->fetch_opcode(pc);
+		if (opcode == 0x00 && this->halt_on_brk) {
+			reason = StopReason::BreakInstruction;
+			break;
+		}
+		dispatches += 1;
+		this->program_counter = pc + 1;
+
+		if (!pending && FUSION_HEADS[opcode]) {
+			const uint32_t fused = execute_superinstruction<skip_idle>(*this, opcode, pc, deadline);
+			if (fused != 0) {
+				instructions += fused;
+				continue;
+			}
+		}
+
+		this->execute_instruction(opcode);
+		instructions += 1;
+		if constexpr (skip_idle) {
+			if ((opcode & 0x1F) == 0x10 && this->program_counter <= pc) {
+				this->skip_idle_loop(pc, deadline);
+			}
+		}
+	}
+
+	this->cold->fusion_instructions += instructions;
+	this->cold->fusion_dispatches += dispatches;
+	return reason;
+}
+
+
+IdleLoop CPU::analyze_loop(const uint16_t loop_start, const uint16_t branch_pc) const {
+	const IdleLoop not_idle = {false, 0, 0, 0};
+	if (branch_pc - loop_start > IDLE_LOOP_MAX_LENGTH) {
+		return not_idle;
+	}
+
+	IdleLoop loop = {true, 0, 0, 0};
+	// Whether an instruction after the counter sets N and Z, and whether X or Y are touched besides a counter
+	bool flags_after_counter = false;
+	bool uses_x = false;
+	bool uses_y = false;
+	uint16_t addr = loop_start;
+	while (addr < branch_pc) {
+		const uint8_t opcode = this->memory[addr];
+		switch (opcode) {
+			case 0xEA: case 0x18: case 0x38: case 0xB8: // NOP, CLC, SEC, CLV
+				break;
+			case 0xCA: case 0x88: case 0xE8: case 0xC8: // DEX, DEY, INX, INY
+				if (loop.counter_opcode != 0) {
+					return not_idle;
+				}
+				loop.counter_opcode = opcode;
+				break;
+			case 0xA9: case 0xA5: case 0xAD: // LDA
+			case 0xC9: case 0xC5: case 0xCD: // CMP
+			case 0x24: case 0x2C:            // BIT
+				flags_after_counter = loop.counter_opcode != 0;
+				break;
+			case 0xA2: case 0xA6: case 0xAE: // LDX
+			case 0xE0: case 0xE4: case 0xEC: // CPX
+				flags_after_counter = loop.counter_opcode != 0;
+				uses_x = true;
+				break;
+			case 0xA0: case 0xA4: case 0xAC: // LDY
+			case 0xC0: case 0xC4: case 0xCC: // CPY
+				flags_after_counter = loop.counter_opcode != 0;
+				uses_y = true;
+				break;
+			default:
+				return not_idle;
+		}
+		// An attached random device changes its register before every instruction, polling it never idles
+		const Opcode& instruction = OPCODES[opcode];
+		if (this->cold->random_device != nullptr && instruction.size > 1 && instruction.mode != AddressingMode::Immediate) {
+			const uint16_t operand = (instruction.size == 2) ? this->memory[addr + 1]
+				: this->memory[addr + 1] | this->memory[(uint16_t)(addr + 2)] << 8;
+			if (operand == RANDOM_DEVICE_ADDRESS) {
+				return not_idle;
+			}
+		}
+		loop.iteration_cycles += instruction.cycles;
+		loop.iteration_instructions += 1;
+		addr += instruction.size;
+	}
+	if (addr != branch_pc) {
+		return not_idle;
+	}
+
+	// A counted loop has to end on the counter, tested by BNE, and nothing else may touch the counter register
+	if (loop.counter_opcode != 0) {
+		const bool counts_x = loop.counter_opcode == 0xCA || loop.counter_opcode == 0xE8;
+		if (this->memory[branch_pc] != 0xD0 || flags_after_counter || (counts_x ? uses_x : uses_y)) {
+			return not_idle;
+		}
+	}
+
+	// The taken branch costs one extra cycle, two when the target is on another page
+	loop.iteration_cycles += OPCODES[this->memory[branch_pc]].cycles + 1;
+	loop.iteration_instructions += 1;
+	if ((loop_start & 0xFF00) != ((branch_pc + 2) & 0xFF00)) {
+		loop.iteration_cycles += 1;
+	}
+	return loop;
+}
+
+
 void CPU::run_callback(const std::function<void(CPU*)>& callback) {
 	while (true) {
-		uint8_t opcode = memory_read(this->program_counter);
 		uint16_t pc = this->program_counter;
-		uint32_t starting_cycles = this->cycles;
+		uint64_t starting_cycles = this->cycles;
 
-		if (opcode == 0x00) {
+		if (this->interrupt_pending != 0 && this->poll_interrupts()) {
+			continue;
+		}
+		uint8_t opcode = this->fetch_opcode(pc);
+		if (opcode == 0x00 && this->halt_on_brk) {
 			break; // Exit if opcode is 0x00
 		}
 		this->program_counter += 1;
@@ -1369,9 +1507,107 @@ void CPU::run_callback(const std::function<void(CPU*)>& callback) {
 	}
 }
 
+void CPU::set_nmi_line(const bool asserted, const uint64_t timestamp) {
+	if (asserted && !this->nmi_line) {
+		// Edge on the (active low) pin, latch the NMI until it is serviced
+		this->interrupt_pending |= InterruptSource::NmiLine;
+		this->cold->nmi_asserted_at = timestamp;
+
+		// The edge happened during a BRK / IRQ sequence that just finished, before its vector fetch. No instruction
+		// ran since, so the hijack can still be applied after the fact.
+		const uint64_t sequence_start = this->cold->interrupt_sequence_start;
+		if (this->cycles >= 7 && this->cycles - 7 == sequence_start && timestamp < sequence_start + 4) {
+			this->interrupt_pending &= ~InterruptSource::NmiLine;
+			this->program_counter = memory_read_uint16(0xFFFA);
+		}
+	}
+	this->nmi_line = asserted;
+}
+
+
+void CPU::set_nmi_line(const bool asserted) {
+	this->set_nmi_line(asserted, this->cycles);
+}
+
+
+void CPU::set_irq_line(const InterruptSource source, const bool asserted, const uint64_t timestamp) {
+	const uint8_t line = source & IRQ_SOURCES;
+	if (asserted) {
+		if ((this->interrupt_pending & IRQ_SOURCES) == 0) {
+			// The wire-OR'ed line only goes low with the first source
+			this->cold->irq_asserted_at = timestamp;
+		}
+		this->interrupt_pending |= line;
+	} else {
+		this->interrupt_pending &= ~line;
+	}
+}
+
+
+void CPU::set_irq_line(const InterruptSource source, const bool asserted) {
+	this->set_irq_line(source, asserted, this->cycles);
+}
+
+
+bool CPU::poll_interrupts() {
+	// Interrupt inputs are sampled before the last cycle of an instruction. A line that changed during the final
+	// cycle of the previous instruction is only recognized after the next one.
+	if ((this->interrupt_pending & InterruptSource::NmiLine) != 0 && this->cold->nmi_asserted_at + 2 <= this->cycles) {
+		this->interrupt_pending &= ~InterruptSource::NmiLine;
+		this->interrupt_sequence(0xFFFA, false);
+		this->cycles += 7;
+		return true;
+	}
+
+	if ((this->interrupt_pending & IRQ_SOURCES) != 0
+		&& (this->status & Flag::InteruptDisable) == 0
+		&& this->cold->irq_asserted_at + 2 <= this->cycles) {
+		this->interrupt_sequence(0xFFFE, false);
+		this->cycles += 7;
+		return true;
+	}
+
+	return false;
+}
+
+
+void CPU::interrupt_sequence(const uint16_t vector, const bool software) {
+	const uint64_t start = this->cycles;
+
+	// BRK skips the padding byte following the opcode
+	uint16_t return_address = this->program_counter;
+	if (software) {
+		return_address += 1;
+	}
+	push_stack_uint16(return_address);
+
+	// Bit 5 always reads as 1 on the stack, the Break flag only exists in the pushed copy of the status
+	uint8_t pushed_status = this->status | 0b00100000;
+	if (software) {
+		pushed_status = pushed_status | Flag::Break;
+	} else {
+		pushed_status = pushed_status & ~Flag::Break;
+	}
+	push_stack(pushed_status);
+	update_flag(Flag::InteruptDisable, Mode::Set);
+
+	uint16_t target = vector;
+	if (vector != 0xFFFA) {
+		this->cold->interrupt_sequence_start = start;
+
+		// An NMI that is recognized before the vector is fetched (cycle 5) takes over the sequence
+		if ((this->interrupt_pending & InterruptSource::NmiLine) != 0 && this->cold->nmi_asserted_at < start + 4) {
+			this->interrupt_pending &= ~InterruptSource::NmiLine;
+			target = 0xFFFA;
+		}
+	}
+	this->program_counter = memory_read_uint16(target);
+}
+
+
 void CPU::wait_cycle_count(uint8_t cycles) {
 	for (int i = 0; i < cycles; i++) {
-		std::this_thread::sleep_for(std::chrono::nanoseconds(this->cycle_duration));
+		std::this_thread::sleep_for(std::chrono::nanoseconds(this->cold->cycle_duration));
 	}
 }
 
@@ -1382,7 +1618,6 @@ void CPU::NOP() { } // Does literally nothing, adds a cycle to the cycle counter
 void CPU::ADC(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	add_to_accumulator_register(operand);
 
@@ -1391,39 +1626,23 @@ void CPU::ADC(const AddressingMode mode) {
 
 
 void CPU::BCC() {
-	if ((this->status & Flag::Carry) == 0) {
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Carry) == 0);
 }
 
 
 void CPU::BCS() {
-	if ((this->status & Flag::Carry) == Flag::Carry) {
-		this->program_counter = branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Carry) != 0);
 }
 
 
-void CPU::BEQ() { 
-	if ((this->status & Flag::Zero) == Flag::Zero) {
-		this->program_counter = branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+void CPU::BEQ() {
+	this->branch((this->status & Flag::Zero) != 0);
 }
 
 
 void CPU::BIT(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 	const uint8_t bitmask = this->register_a;
 
 	// Take the logical AND 
@@ -1442,53 +1661,27 @@ void CPU::BIT(const AddressingMode mode) {
 
 
 void CPU::BMI() {
-	if ((this->status & Flag::Negative) == Flag::Negative) {
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Negative) != 0);
 }
 
 
 void CPU::BNE() {
-	if ((this->status & Flag::Zero) == 0) {
-		// Branch if the Z flag is NOT set
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Zero) == 0);
 }
 
 
 void CPU::BPL() {
-	if ((this->status & Flag::Zero) == 0) { 
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Negative) == 0);
 }
 
 
 void CPU::BVC() {
-	if ((this->status & Flag::Overflow) == 0) { 
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Overflow) == 0);
 }
 
 
 void CPU::BVS() {
-	if ((this->status & Flag::Overflow) != 0) { 
-		this->program_counter = this->branch();
-	} else {
-		// Increment the program counter in case the branch fails.
-		this->program_counter += 1;
-	}
+	this->branch((this->status & Flag::Overflow) != 0);
 }
 
 
@@ -1512,13 +1705,8 @@ void CPU::CLV() {
 }
 
 
-// Look into getting this to work
 void CPU::BRK() {
-	// // Push program counter and processor status onto the stack
-	// uint16_t interrupt_vector = 0xFFFE;
-	// this->program_counter = memory_read(interrupt_vector);
-	// // Set the break flag to 1
-	// this->status = this->status | Flag::Break;
+	this->interrupt_sequence(0xFFFE, true);
 }
 
 
@@ -1540,7 +1728,6 @@ void CPU::CPY(const AddressingMode mode) {
 void CPU::DEC(const AddressingMode mode) {
 	const uint16_t operand_addres = get_operand_address(mode);
 	const uint8_t value = memory_read(operand_addres);
-	this->fetched_data = value;
 
 	memory_write(operand_addres, value-1);
 	update_zero_and_negative_flags(value-1);
@@ -1562,7 +1749,6 @@ void CPU::DEY() {
 void CPU::EOR(const AddressingMode mode) {
 	const uint16_t operand_addres = get_operand_address(mode);
 	const uint8_t value = memory_read(operand_addres);
-	this->fetched_data = value;
 
 	this->register_a = this->register_a ^ value;
 	update_zero_and_negative_flags(this->register_a);
@@ -1572,7 +1758,6 @@ void CPU::EOR(const AddressingMode mode) {
 void CPU::INC(const AddressingMode mode) {
 	const uint16_t operand_addres = get_operand_address(mode);
 	const uint8_t value = memory_read(operand_addres);
-	this->fetched_data = value;
 
 	memory_write(operand_addres, value+1);
 	update_zero_and_negative_flags(value+1);
@@ -1593,7 +1778,6 @@ void CPU::INY() {
 
 void CPU::JMP(const AddressingMode mode) {
 	const uint16_t address = get_operand_address(mode);
-	this->fetched_data = address;
 	this->program_counter = address;
 }
 
@@ -1605,7 +1789,6 @@ void CPU::JSR() {
 
 	// Get the subroutine address and set the program counter to this address
 	const uint16_t address = get_operand_address(AddressingMode::Absolute);
-	this->fetched_data = address;
 	this->program_counter = address;
 } 
 
@@ -1613,7 +1796,6 @@ void CPU::JSR() {
 void CPU::LDA(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	this->register_a = operand;
 	update_zero_and_negative_flags(this->register_a);
@@ -1623,7 +1805,6 @@ void CPU::LDA(const AddressingMode mode) {
 void CPU::LDX(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	this->register_irx = operand;
 	update_zero_and_negative_flags(this->register_irx);
@@ -1633,7 +1814,6 @@ void CPU::LDX(const AddressingMode mode) {
 void CPU::LDY(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	this->register_iry = operand;
 	update_zero_and_negative_flags(this->register_iry);
@@ -1644,7 +1824,6 @@ uint8_t CPU::LSR(const AddressingMode mode) {
 	// Why is it Logical Shift Right but Arithmatic Shift Left???
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	// Set the carry flag if the first bit is set
 	if ((operand & 0b00000001) == 0) {
@@ -1669,7 +1848,6 @@ uint8_t CPU::LSR(const AddressingMode mode) {
 void CPU::ORA(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	this->register_a = this->register_a | operand;
 	update_zero_and_negative_flags(this->register_a);
@@ -1699,7 +1877,6 @@ void CPU::PLP() {
 void CPU::ROL(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	uint8_t result = operand << 1;
 
@@ -1732,7 +1909,6 @@ void CPU::ROL(const AddressingMode mode) {
 void CPU::ROR(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	uint8_t result = operand >> 1;
 
@@ -1762,7 +1938,8 @@ void CPU::ROR(const AddressingMode mode) {
 
 
 void CPU::RTI() {
-	this->status = pop_stack();
+	// The Break flag and bit 5 only exist in the copy on the stack
+	this->status = pop_stack() & ~(Flag::Break | 0b00100000);
 	this->program_counter = pop_stack_uint16();
 }
 
@@ -1775,7 +1952,6 @@ void CPU::RTS() {
 void CPU::SBC(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 	subtract_from_accumulator_register(operand);
 
 	update_zero_and_negative_flags(this->register_a);
@@ -1799,21 +1975,18 @@ void CPU::SEI() {
 
 void CPU::STA(const AddressingMode mode) {
 	const uint16_t address = get_operand_address(mode);
-	this->fetched_data = address;
 	memory_write(address, this->register_a);
 }
 
 
 void CPU::STX(const AddressingMode mode) {
 	const uint16_t address = get_operand_address(mode);
-	this->fetched_data = address;
 	memory_write(address, this->register_irx);
 }
 
 
 void CPU::STY(const AddressingMode mode) {
 	const uint16_t address = get_operand_address(mode);
-	this->fetched_data = address;
 	memory_write(address, this->register_iry);
 }
 
@@ -1855,7 +2028,6 @@ void CPU::TYA() {
 void CPU::AND(const AddressingMode mode) {
 	const uint16_t operand_address = get_operand_address(mode);
 	const uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	// Update register and flags
 	this->register_a = this->register_a & operand;
@@ -1866,7 +2038,6 @@ void CPU::AND(const AddressingMode mode) {
 uint8_t CPU::ASL(const AddressingMode mode) {
 	uint16_t operand_adress = get_operand_address(mode);
 	uint8_t operand = memory_read(operand_adress);
-	this->fetched_data = operand;
 
 	if ((operand & 0b10000000) == 0) { 
 		// If this is not 0, then 1 should be added to the carry
@@ -1890,33 +2061,23 @@ uint8_t CPU::ASL(const AddressingMode mode) {
 }
 
 
-uint16_t CPU::branch() {
-	int8_t jmp = memory_read(this->program_counter);
-	uint16_t jmp_addr = this->program_counter + jmp + 1; 
-
-	// 1 extra cycle in case as the branch was succesfull.
-	this->cycles += 1;
-	this->fetched_data = jmp;
-
-
-	// if ((jmp & 0x80) != 0) {
-	// 	// Sign bit is set, jump should be backwards, use 2's complement
-	// 	// + 1 to correct for program counter being updated to read the operand
-	// 	uint8_t jmp_comp = (uint8_t)(~jmp + 1);
-	// 	jmp_addr = this->program_counter - jmp_comp + 1;
-	// } else {
-	// 	jmp_addr = this->program_counter + jmp + 1; 
-	// }
+void CPU::branch(const bool condition) {
+	const uint16_t target = get_operand_address(AddressingMode::Relative);
 
-	// Update the program counter
-	return jmp_addr;
+	if (condition) {
+		// 1 extra cycle as the branch was succesfull, 1 more if it lands on another page
+		this->cycles += 1;
+		if ((target & 0xFF00) != (this->program_counter & 0xFF00)) {
+			this->cycles += 1;
+		}
+		this->program_counter = target;
+	}
 }
 
 
 void CPU::compare(const uint8_t reg, const AddressingMode mode) {
 	uint16_t operand_address = this->get_operand_address(mode);
 	uint8_t operand = memory_read(operand_address);
-	this->fetched_data = operand;
 
 	if (operand == reg) {
 		update_flag(Flag::Zero, Mode::Set);
@@ -2034,83 +2195,82 @@ void CPU::update_zero_and_negative_flags(const uint8_t reg) {
 
 
 uint16_t CPU::get_operand_address(const AddressingMode mode) {
+	// The program counter points at the first operand byte and is moved past the operand here, so the instructions
+	// themselves never have to account for their size
 	switch(mode) {
 		case AddressingMode::Immediate: {
-			return this->program_counter;
+			const uint16_t addr = this->program_counter;
+			this->program_counter += 1;
+			return addr;
 		}
 		case AddressingMode::Relative: {
-			uint16_t jmp_addr;
-
-			// Get the offset
-			uint8_t jmp = memory_read(this->program_counter);
-
-			if ((jmp & 0x80) != 0) {
-				// Sign bit set, offset negative
-				// This can also be solved by taking the offset as a signed
-				// 8 bit integer, however checking this way is more explicit
-				jmp_addr = this->program_counter + 1 - jmp;
-			} else {
-				// Offset is positive, jump is forward in memory
-				jmp_addr = this->program_counter + 1 + jmp;
-			}
-			return jmp_addr;
+			// The offset is signed and relative to the address of the next instruction
+			const int8_t jmp = memory_read(this->program_counter);
+			this->program_counter += 1;
+			return this->program_counter + jmp;
 		}
 		case AddressingMode::Accumulator: {
 			return this->register_a;
 		}
 		case AddressingMode::ZeroPage: {
-			return (uint16_t)memory_read(this->program_counter);
+			const uint16_t addr = memory_read(this->program_counter);
+			this->program_counter += 1;
+			return addr;
 		}
-		// C++ does wrapping addition by default on uint8 and uint16 types
+		// Indexed zero page addressing wraps around within the zero page
 		case AddressingMode::ZeroPageX: {
 			const uint8_t pos = memory_read(this->program_counter);
-			const uint16_t addr = (uint16_t)(pos + register_irx); 
-			return addr;
+			this->program_counter += 1;
+			return (uint8_t)(pos + this->register_irx);
 		}
 		case AddressingMode::ZeroPageY: {
 			const uint8_t pos = memory_read(this->program_counter);
-			const uint16_t addr = (uint16_t)(pos + register_iry);
-			return addr;
+			this->program_counter += 1;
+			return (uint8_t)(pos + this->register_iry);
 		}
 		case AddressingMode::Absolute: {
-			uint16_t address = this->program_counter;
-			return memory_read_uint16(address);
+			const uint16_t addr = memory_read_uint16(this->program_counter);
+			this->program_counter += 2;
+			return addr;
 		}
 		case AddressingMode::AbsoluteX: {
-			uint16_t base = memory_read_uint16(this->program_counter);
-			uint16_t addr = base + this->register_irx;
+			const uint16_t base = memory_read_uint16(this->program_counter);
+			this->program_counter += 2;
+			const uint16_t addr = base + this->register_irx;
+			this->page_crossed = ((base ^ addr) & 0xFF00) != 0;
 			return addr;
 		}
 		case AddressingMode::AbsoluteY: {
-			uint16_t base = memory_read_uint16(this->program_counter);
-			uint16_t addr = base + this->register_iry;
+			const uint16_t base = memory_read_uint16(this->program_counter);
+			this->program_counter += 2;
+			const uint16_t addr = base + this->register_iry;
+			this->page_crossed = ((base ^ addr) & 0xFF00) != 0;
 			return addr;
 		}
 		case AddressingMode::Indirect: {
-			uint16_t ptr = memory_read_uint16(this->program_counter); // Read the address
+			const uint16_t ptr = memory_read_uint16(this->program_counter); // Read the address
+			this->program_counter += 2;
 			return memory_read_uint16(ptr); // read the data at the ptr location
 		}
 		case AddressingMode::IndirectX: {
-			uint8_t base = memory_read(this->program_counter);
-			uint8_t ptr = base + this->register_irx;
-
-			uint16_t lo_byte = memory_read(ptr);
-			uint16_t hi_byte = memory_read(ptr+1);
+			const uint8_t base = memory_read(this->program_counter);
+			this->program_counter += 1;
+			const uint8_t ptr = base + this->register_irx;
 
+			// The pointer itself wraps around within the zero page
+			const uint16_t lo_byte = memory_read(ptr);
+			const uint16_t hi_byte = memory_read((uint8_t)(ptr + 1));
 			return (hi_byte << 8) | lo_byte;
 		}
 		case AddressingMode::IndirectY: {
-			uint8_t base = memory_read(this->program_counter);
-			uint16_t lo_byte = memory_read(base);
-			uint16_t hi_byte = memory_read(base+1);
-
-			uint16_t deref_base = (hi_byte << 8) | lo_byte;
-			uint16_t deref = deref_base + this->register_iry;
-
-			if ((deref & 0xFF00) != (hi_byte << 8)) {
-				this->cycles += 1;
-			}
+			const uint8_t base = memory_read(this->program_counter);
+			this->program_counter += 1;
+			const uint16_t lo_byte = memory_read(base);
+			const uint16_t hi_byte = memory_read((uint8_t)(base + 1));
 
+			const uint16_t deref_base = (hi_byte << 8) | lo_byte;
+			const uint16_t deref = deref_base + this->register_iry;
+			this->page_crossed = ((deref_base ^ deref) & 0xFF00) != 0;
 			return deref;
 		}
 		case AddressingMode::Implied: {
@@ -2189,75 +2349,10 @@ void CPU::hex_dump_rom() {
 }
 
 
-void CPU::log_instruction(const uint16_t pc, const Opcode opc) const {
-	// Log the program counter
-	std::cout << "$" << std::setw(4) << std::setfill('0') << std::hex << (int)pc << std::dec << ": " << opc.name;
-
-	switch(opc.mode) {
-		case AddressingMode::Accumulator: {
-			std::cout << " A" << std::endl;
-			break; 
-		}
-		case AddressingMode::Relative: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-				<< (this->fetched_data & 0xFF) << std::dec << std::endl;
-			break; 
-		}
-		case AddressingMode::Immediate: {
-			std::cout << " #$" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-					 << this->fetched_data << std::dec << std::endl;
-			break; 
-		}
-		case AddressingMode::ZeroPage: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-					 << this->fetched_data << std::dec << std::endl;
-			break; 
-		}
-		case AddressingMode::ZeroPageX: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-					 << this->fetched_data << std::dec << ",X" << std::endl;
-			break; 
-		}
-		case AddressingMode::ZeroPageY: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-					 << this->fetched_data << std::dec << ",Y" << std::endl;
-			break; 
-		}
-		case AddressingMode::IndirectX: {
-			std::cout << " ($" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << ",X)" << std::endl;
-			break; 
-		}
-		case AddressingMode::IndirectY: {
-			std::cout << " ($" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << "),Y" << std::endl;
-			break; 
-		}
-		case AddressingMode::Absolute: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << std::endl;
-			break; 
-		}
-		case AddressingMode::AbsoluteX: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << ",X" << std::endl;
-			break; 
-		}
-		case AddressingMode::AbsoluteY: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << ",Y" << std::endl;
-			break; 
-		}
-		case AddressingMode::Indirect: {
-			std::cout << " $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0')
-					 << this->fetched_data << std::dec << std::endl;
-			break; 
-		}
-		default: {
-			std::cout << std::endl;
-			break;
-		}
-	}
+void CPU::log_instruction(const uint16_t pc) const {
+	char line[DISASSEMBLY_LINE_LENGTH];
+	disassemble_line(this->memory, pc, line);
+	std::cout << line << std::endl;
 }
 
 
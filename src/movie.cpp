@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "memory_storage.hpp"
+#include "movie.hpp"
+#include "state_hash.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+const char MOVIE_MAGIC[8] = {'N', 'E', 'S', 'M', 'O', 'V', 'I', 'E'};
+
+// Flags byte of a keyframe
+const uint8_t KEYFRAME_HALT_ON_BRK = 0x01;
+const uint8_t KEYFRAME_SKIP_IDLE_LOOPS = 0x02;
+const uint8_t KEYFRAME_FUSE_INSTRUCTIONS = 0x04;
+
+// Longest literal and repeat of the memory encoding
+const size_t MAX_LITERAL = 128;
+const size_t MAX_REPEAT = 129;
+
+void put_u8(std::vector<uint8_t>& out, const uint8_t value) {
+	out.push_back(value);
+}
+
+void put_u16(std::vector<uint8_t>& out, const uint16_t value) {
+	out.push_back(value & 0xFF);
+	out.push_back(value >> 8);
+}
+
+void put_u32(std::vector<uint8_t>& out, const uint32_t value) {
+	for (int i = 0; i < 4; i++) {
+		out.push_back((uint8_t)(value >> (8*i)));
+	}
+}
+
+void put_u64(std::vector<uint8_t>& out, const uint64_t value) {
+	for (int i = 0; i < 8; i++) {
+		out.push_back((uint8_t)(value >> (8*i)));
+	}
+}
+
+// 7 bits per byte, lowest first, the high bit set on all but the last byte
+void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+/**
+ * Reads the numbers `put_*` wrote, throwing when the data ends early
+ */
+struct MovieReader {
+	std::istream& in;
+
+	uint8_t u8() {
+		const int value = this->in.get();
+		if (value == std::char_traits<char>::eof()) {
+			throw std::runtime_error("Movie file is cut short");
+		}
+		return (uint8_t)value;
+	}
+
+	uint16_t u16() {
+		const uint16_t low = this->u8();
+		return low | (uint16_t)(this->u8() << 8);
+	}
+
+	uint32_t u32() {
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++) {
+			value |= (uint32_t)this->u8() << (8*i);
+		}
+		return value;
+	}
+
+	uint64_t u64() {
+		uint64_t value = 0;
+		for (int i = 0; i < 8; i++) {
+			value |= (uint64_t)this->u8() << (8*i);
+		}
+		return value;
+	}
+
+	uint32_t varint() {
+		uint32_t value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			const uint8_t byte = this->u8();
+			value |= (uint32_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		throw std::runtime_error("Malformed movie file: run length out of range");
+	}
+
+	void bytes(uint8_t* data, const size_t size) {
+		if (!this->in.read((char*)data, size)) {
+			throw std::runtime_error("Movie file is cut short");
+		}
+	}
+};
+
+// Run-length encoding of the memory space, mostly zeroes: a control byte below 0x80 is followed by that many plus one
+// literal bytes, a control byte `c` from 0x80 up by a single byte repeated `c - 0x80 + 2` times
+void encode_memory(const uint8_t* memory, std::vector<uint8_t>& out) {
+	size_t literal_start = 0;
+	size_t i = 0;
+	auto flush_literal = [&out, memory, &literal_start](const size_t end) {
+		while (literal_start < end) {
+			const size_t length = std::min(end - literal_start, MAX_LITERAL);
+			out.push_back((uint8_t)(length - 1));
+			out.insert(out.end(), memory + literal_start, memory + literal_start + length);
+			literal_start += length;
+		}
+	};
+	while (i < MEMORY_SIZE) {
+		size_t run = 1;
+		while (i + run < MEMORY_SIZE && run < MAX_REPEAT && memory[i + run] == memory[i]) {
+			run += 1;
+		}
+		// Pairs are cheaper as part of a literal
+		if (run < 3) {
+			i += run;
+			continue;
+		}
+		flush_literal(i);
+		out.push_back((uint8_t)(0x80 + run - 2));
+		out.push_back(memory[i]);
+		i += run;
+		literal_start = i;
+	}
+	flush_literal(MEMORY_SIZE);
+}
+
+// Returns the amount of encoded bytes read
+size_t decode_memory(MovieReader& reader, uint8_t* memory) {
+	size_t size = 0;
+	size_t encoded = 0;
+	while (size < MEMORY_SIZE) {
+		const uint8_t control = reader.u8();
+		const size_t length = (control < 0x80) ? control + 1 : control - 0x80 + 2;
+		if (size + length > MEMORY_SIZE) {
+			throw std::runtime_error("Malformed movie file: keyframe memory overflows the memory space");
+		}
+		if (control < 0x80) {
+			reader.bytes(memory + size, length);
+			encoded += 1 + length;
+		} else {
+			std::memset(memory + size, reader.u8(), length);
+			encoded += 2;
+		}
+		size += length;
+	}
+	return encoded;
+}
+
+uint64_t mix_rng(const uint64_t hash, const uint32_t rng) {
+	return hash ^ ((uint64_t)rng * 0x9E3779B97F4A7C15);
+}
+
+} // namespace
+
+
+uint64_t movie_state_hash(const CPU& cpu, const uint32_t rng) {
+	return mix_rng(hash_cpu_state(cpu), rng);
+}
+
+
+void MovieMachine::start(const std::vector<uint8_t>& program, const uint32_t rng_seed) {
+	this->random.seed(rng_seed);
+	this->cpu.reset_memory_space();
+	this->cpu.load_program(program);
+	this->cpu.reset();
+	this->next_frame = 0;
+}
+
+
+void MovieMachine::run_frame(const uint8_t key) {
+	if (key != 0) {
+		this->cpu.memory_write(0x00FF, key);
+	}
+	this->cpu.run_until((uint64_t)(this->next_frame + 1) * CYCLES_PER_FRAME, this->random);
+	this->next_frame += 1;
+}
+
+
+void MovieMachine::save_keyframe(MovieKeyframe& keyframe) {
+	keyframe.frame = this->next_frame;
+	keyframe.rng = this->random.state();
+	this->cpu.save_snapshot(keyframe.state);
+}
+
+
+void MovieMachine::restore_keyframe(const MovieKeyframe& keyframe) {
+	this->cpu.restore_snapshot(keyframe.state);
+	this->random.seed(keyframe.rng);
+	this->next_frame = keyframe.frame;
+}
+
+
+uint64_t MovieMachine::state_hash() {
+	return mix_rng(this->cpu.state_hash(), this->random.state());
+}
+
+
+bool MovieMachine::matches_keyframe(const MovieKeyframe& keyframe) const {
+	const CPUSnapshot& state = keyframe.state;
+	return this->next_frame == keyframe.frame && this->random.state() == keyframe.rng && this->cpu.cycles == state.cycles
+		&& this->cpu.program_counter == state.program_counter && this->cpu.stack_pointer == state.stack_pointer
+		&& this->cpu.register_a == state.register_a && this->cpu.register_irx == state.register_irx
+		&& this->cpu.register_iry == state.register_iry && this->cpu.status == state.status
+		&& state.memory.size() == MEMORY_SIZE && std::memcmp(this->cpu.memory, state.memory.data(), MEMORY_SIZE) == 0;
+}
+
+
+uint32_t MovieMachine::frame() const {
+	return this->next_frame;
+}
+
+
+MovieRecorder::MovieRecorder(const std::vector<uint8_t>& program, const uint32_t rng_seed, const uint32_t hash_interval,
+							 const uint32_t keyframe_interval) {
+	if (hash_interval == 0 || keyframe_interval == 0) {
+		throw std::invalid_argument("Movie hash and keyframe intervals have to be at least one frame");
+	}
+	this->machine.start(program, rng_seed);
+	this->recorded.program = program;
+	this->recorded.rng_seed = rng_seed;
+	this->recorded.hash_interval = hash_interval;
+	this->recorded.keyframe_interval = keyframe_interval;
+	this->recorded.keyframes.emplace_back();
+	this->machine.save_keyframe(this->recorded.keyframes.back());
+}
+
+
+void MovieRecorder::frame(const uint8_t key) {
+	this->machine.run_frame(key);
+	this->recorded.keys.push_back(key);
+
+	const uint32_t frame = this->machine.frame();
+	if (frame % this->recorded.hash_interval == 0) {
+		this->recorded.hashes.push_back(this->machine.state_hash());
+	}
+	if (frame % this->recorded.keyframe_interval == 0) {
+		this->recorded.keyframes.emplace_back();
+		this->machine.save_keyframe(this->recorded.keyframes.back());
+	}
+}
+
+
+const Movie& MovieRecorder::movie() const {
+	return this->recorded;
+}
+
+
+const CPU& MovieRecorder::cpu() const {
+	return this->machine.cpu;
+}
+
+
+MoviePlayer::MoviePlayer(const Movie& movie) : movie(movie), result() {
+	if (movie.keyframes.empty() || movie.keyframes.front().frame != 0) {
+		throw std::invalid_argument("Movie has no keyframe to start from");
+	}
+	this->machine.restore_keyframe(movie.keyframes.front());
+}
+
+
+bool MoviePlayer::frame() {
+	const uint32_t frame = this->machine.frame();
+	if (this->result.desynced || frame >= this->movie.keys.size()) {
+		return false;
+	}
+	this->machine.run_frame(this->movie.keys[frame]);
+	this->result.frames += 1;
+
+	const uint32_t interval = this->movie.hash_interval;
+	if ((frame + 1) % interval == 0 && (frame + 1) / interval <= this->movie.hashes.size()) {
+		const uint64_t expected = this->movie.hashes[(frame + 1) / interval - 1];
+		const uint64_t actual = this->machine.state_hash();
+		this->result.hashes += 1;
+		if (actual != expected) {
+			this->result.desynced = true;
+			this->result.desync_frame = frame;
+			this->result.expected_hash = expected;
+			this->result.actual_hash = actual;
+		}
+	}
+	return true;
+}
+
+
+const MovieCheck& MoviePlayer::play() {
+	while (this->frame()) {}
+	return this->result;
+}
+
+
+const MovieCheck& MoviePlayer::play_segment(const size_t keyframe) {
+	const std::vector<MovieKeyframe>& keyframes = this->movie.keyframes;
+	if (keyframe >= keyframes.size()) {
+		throw std::out_of_range("Movie has no keyframe " + std::to_string(keyframe));
+	}
+	this->machine.restore_keyframe(keyframes[keyframe]);
+	this->result = MovieCheck();
+	const bool last = keyframe + 1 == keyframes.size();
+	const uint32_t end = last ? this->movie.keys.size() : keyframes[keyframe + 1].frame;
+	while (this->machine.frame() < end && this->frame()) {}
+
+	if (!last && !this->result.desynced && !this->machine.matches_keyframe(keyframes[keyframe + 1])) {
+		this->result.desynced = true;
+		this->result.desync_frame = end - 1;
+		this->result.actual_hash = this->machine.state_hash();
+		this->machine.restore_keyframe(keyframes[keyframe + 1]);
+		this->result.expected_hash = this->machine.state_hash();
+	}
+	return this->result;
+}
+
+
+void MoviePlayer::seek(const uint32_t frame) {
+	if (frame > this->movie.keys.size()) {
+		throw std::out_of_range("Seek past the end of the movie");
+	}
+	const size_t index = std::min<size_t>(frame / this->movie.keyframe_interval, this->movie.keyframes.size() - 1);
+	const MovieKeyframe& keyframe = this->movie.keyframes[index];
+	const uint32_t position = this->machine.frame();
+	if (this->result.desynced || position > frame || position < keyframe.frame) {
+		this->machine.restore_keyframe(keyframe);
+		this->result = MovieCheck();
+	}
+	while (this->machine.frame() < frame && this->frame()) {}
+}
+
+
+uint32_t MoviePlayer::position() const {
+	return this->machine.frame();
+}
+
+
+const MovieCheck& MoviePlayer::check() const {
+	return this->result;
+}
+
+
+const CPU& MoviePlayer::cpu() const {
+	return this->machine.cpu;
+}
+
+
+MovieCheck verify_movie(const Movie& movie) {
+	MoviePlayer player(movie);
+	return player.play();
+}
+
+
+std::vector<MovieCheck> verify_movie_segments(const Movie& movie, const unsigned int thread_count) {
+	WorkStealingPool pool(thread_count);
+	std::vector<std::unique_ptr<MoviePlayer>> players;
+	for (unsigned int i = 0; i < pool.size(); i++) {
+		players.push_back(std::make_unique<MoviePlayer>(movie));
+	}
+
+	std::vector<MovieCheck> segments(movie.keyframes.size());
+	pool.run(segments.size(), [&segments, &players](size_t index, unsigned int worker) {
+		segments[index] = players[worker]->play_segment(index);
+	});
+	return segments;
+}
+
+
+void write_movie(std::ostream& out, const Movie& movie) {
+	std::vector<uint8_t> data(MOVIE_MAGIC, MOVIE_MAGIC + sizeof(MOVIE_MAGIC));
+	put_u32(data, MOVIE_VERSION);
+	put_u32(data, movie.rng_seed);
+	put_u32(data, movie.hash_interval);
+	put_u32(data, movie.keyframe_interval);
+	put_u32(data, movie.keys.size());
+	put_u32(data, movie.program.size());
+	data.insert(data.end(), movie.program.begin(), movie.program.end());
+
+	// Keys change rarely, runs of the same key take a couple of bytes
+	std::vector<uint8_t> runs;
+	uint32_t run_count = 0;
+	for (size_t i = 0; i < movie.keys.size();) {
+		size_t end = i + 1;
+		while (end < movie.keys.size() && movie.keys[end] == movie.keys[i]) {
+			end += 1;
+		}
+		put_varint(runs, end - i);
+		put_u8(runs, movie.keys[i]);
+		run_count += 1;
+		i = end;
+	}
+	put_u32(data, run_count);
+	data.insert(data.end(), runs.begin(), runs.end());
+
+	put_u32(data, movie.hashes.size());
+	for (const uint64_t hash : movie.hashes) {
+		put_u64(data, hash);
+	}
+
+	put_u32(data, movie.keyframes.size());
+	std::vector<uint8_t> memory;
+	for (const MovieKeyframe& keyframe : movie.keyframes) {
+		const CPUSnapshot& state = keyframe.state;
+		put_u32(data, keyframe.frame);
+		put_u32(data, keyframe.rng);
+		put_u64(data, state.cycles);
+		put_u16(data, state.program_counter);
+		put_u8(data, state.stack_pointer);
+		put_u8(data, state.register_a);
+		put_u8(data, state.register_irx);
+		put_u8(data, state.register_iry);
+		put_u8(data, state.status);
+		put_u8(data, (state.halt_on_brk ? KEYFRAME_HALT_ON_BRK : 0) | (state.skip_idle_loops ? KEYFRAME_SKIP_IDLE_LOOPS : 0)
+			| (state.fuse_instructions ? KEYFRAME_FUSE_INSTRUCTIONS : 0));
+		memory.clear();
+		encode_memory(state.memory.data(), memory);
+		put_u32(data, memory.size());
+		data.insert(data.end(), memory.begin(), memory.end());
+	}
+	out.write((const char*)data.data(), data.size());
+}
+
+
+Movie read_movie(std::istream& in) {
+	MovieReader reader = {in};
+	char magic[sizeof(MOVIE_MAGIC)];
+	reader.bytes((uint8_t*)magic, sizeof(magic));
+	if (std::memcmp(magic, MOVIE_MAGIC, sizeof(magic)) != 0) {
+		throw std::runtime_error("Not a movie file");
+	}
+	const uint32_t version = reader.u32();
+	if (version != MOVIE_VERSION) {
+		throw std::runtime_error("Unsupported movie file version " + std::to_string(version));
+	}
+
+	Movie movie;
+	movie.rng_seed = reader.u32();
+	movie.hash_interval = reader.u32();
+	movie.keyframe_interval = reader.u32();
+	const uint32_t frames = reader.u32();
+	if (movie.rng_seed == 0 || movie.hash_interval == 0 || movie.keyframe_interval == 0) {
+		throw std::runtime_error("Malformed movie file: zero seed or interval");
+	}
+	const uint32_t program_size = reader.u32();
+	if (program_size == 0 || program_size > UINT16_MAX/2) {
+		throw std::runtime_error("Malformed movie file: program does not fit into memory");
+	}
+	movie.program.resize(program_size);
+	reader.bytes(movie.program.data(), program_size);
+
+	const uint32_t run_count = reader.u32();
+	movie.keys.reserve(frames);
+	for (uint32_t i = 0; i < run_count; i++) {
+		const uint32_t length = reader.varint();
+		const uint8_t key = reader.u8();
+		if (length > frames - movie.keys.size()) {
+			throw std::runtime_error("Malformed movie file: more keys than frames");
+		}
+		movie.keys.insert(movie.keys.end(), length, key);
+	}
+	if (movie.keys.size() != frames) {
+		throw std::runtime_error("Malformed movie file: fewer keys than frames");
+	}
+
+	const uint32_t hash_count = reader.u32();
+	if (hash_count > frames / movie.hash_interval) {
+		throw std::runtime_error("Malformed movie file: more state hashes than frames");
+	}
+	movie.hashes.resize(hash_count);
+	for (uint64_t& hash : movie.hashes) {
+		hash = reader.u64();
+	}
+
+	// Snapshots get their serial from `CPU::save_snapshot`, so every keyframe is staged in a CPU first
+	const uint32_t keyframe_count = reader.u32();
+	if (keyframe_count == 0 || keyframe_count > frames / movie.keyframe_interval + 1) {
+		throw std::runtime_error("Malformed movie file: keyframes do not match the frames");
+	}
+	CPU staging;
+	movie.keyframes.resize(keyframe_count);
+	for (uint32_t i = 0; i < keyframe_count; i++) {
+		MovieKeyframe& keyframe = movie.keyframes[i];
+		keyframe.frame = reader.u32();
+		keyframe.rng = reader.u32();
+		if (keyframe.frame != i * movie.keyframe_interval || keyframe.rng == 0) {
+			throw std::runtime_error("Malformed movie file: keyframe " + std::to_string(i) + " out of place");
+		}
+		staging.cycles = reader.u64();
+		staging.program_counter = reader.u16();
+		staging.stack_pointer = reader.u8();
+		staging.register_a = reader.u8();
+		staging.register_irx = reader.u8();
+		staging.register_iry = reader.u8();
+		staging.status = reader.u8();
+		const uint8_t flags = reader.u8();
+		staging.halt_on_brk = (flags & KEYFRAME_HALT_ON_BRK) != 0;
+		staging.skip_idle_loops = (flags & KEYFRAME_SKIP_IDLE_LOOPS) != 0;
+		staging.fuse_instructions = (flags & KEYFRAME_FUSE_INSTRUCTIONS) != 0;
+		const uint32_t encoded_size = reader.u32();
+		if (decode_memory(reader, staging.memory) != encoded_size) {
+			throw std::runtime_error("Malformed movie file: keyframe memory size does not match");
+		}
+		staging.save_snapshot(keyframe.state);
+	}
+	return movie;
+}
+
+
+void save_movie(const std::string& path, const Movie& movie) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Could not open movie for writing: " + path);
+	}
+	write_movie(file, movie);
+	if (!file.flush()) {
+		throw std::runtime_error("Could not write movie: " + path);
+	}
+}
+
+
+Movie load_movie(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Could not open movie: " + path);
+	}
+	return read_movie(file);
+}
@@ -0,0 +1,216 @@
+#include <array>
+#include <cstddef>
+
+#include "opcode.hpp"
+
+namespace {
+
+// {code, bytes, cycles, addressingmode, mnemonic, page penalty}
+constexpr Opcode DOCUMENTED_OPCODES[] = {
+	Opcode(0x69, 2, 2, AddressingMode::Immediate, "adc", false),
+	Opcode(0x65, 2, 3, AddressingMode::ZeroPage, "adc", false),
+	Opcode(0x75, 2, 4, AddressingMode::ZeroPageX, "adc", false),
+	Opcode(0x6D, 3, 4, AddressingMode::Absolute, "adc", false),
+	Opcode(0x7D, 3, 4, AddressingMode::AbsoluteX, "adc", true), // +1 if page crossed
+	Opcode(0x79, 3, 4, AddressingMode::AbsoluteY, "adc", true), // +1 if page crossed
+	Opcode(0x61, 2, 6, AddressingMode::IndirectX, "adc", false),
+	Opcode(0x71, 2, 5, AddressingMode::IndirectY, "adc", true), // +1 if page crossed
+
+	Opcode(0x29, 2, 2, AddressingMode::Immediate, "and", false),
+	Opcode(0x25, 2, 3, AddressingMode::ZeroPage, "and", false),
+	Opcode(0x35, 2, 4, AddressingMode::ZeroPageX, "and", false),
+	Opcode(0x2D, 3, 4, AddressingMode::Absolute, "and", false),
+	Opcode(0x3D, 3, 4, AddressingMode::AbsoluteX, "and", true), // +1 if page crossed
+	Opcode(0x39, 3, 4, AddressingMode::AbsoluteY, "and", true), // +1 if page crossed
+	Opcode(0x21, 2, 6, AddressingMode::IndirectX, "and", false),
+	Opcode(0x31, 2, 5, AddressingMode::IndirectY, "and", true), // +1 if page crossed
+
+	Opcode(0x0A, 1, 2, AddressingMode::Accumulator, "asl", false),
+	Opcode(0x06, 2, 5, AddressingMode::ZeroPage, "asl", false),
+	Opcode(0x16, 2, 6, AddressingMode::ZeroPageX, "asl", false),
+	Opcode(0x0E, 3, 6, AddressingMode::Absolute, "asl", false),
+	Opcode(0x1E, 3, 7, AddressingMode::AbsoluteX, "asl", false),
+
+	Opcode(0x24, 2, 3, AddressingMode::ZeroPage, "bit", false),
+	Opcode(0x2C, 3, 4, AddressingMode::Absolute, "bit", false),
+
+	Opcode(0x00, 1, 7, AddressingMode::Implied, "brk", false),
+
+	Opcode(0xC9, 2, 2, AddressingMode::Immediate, "cmp", false),
+	Opcode(0xC5, 2, 3, AddressingMode::ZeroPage, "cmp", false),
+	Opcode(0xD5, 2, 4, AddressingMode::ZeroPageX, "cmp", false),
+	Opcode(0xCD, 3, 4, AddressingMode::Absolute, "cmp", false),
+	Opcode(0xDD, 3, 4, AddressingMode::AbsoluteX, "cmp", true), // +1 if page crossed
+	Opcode(0xD9, 3, 4, AddressingMode::AbsoluteY, "cmp", true), // +1 if page crossed
+	Opcode(0xC1, 2, 6, AddressingMode::IndirectX, "cmp", false),
+	Opcode(0xD1, 2, 5, AddressingMode::IndirectY, "cmp", true), // +1 if page crossed
+
+	Opcode(0xE0, 2, 2, AddressingMode::Immediate, "cpx", false),
+	Opcode(0xE4, 2, 3, AddressingMode::ZeroPage, "cpx", false),
+	Opcode(0xEC, 3, 4, AddressingMode::Absolute, "cpx", false),
+
+	Opcode(0xC0, 2, 2, AddressingMode::Immediate, "cpy", false),
+	Opcode(0xC4, 2, 3, AddressingMode::ZeroPage, "cpy", false),
+	Opcode(0xCC, 3, 4, AddressingMode::Absolute, "cpy", false),
+
+	Opcode(0xC6, 2, 5, AddressingMode::ZeroPage, "dec", false),
+	Opcode(0xD6, 2, 6, AddressingMode::ZeroPageX, "dec", false),
+	Opcode(0xCE, 3, 6, AddressingMode::Absolute, "dec", false),
+	Opcode(0xDE, 3, 7, AddressingMode::AbsoluteX, "dec", false),
+
+	Opcode(0xCA, 1, 2, AddressingMode::Implied, "dex", false),
+	Opcode(0x88, 1, 2, AddressingMode::Implied, "dey", false),
+
+	Opcode(0x49, 2, 2, AddressingMode::Immediate, "eor", false),
+	Opcode(0x45, 2, 3, AddressingMode::ZeroPage, "eor", false),
+	Opcode(0x55, 2, 4, AddressingMode::ZeroPageX, "eor", false),
+	Opcode(0x4D, 3, 4, AddressingMode::Absolute, "eor", false),
+	Opcode(0x5D, 3, 4, AddressingMode::AbsoluteX, "eor", true), // +1 if page crossed
+	Opcode(0x59, 3, 4, AddressingMode::AbsoluteY, "eor", true), // +1 if page crossed
+	Opcode(0x41, 2, 6, AddressingMode::IndirectX, "eor", false),
+	Opcode(0x51, 2, 5, AddressingMode::IndirectY, "eor", true), // +1 if page crossed
+
+	Opcode(0xE6, 2, 5, AddressingMode::ZeroPage, "inc", false),
+	Opcode(0xF6, 2, 6, AddressingMode::ZeroPageX, "inc", false),
+	Opcode(0xEE, 3, 6, AddressingMode::Absolute, "inc", false),
+	Opcode(0xFE, 3, 7, AddressingMode::AbsoluteX, "inc", false),
+
+	Opcode(0xE8, 1, 2, AddressingMode::Implied, "inx", false),
+	Opcode(0xC8, 1, 2, AddressingMode::Implied, "iny", false),
+
+	Opcode(0x4C, 3, 3, AddressingMode::Absolute, "jmp", false),
+	Opcode(0x6C, 3, 5, AddressingMode::Indirect, "jmp", false),
+
+	Opcode(0x20, 3, 6, AddressingMode::Absolute, "jsr", false),
+
+	Opcode(0xA9, 2, 2, AddressingMode::Immediate, "lda", false),
+	Opcode(0xA5, 2, 3, AddressingMode::ZeroPage, "lda", false),
+	Opcode(0xB5, 2, 4, AddressingMode::ZeroPageX, "lda", false),
+	Opcode(0xAD, 3, 4, AddressingMode::Absolute, "lda", false),
+	Opcode(0xBD, 3, 4, AddressingMode::AbsoluteX, "lda", true), // +1 if page crossed
+	Opcode(0xB9, 3, 4, AddressingMode::AbsoluteY, "lda", true), // +1 if page crossed
+	Opcode(0xA1, 2, 6, AddressingMode::IndirectX, "lda", false),
+	Opcode(0xB1, 2, 5, AddressingMode::IndirectY, "lda", true), // +1 if page crossed
+
+	Opcode(0xA2, 2, 2, AddressingMode::Immediate, "ldx", false),
+	Opcode(0xA6, 2, 3, AddressingMode::ZeroPage, "ldx", false),
+	Opcode(0xB6, 2, 4, AddressingMode::ZeroPageY, "ldx", false),
+	Opcode(0xAE, 3, 4, AddressingMode::Absolute, "ldx", false),
+	Opcode(0xBE, 3, 4, AddressingMode::AbsoluteY, "ldx", true), // +1 if page crossed
+
+	Opcode(0xA0, 2, 2, AddressingMode::Immediate, "ldy", false),
+	Opcode(0xA4, 2, 3, AddressingMode::ZeroPage, "ldy", false),
+	Opcode(0xB4, 2, 4, AddressingMode::ZeroPageX, "ldy", false),
+	Opcode(0xAC, 3, 4, AddressingMode::Absolute, "ldy", false),
+	Opcode(0xBC, 3, 4, AddressingMode::AbsoluteX, "ldy", true), // +1 if page crossed
+
+	Opcode(0x4A, 1, 2, AddressingMode::Accumulator, "lsr", false),
+	Opcode(0x46, 2, 5, AddressingMode::ZeroPage, "lsr", false),
+	Opcode(0x56, 2, 6, AddressingMode::ZeroPageX, "lsr", false),
+	Opcode(0x4E, 3, 6, AddressingMode::Absolute, "lsr", false),
+	Opcode(0x5E, 3, 7, AddressingMode::AbsoluteX, "lsr", false),
+
+	Opcode(0xEA, 1, 2, AddressingMode::Implied, "nop", false),
+
+	Opcode(0x09, 2, 2, AddressingMode::Immediate, "ora", false),
+	Opcode(0x05, 2, 3, AddressingMode::ZeroPage, "ora", false),
+	Opcode(0x15, 2, 4, AddressingMode::ZeroPageX, "ora", false),
+	Opcode(0x0D, 3, 4, AddressingMode::Absolute, "ora", false),
+	Opcode(0x1D, 3, 4, AddressingMode::AbsoluteX, "ora", true), // +1 if page crossed
+	Opcode(0x19, 3, 4, AddressingMode::AbsoluteY, "ora", true), // +1 if page crossed
+	Opcode(0x01, 2, 6, AddressingMode::IndirectX, "ora", false),
+	Opcode(0x11, 2, 5, AddressingMode::IndirectY, "ora", true), // +1 if page crossed
+
+	Opcode(0x2A, 1, 2, AddressingMode::Accumulator, "rol", false),
+	Opcode(0x26, 2, 5, AddressingMode::ZeroPage, "rol", false),
+	Opcode(0x36, 2, 6, AddressingMode::ZeroPageX, "rol", false),
+	Opcode(0x2E, 3, 6, AddressingMode::Absolute, "rol", false),
+	Opcode(0x3E, 3, 7, AddressingMode::AbsoluteX, "rol", false),
+
+	Opcode(0x6A, 1, 2, AddressingMode::Accumulator, "ror", false),
+	Opcode(0x66, 2, 5, AddressingMode::ZeroPage, "ror", false),
+	Opcode(0x76, 2, 6, AddressingMode::ZeroPageX, "ror", false),
+	Opcode(0x6E, 3, 6, AddressingMode::Absolute, "ror", false),
+	Opcode(0x7E, 3, 7, AddressingMode::AbsoluteX, "ror", false),
+
+	Opcode(0x40, 1, 6, AddressingMode::Implied, "rti", false),
+	Opcode(0x60, 1, 6, AddressingMode::Implied, "rts", false),
+
+	Opcode(0xE9, 2, 2, AddressingMode::Immediate, "sbc", false),
+	Opcode(0xE5, 2, 3, AddressingMode::ZeroPage, "sbc", false),
+	Opcode(0xF5, 2, 4, AddressingMode::ZeroPageX, "sbc", false),
+	Opcode(0xED, 3, 4, AddressingMode::Absolute, "sbc", false),
+	Opcode(0xFD, 3, 4, AddressingMode::AbsoluteX, "sbc", true), // +1 if page crossed
+	Opcode(0xF9, 3, 4, AddressingMode::AbsoluteY, "sbc", true), // +1 if page crossed
+	Opcode(0xE1, 2, 6, AddressingMode::IndirectX, "sbc", false),
+	Opcode(0xF1, 2, 5, AddressingMode::IndirectY, "sbc", true), // +1 if page crossed
+
+	Opcode(0x85, 2, 3, AddressingMode::ZeroPage, "sta", false),
+	Opcode(0x95, 2, 4, AddressingMode::ZeroPageX, "sta", false),
+	Opcode(0x8D, 3, 4, AddressingMode::Absolute, "sta", false),
+	Opcode(0x9D, 3, 5, AddressingMode::AbsoluteX, "sta", false),
+	Opcode(0x99, 3, 5, AddressingMode::AbsoluteY, "sta", false),
+	Opcode(0x81, 2, 6, AddressingMode::IndirectX, "sta", false),
+	Opcode(0x91, 2, 6, AddressingMode::IndirectY, "sta", false),
+
+	Opcode(0x86, 2, 3, AddressingMode::ZeroPage, "stx", false),
+	Opcode(0x96, 2, 4, AddressingMode::ZeroPageY, "stx", false),
+	Opcode(0x8E, 3, 4, AddressingMode::Absolute, "stx", false),
+
+	Opcode(0x84, 2, 3, AddressingMode::ZeroPage, "sty", false),
+	Opcode(0x94, 2, 4, AddressingMode::ZeroPageX, "sty", false),
+	Opcode(0x8C, 3, 4, AddressingMode::Absolute, "sty", false),
+
+	Opcode(0xAA, 1, 2, AddressingMode::Implied, "tax", false),
+	Opcode(0xA8, 1, 2, AddressingMode::Implied, "tay", false),
+	Opcode(0xBA, 1, 2, AddressingMode::Implied, "tsx", false),
+	Opcode(0x8A, 1, 2, AddressingMode::Implied, "txa", false),
+	Opcode(0x9A, 1, 2, AddressingMode::Implied, "txs", false),
+	Opcode(0x98, 1, 2, AddressingMode::Implied, "tya", false),
+
+	// Stack Instructions
+	Opcode(0x48, 1, 3, AddressingMode::Implied, "pha", false),
+	Opcode(0x08, 1, 3, AddressingMode::Implied, "php", false),
+	Opcode(0x68, 1, 4, AddressingMode::Implied, "pla", false),
+	Opcode(0x28, 1, 4, AddressingMode::Implied, "plp", false),
+
+	// Flag instructions
+	Opcode(0x18, 1, 2, AddressingMode::Implied, "clc", false),
+	Opcode(0xD8, 1, 2, AddressingMode::Implied, "cld", false),
+	Opcode(0x58, 1, 2, AddressingMode::Implied, "cli", false),
+	Opcode(0xB8, 1, 2, AddressingMode::Implied, "clv", false),
+	Opcode(0x38, 1, 2, AddressingMode::Implied, "sec", false),
+	Opcode(0xF8, 1, 2, AddressingMode::Implied, "sed", false),
+	Opcode(0x78, 1, 2, AddressingMode::Implied, "sei", false),
+
+	// Branch instructions
+	Opcode(0x90, 2, 2, AddressingMode::Relative, "bcc", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0xB0, 2, 2, AddressingMode::Relative, "bcs", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0xF0, 2, 2, AddressingMode::Relative, "beq", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0x30, 2, 2, AddressingMode::Relative, "bmi", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0xD0, 2, 2, AddressingMode::Relative, "bne", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0x10, 2, 2, AddressingMode::Relative, "bpl", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0x50, 2, 2, AddressingMode::Relative, "bvc", false), // +1 if taken, +1 more if the target is on another page
+	Opcode(0x70, 2, 2, AddressingMode::Relative, "bvs", false), // +1 if taken, +1 more if the target is on another page
+};
+
+// Built at compile time, so the table is constant-initialized and safe to use from other static initializers
+constexpr std::array<Opcode, OPCODE_COUNT> build_opcode_table() {
+	std::array<Opcode, OPCODE_COUNT> table{};
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		table[i].code = (uint8_t)i;
+	}
+	for (const Opcode& opcode : DOCUMENTED_OPCODES) {
+		table[opcode.code] = opcode;
+	}
+	return table;
+}
+
+} // namespace
+
+constexpr std::array<Opcode, OPCODE_COUNT> OPCODES = build_opcode_table();
+
+const char* const MODE_NAMES[ADDRESSING_MODE_COUNT] = {
+	"Implied", "Immediate", "Relative", "Accumulator", "ZeroPage", "ZeroPageX", "ZeroPageY",
+	"Absolute", "AbsoluteX", "AbsoluteY", "Indirect", "IndirectX", "IndirectY",
+};
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "profiler.hpp"
+
+namespace {
+
+// Whether an instruction reads or writes a memory operand, the absolute JMP and JSR only use theirs as target
+bool accesses_memory_operand(const Opcode& opcode) {
+	const AddressingMode mode = opcode.mode;
+	if (mode == AddressingMode::Implied || mode == AddressingMode::Immediate
+		|| mode == AddressingMode::Accumulator || mode == AddressingMode::Relative) {
+		return false;
+	}
+	return opcode.code != 0x4C && opcode.code != 0x20;
+}
+
+double percentage(const uint64_t part, const uint64_t total) {
+	return (total == 0) ? 0 : 100.0 * part / total;
+}
+
+} // namespace
+
+
+Profiler::Profiler() : pc_count(MEMORY_SIZE, 0), pc_cycles(MEMORY_SIZE, 0) {
+	this->opcode_count.fill(0);
+	this->opcode_cycles.fill(0);
+}
+
+
+void Profiler::clear() {
+	this->opcode_count.fill(0);
+	this->opcode_cycles.fill(0);
+	std::fill(this->pc_count.begin(), this->pc_count.end(), 0);
+	std::fill(this->pc_cycles.begin(), this->pc_cycles.end(), 0);
+}
+
+
+uint64_t Profiler::instructions() const {
+	uint64_t total = 0;
+	for (const uint64_t count : this->opcode_count) {
+		total += count;
+	}
+	return total;
+}
+
+
+uint64_t Profiler::cycles() const {
+	uint64_t total = 0;
+	for (const uint64_t count : this->opcode_cycles) {
+		total += count;
+	}
+	return total;
+}
+
+
+uint64_t Profiler::mode_count(const AddressingMode mode) const {
+	uint64_t total = 0;
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		if (OPCODES[i].mode == mode) {
+			total += this->opcode_count[i];
+		}
+	}
+	return total;
+}
+
+
+uint64_t Profiler::mode_cycles(const AddressingMode mode) const {
+	uint64_t total = 0;
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		if (OPCODES[i].mode == mode) {
+			total += this->opcode_cycles[i];
+		}
+	}
+	return total;
+}
+
+
+std::vector<uint16_t> Profiler::hottest_pcs(const size_t count) const {
+	std::vector<uint16_t> pcs;
+	for (size_t pc = 0; pc < MEMORY_SIZE; pc++) {
+		if (this->pc_count[pc] != 0) {
+			pcs.push_back((uint16_t)pc);
+		}
+	}
+
+	const size_t kept = std::min(count, pcs.size());
+	std::partial_sort(pcs.begin(), pcs.begin() + kept, pcs.end(), [this](const uint16_t a, const uint16_t b) {
+		if (this->pc_cycles[a] != this->pc_cycles[b]) {
+			return this->pc_cycles[a] > this->pc_cycles[b];
+		}
+		return a < b;
+	});
+	pcs.resize(kept);
+	return pcs;
+}
+
+
+void Profiler::write_report(std::ostream& out, const CPU& cpu, const size_t top) const {
+	const uint64_t total_instructions = this->instructions();
+	const uint64_t total_cycles = this->cycles();
+
+	out << total_instructions << " instructions, " << total_cycles << " cycles";
+	if (total_instructions != 0) {
+		out << ", " << std::fixed << std::setprecision(2) << (double)total_cycles / total_instructions
+			<< " cycles/instruction" << std::defaultfloat;
+	}
+	out << std::endl;
+
+	out << std::endl << "hot instructions:" << std::endl;
+	for (const uint16_t pc : this->hottest_pcs(top)) {
+		char line[DISASSEMBLY_LINE_LENGTH];
+		disassemble_line(cpu.memory, pc, line);
+		out << "  " << std::left << std::setw(30) << line << std::right
+			<< std::setw(12) << this->pc_count[pc] << " x" << std::setw(14) << this->pc_cycles[pc] << " cycles"
+			<< std::fixed << std::setprecision(1) << std::setw(7) << percentage(this->pc_cycles[pc], total_cycles)
+			<< "%" << std::defaultfloat << std::endl;
+	}
+
+	out << std::endl << "opcodes:" << std::endl;
+	std::vector<size_t> opcodes;
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		if (this->opcode_count[i] != 0) {
+			opcodes.push_back(i);
+		}
+	}
+	std::sort(opcodes.begin(), opcodes.end(), [this](const size_t a, const size_t b) {
+		return this->opcode_cycles[a] > this->opcode_cycles[b];
+	});
+	for (const size_t opcode : opcodes) {
+		out << "  $" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << opcode
+			<< std::dec << std::nouppercase << std::setfill(' ') << "  " << std::left << std::setw(4)
+			<< OPCODES[opcode].name << std::setw(14) << MODE_NAMES[OPCODES[opcode].mode] << std::right
+			<< std::setw(12) << this->opcode_count[opcode] << " x" << std::setw(14) << this->opcode_cycles[opcode]
+			<< " cycles" << std::fixed << std::setprecision(1) << std::setw(7)
+			<< percentage(this->opcode_cycles[opcode], total_cycles) << "%" << std::defaultfloat << std::endl;
+	}
+
+	out << std::endl << "addressing modes:" << std::endl;
+	for (size_t mode = 0; mode < ADDRESSING_MODE_COUNT; mode++) {
+		const uint64_t count = this->mode_count((AddressingMode)mode);
+		const uint64_t cycles = this->mode_cycles((AddressingMode)mode);
+		if (count == 0) {
+			continue;
+		}
+		out << "  " << std::left << std::setw(20) << MODE_NAMES[mode] << std::right
+			<< std::setw(12) << count << " x" << std::setw(14) << cycles << " cycles"
+			<< std::fixed << std::setprecision(1) << std::setw(7) << percentage(cycles, total_cycles) << "%"
+			<< std::defaultfloat << std::endl;
+	}
+
+	uint64_t memory_cycles = 0;
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		if (accesses_memory_operand(OPCODES[i])) {
+			memory_cycles += this->opcode_cycles[i];
+		}
+	}
+	const double memory_share = percentage(memory_cycles, total_cycles);
+	out << std::endl << std::fixed << std::setprecision(1) << memory_share
+		<< "% of cycles in instructions with a memory operand: "
+		<< ((memory_share > 50) ? "memory-bound" : "dispatch-bound") << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,457 @@
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "recompiler.hpp"
+
+namespace {
+
+std::string hex(const uint32_t value, const int digits) {
+	std::ostringstream out;
+	out << "0x" << std::hex << std::uppercase << std::setw(digits) << std::setfill('0') << value;
+	return out.str();
+}
+
+std::string uppercase(const char* name) {
+	std::string result(name);
+	for (char& c : result) {
+		c = (char)std::toupper(c);
+	}
+	return result;
+}
+
+// Instructions after which execution does not simply continue with the next instruction
+bool ends_block(const Opcode& opcode) {
+	return opcode.mode == AddressingMode::Relative || opcode.code == 0x4C || opcode.code == 0x6C ||
+		opcode.code == 0x20 || opcode.code == 0x60 || opcode.code == 0x40;
+}
+
+uint32_t worst_case_cycles(const Opcode& opcode) {
+	// A taken branch to another page costs 2 more cycles
+	return opcode.cycles + (opcode.page_penalty ? 1 : 0) + ((opcode.mode == AddressingMode::Relative) ? 2 : 0);
+}
+
+// Condition under which a branch is taken, on the cached status register
+const char* branch_condition(const uint8_t code) {
+	switch (code) {
+		case 0x90: return "(p & Flag::Carry) == 0";
+		case 0xB0: return "(p & Flag::Carry) != 0";
+		case 0xF0: return "(p & Flag::Zero) != 0";
+		case 0x30: return "(p & Flag::Negative) != 0";
+		case 0xD0: return "(p & Flag::Zero) == 0";
+		case 0x10: return "(p & Flag::Negative) == 0";
+		case 0x50: return "(p & Flag::Overflow) == 0";
+		default: return "(p & Flag::Overflow) != 0";
+	}
+}
+
+// Cached register an instruction works on, from the last letter of its mnemonic (lda, stx, cpy, inx, ...)
+const char* register_of(const std::string& name) {
+	const char last = name.back();
+	if (last == 'x') {
+		return "x";
+	} else if (last == 'y') {
+		return "y";
+	}
+	return "a";
+}
+
+const char* const PRELUDE =
+	"#include <cstdint>\n"
+	"#include <cstring>\n"
+	"\n"
+	"#include \"recompiler.hpp\"\n"
+	"\n"
+	"namespace {\n"
+	"\n"
+	"// The registers are cached in locals, as stores through `memory` could otherwise alias them\n"
+	"#define LOAD_REGISTERS \\\n"
+	"\ta = cpu.register_a; x = cpu.register_irx; y = cpu.register_iry; sp = cpu.stack_pointer; p = cpu.status; \\\n"
+	"\tcycles = cpu.cycles;\n"
+	"#define STORE_REGISTERS \\\n"
+	"\tcpu.register_a = a; cpu.register_irx = x; cpu.register_iry = y; cpu.stack_pointer = sp; cpu.status = p; \\\n"
+	"\tcpu.cycles = cycles;\n"
+	"\n"
+	"inline uint8_t nz(const uint8_t p, const uint8_t value) {\n"
+	"\treturn (p & ~(Flag::Zero | Flag::Negative)) | ((value == 0) ? Flag::Zero : 0) | (value & Flag::Negative);\n"
+	"}\n"
+	"\n"
+	"// Same flags as `CPU::compare`\n"
+	"inline uint8_t compare(uint8_t p, const uint8_t reg, const uint8_t operand) {\n"
+	"\tif (operand == reg) {\n"
+	"\t\tp |= Flag::Zero;\n"
+	"\t} else if (reg > operand) {\n"
+	"\t\tp |= Flag::Carry;\n"
+	"\t} else if (((reg - operand) & 0b10000000) == 0) {\n"
+	"\t\tp |= Flag::Negative;\n"
+	"\t}\n"
+	"\treturn p;\n"
+	"}\n";
+
+} // namespace
+
+
+StaticRecompiler::StaticRecompiler(const uint8_t* image) : image(image, image + MEMORY_SIZE) {
+	this->discovered = false;
+	// Vectors that were never written are left out, they would only point at the zero page
+	for (const uint32_t vector : {0xFFFC, 0xFFFA, 0xFFFE}) {
+		const uint16_t entry = this->image[vector] | (this->image[vector + 1] << 8);
+		if (entry != 0x0000) {
+			this->entries.push_back(entry);
+		}
+	}
+}
+
+
+void StaticRecompiler::add_entry(const uint16_t address) {
+	this->entries.push_back(address);
+	this->discovered = false;
+}
+
+
+uint16_t StaticRecompiler::operand_uint16(const uint16_t pc) const {
+	return this->image[(uint16_t)(pc + 1)] | (this->image[(uint16_t)(pc + 2)] << 8);
+}
+
+
+const std::vector<BasicBlock>& StaticRecompiler::discover() {
+	if (this->discovered) {
+		return this->blocks;
+	}
+
+	// Walk every path from the entry points, marking instruction starts and the places that are jumped to
+	std::set<uint16_t> leaders(this->entries.begin(), this->entries.end());
+	std::set<uint16_t> decoded;
+	std::vector<uint16_t> pending = this->entries;
+	auto follow = [&leaders, &pending](const uint32_t target) {
+		if (target < MEMORY_SIZE) {
+			leaders.insert((uint16_t)target);
+			pending.push_back((uint16_t)target);
+		}
+	};
+	while (!pending.empty()) {
+		uint32_t pc = pending.back();
+		pending.pop_back();
+		while (pc < MEMORY_SIZE && decoded.count((uint16_t)pc) == 0) {
+			const Opcode& opcode = OPCODES[this->image[pc]];
+			if (opcode.size == 0 || pc + opcode.size > MEMORY_SIZE) {
+				break;
+			}
+			decoded.insert((uint16_t)pc);
+			const uint32_t next = pc + opcode.size;
+
+			if (opcode.code == 0x00) {
+				// RTI returns past the padding byte of the BRK
+				follow(pc + 2);
+				break;
+			} else if (opcode.mode == AddressingMode::Relative) {
+				follow((uint16_t)(next + (int8_t)this->image[pc + 1]));
+				follow(next);
+				break;
+			} else if (opcode.code == 0x4C) {
+				follow(this->operand_uint16(pc));
+				break;
+			} else if (opcode.code == 0x20) {
+				follow(this->operand_uint16(pc));
+				follow(next);
+				break;
+			} else if (ends_block(opcode)) {
+				break;
+			}
+			pc = next;
+		}
+	}
+
+	// Split the decoded code at the leaders and after control flow. A BRK stays with the interpreter.
+	this->blocks.clear();
+	for (const uint16_t leader : leaders) {
+		if (decoded.count(leader) == 0 || this->image[leader] == 0x00) {
+			continue;
+		}
+		BasicBlock block = {leader, leader, {}, 0};
+		uint32_t pc = leader;
+		while (true) {
+			const Opcode& opcode = OPCODES[this->image[pc]];
+			block.instructions.push_back((uint16_t)pc);
+			block.end = pc + opcode.size;
+			if (ends_block(opcode) || block.end >= MEMORY_SIZE || leaders.count(block.end) != 0 ||
+				decoded.count(block.end) == 0 || this->image[block.end] == 0x00) {
+				break;
+			}
+			block.budget += worst_case_cycles(opcode);
+			pc = block.end;
+		}
+		this->blocks.push_back(block);
+	}
+	this->discovered = true;
+	return this->blocks;
+}
+
+
+void StaticRecompiler::emit_instruction(std::ostream& out, const uint16_t pc, const bool last) const {
+	const Opcode& opcode = OPCODES[this->image[pc]];
+	const std::string name = opcode.name;
+	const uint8_t operand = this->image[(uint16_t)(pc + 1)];
+	const uint16_t next = pc + opcode.size;
+
+	char line[DISASSEMBLY_LINE_LENGTH];
+	disassemble_line(this->image.data(), pc, line);
+	out << "\t// " << line << std::endl;
+
+	const bool reads = name == "lda" || name == "ldx" || name == "ldy" || name == "and" || name == "ora" ||
+		name == "eor" || name == "cmp" || name == "cpx" || name == "cpy";
+	const bool writes = name == "sta" || name == "stx" || name == "sty";
+	const bool modifies = name == "inc" || name == "dec";
+
+	if (reads || writes || modifies) {
+		// Operand address, computed like `CPU::get_operand_address`
+		switch (opcode.mode) {
+			case AddressingMode::Immediate:
+				out << "\tvalue = " << hex(operand, 2) << ";" << std::endl;
+				break;
+			case AddressingMode::ZeroPage:
+				out << "\taddress = " << hex(operand, 2) << ";" << std::endl;
+				break;
+			case AddressingMode::ZeroPageX:
+			case AddressingMode::ZeroPageY:
+				out << "\taddress = (uint8_t)(" << hex(operand, 2) << " + "
+					<< ((opcode.mode == AddressingMode::ZeroPageX) ? "x" : "y") << ");" << std::endl;
+				break;
+			case AddressingMode::Absolute:
+				out << "\taddress = " << hex(this->operand_uint16(pc), 4) << ";" << std::endl;
+				break;
+			case AddressingMode::AbsoluteX:
+			case AddressingMode::AbsoluteY:
+				out << "\taddress = (uint16_t)(" << hex(this->operand_uint16(pc), 4) << " + "
+					<< ((opcode.mode == AddressingMode::AbsoluteX) ? "x" : "y") << ");" << std::endl;
+				out << "\tcrossed = (address >> 8) != " << hex(this->operand_uint16(pc) >> 8, 2) << ";" << std::endl;
+				break;
+			case AddressingMode::IndirectX:
+				out << "\tpointer = (uint8_t)(" << hex(operand, 2) << " + x);" << std::endl;
+				out << "\taddress = memory[pointer] | (memory[(uint8_t)(pointer + 1)] << 8);" << std::endl;
+				break;
+			case AddressingMode::IndirectY:
+				out << "\tbase = memory[" << hex(operand, 2) << "] | (memory[" << hex((uint8_t)(operand + 1), 2)
+					<< "] << 8);" << std::endl;
+				out << "\taddress = (uint16_t)(base + y);" << std::endl;
+				out << "\tcrossed = ((base ^ address) & 0xFF00) != 0;" << std::endl;
+				break;
+			default:
+				break;
+		}
+		if ((reads || modifies) && opcode.mode != AddressingMode::Immediate) {
+			out << "\tvalue = memory[address];" << std::endl;
+		}
+
+		const char* reg = register_of(name);
+		if (name == "lda" || name == "ldx" || name == "ldy") {
+			out << "\t" << reg << " = value;" << std::endl;
+			out << "\tp = nz(p, " << reg << ");" << std::endl;
+		} else if (name == "and" || name == "ora" || name == "eor") {
+			const char* op = (name == "and") ? "&" : ((name == "ora") ? "|" : "^");
+			out << "\ta = a " << op << " value;" << std::endl;
+			out << "\tp = nz(p, a);" << std::endl;
+		} else if (name == "cmp" || name == "cpx" || name == "cpy") {
+			out << "\tp = compare(p, " << reg << ", value);" << std::endl;
+		} else if (writes) {
+			out << "\tmemory[address] = " << reg << ";" << std::endl;
+			out << "\tcpu.mark_dirty(address);" << std::endl;
+		} else {
+			out << "\tvalue " << ((name == "inc") ? "+" : "-") << "= 1;" << std::endl;
+			out << "\tmemory[address] = value;" << std::endl;
+			out << "\tcpu.mark_dirty(address);" << std::endl;
+			out << "\tp = nz(p, value);" << std::endl;
+		}
+
+		out << "\tcycles += " << (int)opcode.cycles;
+		if (opcode.page_penalty && (opcode.mode == AddressingMode::AbsoluteX ||
+			opcode.mode == AddressingMode::AbsoluteY || opcode.mode == AddressingMode::IndirectY)) {
+			out << " + crossed";
+		}
+		out << ";" << std::endl;
+		if (last) {
+			out << "\tcpu.program_counter = " << hex(next, 4) << ";" << std::endl;
+		}
+		return;
+	}
+
+	if (opcode.mode == AddressingMode::Relative) {
+		const uint16_t target = next + (int8_t)operand;
+		const int taken_cycles = ((target & 0xFF00) != (next & 0xFF00)) ? 2 : 1;
+		out << "\tcycles += " << (int)opcode.cycles << ";" << std::endl;
+		out << "\tif (" << branch_condition(opcode.code) << ") {" << std::endl;
+		out << "\t\tcycles += " << taken_cycles << ";" << std::endl;
+		out << "\t\tcpu.program_counter = " << hex(target, 4) << ";" << std::endl;
+		out << "\t} else {" << std::endl;
+		out << "\t\tcpu.program_counter = " << hex(next, 4) << ";" << std::endl;
+		out << "\t}" << std::endl;
+		return;
+	}
+
+	// Register, flag and jump instructions
+	std::string statement;
+	if (name == "tax" || name == "tay" || name == "txa" || name == "tsx") {
+		const std::string to = (name == "txa") ? "a" : ((name == "tax" || name == "tsx") ? "x" : "y");
+		const std::string from = (name == "tsx") ? "sp" : ((name == "txa") ? "x" : "a");
+		statement = to + " = " + from + "; p = nz(p, " + to + ");";
+	} else if (name == "tya") {
+		// Like `CPU::TYA`, without touching the flags
+		statement = "a = y;";
+	} else if (name == "txs") {
+		statement = "sp = x;";
+	} else if (name == "inx" || name == "iny" || name == "dex" || name == "dey") {
+		const std::string reg = register_of(name);
+		statement = reg + ((name[0] == 'i') ? " += 1; " : " -= 1; ") + "p = nz(p, " + reg + ");";
+	} else if (name == "clc" || name == "sec") {
+		statement = (name == "clc") ? "p &= ~Flag::Carry;" : "p |= Flag::Carry;";
+	} else if (name == "cli" || name == "sei") {
+		statement = (name == "cli") ? "p &= ~Flag::InteruptDisable;" : "p |= Flag::InteruptDisable;";
+	} else if (name == "cld" || name == "sed") {
+		statement = (name == "cld") ? "p &= ~Flag::DecimalMode;" : "p |= Flag::DecimalMode;";
+	} else if (name == "clv") {
+		statement = "p &= ~Flag::Overflow;";
+	} else if (name == "jmp" && opcode.mode == AddressingMode::Absolute) {
+		statement = "cpu.program_counter = " + hex(this->operand_uint16(pc), 4) + ";";
+	} else if (name == "jsr") {
+		// Pushes the return address like `CPU::push_stack_uint16`
+		const uint16_t return_address = pc + 2;
+		statement = "memory[0x0100 + sp] = " + hex(return_address & 0xFF, 2) + "; memory[(uint16_t)(0x0100 + sp - 1)] = " +
+			hex(return_address >> 8, 2) + "; cpu.mark_dirty(0x0100); sp -= 2; cpu.program_counter = " + hex(this->operand_uint16(pc), 4) + ";";
+	}
+	if (!statement.empty() || name == "nop") {
+		if (!statement.empty()) {
+			out << "\t" << statement << std::endl;
+		}
+		out << "\tcycles += " << (int)opcode.cycles << ";" << std::endl;
+		if (last && name != "jmp" && name != "jsr") {
+			out << "\tcpu.program_counter = " << hex(next, 4) << ";" << std::endl;
+		}
+		return;
+	}
+
+	// Everything else runs through the instruction functions of the CPU, which leave the program counter at the
+	// next instruction or at the jump target
+	out << "\tSTORE_REGISTERS" << std::endl;
+	out << "\tcpu.program_counter = " << hex((uint16_t)(pc + 1), 4) << ";" << std::endl;
+	if (opcode.page_penalty) {
+		out << "\tcpu.page_crossed = 0;" << std::endl;
+	}
+	out << "\tcpu." << uppercase(opcode.name);
+	if (opcode.mode == AddressingMode::Implied || opcode.code == 0x20) {
+		out << "();" << std::endl;
+	} else {
+		out << "(AddressingMode::" << MODE_NAMES[opcode.mode] << ");" << std::endl;
+	}
+	out << "\tLOAD_REGISTERS" << std::endl;
+	out << "\tcycles += " << (int)opcode.cycles << (opcode.page_penalty ? " + (cpu.page_crossed & 1)" : "") << ";"
+		<< std::endl;
+}
+
+
+void StaticRecompiler::emit_block(std::ostream& out, const BasicBlock& block) const {
+	out << "// $" << hex(block.start, 4).substr(2) << " - $" << hex(block.end - 1, 4).substr(2) << ", "
+		<< block.instructions.size() << " instructions" << std::endl;
+	out << "void block_" << hex(block.start, 4).substr(2) << "(CPU& cpu) {" << std::endl;
+	out << "\t[[maybe_unused]] uint8_t* const memory = cpu.memory;" << std::endl;
+	out << "\tuint8_t a, x, y, sp, p;" << std::endl;
+	out << "\tuint64_t cycles;" << std::endl;
+	out << "\t[[maybe_unused]] uint16_t address, base;" << std::endl;
+	out << "\t[[maybe_unused]] uint8_t value, pointer;" << std::endl;
+	out << "\t[[maybe_unused]] bool crossed;" << std::endl;
+	out << "\tLOAD_REGISTERS" << std::endl;
+	for (size_t i = 0; i < block.instructions.size(); i++) {
+		this->emit_instruction(out, block.instructions[i], i + 1 == block.instructions.size());
+	}
+	out << "\tSTORE_REGISTERS" << std::endl;
+	out << "}" << std::endl << std::endl;
+}
+
+
+void StaticRecompiler::emit(std::ostream& out, const std::string& name) {
+	this->discover();
+
+	out << "// Recompiled by nes-emu --recompile, do not edit" << std::endl;
+	out << PRELUDE << std::endl;
+	for (const BasicBlock& block : this->blocks) {
+		this->emit_block(out, block);
+	}
+
+	// The code bytes the blocks were recompiled from, in contiguous segments
+	std::set<uint16_t> code;
+	for (const BasicBlock& block : this->blocks) {
+		for (uint32_t addr = block.start; addr < block.end; addr++) {
+			code.insert((uint16_t)addr);
+		}
+	}
+	std::vector<std::pair<uint16_t, uint32_t>> segments;
+	for (const uint16_t addr : code) {
+		if (!segments.empty() && segments.back().second == addr) {
+			segments.back().second += 1;
+		} else {
+			segments.push_back({addr, (uint32_t)addr + 1});
+		}
+	}
+	for (const std::pair<uint16_t, uint32_t>& segment : segments) {
+		out << "const uint8_t code_" << hex(segment.first, 4).substr(2) << "[] = {";
+		for (uint32_t addr = segment.first; addr < segment.second; addr++) {
+			out << (((addr - segment.first) % 16 == 0) ? "\n\t" : " ") << hex(this->image[addr], 2) << ",";
+		}
+		out << "\n};" << std::endl;
+	}
+	out << std::endl << "} // namespace" << std::endl << std::endl << std::endl;
+
+	out << "void " << name << "_run(CPU& cpu, const uint64_t deadline) {" << std::endl;
+	out << "\twhile (true) {" << std::endl;
+	out << "\t\tswitch (cpu.program_counter) {" << std::endl;
+	for (const BasicBlock& block : this->blocks) {
+		const std::string start = hex(block.start, 4);
+		out << "\t\t\tcase " << start << ":" << std::endl;
+		out << "\t\t\t\tif (cpu.cycles + " << block.budget << " >= deadline) {" << std::endl;
+		out << "\t\t\t\t\treturn;" << std::endl;
+		out << "\t\t\t\t}" << std::endl;
+		out << "\t\t\t\tblock_" << start.substr(2) << "(cpu);" << std::endl;
+		out << "\t\t\t\tbreak;" << std::endl;
+	}
+	out << "\t\t\tdefault:" << std::endl;
+	out << "\t\t\t\treturn;" << std::endl;
+	out << "\t\t}" << std::endl;
+	out << "\t}" << std::endl;
+	out << "}" << std::endl << std::endl << std::endl;
+
+	out << "bool " << name << "_matches(const CPU& cpu) {" << std::endl;
+	out << "\treturn true";
+	for (const std::pair<uint16_t, uint32_t>& segment : segments) {
+		const std::string start = hex(segment.first, 4);
+		out << std::endl << "\t\t&& std::memcmp(cpu.memory + " << start << ", code_" << start.substr(2)
+			<< ", sizeof(code_" << start.substr(2) << ")) == 0";
+	}
+	out << ";" << std::endl << "}" << std::endl;
+}
+
+
+StopReason run_recompiled(CPU& cpu, const uint64_t deadline, RecompiledProgram program) {
+	// Recompiled blocks neither stop on breakpoints nor refresh a random device between their instructions
+	if (cpu.cold->debugger != nullptr || cpu.cold->random_device != nullptr) {
+		return cpu.run_until(deadline);
+	}
+	const bool recompiled = cpu.cold->heatmap == nullptr;
+	while (cpu.cycles < deadline) {
+		if (recompiled && cpu.interrupt_pending == 0) {
+			program(cpu, deadline);
+			if (cpu.cycles >= deadline) {
+				break;
+			}
+		}
+		if (!cpu.step()) {
+			return StopReason::BreakInstruction;
+		}
+	}
+	return StopReason::BudgetExhausted;
+}
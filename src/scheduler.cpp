@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scheduler.hpp"
+
+
+Scheduler::Scheduler() {
+	this->next_sequence = 0;
+	// Devices typically keep only a few events in flight, avoid growing the heap in the common case
+	this->heap.reserve(16);
+}
+
+
+void Scheduler::set_handler(const DeviceEvent event, Handler handler) {
+	this->handlers[event] = handler;
+}
+
+
+bool Scheduler::fires_after(const PendingEvent& a, const PendingEvent& b) {
+	if (a.timestamp != b.timestamp) {
+		return a.timestamp > b.timestamp;
+	}
+	return a.sequence > b.sequence;
+}
+
+
+void Scheduler::schedule(const DeviceEvent event, const uint64_t timestamp, const uint32_t payload) {
+	this->heap.push_back({timestamp, this->next_sequence, payload, event});
+	this->next_sequence += 1;
+	std::push_heap(this->heap.begin(), this->heap.end(), Scheduler::fires_after);
+}
+
+
+void Scheduler::cancel(const DeviceEvent event) {
+	auto removed = std::remove_if(this->heap.begin(), this->heap.end(), [event](const PendingEvent& pending) {
+		return pending.event == event;
+	});
+	if (removed != this->heap.end()) {
+		this->heap.erase(removed, this->heap.end());
+		std::make_heap(this->heap.begin(), this->heap.end(), Scheduler::fires_after);
+	}
+}
+
+
+uint64_t Scheduler::next_deadline() const {
+	if (this->heap.empty()) {
+		return UINT64_MAX;
+	}
+	return this->heap.front().timestamp;
+}
+
+
+size_t Scheduler::pending() const {
+	return this->heap.size();
+}
+
+
+size_t Scheduler::dispatch_due(CPU& cpu) {
+	size_t fired = 0;
+	while (!this->heap.empty() && this->heap.front().timestamp <= cpu.cycles) {
+		// Pop before invoking the handler, it may schedule new events
+		std::pop_heap(this->heap.begin(), this->heap.end(), Scheduler::fires_after);
+		const PendingEvent due = this->heap.back();
+		this->heap.pop_back();
+
+		const Handler& handler = this->handlers[due.event];
+		if (handler) {
+			handler(cpu, due.timestamp, due.payload);
+		}
+		fired += 1;
+	}
+	return fired;
+}
+
+
+StopReason Scheduler::run(CPU& cpu, const uint64_t until) {
+	while (cpu.cycles < until) {
+		const uint64_t deadline = std::min(this->next_deadline(), until);
+		const StopReason reason = cpu.run_until(deadline);
+		if (reason != StopReason::BudgetExhausted) {
+			return reason;
+		}
+		this->dispatch_due(cpu);
+	}
+	return StopReason::BudgetExhausted;
+}
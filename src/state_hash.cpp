@@ -0,0 +1,113 @@
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "memory_storage.hpp"
+#include "mos6502.hpp"
+#include "state_hash.hpp"
+
+namespace {
+
+const size_t STRIPE_WORDS = 8;
+const size_t PAGE_WORDS = DIRTY_PAGE_SIZE / sizeof(uint64_t);
+const size_t PAGE_STRIPES = PAGE_WORDS / STRIPE_WORDS;
+
+// Keys of the words, stripe `s` uses `PAGE_KEYS[s]` - `PAGE_KEYS[s + 7]` so equal stripes at different offsets differ
+const uint64_t PAGE_KEYS[PAGE_STRIPES + STRIPE_WORDS - 1] = {
+	0xBE4BA423396CFEB8, 0x1CAD21F72C81017C, 0xDB979083E96DD4DE, 0x1F67B3B7A4A44072,
+	0x78E5C0CC4EE679CB, 0x2172FFCC7DD05A82, 0x8E2443F7744608B8, 0x4C263A81E69035E0,
+	0xCB00C391BB52283C, 0xA32E531B8B65D088, 0x4EF90DA297486471, 0xD8ACDEA946EF1938,
+	0x3F349CE33F76FAA8, 0x1D4F0BC7C7BBDCF9, 0x3159B4CD4BE0518A, 0x647378D9C97E9FC8,
+	0xC3EBD33483ACC5EA, 0xEB6313FAFFA081C5, 0x49DAF0B751DD0D17, 0x9E68D429265516D3,
+	0xFCA1477D58BE162B, 0xCE31D07AD1B8F88F, 0x280416958F3ACB45,
+};
+
+// Initial lanes, the primes of XXH3
+const uint64_t LANE_SEEDS[STRIPE_WORDS] = {
+	0x00000000C2B2AE3D, 0x9E3779B185EBCA87, 0xC2B2AE3D27D4EB4F, 0x165667B19E3779F9,
+	0x85EBCA77C2B2AE63, 0x0000000085EBCA77, 0x27D4EB2F165667C5, 0x000000009E3779B1,
+};
+
+const uint64_t STATE_SEED = 0x9FB21C651E98DF25;
+
+// Finalizer of MurmurHash3, a bijection spreading every input bit over the whole output
+uint64_t fmix64(uint64_t value) {
+	value ^= value >> 33;
+	value *= 0xFF51AFD7ED558CCD;
+	value ^= value >> 33;
+	value *= 0xC4CEB9FE1A85EC53;
+	value ^= value >> 33;
+	return value;
+}
+
+void accumulate_page(const uint8_t* page, uint64_t* lanes) {
+	#ifdef __SSE2__
+	__m128i accumulators[STRIPE_WORDS / 2];
+	for (size_t k = 0; k < STRIPE_WORDS / 2; k++) {
+		accumulators[k] = _mm_loadu_si128((const __m128i*)(LANE_SEEDS + 2*k));
+	}
+	for (size_t stripe = 0; stripe < PAGE_STRIPES; stripe++) {
+		const uint8_t* words = page + stripe * STRIPE_WORDS * sizeof(uint64_t);
+		for (size_t k = 0; k < STRIPE_WORDS / 2; k++) {
+			const __m128i data = _mm_loadu_si128((const __m128i*)(words + 16*k));
+			const __m128i key = _mm_loadu_si128((const __m128i*)(PAGE_KEYS + stripe + 2*k));
+			const __m128i keyed = _mm_xor_si128(data, key);
+			const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+			const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+			accumulators[k] = _mm_add_epi64(accumulators[k], _mm_add_epi64(product, swapped));
+		}
+	}
+	for (size_t k = 0; k < STRIPE_WORDS / 2; k++) {
+		_mm_storeu_si128((__m128i*)(lanes + 2*k), accumulators[k]);
+	}
+	#else
+	std::memcpy(lanes, LANE_SEEDS, sizeof(LANE_SEEDS));
+	for (size_t stripe = 0; stripe < PAGE_STRIPES; stripe++) {
+		for (size_t lane = 0; lane < STRIPE_WORDS; lane++) {
+			uint64_t data;
+			std::memcpy(&data, page + (stripe * STRIPE_WORDS + lane) * sizeof(uint64_t), sizeof(data));
+			const uint64_t keyed = data ^ PAGE_KEYS[stripe + lane];
+			lanes[lane ^ 1] += data;
+			lanes[lane] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+		}
+	}
+	#endif
+}
+
+} // namespace
+
+
+uint64_t hash_memory_page(const uint8_t* page) {
+	uint64_t lanes[STRIPE_WORDS];
+	accumulate_page(page, lanes);
+	uint64_t hash = DIRTY_PAGE_SIZE;
+	for (size_t lane = 0; lane < STRIPE_WORDS; lane++) {
+		hash = fmix64(hash ^ lanes[lane]);
+	}
+	return hash;
+}
+
+
+uint64_t combine_state_hash(const CPU& cpu, const uint64_t* page_hashes) {
+	const uint64_t registers = (uint64_t)cpu.program_counter | (uint64_t)cpu.stack_pointer << 16
+		| (uint64_t)cpu.register_a << 24 | (uint64_t)cpu.register_irx << 32 | (uint64_t)cpu.register_iry << 40
+		| (uint64_t)cpu.status << 48;
+	uint64_t hash = fmix64(STATE_SEED ^ registers);
+	hash = fmix64(hash ^ cpu.cycles);
+	for (size_t page = 0; page < DIRTY_PAGE_COUNT; page++) {
+		hash = fmix64(hash ^ page_hashes[page]);
+	}
+	return hash;
+}
+
+
+uint64_t hash_cpu_state(const CPU& cpu) {
+	uint64_t page_hashes[DIRTY_PAGE_COUNT];
+	for (size_t page = 0; page < DIRTY_PAGE_COUNT; page++) {
+		page_hashes[page] = hash_memory_page(cpu.memory + page * DIRTY_PAGE_SIZE);
+	}
+	return combine_state_hash(cpu, page_hashes);
+}
@@ -0,0 +1,144 @@
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "thread_pool.hpp"
+
+
+WorkStealingPool::WorkStealingPool(const unsigned int thread_count) {
+	unsigned int count = thread_count;
+	if (count == 0) {
+		count = std::thread::hardware_concurrency();
+	}
+	if (count == 0) {
+		// hardware_concurrency is allowed to return 0 when it can not be determined
+		count = 1;
+	}
+
+	this->batch_task = nullptr;
+	this->batch_id = 0;
+	this->workers_busy = 0;
+	this->stopping = false;
+
+	for (unsigned int i = 0; i < count; i++) {
+		this->queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		this->threads.emplace_back(&WorkStealingPool::worker_loop, this, i);
+	}
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> guard(this->batch_lock);
+		this->stopping = true;
+	}
+	this->batch_start.notify_all();
+
+	for (std::thread& thread : this->threads) {
+		thread.join();
+	}
+}
+
+
+unsigned int WorkStealingPool::size() const {
+	return this->threads.size();
+}
+
+
+void WorkStealingPool::run(const size_t task_count, const std::function<void(size_t, unsigned int)>& task) {
+	if (task_count == 0) {
+		return;
+	}
+
+	// Deal the tasks round-robin, neighbouring tasks tend to have similar cost so this spreads the load
+	// before any stealing has to happen.
+	const size_t worker_count = this->queues.size();
+	for (size_t i = 0; i < task_count; i++) {
+		WorkerQueue& queue = *this->queues[i % worker_count];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.tasks.push_back(i);
+	}
+
+	std::unique_lock<std::mutex> guard(this->batch_lock);
+	this->batch_task = &task;
+	this->batch_error = nullptr;
+	this->workers_busy = this->threads.size();
+	this->batch_id += 1;
+	this->batch_start.notify_all();
+
+	this->batch_done.wait(guard, [this]() { return this->workers_busy == 0; });
+	this->batch_task = nullptr;
+
+	if (this->batch_error) {
+		std::rethrow_exception(this->batch_error);
+	}
+}
+
+
+bool WorkStealingPool::next_task(const unsigned int worker, size_t& task) {
+	// Own queue first, LIFO keeps recently dealt work local
+	{
+		WorkerQueue& own = *this->queues[worker];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// Steal from the opposite end of the other queues, starting at the neighbour
+	const size_t worker_count = this->queues.size();
+	for (size_t offset = 1; offset < worker_count; offset++) {
+		WorkerQueue& victim = *this->queues[(worker + offset) % worker_count];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void WorkStealingPool::worker_loop(const unsigned int worker) {
+	size_t seen_batch = 0;
+
+	while (true) {
+		const std::function<void(size_t, unsigned int)>* task_fn;
+		{
+			std::unique_lock<std::mutex> guard(this->batch_lock);
+			this->batch_start.wait(guard, [this, seen_batch]() {
+				return this->stopping || this->batch_id != seen_batch;
+			});
+			if (this->stopping) {
+				return;
+			}
+			seen_batch = this->batch_id;
+			task_fn = this->batch_task;
+		}
+
+		size_t task;
+		while (this->next_task(worker, task)) {
+			try {
+				(*task_fn)(task, worker);
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(this->batch_lock);
+				if (!this->batch_error) {
+					this->batch_error = std::current_exception();
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(this->batch_lock);
+		this->workers_busy -= 1;
+		if (this->workers_busy == 0) {
+			this->batch_done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,142 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "test.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+struct TestCase {
+	const char* section;
+	const char* name;
+	int (*run)();
+};
+
+// CMakeLists.txt registers every `TEST_CASE` line of this table with CTest, one test per line
+#define TEST_CASE(section, function) {section, #function, function}
+
+const TestCase TESTS[] = {
+	TEST_CASE("lda", test_lda_immediate_load_state),
+	TEST_CASE("lda", test_lda_zero_flag),
+	TEST_CASE("tax", test_tax_load_state),
+	TEST_CASE("tax", test_tax_zero_flag),
+	TEST_CASE("inx", test_inx),
+	TEST_CASE("inx", test_inx_overflow),
+	TEST_CASE("iny", test_iny),
+	TEST_CASE("iny", test_iny_overflow),
+	TEST_CASE("adc", test_adc),
+	TEST_CASE("adc", test_adc_status_updates),
+	TEST_CASE("sbc", test_sbc_status_updates),
+	TEST_CASE("layout", test_cpu_layout),
+	TEST_CASE("farm", test_pool_runs_every_task_once),
+	TEST_CASE("farm", test_farm_matches_single_run),
+	TEST_CASE("scheduler", test_scheduler_event_order),
+	TEST_CASE("scheduler", test_scheduler_periodic_event),
+	TEST_CASE("scheduler", test_scheduler_64bit_clock),
+	TEST_CASE("interrupt", test_nmi_latency),
+	TEST_CASE("interrupt", test_interrupt_polling_cycle),
+	TEST_CASE("interrupt", test_irq_masking),
+	TEST_CASE("interrupt", test_nmi_hijacks_irq),
+	TEST_CASE("interrupt", test_brk_software_interrupt),
+	TEST_CASE("cycle", test_opcode_table),
+	TEST_CASE("cycle", test_page_cross_penalty),
+	TEST_CASE("cycle", test_branch_penalty),
+	TEST_CASE("profiler", test_profiler_counts),
+	TEST_CASE("profiler", test_profiler_matches_plain_run),
+	TEST_CASE("call profiler", test_call_profiler_nesting),
+	TEST_CASE("call profiler", test_call_profiler_stack_tricks),
+	TEST_CASE("call profiler", test_call_profiler_interrupts),
+	TEST_CASE("heatmap", test_heatmap_export),
+	TEST_CASE("heatmap", test_heatmap_cpu_accesses),
+	TEST_CASE("idle loop", test_idle_counted_loops),
+	TEST_CASE("idle loop", test_idle_poll_loop),
+	TEST_CASE("fusion", test_fusion_matches_plain),
+	TEST_CASE("fusion", test_fusion_dispatch_count),
+	TEST_CASE("recompiler", test_recompiler_blocks),
+	TEST_CASE("recompiler", test_recompiler_fallback),
+	TEST_CASE("disassembler", test_disassembler_modes),
+	TEST_CASE("disassembler", test_disassembler_lines),
+	TEST_CASE("assembler", test_assembler_modes),
+	TEST_CASE("assembler", test_assembler_labels),
+	TEST_CASE("assembler", test_assembler_errors),
+	TEST_CASE("assembler", test_assembler_round_trip),
+	TEST_CASE("debugger", test_debugger_breakpoints),
+	TEST_CASE("debugger", test_debugger_watchpoints),
+	TEST_CASE("gdb server", test_gdb_server_session),
+	TEST_CASE("gdb server", test_gdb_server_unattached),
+	TEST_CASE("lockstep", test_lockstep_engines_agree),
+	TEST_CASE("lockstep", test_lockstep_reports_divergence),
+	TEST_CASE("conformance", test_json_reader),
+	TEST_CASE("conformance", test_conformance_cases),
+	TEST_CASE("cpu pool", test_snapshot_restores_dirty_pages),
+	TEST_CASE("cpu pool", test_cpu_pool_reuse),
+	TEST_CASE("fuzzer", test_fuzzer_finds_planted_bugs),
+	TEST_CASE("fuzzer", test_fuzzer_executions_are_isolated),
+	TEST_CASE("movie", test_movie_playback_is_bit_exact),
+	TEST_CASE("movie", test_movie_seek),
+	TEST_CASE("movie", test_movie_segments),
+	TEST_CASE("state hash", test_state_hash_incremental),
+	TEST_CASE("state hash", test_state_hash_sensitivity),
+	TEST_CASE("random device", test_random_device_sequence),
+	TEST_CASE("random device", test_random_device_attached),
+};
+
+const size_t TEST_COUNT = sizeof(TESTS) / sizeof(TESTS[0]);
+
+void print_usage(const char* program_name) {
+	std::cerr << "Usage: " << program_name << "               run every test, section by section" << std::endl
+	          << "       " << program_name << " <test>...     run the named tests only (how CTest runs them)" << std::endl
+	          << "       " << program_name << " --list        print the name of every test" << std::endl;
+}
+
+int run_all() {
+	int total_tests = 0;
+	int tests_succeeded = 0;
+	const char* section = nullptr;
+	for (const TestCase& test : TESTS) {
+		if (section == nullptr || std::strcmp(section, test.section) != 0) {
+			const std::string header = std::string(test.section) + " tests:";
+			std::cout << (section == nullptr ? "" : "\n") << header << std::endl
+			          << std::string(header.size(), '-') << std::endl;
+			section = test.section;
+		}
+		tests_succeeded += test.run();
+		total_tests += 1;
+	}
+
+	std::cout << YELLOW << "[INFO] " << DEFAULT
+	          << tests_succeeded << "/" << total_tests
+	          << " ran succesfully." << std::endl;
+	return tests_succeeded == total_tests ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 1) {
+		return run_all();
+	}
+	if (argc == 2 && std::strcmp(argv[1], "--list") == 0) {
+		for (const TestCase& test : TESTS) {
+			std::cout << test.name << std::endl;
+		}
+		return 0;
+	}
+
+	int failed = 0;
+	for (int i = 1; i < argc; i++) {
+		const TestCase* found = nullptr;
+		for (size_t t = 0; t < TEST_COUNT; t++) {
+			if (std::strcmp(TESTS[t].name, argv[i]) == 0) {
+				found = &TESTS[t];
+			}
+		}
+		if (found == nullptr) {
+			std::cerr << "Unknown test " << argv[i] << std::endl;
+			print_usage(argv[0]);
+			return 2;
+		}
+		failed += 1 - found->run();
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -7,10 +7,11 @@
 //		- INY (Increment Y register), Mostly the same as increment X
 //------------------------------------------------------------------------
 #include "test.hpp"
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <vector>
-#include "../src/mos6502.hpp"
+#include "mos6502.hpp"
 
 #define DEFAULT         "\033[0m"
 #define RED             "\033[31m"
@@ -476,3 +477,49 @@ int test_sbc_status_updates() {
 		      << __FUNCTION__ << ": All tests passed" << std::endl;
 	return 1;
 }
+
+
+int test_cpu_layout() {
+	// The hot execution state should stay packed on a single cache line, with memory and cold state allocated
+	// separately. Adding a field to `CPU` that breaks this should be a conscious decision.
+	if (sizeof(CPU) > 64 || alignof(CPU) != 64) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": sizeof(CPU) == " << sizeof(CPU) << ", alignof(CPU) == " << alignof(CPU)
+				  << ", expected a single aligned 64 byte cache line" << std::endl;
+		return 0;
+	}
+	if (offsetof(CPU, status) >= 64 || offsetof(CPU, cycles) >= 64 || offsetof(CPU, program_counter) >= 64) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": hot registers are not on the first cache line" << std::endl;
+		return 0;
+	}
+
+	CPU cpu = CPU();
+	CPU huge_cpu = CPU(MemoryBacking::HugePages);
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(&cpu);
+	if (cpu.memory >= base && cpu.memory < base + sizeof(CPU)) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": memory space is stored inline" << std::endl;
+		return 0;
+	}
+	for (size_t i = 0; i < MEMORY_SIZE; i++) {
+		if (cpu.memory[i] != 0 || huge_cpu.memory[i] != 0) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": memory not zero initialized at " << i << std::endl;
+			return 0;
+		}
+	}
+
+	// The last address of the memory space is addressable
+	cpu.memory_write(0xFFFF, 0x42);
+	huge_cpu.memory_write_uint16(0xFFFE, 0x1234);
+	if (cpu.memory_read(0xFFFF) != 0x42 || huge_cpu.memory_read_uint16(0xFFFE) != 0x1234) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": could not read back the top of the memory space" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
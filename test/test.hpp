@@ -1,5 +1,22 @@
 #pragma once
 // Functions for unit testing
+#include <iostream>
+#include <string>
+#include "mos6502.hpp"
+
+// Report a failed check of `test`, returns false so a test can keep going with `passed = fail(...)`
+inline bool fail(const char* test, const std::string& message) {
+    std::cout << "\033[31m" << "[FAIL]: " << "\033[0m"
+              << test << ": " << message << std::endl;
+    return false;
+}
+
+// Registers and master clock of both CPUs are equal, memory is not compared
+inline bool same_state(const CPU& a, const CPU& b) {
+    return a.cycles == b.cycles && a.program_counter == b.program_counter && a.stack_pointer == b.stack_pointer
+        && a.register_a == b.register_a && a.register_irx == b.register_irx && a.register_iry == b.register_iry
+        && a.status == b.status;
+}
 
 // TODO: Write unit tests for testing the different addressing modes
 // TODO: Write unit tests for AND
@@ -32,3 +49,99 @@ int test_inx_overflow();
 // iny
 int test_iny();
 int test_iny_overflow();
+
+// cpu layout
+int test_cpu_layout();
+
+// farm
+int test_pool_runs_every_task_once();
+int test_farm_matches_single_run();
+
+// scheduler
+int test_scheduler_event_order();
+int test_scheduler_periodic_event();
+int test_scheduler_64bit_clock();
+
+// interrupts
+int test_nmi_latency();
+int test_interrupt_polling_cycle();
+int test_irq_masking();
+int test_nmi_hijacks_irq();
+int test_brk_software_interrupt();
+
+// cycles
+int test_opcode_table();
+int test_page_cross_penalty();
+int test_branch_penalty();
+
+// profiler
+int test_profiler_counts();
+int test_profiler_matches_plain_run();
+
+// call profiler
+int test_call_profiler_nesting();
+int test_call_profiler_stack_tricks();
+int test_call_profiler_interrupts();
+
+// heatmap
+int test_heatmap_export();
+int test_heatmap_cpu_accesses();
+
+// idle loops
+int test_idle_counted_loops();
+int test_idle_poll_loop();
+
+// fusion
+int test_fusion_matches_plain();
+int test_fusion_dispatch_count();
+
+// recompiler
+int test_recompiler_blocks();
+int test_recompiler_fallback();
+
+// disassembler
+int test_disassembler_modes();
+int test_disassembler_lines();
+
+// assembler
+int test_assembler_modes();
+int test_assembler_labels();
+int test_assembler_errors();
+int test_assembler_round_trip();
+
+// debugger
+int test_debugger_breakpoints();
+int test_debugger_watchpoints();
+
+// gdb server
+int test_gdb_server_session();
+int test_gdb_server_unattached();
+
+// lockstep
+int test_lockstep_engines_agree();
+int test_lockstep_reports_divergence();
+
+// conformance
+int test_json_reader();
+int test_conformance_cases();
+
+// cpu pool
+int test_snapshot_restores_dirty_pages();
+int test_cpu_pool_reuse();
+
+// fuzzer
+int test_fuzzer_finds_planted_bugs();
+int test_fuzzer_executions_are_isolated();
+
+// movie
+int test_movie_playback_is_bit_exact();
+int test_movie_seek();
+int test_movie_segments();
+
+// state hash
+int test_state_hash_incremental();
+int test_state_hash_sensitivity();
+
+// random device
+int test_random_device_sequence();
+int test_random_device_attached();
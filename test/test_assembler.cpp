@@ -0,0 +1,187 @@
+#include "test.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "assembler.hpp"
+#include "disassembler.hpp"
+#include "mos6502.hpp"
+#include "programs.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+bool expect_bytes(const char* test, const std::string& source, const std::vector<uint8_t>& expected) {
+	const AssembledProgram program = assemble(source);
+	if (program.bytes != expected) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << test << ": `" << source << "` assembled to " << program.bytes.size() << " bytes:" << std::hex;
+		for (const uint8_t byte : program.bytes) {
+			std::cout << " " << (int)byte;
+		}
+		std::cout << std::dec << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool expect_error(const char* test, const std::string& source, const std::string& prefix) {
+	try {
+		assemble(source);
+	} catch (const std::runtime_error& error) {
+		if (std::string(error.what()).rfind(prefix, 0) == 0) {
+			return true;
+		}
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << test << ": `" << source << "` failed with `" << error.what() << "`" << std::endl;
+		return false;
+	}
+	std::cout << RED << "[FAIL]: " << DEFAULT
+		      << test << ": `" << source << "` did not fail" << std::endl;
+	return false;
+}
+
+} // namespace
+
+int test_assembler_modes() {
+	bool passed = true;
+	passed &= expect_bytes(__FUNCTION__, "nop", {0xEA});
+	passed &= expect_bytes(__FUNCTION__, "LDA #$0F", {0xA9, 0x0F});
+	passed &= expect_bytes(__FUNCTION__, "lda #-1", {0xA9, 0xFF});
+	passed &= expect_bytes(__FUNCTION__, "lsr a", {0x4A});
+	passed &= expect_bytes(__FUNCTION__, "lsr", {0x4A});
+	passed &= expect_bytes(__FUNCTION__, "lda $10", {0xA5, 0x10});
+	passed &= expect_bytes(__FUNCTION__, "lda $10 , x", {0xB5, 0x10});
+	passed &= expect_bytes(__FUNCTION__, "ldx $10,Y", {0xB6, 0x10});
+	// Wide hex literals force absolute addressing
+	passed &= expect_bytes(__FUNCTION__, "lda $0010", {0xAD, 0x10, 0x00});
+	passed &= expect_bytes(__FUNCTION__, "lda $0200,X", {0xBD, 0x00, 0x02});
+	// `lda zp,Y` does not exist, so zero page operands fall back to absolute
+	passed &= expect_bytes(__FUNCTION__, "lda $10,Y", {0xB9, 0x10, 0x00});
+	passed &= expect_bytes(__FUNCTION__, "jmp ($FFFC)", {0x6C, 0xFC, 0xFF});
+	passed &= expect_bytes(__FUNCTION__, "lda ($20,X)", {0xA1, 0x20});
+	passed &= expect_bytes(__FUNCTION__, "lda ($20),Y", {0xB1, 0x20});
+	passed &= expect_bytes(__FUNCTION__, "loop: bne loop", {0xD0, 0xFE});
+	passed &= expect_bytes(__FUNCTION__, "lda #'A' ; comment; with ';'", {0xA9, 0x41});
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_assembler_labels() {
+	const std::string source =
+		"screen = $0200\n"
+		"pointer = $10\n"
+		"start:\n"
+		"    lda #<screen        ; zero page pointer to the screen\n"
+		"    sta pointer\n"
+		"    lda #>screen\n"
+		"    sta pointer+1\n"
+		"    ldy #0\n"
+		"fill: lda data,Y        ; forward reference, absolute\n"
+		"    sta (pointer),Y\n"
+		"    iny\n"
+		"    bne fill\n"
+		"    jmp end\n"
+		"data: .byte 1, $02, %11, \"hi\"\n"
+		"    .word start, *\n"
+		"end: brk\n"
+		"    .org $FFFC\n"
+		"    .word start\n";
+	const std::vector<uint8_t> expected = {
+		0xA9, 0x00, 0x85, 0x10, 0xA9, 0x02, 0x85, 0x11, 0xA0, 0x00,
+		0xB9, 0x15, 0x06, 0x91, 0x10, 0xC8, 0xD0, 0xF8, 0x4C, 0x1E, 0x06,
+		0x01, 0x02, 0x03, 0x68, 0x69, 0x00, 0x06, 0x1A, 0x06, 0x00,
+	};
+	const AssembledProgram program = assemble(source);
+
+	// The `.org` section extends the image up to the reset vector, with zeroes in between
+	bool passed = program.origin == 0x0600 && program.bytes.size() == 0xFFFE - 0x0600
+		&& std::vector<uint8_t>(program.bytes.begin(), program.bytes.begin() + expected.size()) == expected
+		&& program.bytes[expected.size()] == 0x00
+		&& program.bytes[0xFFFC - 0x0600] == 0x00 && program.bytes[0xFFFD - 0x0600] == 0x06
+		&& program.labels.at("fill") == 0x060A && program.labels.at("end") == 0x061E
+		&& program.labels.count("screen") == 0;
+	if (!passed) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": unexpected image or labels" << std::endl;
+		return 0;
+	}
+
+	// The loaded program copies its data to the screen
+	CPU cpu = CPU();
+	load_assembled(cpu, program);
+	cpu.reset();
+	if (cpu.run_for(100000) != StopReason::BreakInstruction || cpu.memory[0x0200] != 0x01 || cpu.memory[0x0203] != 'h' || cpu.memory[0x0206] != 0x06) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": program did not run as expected" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_assembler_errors() {
+	bool passed = true;
+	passed &= expect_error(__FUNCTION__, "nop\nfoo $10", "line 2: unknown instruction");
+	passed &= expect_error(__FUNCTION__, "lda missing", "line 1: undefined label");
+	passed &= expect_error(__FUNCTION__, "a: nop\na: nop", "line 2: `a` is already defined");
+	passed &= expect_error(__FUNCTION__, "jmp $10,X", "line 1: `jmp` does not support");
+	passed &= expect_error(__FUNCTION__, "lda #$100", "line 1: value 256 out of range");
+	passed &= expect_error(__FUNCTION__, "stx $0200,X", "line 1: `stx` does not support");
+	passed &= expect_error(__FUNCTION__, "start: .byte 0\n.org $0700\nbne start", "line 3: branch target");
+	passed &= expect_error(__FUNCTION__, ".org later\nlater: nop", "line 1: `later` has to be defined");
+	passed &= expect_error(__FUNCTION__, "lda $10 +", "line 1: missing value");
+	passed &= expect_error(__FUNCTION__, ".include \"x\"", "line 1: unknown directive");
+
+	try {
+		CPU cpu = CPU();
+		load_assembled(cpu, assemble("; nothing here"));
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": loading an empty program did not fail" << std::endl;
+		passed = false;
+	} catch (const std::out_of_range&) {
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_assembler_round_trip() {
+	// The disassembler listing of the snake game assembles back into the same bytes
+	CPU cpu = CPU();
+	cpu.load_program(SNAKE_PROGRAM);
+	std::string source;
+	char text[DISASSEMBLY_LENGTH];
+	for (uint32_t addr = 0x0600; addr < 0x0600 + SNAKE_PROGRAM.size();) {
+		addr += disassemble(cpu.memory, (uint16_t)addr, text);
+		source += text;
+		source += '\n';
+	}
+
+	const AssembledProgram program = assemble(source);
+	if (program.origin != 0x0600 || program.bytes.size() < SNAKE_PROGRAM.size()
+		|| !std::equal(SNAKE_PROGRAM.begin(), SNAKE_PROGRAM.end(), program.bytes.begin())) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": snake did not assemble back into the same bytes" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
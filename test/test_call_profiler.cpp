@@ -0,0 +1,128 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "call_profiler.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_call_profiler_nesting() {
+	// JSR outer, BRK; outer: JSR inner, RTS; inner: INX, RTS
+	CPU cpu = CPU();
+	cpu.load_program({0x20, 0x08, 0x06, 0x00, 0xEA, 0xEA, 0xEA, 0xEA, 0x20, 0x0C, 0x06, 0x60, 0xE8, 0x60});
+	cpu.reset();
+	CallProfiler profiler;
+	profiler.set_label(0x0608, "outer");
+	cpu.run_until(1000, profiler);
+	profiler.finish(cpu);
+
+	// JSR (6) at the top level, JSR (6) and RTS (6) in outer, INX (2) and RTS (6) in inner
+	const std::vector<CallProfiler::Node>& nodes = profiler.nodes();
+	if (nodes.size() != 3 || nodes[0].inclusive_cycles != 26 || nodes[0].exclusive_cycles != 6
+		|| nodes[1].routine != 0x0608 || nodes[1].inclusive_cycles != 20 || nodes[1].exclusive_cycles != 12
+		|| nodes[2].routine != 0x060C || nodes[2].parent != 1 || nodes[2].inclusive_cycles != 8
+		|| nodes[2].exclusive_cycles != 8) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong inclusive or exclusive cycles in the calling context tree" << std::endl;
+		return 0;
+	}
+
+	std::ostringstream folded;
+	profiler.write_folded(folded);
+	if (folded.str() != "program 6\nprogram;outer 12\nprogram;outer;sub_060C 8\n") {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong folded stacks:" << std::endl << folded.str();
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_call_profiler_stack_tricks() {
+	// A routine jumping through a pushed address with RTS stays on the shadow stack
+	// JSR sub, BRK; sub: LDA #$0D, PHA, LDA #$06, PHA, RTS; $060E: BRK (same byte order as push_stack_uint16)
+	CPU cpu = CPU();
+	cpu.load_program({0x20, 0x04, 0x06, 0x00, 0xA9, 0x0D, 0x48, 0xA9, 0x06, 0x48, 0x60, 0xEA, 0xEA, 0xEA, 0x00});
+	cpu.reset();
+	CallProfiler profiler;
+	cpu.run_until(1000, profiler);
+	if (cpu.program_counter != 0x060E || profiler.depth() != 1) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": RTS through a pushed address left the routine, depth "
+				  << profiler.depth() << std::endl;
+		return 0;
+	}
+
+	// A routine dropping its return address with PLA leaves the shadow stack
+	// JSR sub, BRK; sub: PLA, PLA, BRK
+	CPU dropping = CPU();
+	dropping.load_program({0x20, 0x04, 0x06, 0x00, 0x68, 0x68, 0x00});
+	dropping.reset();
+	CallProfiler dropped;
+	dropping.run_until(1000, dropped);
+	dropped.finish(dropping);
+	const std::vector<CallProfiler::RoutineTotals> routines = dropped.routines();
+	if (dropping.program_counter != 0x0606 || dropped.depth() != 0 || routines.size() != 1 || routines[0].calls != 1
+		|| dropped.nodes()[0].exclusive_cycles != 6 + 4) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": dropping the return address did not leave the routine" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_call_profiler_interrupts() {
+	// JSR loop; loop: NOP, NOP, NOP, JMP loop. NMI handler: JSR $0710, RTI; $0710: INX, RTS
+	CPU cpu = CPU();
+	cpu.load_program({0x20, 0x08, 0x06, 0x00, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0xEA, 0x4C, 0x08, 0x06});
+	cpu.memory_write(0x0700, 0x20);
+	cpu.memory_write_uint16(0x0701, 0x0710);
+	cpu.memory_write(0x0703, 0x40);
+	cpu.memory_write(0x0710, 0xE8);
+	cpu.memory_write(0x0711, 0x60);
+	cpu.memory_write_uint16(0xFFFA, 0x0700);
+	cpu.reset();
+
+	CallProfiler profiler;
+	cpu.step(profiler); // JSR
+	cpu.set_nmi_line(true);
+	cpu.step(profiler); // NOP
+	cpu.step(profiler); // Interrupt sequence
+	if (profiler.depth() != 2) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": the interrupt did not push a frame" << std::endl;
+		return 0;
+	}
+	for (int i = 0; i < 4; i++) {
+		cpu.step(profiler); // JSR, INX, RTS, RTI
+	}
+	if (profiler.depth() != 1 || cpu.program_counter != 0x0609) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": RTI did not end the handler frame" << std::endl;
+		return 0;
+	}
+
+	// The 7 cycle sequence, JSR (6) and RTI (6) in the handler, INX (2) and RTS (6) in the subroutine
+	std::ostringstream folded;
+	profiler.write_folded(folded);
+	if (folded.str() != "program;sub_0608;nmi_0700 19\nprogram;sub_0608;nmi_0700;sub_0710 8\n") {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong folded stacks:" << std::endl << folded.str();
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
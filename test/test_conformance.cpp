@@ -0,0 +1,152 @@
+#include "test.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "conformance.hpp"
+#include "json_reader.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+// LDA #$23 and INX passing, then an INX whose expected accumulator is wrong
+const std::string CASES =
+	"[\n"
+	"  {\"name\": \"a9 23 00\", \"initial\": {\"pc\": 512, \"s\": 253, \"a\": 0, \"x\": 0, \"y\": 0, \"p\": 36,\n"
+	"     \"ram\": [[512, 169], [513, 35]]},\n"
+	"   \"final\": {\"pc\": 514, \"s\": 253, \"a\": 35, \"x\": 0, \"y\": 0, \"p\": 36, \"ram\": [[512, 169], [513, 35]]},\n"
+	"   \"cycles\": [[512, 169, \"read\"], [513, 35, \"read\"]]},\n"
+	"  {\"name\": \"e8 00 00\", \"initial\": {\"pc\": 4660, \"s\": 1, \"a\": 7, \"x\": 127, \"y\": 9, \"p\": 36,\n"
+	"     \"ram\": [[4660, 232]]},\n"
+	"   \"final\": {\"pc\": 4661, \"s\": 1, \"a\": 7, \"x\": 128, \"y\": 9, \"p\": 164, \"ram\": [[4660, 232]]},\n"
+	"   \"cycles\": [[4660, 232, \"read\"], [4661, null, \"read\"]], \"notes\": {\"ignored\": [1, 2.5e3, true]}},\n"
+	"  {\"name\": \"e8 bad\", \"initial\": {\"pc\": 0, \"s\": 0, \"a\": 1, \"x\": 0, \"y\": 0, \"p\": 36, \"ram\": [[0, 232]]},\n"
+	"   \"final\": {\"pc\": 1, \"s\": 0, \"a\": 2, \"x\": 1, \"y\": 0, \"p\": 36, \"ram\": [[0, 232]]},\n"
+	"   \"cycles\": [[0, 232, \"read\"], [1, 0, \"read\"]]}\n"
+	"]\n";
+
+bool throws(const std::string& document) {
+	std::istringstream in(document);
+	JsonReader reader(in);
+	try {
+		reader.skip_value();
+		return !reader.at_end();
+	} catch (const std::runtime_error&) {
+		return true;
+	}
+}
+
+} // namespace
+
+int test_json_reader() {
+	bool passed = true;
+
+	std::istringstream in(" {\"text\": \"a\\\"b\\n\\u00e9\", \"list\": [-12, 0, 9007199254740993], \"skip\": {\"x\": [null, false]},"
+		" \"flag\": true, \"empty\": []} ");
+	JsonReader reader(in);
+	std::string key;
+	std::vector<std::string> keys;
+	reader.begin_object();
+	while (reader.next_key(key)) {
+		keys.push_back(key);
+		if (key == "text" && reader.read_string() != "a\"b\n\xC3\xA9") {
+			passed = fail(__FUNCTION__, "the escapes were not resolved");
+		} else if (key == "list") {
+			std::vector<int64_t> values;
+			reader.begin_array();
+			while (reader.next_element()) {
+				values.push_back(reader.read_integer());
+			}
+			if (values != std::vector<int64_t>{-12, 0, 9007199254740993}) {
+				passed = fail(__FUNCTION__, "the integers were not read");
+			}
+		} else if (key == "flag" && !reader.read_bool()) {
+			passed = fail(__FUNCTION__, "the boolean was not read");
+		} else if (key == "skip" || key == "empty") {
+			reader.skip_value();
+		}
+	}
+	if (keys != std::vector<std::string>{"text", "list", "skip", "flag", "empty"} || !reader.at_end()) {
+		passed = fail(__FUNCTION__, "the members were not visited in order");
+	}
+
+	// Documents larger than the read buffer are streamed through it
+	std::ostringstream large;
+	large << "[";
+	for (int i = 0; i < 100000; i++) {
+		large << (i == 0 ? "" : ", ") << i;
+	}
+	large << "]";
+	std::istringstream large_in(large.str());
+	JsonReader large_reader(large_in);
+	int64_t sum = 0;
+	int64_t count = 0;
+	large_reader.begin_array();
+	while (large_reader.next_element()) {
+		sum += large_reader.read_integer();
+		count += 1;
+	}
+	if (count != 100000 || sum != (int64_t)99999 * 100000 / 2) {
+		passed = fail(__FUNCTION__, "the large document was not read across buffer boundaries");
+	}
+
+	if (!throws("[1, 2") || !throws("[1 2]") || !throws("{\"a\" 1}") || !throws("\"\\q\"") || !throws("[1] 2")
+		|| !throws("tru") || throws("[1, {\"a\": [2.5e-3]}]")) {
+		passed = fail(__FUNCTION__, "malformed documents were not rejected");
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_conformance_cases() {
+	bool passed = true;
+	CPU cpu = CPU();
+	std::vector<std::string> mismatches;
+	std::istringstream in(CASES);
+	const uint64_t cases = for_each_conformance_case(in, [&cpu, &mismatches](const ConformanceCase& test_case) {
+		mismatches.push_back(run_conformance_case(cpu, test_case));
+	});
+	if (cases != 3 || mismatches.size() != 3 || !mismatches[0].empty() || !mismatches[1].empty()
+		|| mismatches[2] != "A $01, expected $02") {
+		passed = fail(__FUNCTION__, "the cases were not run as expected");
+	}
+	if (cpu.memory[512] != 0 || cpu.memory[513] != 0 || cpu.memory[4660] != 0) {
+		passed = fail(__FUNCTION__, "the memory of the cases was left behind");
+	}
+
+	// Files run in parallel and are reported per opcode, undocumented opcodes are skipped
+	const std::string directory = "/tmp/nes-emu-conformance-" + std::to_string(::getpid());
+	std::filesystem::create_directories(directory);
+	std::ofstream(directory + "/02.json") << "[]";
+	std::ofstream(directory + "/e8.json") << CASES;
+	std::vector<std::string> paths = conformance_files(directory);
+	paths.push_back(directory + "/a9.json");
+	const std::vector<ConformanceResult> results = run_conformance(paths, 2);
+	if (results.size() != 3 || !results[0].skipped || results[0].opcode != 0x02
+		|| results[1].skipped || results[1].opcode != 0xE8 || results[1].cases != 3 || results[1].failed != 1
+		|| results[1].first_failure != "\"e8 bad\": A $01, expected $02"
+		|| results[2].first_failure != "could not open the file") {
+		passed = fail(__FUNCTION__, "the files were not reported per opcode");
+	}
+	std::filesystem::remove_all(directory);
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
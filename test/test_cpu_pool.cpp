@@ -0,0 +1,163 @@
+#include "test.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "cpu_pool.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+// Writes to the zero page, the stack and $2345, leaving $42 in A
+const std::vector<uint8_t> SCRIBBLE_PROGRAM = {
+	0xA9, 0x42, // LDA #$42
+	0x85, 0x10, // STA $10
+	0x8D, 0x45, 0x23, // STA $2345
+	0x48, // PHA
+	0x00
+};
+
+bool memory_is_zero(const CPU& cpu) {
+	for (size_t i = 0; i < MEMORY_SIZE; i++) {
+		if (cpu.memory[i] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int test_snapshot_restores_dirty_pages() {
+	// Only the pages written since the snapshot are tracked, restoring brings back memory and registers
+	CPU cpu = CPU();
+	cpu.load_program(SCRIBBLE_PROGRAM);
+	cpu.reset();
+	CPUSnapshot snapshot;
+	cpu.save_snapshot(snapshot);
+
+	cpu.run_for(1000);
+	const uint64_t expected_dirty = ((uint64_t)1 << 0) | ((uint64_t)1 << (0x2345 / DIRTY_PAGE_SIZE));
+	if (cpu.dirty_pages != expected_dirty) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": dirty pages " << std::hex << cpu.dirty_pages << ", expected " << expected_dirty
+				  << std::dec << std::endl;
+		return 0;
+	}
+
+	cpu.restore_snapshot(snapshot);
+	if (cpu.dirty_pages != 0 || std::memcmp(cpu.memory, snapshot.memory.data(), MEMORY_SIZE) != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": memory does not match the snapshot after a restore" << std::endl;
+		return 0;
+	}
+	if (cpu.program_counter != 0x0600 || cpu.register_a != 0 || cpu.stack_pointer != 0xFF || cpu.cycles != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": registers were not restored" << std::endl;
+		return 0;
+	}
+
+	// Restoring runs again from the same state
+	cpu.run_for(1000);
+	if (cpu.register_a != 0x42 || cpu.memory[0x2345] != 0x42) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": restored CPU did not run the program again" << std::endl;
+		return 0;
+	}
+
+	// A CPU that was never in sync with the snapshot gets the full memory space
+	CPU other = CPU();
+	other.memory_write(0x8000, 0x99);
+	other.restore_snapshot(snapshot);
+	if (std::memcmp(other.memory, snapshot.memory.data(), MEMORY_SIZE) != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": restoring a foreign snapshot did not copy the full memory space" << std::endl;
+		return 0;
+	}
+
+	try {
+		other.restore_snapshot(CPUSnapshot());
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": restoring an unsaved snapshot did not throw" << std::endl;
+		return 0;
+	} catch (const std::invalid_argument&) {
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_cpu_pool_reuse() {
+	// Returned instances are handed out again in the template state
+	CPUPool pool;
+	for (int i = 0; i < 50; i++) {
+		PooledCPU cpu = pool.acquire();
+		if (!memory_is_zero(*cpu) || cpu->cycles != 0 || cpu->register_a != 0 || !cpu->halt_on_brk) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": acquired CPU " << i << " is not in its power-on state" << std::endl;
+			return 0;
+		}
+		cpu->load_program(SCRIBBLE_PROGRAM);
+		cpu->reset();
+		cpu->run_for(1000);
+	}
+	if (pool.created() != 1 || pool.idle() != 1) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << pool.created() << " instances created for sequential use" << std::endl;
+		return 0;
+	}
+
+	// A template with the program loaded
+	CPU loaded = CPU();
+	loaded.load_program(SCRIBBLE_PROGRAM);
+	loaded.reset();
+	pool.set_template(loaded);
+	{
+		PooledCPU first = pool.acquire();
+		PooledCPU second = pool.acquire();
+		first->run_for(1000);
+		second->run_for(1000);
+		if (first->register_a != 0x42 || second->memory[0x2345] != 0x42 || pool.created() != 2) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": instances do not start from the new template" << std::endl;
+			return 0;
+		}
+	}
+
+	// Borrowed from several threads at once
+	std::atomic<int> wrong(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&pool, &wrong]() {
+			for (int i = 0; i < 200; i++) {
+				PooledCPU cpu = pool.acquire();
+				if (cpu->memory[0x2345] != 0 || cpu->memory[0x0600] != 0xA9) {
+					wrong += 1;
+				}
+				cpu->run_for(1000);
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	if (wrong != 0 || pool.created() > 4 || pool.idle() != pool.created()) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << wrong << " dirty instances handed out, " << pool.created()
+				  << " instances for 4 threads" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,132 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+struct StepResult {
+	uint64_t cycles;
+	uint16_t program_counter;
+};
+
+/**
+ * Execute the first instruction of `program` with the X and Y registers preset and report the cycles it took and
+ * where the program counter ended up.
+ */
+static StepResult step_once(const std::vector<uint8_t>& program, const uint8_t x, const uint8_t y, const uint8_t status) {
+	CPU cpu = CPU();
+	cpu.load_program(program);
+	cpu.reset();
+	cpu.register_irx = x;
+	cpu.register_iry = y;
+	cpu.status = status;
+	cpu.step();
+	return {cpu.cycles, cpu.program_counter};
+}
+
+static int expect_step(const char* function, const char* name, const StepResult result,
+					   const uint64_t cycles, const uint16_t program_counter) {
+	if (result.cycles != cycles || result.program_counter != program_counter) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << function << ": " << name << " took " << result.cycles << " cycles to $"
+				  << std::hex << result.program_counter << std::dec << ", expected " << cycles << " cycles to $"
+				  << std::hex << program_counter << std::dec << std::endl;
+		return 0;
+	}
+	return 1;
+}
+
+int test_opcode_table() {
+	// Every documented opcode has a size matching its addressing mode, only read instructions with indexed
+	// addressing carry a page-cross penalty
+	int documented = 0;
+	for (size_t i = 0; i < OPCODE_COUNT; i++) {
+		const Opcode& opcode = OPCODES[i];
+		if (opcode.code != i) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": OPCODES[" << i << "] holds opcode " << (int)opcode.code << std::endl;
+			return 0;
+		}
+		if (opcode.size == 0) {
+			continue;
+		}
+		documented += 1;
+
+		uint8_t expected_size = 1;
+		switch (opcode.mode) {
+			case AddressingMode::Implied:
+			case AddressingMode::Accumulator: expected_size = 1; break;
+			case AddressingMode::Absolute:
+			case AddressingMode::AbsoluteX:
+			case AddressingMode::AbsoluteY:
+			case AddressingMode::Indirect: expected_size = 3; break;
+			default: expected_size = 2; break;
+		}
+		const bool indexed = opcode.mode == AddressingMode::AbsoluteX || opcode.mode == AddressingMode::AbsoluteY
+			|| opcode.mode == AddressingMode::IndirectY;
+		if (opcode.size != expected_size || (opcode.page_penalty && !indexed)) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": inconsistent entry for " << opcode.name << " ($" << std::hex
+					  << (int)opcode.code << std::dec << ")" << std::endl;
+			return 0;
+		}
+	}
+	if (documented != 151) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << documented << " documented opcodes, expected 151" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_page_cross_penalty() {
+	// Read instructions pay one cycle when indexing crosses a page, stores and read-modify-write instructions always
+	// pay the worst case
+	int passed = 1;
+	passed &= expect_step(__FUNCTION__, "LDA $02F0,X", step_once({0xBD, 0xF0, 0x02}, 0x0F, 0, 0), 4, 0x0603);
+	passed &= expect_step(__FUNCTION__, "LDA $02F0,X crossing", step_once({0xBD, 0xF0, 0x02}, 0x10, 0, 0), 5, 0x0603);
+	passed &= expect_step(__FUNCTION__, "CMP $02F0,Y", step_once({0xD9, 0xF0, 0x02}, 0, 0x01, 0), 4, 0x0603);
+	passed &= expect_step(__FUNCTION__, "CMP $02F0,Y crossing", step_once({0xD9, 0xF0, 0x02}, 0, 0x20, 0), 5, 0x0603);
+	passed &= expect_step(__FUNCTION__, "ADC $02F0,X", step_once({0x7D, 0xF0, 0x02}, 0x01, 0, 0), 4, 0x0603);
+	passed &= expect_step(__FUNCTION__, "STA $02F0,X", step_once({0x9D, 0xF0, 0x02}, 0x01, 0, 0), 5, 0x0603);
+	passed &= expect_step(__FUNCTION__, "STA $02F0,X crossing", step_once({0x9D, 0xF0, 0x02}, 0x10, 0, 0), 5, 0x0603);
+	passed &= expect_step(__FUNCTION__, "INC $02F0,X crossing", step_once({0xFE, 0xF0, 0x02}, 0x10, 0, 0), 7, 0x0603);
+
+	// ($10),Y with the pointer at $10 being zero: the base is $0000
+	passed &= expect_step(__FUNCTION__, "LDA ($10),Y", step_once({0xB1, 0x10}, 0, 0xFF, 0), 5, 0x0602);
+	passed &= expect_step(__FUNCTION__, "STA ($10),Y", step_once({0x91, 0x10}, 0, 0xFF, 0), 6, 0x0602);
+	if (!passed) {
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_branch_penalty() {
+	// Branches take 2 cycles when not taken, 3 when taken and 4 when the target is on another page
+	int passed = 1;
+	passed &= expect_step(__FUNCTION__, "BNE not taken", step_once({0xD0, 0x10}, 0, 0, Flag::Zero), 2, 0x0602);
+	passed &= expect_step(__FUNCTION__, "BNE taken", step_once({0xD0, 0x10}, 0, 0, 0), 3, 0x0612);
+	passed &= expect_step(__FUNCTION__, "BNE backwards", step_once({0xD0, 0xFE}, 0, 0, 0), 3, 0x0600);
+	passed &= expect_step(__FUNCTION__, "BNE to previous page", step_once({0xD0, 0xF0}, 0, 0, 0), 4, 0x05F2);
+	passed &= expect_step(__FUNCTION__, "BMI taken", step_once({0x30, 0x04}, 0, 0, Flag::Negative), 3, 0x0606);
+	passed &= expect_step(__FUNCTION__, "BPL not taken", step_once({0x10, 0x04}, 0, 0, Flag::Negative), 2, 0x0602);
+	passed &= expect_step(__FUNCTION__, "BVC taken", step_once({0x50, 0x04}, 0, 0, 0), 3, 0x0606);
+	if (!passed) {
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
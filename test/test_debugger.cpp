@@ -0,0 +1,153 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "assembler.hpp"
+#include "debugger.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+const std::string COUNTER_SOURCE =
+	"    ldx #0\n"
+	"loop: lda $0200\n"
+	"    inx\n"
+	"store: stx $10\n"
+	"    cpx #5\n"
+	"    bne loop\n"
+	"    brk\n";
+
+} // namespace
+
+int test_debugger_breakpoints() {
+	const AssembledProgram program = assemble(COUNTER_SOURCE);
+	const uint16_t store = program.labels.at("store");
+	CPU cpu = CPU();
+	CPU reference = CPU();
+	load_assembled(cpu, program);
+	load_assembled(reference, program);
+	cpu.reset();
+	reference.reset();
+
+	Debugger debugger = Debugger();
+	cpu.attach_debugger(&debugger);
+	debugger.add_breakpoint(store);
+
+	// Every pass through the loop stops before the store, in the state plain stepping reaches
+	bool passed = true;
+	for (uint8_t x = 1; x <= 5; x++) {
+		while (reference.step() && reference.program_counter != store) {
+		}
+		const StopReason reason = cpu.run_until(10000);
+		if (reason != StopReason::Breakpoint || debugger.hit.pc != store || cpu.register_irx != x
+			|| !same_state(cpu, reference)) {
+			passed = fail(__FUNCTION__, "pass " + std::to_string(x) + " did not stop at the breakpoint");
+		}
+	}
+	if (cpu.run_until(10000) != StopReason::BreakInstruction || cpu.register_irx != 5) {
+		passed = fail(__FUNCTION__, "the run did not continue to the BRK");
+	}
+
+	// A conditional breakpoint only stops when the register holds the value
+	cpu.reset();
+	debugger.remove_breakpoint(store);
+	debugger.add_breakpoint(store, {DebugRegister::RegisterX, 4});
+	if (cpu.run_until(10000) != StopReason::Breakpoint || cpu.register_irx != 4
+		|| cpu.run_until(10000) != StopReason::BreakInstruction) {
+		passed = fail(__FUNCTION__, "the conditional breakpoint did not stop once");
+	}
+
+	// A condition on its own stops on any instruction
+	cpu.reset();
+	debugger.clear();
+	debugger.add_condition({DebugRegister::RegisterX, 3});
+	if (cpu.run_until(10000) != StopReason::Breakpoint || cpu.program_counter != store || cpu.register_irx != 3) {
+		passed = fail(__FUNCTION__, "the register condition did not stop after the INX");
+	}
+
+	// Detached, the CPU runs through
+	cpu.reset();
+	cpu.attach_debugger(nullptr);
+	if (cpu.cold->debugger != nullptr || cpu.run_until(10000) != StopReason::BreakInstruction) {
+		passed = fail(__FUNCTION__, "the detached debugger still stopped the run");
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_debugger_watchpoints() {
+	const AssembledProgram program = assemble(COUNTER_SOURCE);
+	CPU cpu = CPU();
+	load_assembled(cpu, program);
+	cpu.memory[0x0200] = 0x42;
+	cpu.reset();
+	bool passed = true;
+
+	{
+		Debugger debugger = Debugger();
+		cpu.attach_debugger(&debugger);
+		debugger.add_watchpoint(0x0010, 0x0010, DebugAccess::WriteAccess);
+		debugger.add_watchpoint(0x0200, 0x02FF, DebugAccess::ReadAccess);
+
+		// The read stops right after the LDA, with the value it read
+		const uint16_t after_load = program.labels.at("loop") + 3;
+		if (cpu.run_until(10000) != StopReason::Watchpoint || debugger.hit.access != DebugAccess::ReadAccess
+			|| debugger.hit.address != 0x0200 || debugger.hit.value != 0x42 || debugger.hit.pc != after_load
+			|| cpu.program_counter != after_load || cpu.register_a != 0x42 || cpu.register_irx != 0) {
+			passed = fail(__FUNCTION__, "the read watchpoint did not stop after the load");
+		}
+		// Then the write of the STX, after the store
+		if (cpu.run_until(10000) != StopReason::Watchpoint || debugger.hit.access != DebugAccess::WriteAccess
+			|| debugger.hit.address != 0x0010 || debugger.hit.value != 1
+			|| cpu.program_counter != program.labels.at("store") + 2 || cpu.memory[0x0010] != 1) {
+			passed = fail(__FUNCTION__, "the write watchpoint did not stop after the store");
+		}
+
+		// Unwatched accesses on a flagged page do not stop
+		debugger.remove_watchpoint(0x0010, 0x0010, DebugAccess::WriteAccess);
+		debugger.remove_watchpoint(0x0200, 0x02FF, DebugAccess::ReadAccess);
+		debugger.add_watchpoint(0x0011, 0x0011, DebugAccess::ReadAccess | DebugAccess::WriteAccess);
+		if (cpu.run_until(10000) != StopReason::BreakInstruction || cpu.memory[0x0010] != 5) {
+			passed = fail(__FUNCTION__, "an unwatched address on a watched page stopped the run");
+		}
+	}
+
+	// Pushes and pulls are watched on the stack page
+	{
+		const AssembledProgram subroutine = assemble("jsr sub\nbrk\nsub: rts\n");
+		load_assembled(cpu, subroutine);
+		cpu.reset();
+		Debugger debugger = Debugger();
+		cpu.attach_debugger(&debugger);
+		debugger.add_watchpoint(0x01FE, 0x01FF, DebugAccess::ReadAccess | DebugAccess::WriteAccess);
+		const StopReason pushed = cpu.run_until(10000);
+		const DebugHit push = debugger.hit;
+		const StopReason pulled = cpu.run_until(10000);
+		if (pushed != StopReason::Watchpoint || push.access != DebugAccess::WriteAccess
+			|| push.pc != subroutine.labels.at("sub") || pulled != StopReason::Watchpoint
+			|| debugger.hit.access != DebugAccess::ReadAccess || debugger.hit.pc != 0x0603
+			|| cpu.run_until(10000) != StopReason::BreakInstruction) {
+			passed = fail(__FUNCTION__, "the JSR / RTS did not stop on the watched stack slots");
+		}
+	}
+
+	// The debugger went out of scope and detached itself
+	if (cpu.cold->debugger != nullptr) {
+		passed = fail(__FUNCTION__, "the destroyed debugger is still attached");
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
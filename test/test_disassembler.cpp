@@ -0,0 +1,96 @@
+#include "test.hpp"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "disassembler.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+bool expect_disassembly(const char* test, CPU& cpu, const std::vector<uint8_t>& bytes, const uint16_t addr,
+                        const std::string& expected, const size_t expected_size) {
+	for (size_t i = 0; i < bytes.size(); i++) {
+		cpu.memory[(uint16_t)(addr + i)] = bytes[i];
+	}
+	char text[DISASSEMBLY_LENGTH];
+	const size_t size = disassemble(cpu.memory, addr, text);
+	if (expected != text || size != expected_size) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << test << ": expected `" << expected << "` (" << expected_size << " bytes), got `" << text
+			      << "` (" << size << " bytes)" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+int test_disassembler_modes() {
+	CPU cpu = CPU();
+	bool passed = true;
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xEA}, 0x0600, "nop", 1);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xA9, 0x0F}, 0x0600, "lda #$0F", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0x4A}, 0x0600, "lsr A", 1);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xA5, 0x10}, 0x0600, "lda $10", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xB5, 0x10}, 0x0600, "lda $10,X", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xB6, 0x10}, 0x0600, "ldx $10,Y", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xAD, 0x34, 0x12}, 0x0600, "lda $1234", 3);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xBD, 0x00, 0x02}, 0x0600, "lda $0200,X", 3);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xB9, 0xFF, 0x02}, 0x0600, "lda $02FF,Y", 3);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0x6C, 0xFC, 0xFF}, 0x0600, "jmp ($FFFC)", 3);
+	// The indexed indirect modes take a zero page pointer, two digits wide
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xA1, 0x20}, 0x0600, "lda ($20,X)", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xB1, 0x20}, 0x0600, "lda ($20),Y", 2);
+	// Branches show their target, backwards and forwards
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0xD0, 0xFE}, 0x0600, "bne $0600", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0x10, 0x7F}, 0x0600, "bpl $0681", 2);
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0x02}, 0x0600, ".byte $02", 1);
+	// Operand bytes wrap around the end of the address space
+	passed &= expect_disassembly(__FUNCTION__, cpu, {0x4C, 0x00, 0x06}, 0xFFFF, "jmp $0600", 3);
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_disassembler_lines() {
+	CPU cpu = CPU();
+	cpu.load_program({0xA2, 0x08, 0x9D, 0x00, 0x02, 0x02, 0xCA, 0x00});
+	const std::vector<std::string> expected = {
+		"$0600: A2 08     ldx #$08",
+		"$0602: 9D 00 02  sta $0200,X",
+		"$0605: 02        .byte $02",
+		"$0606: CA        dex",
+		"$0607: 00        brk",
+	};
+
+	// Walking the listing by the returned sizes visits every instruction
+	char line[DISASSEMBLY_LINE_LENGTH];
+	uint16_t addr = 0x0600;
+	for (const std::string& text : expected) {
+		addr += disassemble_line(cpu.memory, addr, line);
+		if (text != line || std::strlen(line) >= DISASSEMBLY_LINE_LENGTH) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": expected `" << text << "`, got `" << line << "`" << std::endl;
+			return 0;
+		}
+	}
+	if (addr != 0x0608) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": listing ended at $" << std::hex << addr << std::dec << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,96 @@
+#include "test.hpp"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "farm.hpp"
+#include "mos6502.hpp"
+#include "thread_pool.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_pool_runs_every_task_once() {
+	// Every task index of a batch should be executed exactly once, also over multiple batches
+	WorkStealingPool pool(4);
+	std::vector<std::atomic<int>> counters(1000);
+
+	for (int batch = 0; batch < 3; batch++) {
+		pool.run(counters.size(), [&counters](size_t task, unsigned int) {
+			counters[task] += 1;
+		});
+	}
+
+	for (size_t i = 0; i < counters.size(); i++) {
+		if (counters[i] != 3) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": task " << i << " executed " << counters[i] << " times instead of 3"
+					  << std::endl;
+			return 0;
+		}
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_farm_matches_single_run() {
+	// Running a program on the farm should give the same end state as running it on a fresh CPU, even when the
+	// worker CPU was dirtied by another program first
+	std::vector<uint8_t> dirty = {
+		0xA9, 0xFF, // LDA #$FF
+		0x85, 0x10, // STA $10
+		0x8D, 0x00, 0x02, // STA $0200
+		0x48, // PHA
+		0x00
+	};
+	std::vector<uint8_t> counter = {
+		0xA2, 0x00, // LDX #$00
+		0xE8, // INX
+		0x86, 0x20, // STX $20
+		0x4C, 0x02, 0x06, // JMP $0602
+	};
+
+	CPU reference = CPU();
+	reference.load_program(counter);
+	reference.reset();
+	reference.run_for(5000);
+	const uint64_t expected_hash = hash_cpu_state(reference);
+
+	std::vector<FarmJob> jobs;
+	for (int i = 0; i < 8; i++) {
+		jobs.push_back({"dirty", dirty, 1000});
+		jobs.push_back({"counter", counter, 5000});
+	}
+
+	Farm farm(2);
+	const std::vector<FarmResult> results = farm.run(jobs);
+
+	for (size_t i = 1; i < results.size(); i += 2) {
+		if (results[i].name != "counter" || results[i].state_hash != expected_hash) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": result " << i << " does not match the reference run"
+					  << std::endl;
+			return 0;
+		}
+		if (results[i].stop_reason != StopReason::BudgetExhausted || results[i].cycles != reference.cycles) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": result " << i << " did not stop on its budget"
+					  << std::endl;
+			return 0;
+		}
+	}
+	if (results[0].stop_reason != StopReason::BreakInstruction || results[0].exit_pc != 0x0608) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": dirty program did not stop on its BRK"
+				  << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,105 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+// Every fused sequence, with page crossing indexed loads and a loop counter crossing from negative to positive
+const std::vector<uint8_t> FUSION_PROGRAM = {
+	0xA2, 0x90,       // LDX #$90
+	0xBD, 0x80, 0x10, // LDA $1080,X (crosses a page)
+	0x9D, 0x00, 0x20, // STA $2000,X
+	0xA5, 0x10,       // LDA $10
+	0x18,             // CLC
+	0x65, 0x11,       // ADC $11
+	0x85, 0x10,       // STA $10
+	0xC9, 0x40,       // CMP #$40
+	0xD0, 0x02,       // BNE +2
+	0xA9, 0x00,       // LDA #$00
+	0xA0, 0x00,       // LDY #$00
+	0xC8,             // INY
+	0xC0, 0x05,       // CPY #$05
+	0xD0, 0xFB,       // BNE $0617
+	0xE8,             // INX
+	0xE0, 0xF8,       // CPX #$F8
+	0xCA,             // DEX
+	0xCA,             // DEX
+	0xD0, 0xDF,       // BNE $0602
+	0x00,
+};
+
+int test_fusion_matches_plain() {
+	CPU plain = CPU();
+	plain.load_program(FUSION_PROGRAM);
+	plain.memory_write(0x0011, 0x07);
+	plain.reset();
+	CPU fused = CPU();
+	fused.load_program(FUSION_PROGRAM);
+	fused.memory_write(0x0011, 0x07);
+	fused.reset();
+	fused.fuse_instructions = true;
+
+	// Deadlines every few cycles land in the middle of most superinstructions
+	uint64_t deadline = 0;
+	StopReason reason = StopReason::BudgetExhausted;
+	while (reason == StopReason::BudgetExhausted) {
+		deadline += 3;
+		reason = plain.run_until(deadline);
+		if (fused.run_until(deadline) != reason || fused.cycles != plain.cycles
+			|| fused.program_counter != plain.program_counter || fused.status != plain.status
+			|| fused.register_a != plain.register_a || fused.register_irx != plain.register_irx
+			|| fused.register_iry != plain.register_iry) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": diverged from plain interpretation at deadline " << deadline << std::endl;
+			return 0;
+		}
+	}
+	for (uint16_t addr = 0x2000; addr < 0x2100; addr++) {
+		if (fused.memory_read(addr) != plain.memory_read(addr) || fused.memory_read(0x10) != plain.memory_read(0x10)) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": memory differs at $" << std::hex << addr << std::dec << std::endl;
+			return 0;
+		}
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_fusion_dispatch_count() {
+	// LDX #$05, DEX, BNE, BRK: 11 instructions, the 5 DEX / BNE pairs take one dispatch each
+	CPU cpu = CPU();
+	cpu.load_program({0xA2, 0x05, 0xCA, 0xD0, 0xFD, 0x00});
+	cpu.reset();
+	cpu.fuse_instructions = true;
+	if (cpu.run_until(1000) != StopReason::BreakInstruction || cpu.cycles != 26
+		|| cpu.cold->fusion_instructions != 11 || cpu.cold->fusion_dispatches != 6) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << cpu.cold->fusion_instructions << " instructions in "
+				  << cpu.cold->fusion_dispatches << " dispatches, expected 11 in 6" << std::endl;
+		return 0;
+	}
+
+	// A pending (masked) IRQ keeps every instruction on its own dispatch
+	CPU masked = CPU();
+	masked.load_program({0x78, 0xA2, 0x05, 0xCA, 0xD0, 0xFD, 0x00}); // SEI first
+	masked.reset();
+	masked.fuse_instructions = true;
+	masked.set_irq_line(InterruptSource::ExternalIrq, true);
+	masked.run_until(1000);
+	if (masked.cold->fusion_instructions != 12 || masked.cold->fusion_dispatches != 12) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": instructions were fused while an interrupt was pending" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,115 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "fuzzer.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+// Polls the key byte, `w` ends in a jump to itself and `a` runs into an invalid opcode. Compares with `EOR`, as `CMP`
+// leaves a zero flag set by the load in place
+const std::vector<uint8_t> PLANTED_BUGS_PROGRAM = {
+	0xA5, 0xFF, // $0600 LDA $FF
+	0x49, 0x77, // $0602 EOR #$77
+	0xD0, 0x03, // $0604 BNE $0609
+	0x4C, 0x06, 0x06, // $0606 JMP $0606
+	0x49, 0x16, // $0609 EOR #$16, zero when the key was $61
+	0xD0, 0x01, // $060B BNE $060E
+	0x02, // $060D invalid
+	0x4C, 0x00, 0x06, // $060E JMP $0600
+};
+
+bool has_finding(const Fuzzer& fuzzer, const FuzzOutcome outcome, const uint16_t pc) {
+	for (const FuzzFinding& finding : fuzzer.findings()) {
+		if (finding.outcome == outcome && finding.pc == pc) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+int test_fuzzer_finds_planted_bugs() {
+	// Both bugs are behind a key press the seed input never makes
+	Fuzzer fuzzer(PLANTED_BUGS_PROGRAM, {2000, 16, 7});
+	if (!fuzzer.findings().empty()) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": the seed input alone produced a finding" << std::endl;
+		return 0;
+	}
+	fuzzer.run(20000);
+	if (!has_finding(fuzzer, FuzzInfiniteLoop, 0x0606) || !has_finding(fuzzer, FuzzInvalidOpcode, 0x060D)) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": planted bugs not found in " << fuzzer.executions() << " executions, "
+				  << fuzzer.findings().size() << " findings" << std::endl;
+		return 0;
+	}
+	const uint64_t total = fuzzer.outcomes()[FuzzHalted] + fuzzer.outcomes()[FuzzBudgetExhausted]
+		+ fuzzer.outcomes()[FuzzInfiniteLoop] + fuzzer.outcomes()[FuzzInvalidOpcode] + fuzzer.outcomes()[FuzzException];
+	if (total != fuzzer.executions() || fuzzer.executions() != 20001) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << total << " outcomes counted for " << fuzzer.executions() << " executions"
+				  << std::endl;
+		return 0;
+	}
+
+	// The same seed finds the same inputs
+	Fuzzer again(PLANTED_BUGS_PROGRAM, {2000, 16, 7});
+	again.run(20000);
+	if (again.corpus().size() != fuzzer.corpus().size() || again.findings().size() != fuzzer.findings().size()
+		|| again.edges() != fuzzer.edges()) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": two runs with the same seed differ" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_fuzzer_executions_are_isolated() {
+	// Takes the invalid opcode path when $2000 is set, which only a previous execution could have done
+	const std::vector<uint8_t> program = {
+		0xAD, 0x00, 0x20, // LDA $2000
+		0xD0, 0x06, // BNE $060B
+		0xA9, 0x01, // LDA #$01
+		0x8D, 0x00, 0x20, // STA $2000
+		0x00, // BRK
+		0x02, // invalid
+	};
+	Fuzzer fuzzer(program, {1000, 64, 1});
+	const size_t corpus = fuzzer.corpus().size();
+	for (int i = 0; i < 3; i++) {
+		if (fuzzer.execute({program, {}, 1}) != FuzzHalted) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": execution " << i << " saw memory written by an earlier one" << std::endl;
+			return 0;
+		}
+	}
+	if (fuzzer.corpus().size() != corpus || fuzzer.edges() == 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": repeated input grew the corpus, or no edges recorded" << std::endl;
+		return 0;
+	}
+
+	try {
+		fuzzer.execute({{0xEA}, {}, 1});
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": input of another length did not throw" << std::endl;
+		return 0;
+	} catch (const std::invalid_argument&) {
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
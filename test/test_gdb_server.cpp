@@ -0,0 +1,246 @@
+#include "test.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "assembler.hpp"
+#include "gdb_server.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+const std::string COUNTER_SOURCE =
+	"    ldx #0\n"
+	"loop: lda $0200\n"
+	"    inx\n"
+	"store: stx $10\n"
+	"    cpx #5\n"
+	"    bne loop\n"
+	"    brk\n";
+
+std::string socket_path(const char* name) {
+	return "/tmp/nes-emu-" + std::string(name) + "-" + std::to_string(::getpid()) + ".sock";
+}
+
+int connect_client(const std::string& path) {
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+	if (fd < 0 || ::connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+		return -1;
+	}
+	// Never hang the test run on a missing reply
+	timeval timeout = {5, 0};
+	::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	return fd;
+}
+
+// Send a packet and return the payload of the reply, after its acknowledgement
+std::string exchange(const int fd, const std::string& payload, const bool expect_reply = true) {
+	const char* digits = "0123456789abcdef";
+	uint8_t checksum = 0;
+	for (const char c : payload) {
+		checksum += c;
+	}
+	const std::string packet = "$" + payload + "#" + digits[checksum >> 4] + digits[checksum & 0xF];
+	if (::send(fd, packet.data(), packet.size(), MSG_NOSIGNAL) != (ssize_t)packet.size()) {
+		return "<send failed>";
+	}
+
+	std::string reply;
+	bool in_packet = false;
+	char c;
+	while (::recv(fd, &c, 1, 0) == 1) {
+		if (!in_packet) {
+			if (c == '+' && !expect_reply) {
+				return "+";
+			}
+			in_packet = (c == '$');
+		} else if (c == '#') {
+			char checksum_digits[2];
+			if (::recv(fd, checksum_digits, 2, MSG_WAITALL) != 2 || ::send(fd, "+", 1, MSG_NOSIGNAL) != 1) {
+				break;
+			}
+			return reply;
+		} else {
+			reply += c;
+		}
+	}
+	return "<no reply>";
+}
+
+// Send the same packet `count` times in a single write, then count the replies equal to `expected`
+int pipeline(const int fd, const std::string& payload, const int count, const std::string& expected) {
+	const char* digits = "0123456789abcdef";
+	uint8_t checksum = 0;
+	for (const char c : payload) {
+		checksum += c;
+	}
+	std::string packets;
+	for (int i = 0; i < count; i++) {
+		packets += "$" + payload + "#" + digits[checksum >> 4] + digits[checksum & 0xF];
+	}
+	if (::send(fd, packets.data(), packets.size(), MSG_NOSIGNAL) != (ssize_t)packets.size()) {
+		return 0;
+	}
+
+	int matching = 0;
+	std::string reply;
+	bool in_packet = false;
+	char c;
+	for (int replies = 0; replies < count && ::recv(fd, &c, 1, 0) == 1;) {
+		if (!in_packet) {
+			in_packet = (c == '$');
+		} else if (c == '#') {
+			char checksum_digits[2];
+			if (::recv(fd, checksum_digits, 2, MSG_WAITALL) != 2) {
+				break;
+			}
+			matching += (reply == expected);
+			replies += 1;
+			reply.clear();
+			in_packet = false;
+		} else {
+			reply += c;
+		}
+	}
+	return matching;
+}
+
+} // namespace
+
+int test_gdb_server_session() {
+	const AssembledProgram program = assemble(COUNTER_SOURCE);
+	const uint16_t store = program.labels.at("store");
+	char store_hex[5];
+	std::snprintf(store_hex, sizeof(store_hex), "%04x", store);
+	char store_le[5];
+	std::snprintf(store_le, sizeof(store_le), "%02x%02x", store & 0xFF, store >> 8);
+
+	CPU cpu = CPU();
+	load_assembled(cpu, program);
+	cpu.reset();
+	const std::string path = socket_path(__FUNCTION__);
+	GdbServer server(cpu, path);
+	bool passed = true;
+
+	const int client = connect_client(path);
+	for (int i = 0; i < 1000 && !server.client_connected(); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (client < 0 || !server.client_connected()) {
+		return fail(__FUNCTION__, "the client could not connect");
+	}
+
+	// The emulation thread drives the CPU in frames, the target halts as soon as it sees the client
+	StopReason reason = StopReason::BudgetExhausted;
+	std::thread emulation([&server, &cpu, &reason]() {
+		for (int frame = 0; frame < 1000 && reason == StopReason::BudgetExhausted; frame++) {
+			reason = server.run_until(cpu.cycles + CYCLES_PER_FRAME);
+		}
+	});
+
+	const std::string steps[][2] = {
+		{"qSupported:swbreak+", "PacketSize=1000"},
+		{"?", "S05"},
+		{std::string("Z0,") + store_hex + ",1", "OK"},
+		{"c", "S05"},
+		// A X Y P SP PC, stopped before the first store
+		{"p1", "01"},
+		{"p5", store_le},
+		{"m0010,1", "00"},
+		{"s", "S05"},
+		{"m0010,1", "01"},
+		{"M0010,2:0709", "OK"},
+		{"m0010,2", "0709"},
+		{"P1=04", "OK"},
+		{std::string("z0,") + store_hex + ",1", "OK"},
+		{"Z2,0010,1", "OK"},
+		{"c", "T05watch:0010;"},
+		{"p1", "05"},
+		{"z2,0010,1", "OK"},
+		{"c", "W00"},
+	};
+	// Far more packets in one write than both queues hold, the server drains replies while the commands back up
+	const int pipelined = pipeline(client, "?", 300, "S05");
+	if (pipelined != 300) {
+		passed = fail(__FUNCTION__, "only " + std::to_string(pipelined) + " of 300 pipelined packets were answered");
+	}
+	for (size_t i = 0; passed && i < sizeof(steps) / sizeof(steps[0]); i++) {
+		const auto& step = steps[i];
+		const std::string reply = exchange(client, step[0]);
+		if (reply != step[1]) {
+			passed = fail(__FUNCTION__, "'" + step[0] + "' was answered with '" + reply + "' instead of '" + step[1] + "'");
+			break;
+		}
+	}
+	if (!passed) {
+		// Let the emulation thread run out
+		::close(client);
+	}
+	emulation.join();
+	if (passed) {
+		::close(client);
+	}
+
+	if (reason != StopReason::BreakInstruction || cpu.memory[0x0010] != 5 || cpu.register_irx != 5
+		|| cpu.cold->debugger != nullptr) {
+		passed = fail(__FUNCTION__, "the program did not run to its BRK with the debugger detached");
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_gdb_server_unattached() {
+	const AssembledProgram program = assemble(COUNTER_SOURCE);
+	CPU cpu = CPU();
+	CPU reference = CPU();
+	load_assembled(cpu, program);
+	load_assembled(reference, program);
+	cpu.reset();
+	reference.reset();
+	bool passed = true;
+
+	// Without a client the server only hands over to the CPU
+	{
+		GdbServer server(cpu, socket_path(__FUNCTION__));
+		const StopReason reason = server.run_until(100000);
+		if (reason != reference.run_until(100000) || cpu.cycles != reference.cycles
+			|| cpu.program_counter != reference.program_counter || cpu.memory[0x0010] != reference.memory[0x0010]
+			|| cpu.cold->debugger != nullptr) {
+			passed = fail(__FUNCTION__, "the run without a client differs from a plain run");
+		}
+	}
+
+	// A socket path that does not fit is refused
+	try {
+		GdbServer server(cpu, "/tmp/" + std::string(200, 'x'));
+		passed = fail(__FUNCTION__, "an overlong socket path was accepted");
+	} catch (const std::runtime_error&) {
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,96 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "heatmap.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_heatmap_export() {
+	MemoryHeatmap heatmap;
+	heatmap.record_read(0x0010);
+	heatmap.record_read(0x0010);
+	heatmap.record_write(0x0011);
+	heatmap.record_execute(0x0600);
+
+	std::ostringstream csv;
+	heatmap.write_csv(csv, false);
+	if (csv.str() != "address,reads,writes,executes\n$0010,2,0,0\n$0011,0,1,0\n$0600,0,0,1\n") {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong per address CSV:" << std::endl << csv.str();
+		return 0;
+	}
+	std::ostringstream pages;
+	heatmap.write_csv(pages, true);
+	if (pages.str() != "page,reads,writes,executes\n$00,2,1,0\n$06,0,0,1\n" || heatmap.page_accesses(0x00) != 3) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong per page CSV:" << std::endl << pages.str();
+		return 0;
+	}
+
+	// Header followed by 256 x 256 RGB pixels, the hottest read at full green
+	std::ostringstream image;
+	heatmap.write_image(image);
+	const std::string header = "P6\n256 256\n255\n";
+	const std::string pixels = image.str();
+	if (pixels.size() != header.size() + 3 * 0x10000 || pixels.compare(0, header.size(), header) != 0
+		|| (uint8_t)pixels[header.size() + 3 * 0x0010 + 1] != 255 || pixels[header.size() + 3 * 0x0020 + 1] != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong image" << std::endl;
+		return 0;
+	}
+
+	heatmap.clear();
+	if (heatmap.page_accesses(0x00) != 0 || heatmap.executes[0x0600] != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": clear did not reset the counters" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_heatmap_cpu_accesses() {
+	// LDA $10, STA $11, BRK
+	CPU cpu = CPU();
+	cpu.load_program({0xA5, 0x10, 0x85, 0x11, 0x00});
+	cpu.reset();
+	MemoryHeatmap heatmap;
+
+	if (!HEATMAP_SUPPORTED) {
+		// Without the hooks attaching has to fail loudly instead of producing an empty heatmap
+		try {
+			cpu.attach_heatmap(&heatmap);
+		} catch (const std::runtime_error&) {
+			std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+				      << __FUNCTION__ << ": All tests passed (build without heatmap hooks)" << std::endl;
+			return 1;
+		}
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": attaching a heatmap without the hooks did not throw" << std::endl;
+		return 0;
+	}
+
+	cpu.attach_heatmap(&heatmap);
+	cpu.run_until(100);
+	cpu.attach_heatmap(nullptr);
+	if (heatmap.executes[0x0600] != 1 || heatmap.executes[0x0602] != 1 || heatmap.reads[0x0600] != 0
+		|| heatmap.reads[0x0601] != 1 || heatmap.reads[0x0010] != 1 || heatmap.writes[0x0011] != 1) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong read, write or execute counters" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
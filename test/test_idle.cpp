@@ -0,0 +1,107 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+#include "scheduler.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_idle_counted_loops() {
+	// LDX #$00; NOP, NOP, DEX, BNE (the snake delay loop); LDY #$F0; INY, BNE; LDX #$03; LDA $10, DEX, BNE;
+	// STA $20, DEX, BNE (writes memory, not idle); BRK
+	const std::vector<uint8_t> program = {
+		0xA2, 0x00, 0xEA, 0xEA, 0xCA, 0xD0, 0xFB, 0xA0, 0xF0, 0xC8, 0xD0, 0xFD,
+		0xA2, 0x03, 0xA5, 0x10, 0xCA, 0xD0, 0xFB, 0x85, 0x20, 0xCA, 0xD0, 0xFB, 0x00,
+	};
+	CPU plain = CPU();
+	plain.load_program(program);
+	plain.reset();
+	CPU skipping = CPU();
+	skipping.load_program(program);
+	skipping.reset();
+	skipping.skip_idle_loops = true;
+	CPU fused = CPU();
+	fused.load_program(program);
+	fused.reset();
+	fused.skip_idle_loops = true;
+	fused.fuse_instructions = true;
+
+	// Stop at many different deadlines, the skipping CPU has to stop on the same instruction boundaries
+	uint64_t deadline = 0;
+	StopReason reason = StopReason::BudgetExhausted;
+	while (reason == StopReason::BudgetExhausted) {
+		deadline += 97;
+		reason = plain.run_until(deadline);
+		if (skipping.run_until(deadline) != reason || !same_state(plain, skipping)
+			|| fused.run_until(deadline) != reason || !same_state(plain, fused)) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": diverged from plain interpretation at deadline " << deadline << std::endl;
+			return 0;
+		}
+	}
+	if (skipping.cold->idle_iterations_skipped == 0 || fused.cold->idle_iterations_skipped == 0 || skipping.memory_read(0x20) != plain.memory_read(0x20)) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": no iterations were skipped" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+/**
+ * Poll `$10` until a DMA event writes it, while NMIs (handler: INY, RTI) hit the loop every 3000 cycles
+ */
+static StopReason run_poll_program(CPU& cpu) {
+	// LDA $10, BEQ; LDX #$01; BRK
+	cpu.load_program({0xA5, 0x10, 0xF0, 0xFC, 0xA2, 0x01, 0x00});
+	cpu.memory_write(0x0700, 0xC8); // INY
+	cpu.memory_write(0x0701, 0x40); // RTI
+	cpu.memory_write_uint16(0xFFFA, 0x0700);
+	cpu.reset();
+
+	Scheduler scheduler;
+	scheduler.set_handler(DeviceEvent::DmaEvent, [](CPU& cpu, uint64_t, uint32_t) {
+		cpu.memory_write(0x10, 0x01);
+	});
+	scheduler.set_handler(DeviceEvent::NmiEvent, [&scheduler](CPU& cpu, uint64_t timestamp, uint32_t) {
+		cpu.set_nmi_line(true, timestamp);
+		cpu.set_nmi_line(false, timestamp);
+		scheduler.schedule(DeviceEvent::NmiEvent, timestamp + 3000);
+	});
+	scheduler.schedule(DeviceEvent::NmiEvent, 3000);
+	scheduler.schedule(DeviceEvent::DmaEvent, 100000);
+	return scheduler.run(cpu, 1000000);
+}
+
+int test_idle_poll_loop() {
+	CPU plain = CPU();
+	const StopReason plain_reason = run_poll_program(plain);
+	CPU skipping = CPU();
+	skipping.skip_idle_loops = true;
+	const StopReason skipping_reason = run_poll_program(skipping);
+
+	if (plain_reason != StopReason::BreakInstruction || skipping_reason != plain_reason
+		|| !same_state(plain, skipping) || skipping.register_iry != 33) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": diverged from plain interpretation, " << skipping.cycles << " cycles vs "
+				  << plain.cycles << std::endl;
+		return 0;
+	}
+	// The loop takes 6 cycles per iteration, nearly all of the 100000 cycles should have been skipped
+	if (skipping.cold->idle_iterations_skipped < 15000) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": only " << skipping.cold->idle_iterations_skipped << " iterations skipped"
+				  << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
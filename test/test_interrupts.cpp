@@ -0,0 +1,235 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+/**
+ * Load an endless NOP loop at `0x0600` with an NMI handler (INX, RTI) at `0x0700` and an IRQ/BRK handler (INY, RTI)
+ * at `0x0710`.
+ */
+static void load_interrupt_program(CPU& cpu) {
+	cpu.load_program({0xEA, 0xEA, 0xEA, 0x4C, 0x00, 0x06});
+	cpu.memory_write(0x0700, 0xE8); // INX
+	cpu.memory_write(0x0701, 0x40); // RTI
+	cpu.memory_write(0x0710, 0xC8); // INY
+	cpu.memory_write(0x0711, 0x40); // RTI
+	cpu.memory_write_uint16(0xFFFA, 0x0700);
+	cpu.memory_write_uint16(0xFFFE, 0x0710);
+	cpu.reset();
+}
+
+int test_nmi_latency() {
+	// An NMI raised on an instruction boundary lets the current instruction finish, then takes 7 cycles to enter
+	// the handler. Returning with RTI resumes the interrupted program.
+	CPU cpu = CPU();
+	load_interrupt_program(cpu);
+	cpu.step();
+	cpu.step();
+
+	const uint64_t raised_at = cpu.cycles;
+	cpu.set_nmi_line(true);
+	cpu.step(); // NOP at 0x0602 still executes
+	if (cpu.program_counter != 0x0603) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": NMI serviced before the current instruction finished" << std::endl;
+		return 0;
+	}
+	cpu.step(); // Interrupt sequence
+	if (cpu.program_counter != 0x0700 || cpu.cycles - raised_at != 2 + 7) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": handler entered after " << cpu.cycles - raised_at << " cycles, expected 9"
+				  << std::endl;
+		return 0;
+	}
+	if ((cpu.status & Flag::InteruptDisable) == 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": InteruptDisable not set in the handler" << std::endl;
+		return 0;
+	}
+
+	cpu.step(); // INX
+	cpu.step(); // RTI
+	if (cpu.program_counter != 0x0603 || cpu.register_irx != 1 || (cpu.status & Flag::InteruptDisable) != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": RTI did not restore the interrupted state" << std::endl;
+		return 0;
+	}
+
+	// Edge triggered, holding the line does not retrigger
+	for (int i = 0; i < 10; i++) {
+		cpu.step();
+	}
+	if (cpu.register_irx != 1) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": NMI retriggered while the line was held" << std::endl;
+		return 0;
+	}
+	cpu.set_nmi_line(false);
+	cpu.set_nmi_line(true);
+	for (int i = 0; i < 10; i++) {
+		cpu.step();
+	}
+	if (cpu.register_irx != 2) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": second NMI edge was not serviced" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_interrupt_polling_cycle() {
+	// Lines are sampled before the last cycle of an instruction: an NMI raised during the final cycle of the previous
+	// instruction is delayed by one more instruction, one raised a cycle earlier is serviced right away
+	CPU cpu = CPU();
+	load_interrupt_program(cpu);
+	cpu.step();
+	cpu.set_nmi_line(true, cpu.cycles - 1);
+	cpu.step();
+	if (cpu.program_counter != 0x0602) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": NMI raised in the last cycle was not delayed" << std::endl;
+		return 0;
+	}
+
+	CPU early = CPU();
+	load_interrupt_program(early);
+	early.step();
+	const uint64_t boundary = early.cycles;
+	early.set_nmi_line(true, boundary - 2);
+	early.step();
+	if (early.program_counter != 0x0700 || early.cycles != boundary + 7) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": NMI raised before the last cycle was not serviced immediately" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_irq_masking() {
+	// IRQ is level triggered and masked by the InteruptDisable flag
+	CPU cpu = CPU();
+	load_interrupt_program(cpu);
+	cpu.update_flag(Flag::InteruptDisable, Mode::Set);
+	cpu.set_irq_line(InterruptSource::ApuFrameIrq, true);
+	for (int i = 0; i < 10; i++) {
+		cpu.step();
+	}
+	if (cpu.register_iry != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": masked IRQ was serviced" << std::endl;
+		return 0;
+	}
+
+	cpu.update_flag(Flag::InteruptDisable, Mode::Clear);
+	const uint64_t unmasked_at = cpu.cycles;
+	cpu.step();
+	if (cpu.program_counter != 0x0710 || cpu.cycles != unmasked_at + 7) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": unmasked IRQ was not serviced on the next boundary" << std::endl;
+		return 0;
+	}
+
+	// Still asserted after RTI, so the handler runs again. A second source keeps the line low after the first drops.
+	cpu.set_irq_line(InterruptSource::MapperIrq, true);
+	cpu.step(); // INY
+	cpu.step(); // RTI
+	cpu.set_irq_line(InterruptSource::ApuFrameIrq, false);
+	cpu.step(); // Serviced again
+	cpu.step(); // INY
+	cpu.step(); // RTI
+	cpu.set_irq_line(InterruptSource::MapperIrq, false);
+	for (int i = 0; i < 10; i++) {
+		cpu.step();
+	}
+	if (cpu.register_iry != 2) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": IRQ handler ran " << (int)cpu.register_iry << " times, expected 2" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_nmi_hijacks_irq() {
+	// An NMI raised before the vector fetch of an IRQ sequence takes over the sequence, one raised later waits until
+	// the next instruction boundary
+	CPU cpu = CPU();
+	load_interrupt_program(cpu);
+	cpu.step();
+	cpu.set_irq_line(InterruptSource::ExternalIrq, true, cpu.cycles - 2);
+	const uint64_t sequence_start = cpu.cycles;
+	cpu.step();
+	cpu.set_irq_line(InterruptSource::ExternalIrq, false);
+	cpu.set_nmi_line(true, sequence_start + 2);
+	if (cpu.program_counter != 0x0700 || cpu.interrupt_pending != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": IRQ sequence was not hijacked by the NMI" << std::endl;
+		return 0;
+	}
+
+	CPU late = CPU();
+	load_interrupt_program(late);
+	late.step();
+	late.set_irq_line(InterruptSource::ExternalIrq, true, late.cycles - 2);
+	const uint64_t late_start = late.cycles;
+	late.step();
+	late.set_irq_line(InterruptSource::ExternalIrq, false);
+	late.set_nmi_line(true, late_start + 5);
+	if (late.program_counter != 0x0710) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": NMI after the vector fetch hijacked the IRQ" << std::endl;
+		return 0;
+	}
+	late.step(); // NMI taken at the boundary, before the first handler instruction
+	if (late.program_counter != 0x0700) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": late NMI was not serviced on the next boundary" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_brk_software_interrupt() {
+	// With halt_on_brk disabled BRK enters the IRQ handler with the Break flag pushed, RTI skips the padding byte
+	CPU cpu = CPU();
+	load_interrupt_program(cpu);
+	cpu.memory_write(0x0600, 0x00);
+	cpu.memory_write(0x0601, 0xFF);
+	cpu.halt_on_brk = false;
+
+	cpu.step();
+	const uint8_t pushed_status = cpu.memory_read(0x0100 + cpu.stack_pointer + 1);
+	if (cpu.program_counter != 0x0710 || cpu.cycles != 7 || (pushed_status & Flag::Break) == 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": BRK did not enter the handler with the Break flag pushed" << std::endl;
+		return 0;
+	}
+	cpu.step(); // INY
+	cpu.step(); // RTI
+	if (cpu.program_counter != 0x0602 || (cpu.status & Flag::Break) != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": RTI did not return past the BRK padding byte" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,109 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "farm.hpp"
+#include "lockstep.hpp"
+#include "mos6502.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_lockstep_engines_agree() {
+	const std::vector<FarmJob> jobs = random_lockstep_jobs(24, 7, 64, 20000);
+	const LockstepEngine interpreter = lockstep_engine("interpreter");
+	bool passed = true;
+
+	// The optimized engines match plain interpretation instruction by instruction, and in coarser steps
+	for (const std::string name : {"fused", "idle", "fused-idle"}) {
+		LockstepFarm farm(interpreter, lockstep_engine(name), 2);
+		for (const uint64_t step_cycles : {1, 50}) {
+			uint64_t steps = 0;
+			for (const LockstepResult& result : farm.run(jobs, step_cycles)) {
+				steps += result.steps;
+				if (result.diverged) {
+					passed = fail(__FUNCTION__, name + " diverged on " + result.name + ": " + result.divergence);
+				}
+			}
+			if (steps < jobs.size() * 2) {
+				passed = fail(__FUNCTION__, name + " compared only " + std::to_string(steps) + " steps");
+			}
+		}
+	}
+
+	// The same seed generates the same programs, which leave the same writes behind
+	const std::vector<FarmJob> again = random_lockstep_jobs(2, 7, 64, 20000);
+	CPU reference = CPU();
+	CPU candidate = CPU();
+	if (again[1].program != jobs[1].program
+		|| run_lockstep(interpreter, interpreter, reference, candidate, again[1]).write_hash
+			!= run_lockstep(interpreter, interpreter, reference, candidate, jobs[1]).write_hash) {
+		passed = fail(__FUNCTION__, "the generated programs are not reproducible");
+	}
+
+	try {
+		lockstep_engine("jit");
+		passed = fail(__FUNCTION__, "an unknown engine was accepted");
+	} catch (const std::invalid_argument&) {
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
+
+int test_lockstep_reports_divergence() {
+	// LDX #0, loop: INX, STX $10, CPX #8, BNE loop, BRK
+	const FarmJob job = {"counter", {0xA2, 0x00, 0xE8, 0x86, 0x10, 0xE0, 0x08, 0xD0, 0xF9, 0x00}, 10000};
+	const LockstepEngine interpreter = lockstep_engine("interpreter");
+	CPU reference = CPU();
+	CPU candidate = CPU();
+	bool passed = true;
+
+	const LockstepResult agreed = run_lockstep(interpreter, lockstep_engine("fused"), reference, candidate, job);
+	if (agreed.diverged || agreed.stop_reason != StopReason::BreakInstruction || !agreed.trace.empty()) {
+		passed = fail(__FUNCTION__, "the fused engine diverged on the counter: " + agreed.divergence);
+	}
+
+	// An engine that corrupts the store of the fifth iteration
+	LockstepEngine broken_store = interpreter;
+	broken_store.name = "broken";
+	broken_store.run_until = [](CPU& cpu, const uint64_t deadline) {
+		const uint16_t pc = cpu.program_counter;
+		const StopReason reason = cpu.run_until(deadline);
+		if (pc == 0x0603 && cpu.memory[0x10] == 5) {
+			cpu.memory[0x10] = 0x55;
+		}
+		return reason;
+	};
+	const LockstepResult store = run_lockstep(interpreter, broken_store, reference, candidate, job);
+	if (!store.diverged || store.divergence != "memory $0010 $05 != $55" || store.trace.empty()
+		|| store.trace.back().find("stx $10") == std::string::npos || store.trace.back().find("X=05") == std::string::npos) {
+		passed = fail(__FUNCTION__, "the corrupted store was reported as '" + store.divergence + "'");
+	}
+
+	// And one that charges a cycle too many for the compare
+	LockstepEngine broken_cycles = interpreter;
+	broken_cycles.run_until = [](CPU& cpu, const uint64_t deadline) {
+		const bool compare = cpu.memory[cpu.program_counter] == 0xE0;
+		const StopReason reason = cpu.run_until(deadline);
+		cpu.cycles += compare;
+		return reason;
+	};
+	const LockstepResult cycles = run_lockstep(interpreter, broken_cycles, reference, candidate, job);
+	if (!cycles.diverged || cycles.divergence.compare(0, 7, "cycles ") != 0 || cycles.steps != 4) {
+		passed = fail(__FUNCTION__, "the extra cycle was reported as '" + cycles.divergence + "' after "
+			+ std::to_string(cycles.steps) + " steps");
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,179 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "state_hash.hpp"
+#include "movie.hpp"
+#include "programs.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+// 300 frames of snake, a direction key every 20 frames, a state hash every 30 and a keyframe every 100 frames
+void record_snake(MovieRecorder& recorder) {
+	const uint8_t keys[] = {0x73, 0x61, 0x77, 0x64};
+	for (uint32_t frame = 0; frame < 300; frame++) {
+		recorder.frame((frame % 20 == 0) ? keys[(frame / 20) % 4] : 0);
+	}
+}
+
+} // namespace
+
+int test_movie_playback_is_bit_exact() {
+	MovieRecorder recorder(SNAKE_PROGRAM, 0x1234567, 30, 100);
+	record_snake(recorder);
+	if (recorder.movie().hashes.size() != 10 || recorder.movie().keyframes.size() != 4) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": recorded " << recorder.movie().hashes.size() << " hashes and "
+				  << recorder.movie().keyframes.size() << " keyframes" << std::endl;
+		return 0;
+	}
+
+	// Through the file format and back
+	std::stringstream file;
+	write_movie(file, recorder.movie());
+	const size_t file_size = file.str().size();
+	const Movie movie = read_movie(file);
+	if (movie.keys != recorder.movie().keys || movie.hashes != recorder.movie().hashes
+		|| movie.keyframes.back().state.memory != recorder.movie().keyframes.back().state.memory
+		|| movie.keyframes.back().state.cycles != recorder.movie().keyframes.back().state.cycles || file_size > 8192) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": movie changed on its way through a " << file_size << " byte file" << std::endl;
+		return 0;
+	}
+
+	MoviePlayer player(movie);
+	const MovieCheck check = player.play();
+	if (check.desynced || check.frames != 300 || check.hashes != 10 || player.position() != 300
+		|| hash_cpu_state(player.cpu()) != hash_cpu_state(recorder.cpu())) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": playback of " << check.frames << " frames, " << check.hashes
+				  << " hashes, desync after frame " << (check.desynced ? (int64_t)check.desync_frame : -1) << std::endl;
+		return 0;
+	}
+
+	// Another first key sends the snake another way, the first state hash gives it away
+	Movie tampered = movie;
+	tampered.keys[0] = 0x64;
+	const MovieCheck tampered_check = verify_movie(tampered);
+	if (!tampered_check.desynced || tampered_check.desync_frame != 29) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": tampered movie not caught at the first state hash" << std::endl;
+		return 0;
+	}
+
+	const std::string data = file.str();
+	for (const std::string& broken : {data.substr(0, data.size() - 1), "NESMOVIX" + data.substr(8), std::string()}) {
+		std::istringstream in(broken);
+		try {
+			read_movie(in);
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": broken movie file of " << broken.size() << " bytes did not throw" << std::endl;
+			return 0;
+		} catch (const std::runtime_error&) {
+		}
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_movie_seek() {
+	MovieRecorder recorder(SNAKE_PROGRAM, 0x1234567, 30, 100);
+	record_snake(recorder);
+	const Movie& movie = recorder.movie();
+	MoviePlayer straight(movie);
+	for (int i = 0; i < 250; i++) {
+		straight.frame();
+	}
+
+	// From the keyframe before frame 250
+	MoviePlayer player(movie);
+	player.seek(250);
+	if (player.position() != 250 || player.check().frames != 50
+		|| hash_cpu_state(player.cpu()) != hash_cpu_state(straight.cpu())) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": seek to frame 250 emulated " << player.check().frames
+				  << " frames and ended at frame " << player.position() << std::endl;
+		return 0;
+	}
+
+	// Backward from the first keyframe, then forward from where the player is
+	player.seek(50);
+	player.seek(80);
+	MoviePlayer again(movie);
+	for (int i = 0; i < 80; i++) {
+		again.frame();
+	}
+	if (player.position() != 80 || player.check().frames != 80 || player.check().hashes != 2
+		|| hash_cpu_state(player.cpu()) != hash_cpu_state(again.cpu())) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": seek back to frame 50 and on to 80 emulated " << player.check().frames
+				  << " frames" << std::endl;
+		return 0;
+	}
+
+	const MovieCheck& check = player.play();
+	if (check.desynced || player.position() != 300) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": playback after seeking went out of sync" << std::endl;
+		return 0;
+	}
+	try {
+		player.seek(301);
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": seek past the end did not throw" << std::endl;
+		return 0;
+	} catch (const std::out_of_range&) {
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_movie_segments() {
+	MovieRecorder recorder(SNAKE_PROGRAM, 0x1234567, 30, 100);
+	record_snake(recorder);
+	const std::vector<MovieCheck> segments = verify_movie_segments(recorder.movie(), 2);
+	uint32_t frames = 0;
+	uint32_t hashes = 0;
+	for (const MovieCheck& check : segments) {
+		frames += check.frames;
+		hashes += check.hashes;
+		if (check.desynced) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": segment out of sync after frame " << check.desync_frame << std::endl;
+			return 0;
+		}
+	}
+	if (segments.size() != 4 || frames != 300 || hashes != 10) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << segments.size() << " segments played " << frames << " frames and "
+				  << hashes << " hashes" << std::endl;
+		return 0;
+	}
+
+	// A broken keyframe fails the segment ending at it and the one starting from it, and no other
+	Movie broken = recorder.movie();
+	broken.keyframes[2].rng ^= 1;
+	const std::vector<MovieCheck> broken_segments = verify_movie_segments(broken, 2);
+	if (broken_segments[0].desynced || !broken_segments[1].desynced || broken_segments[1].desync_frame != 199
+		|| !broken_segments[2].desynced || broken_segments[2].desync_frame != 209 || broken_segments[3].desynced) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": desync of a broken keyframe not pinned to its segments" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,87 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+#include "profiler.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+// LDX #$05, DEX, BNE $0602, BRK: 11 instructions taking 26 cycles
+const std::vector<uint8_t> COUNTDOWN_PROGRAM = {0xA2, 0x05, 0xCA, 0xD0, 0xFD, 0x00};
+
+int test_profiler_counts() {
+	CPU cpu = CPU();
+	cpu.load_program(COUNTDOWN_PROGRAM);
+	cpu.reset();
+	Profiler profiler;
+	if (cpu.run_until(1000, profiler) != StopReason::BreakInstruction) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": program did not run to BRK" << std::endl;
+		return 0;
+	}
+
+	if (profiler.instructions() != 11 || profiler.cycles() != 26 || cpu.cycles != 26) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": counted " << profiler.instructions() << " instructions and "
+				  << profiler.cycles() << " cycles, expected 11 and 26" << std::endl;
+		return 0;
+	}
+	if (profiler.opcode_count[0xCA] != 5 || profiler.opcode_cycles[0xD0] != 14 || profiler.pc_count[0x0603] != 5) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong per opcode or per PC counters" << std::endl;
+		return 0;
+	}
+	if (profiler.mode_count(AddressingMode::Immediate) != 1 || profiler.mode_count(AddressingMode::Implied) != 5
+		|| profiler.mode_cycles(AddressingMode::Relative) != 14) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong per addressing mode counters" << std::endl;
+		return 0;
+	}
+
+	const std::vector<uint16_t> hottest = profiler.hottest_pcs(2);
+	if (hottest.size() != 2 || hottest[0] != 0x0603 || hottest[1] != 0x0602) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": wrong hot instruction ranking" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_profiler_matches_plain_run() {
+	// Profiling must not change what the program does
+	CPU plain = CPU();
+	plain.load_program(COUNTDOWN_PROGRAM);
+	plain.reset();
+	plain.run_until(1000);
+
+	CPU profiled = CPU();
+	profiled.load_program(COUNTDOWN_PROGRAM);
+	profiled.reset();
+	Profiler profiler;
+	profiled.run_until(1000, profiler);
+
+	if (plain.cycles != profiled.cycles || plain.program_counter != profiled.program_counter
+		|| plain.register_irx != profiled.register_irx || plain.status != profiled.status) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": profiled run diverged from the plain run" << std::endl;
+		return 0;
+	}
+
+	profiler.clear();
+	if (profiler.instructions() != 0 || profiler.pc_count[0x0602] != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": clear did not reset the counters" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,150 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "mos6502.hpp"
+#include "programs.hpp"
+#include "random_device.hpp"
+#include "state_hash.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+namespace {
+
+// Reads the register three times and stores the values at $10 - $12
+const std::vector<uint8_t> READ_RANDOM_PROGRAM = {
+	0xA5, 0xFE, // lda $FE
+	0x85, 0x10, // sta $10
+	0xA5, 0xFE, // lda $FE
+	0x85, 0x11, // sta $11
+	0xA5, 0xFE, // lda $FE
+	0x85, 0x12, // sta $12
+	0x00,       // brk
+};
+
+void run_read_random(CPU& cpu, RandomDevice& random) {
+	cpu.load_program(READ_RANDOM_PROGRAM);
+	cpu.reset();
+	cpu.run_until(cpu.cycles + 1000, random);
+}
+
+// Polls the register until it reads zero, then sets $10
+const std::vector<uint8_t> POLL_RANDOM_PROGRAM = {
+	0xA5, 0xFE, // loop: lda $FE
+	0xD0, 0xFC, // bne loop
+	0xA9, 0x01, // lda #$01
+	0x85, 0x10, // sta $10
+	0x00,       // brk
+};
+
+} // namespace
+
+int test_random_device_sequence() {
+	CPU cpu = CPU();
+	RandomDevice random(0x1234567);
+	run_read_random(cpu, random);
+	const uint8_t first[] = {cpu.memory[0x10], cpu.memory[0x11], cpu.memory[0x12]};
+	if (first[0] == first[1] && first[1] == first[2]) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": three reads of the register all returned " << (int)first[0] << std::endl;
+		return 0;
+	}
+
+	// Same seed, same values, also on another CPU
+	CPU other = CPU();
+	RandomDevice again(0x1234567);
+	run_read_random(other, again);
+	if (other.memory[0x10] != first[0] || other.memory[0x11] != first[1] || other.memory[0x12] != first[2]
+		|| again.state() != random.state()) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": same seed produced other values" << std::endl;
+		return 0;
+	}
+
+	// Continuing from a saved state matches the generator it was saved from
+	RandomDevice continued(random.state());
+	for (int i = 0; i < 100; i++) {
+		if (continued.next() != random.next()) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": generator continued from its state diverged after " << i << " values" << std::endl;
+			return 0;
+		}
+	}
+
+	RandomDevice different(0x7654321);
+	run_read_random(other, different);
+	if (other.memory[0x10] == first[0] && other.memory[0x11] == first[1] && other.memory[0x12] == first[2]) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": another seed produced the same values" << std::endl;
+		return 0;
+	}
+
+	try {
+		RandomDevice zero(0);
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": seed zero did not throw" << std::endl;
+		return 0;
+	} catch (const std::invalid_argument&) {
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_random_device_attached() {
+	// Snake with the device attached, idle loops skipped and instructions fused, against the device as the policy of a
+	// plain run: skipped delay loops still draw their values, so both runs stay in lockstep
+	CPU plain = CPU();
+	CPU attached = CPU();
+	for (CPU* cpu : {&plain, &attached}) {
+		cpu->load_program(SNAKE_PROGRAM);
+		cpu->reset();
+		cpu->memory_write(0x00FF, 0x64);
+	}
+	RandomDevice policy(0x1234567);
+	RandomDevice device(0x1234567);
+	attached.skip_idle_loops = true;
+	attached.fuse_instructions = true;
+	attached.attach_random_device(&device);
+	for (uint32_t frame = 1; frame <= 60; frame++) {
+		const uint64_t deadline = frame * (uint64_t)CYCLES_PER_FRAME;
+		if (plain.run_until(deadline, policy) != attached.run_until(deadline) || !same_state(plain, attached)
+			|| hash_cpu_state(plain) != hash_cpu_state(attached) || policy.state() != device.state()) {
+			return fail(__FUNCTION__, "attached device diverged from the policy run in frame " + std::to_string(frame));
+		}
+	}
+	if (attached.cold->idle_iterations_skipped == 0) {
+		return fail(__FUNCTION__, "no idle loop iterations were skipped");
+	}
+
+	// Polling the register is not idle, the loop sees new values until it reads zero
+	CPU poll = CPU();
+	poll.load_program(POLL_RANDOM_PROGRAM);
+	poll.reset();
+	poll.skip_idle_loops = true;
+	RandomDevice random;
+	poll.attach_random_device(&random);
+	if (poll.run_until(10000000) != StopReason::BreakInstruction || poll.memory[0x10] != 0x01) {
+		return fail(__FUNCTION__, "the poll loop on the register did not end");
+	}
+
+	// Single steps refresh the register as well
+	poll.attach_random_device(nullptr);
+	poll.reset();
+	poll.attach_random_device(&random);
+	const uint32_t before = random.state();
+	poll.step();
+	if (random.state() == before || poll.memory[RANDOM_DEVICE_ADDRESS] != (uint8_t)random.state()) {
+		return fail(__FUNCTION__, "a single step did not refresh the register");
+	}
+	poll.attach_random_device(nullptr);
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
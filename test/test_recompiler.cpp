@@ -0,0 +1,138 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mos6502.hpp"
+#include "recompiler.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+// A counted loop around a subroutine call, left through an indirect jump ($0010 points at the BRK)
+const std::vector<uint8_t> RECOMPILER_PROGRAM = {
+	0xA2, 0x03,       // $0600 LDX #$03
+	0x20, 0x0C, 0x06, // $0602 JSR $060C
+	0xCA,             // $0605 DEX
+	0xD0, 0xFA,       // $0606 BNE $0602
+	0x6C, 0x10, 0x00, // $0608 JMP ($0010)
+	0xEA,             // $060B NOP, never reached
+	0x18,             // $060C CLC
+	0x69, 0x01,       // $060D ADC #$01
+	0x60,             // $060F RTS
+	0x00,             // $0610 BRK
+};
+
+int test_recompiler_blocks() {
+	CPU cpu = CPU();
+	cpu.load_program(RECOMPILER_PROGRAM);
+	StaticRecompiler recompiler(cpu.memory);
+	const std::vector<BasicBlock>& blocks = recompiler.discover();
+
+	// start, instruction count, budget
+	const uint32_t expected[][3] = {
+		{0x0600, 1, 0},
+		{0x0602, 1, 0},
+		{0x0605, 2, 2},
+		{0x0608, 1, 0},
+		{0x060C, 3, 4},
+	};
+	if (blocks.size() != 5) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": expected 5 blocks, got " << blocks.size() << std::endl;
+		return 0;
+	}
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i].start != expected[i][0] || blocks[i].instructions.size() != expected[i][1]
+			|| blocks[i].budget != expected[i][2]) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": block " << i << " starts at $" << std::hex << blocks[i].start << std::dec
+				      << " with " << blocks[i].instructions.size() << " instructions and a budget of "
+				      << blocks[i].budget << std::endl;
+			return 0;
+		}
+	}
+
+	std::ostringstream source;
+	recompiler.emit(source, "loop");
+	const std::vector<std::string> fragments = {
+		"void loop_run(CPU& cpu, const uint64_t deadline)",
+		"bool loop_matches(const CPU& cpu)",
+		"case 0x060C:",
+		"cpu.ADC(AddressingMode::Immediate);",
+		"cpu.JMP(AddressingMode::Indirect);",
+		"cpu.program_counter = 0x060C;",
+	};
+	for (const std::string& fragment : fragments) {
+		if (source.str().find(fragment) == std::string::npos) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": emitted source lacks `" << fragment << "`" << std::endl;
+			return 0;
+		}
+	}
+	// The BRK and the unreachable NOP are left to the interpreter
+	if (source.str().find("block_060B") != std::string::npos || source.str().find("block_0610") != std::string::npos) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": recompiled code that is not reachable as a block" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+namespace {
+
+uint64_t recompiled_calls = 0;
+
+// Stands in for recompiled code that has no block at the program counter
+void no_blocks(CPU&, const uint64_t) {
+	recompiled_calls += 1;
+}
+
+} // namespace
+
+int test_recompiler_fallback() {
+	bool passed = true;
+	for (const bool masked_irq : {false, true}) {
+		CPU plain = CPU();
+		CPU recompiled = CPU();
+		for (CPU* cpu : {&plain, &recompiled}) {
+			cpu->load_program(RECOMPILER_PROGRAM);
+			cpu->reset();
+			cpu->memory_write_uint16(0x0010, 0x0610);
+			if (masked_irq) {
+				cpu->status |= Flag::InteruptDisable;
+				cpu->set_irq_line(InterruptSource::ExternalIrq, true);
+			}
+		}
+
+		recompiled_calls = 0;
+		const StopReason expected = plain.run_until(1000);
+		const StopReason actual = run_recompiled(recompiled, 1000, no_blocks);
+		if (actual != expected || actual != StopReason::BreakInstruction || recompiled.cycles != plain.cycles
+			|| recompiled.program_counter != 0x0610 || recompiled.register_a != plain.register_a) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": interpreted fallback ended at $" << std::hex << recompiled.program_counter
+				      << std::dec << " after " << recompiled.cycles << " cycles, expected " << plain.cycles << std::endl;
+			passed = false;
+		}
+		// Recompiled code is only entered on the fast path, never with an interrupt pending
+		if ((recompiled_calls == 0) != masked_irq) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": recompiled code entered " << recompiled_calls << " times"
+				      << (masked_irq ? " with an interrupt pending" : "") << std::endl;
+			passed = false;
+		}
+	}
+
+	if (passed) {
+		std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+			      << __FUNCTION__ << ": All tests passed" << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,124 @@
+#include "test.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mos6502.hpp"
+#include "scheduler.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+// Endless loop of NOPs, executes in 2 or 3 cycle steps
+static const std::vector<uint8_t> NOP_LOOP = {0xEA, 0xEA, 0xEA, 0x4C, 0x00, 0x06};
+
+int test_scheduler_event_order() {
+	// Events should fire in timestamp order, ties in scheduling order, on the first instruction boundary at or
+	// after their timestamp
+	CPU cpu = CPU();
+	cpu.load_program(NOP_LOOP);
+	cpu.reset();
+
+	struct Fired {
+		DeviceEvent event;
+		uint64_t timestamp;
+		uint64_t cycles;
+	};
+	std::vector<Fired> fired;
+	Scheduler scheduler;
+	for (const DeviceEvent event : {NmiEvent, FrameIrqEvent, MapperIrqEvent, DmaEvent}) {
+		scheduler.set_handler(event, [&fired, event](CPU& cpu, uint64_t timestamp, uint32_t) {
+			fired.push_back({event, timestamp, cpu.cycles});
+		});
+	}
+	scheduler.schedule(FrameIrqEvent, 100);
+	scheduler.schedule(NmiEvent, 50);
+	scheduler.schedule(DmaEvent, 50);
+	scheduler.schedule(MapperIrqEvent, 5000);
+	scheduler.cancel(MapperIrqEvent);
+
+	scheduler.run(cpu, 1000);
+
+	const DeviceEvent expected[] = {NmiEvent, DmaEvent, FrameIrqEvent};
+	if (fired.size() != 3 || scheduler.pending() != 0) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": " << fired.size() << " events fired, expected 3"
+				  << std::endl;
+		return 0;
+	}
+	for (size_t i = 0; i < fired.size(); i++) {
+		if (fired[i].event != expected[i]) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": event " << i << " fired out of order"
+					  << std::endl;
+			return 0;
+		}
+		// Longest instruction in the loop is 3 cycles
+		if (fired[i].cycles < fired[i].timestamp || fired[i].cycles >= fired[i].timestamp + 3) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": event " << i << " scheduled at " << fired[i].timestamp
+					  << " fired at " << fired[i].cycles << std::endl;
+			return 0;
+		}
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_scheduler_periodic_event() {
+	// A handler re-arming its own event should fire once per period
+	CPU cpu = CPU();
+	cpu.load_program(NOP_LOOP);
+	cpu.reset();
+
+	int count = 0;
+	Scheduler scheduler;
+	scheduler.set_handler(FrameIrqEvent, [&count, &scheduler](CPU&, uint64_t timestamp, uint32_t) {
+		count += 1;
+		scheduler.schedule(FrameIrqEvent, timestamp + CYCLES_PER_FRAME);
+	});
+	scheduler.schedule(FrameIrqEvent, CYCLES_PER_FRAME);
+
+	scheduler.run(cpu, 10 * (uint64_t)CYCLES_PER_FRAME + 1);
+
+	if (count != 10) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": periodic event fired " << count << " times, expected 10"
+				  << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_scheduler_64bit_clock() {
+	// The master clock should keep counting past 2^32 cycles
+	CPU cpu = CPU();
+	cpu.load_program(NOP_LOOP);
+	cpu.reset();
+	cpu.cycles = 0xFFFFFF00;
+
+	bool fired = false;
+	Scheduler scheduler;
+	scheduler.set_handler(NmiEvent, [&fired](CPU& cpu, uint64_t, uint32_t payload) {
+		fired = (cpu.cycles >= 0x100000100) && (payload == 7);
+	});
+	scheduler.schedule(NmiEvent, 0x100000100, 7);
+	scheduler.run(cpu, 0x100000200);
+
+	if (!fired || cpu.cycles < 0x100000200) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": clock wrapped or event did not fire past 2^32 cycles"
+				  << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT 
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,126 @@
+#include "test.hpp"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "mos6502.hpp"
+#include "programs.hpp"
+#include "state_hash.hpp"
+
+#define DEFAULT         "\033[0m"
+#define RED             "\033[31m"
+#define GREEN           "\033[32m"
+#define YELLOW          "\033[33m"
+
+int test_state_hash_incremental() {
+	CPU cpu = CPU();
+	cpu.load_program(SNAKE_PROGRAM);
+	cpu.reset();
+	CPUSnapshot start;
+	cpu.save_snapshot(start);
+
+	// Writes, snapshot saves and restores (in sync and not) in any order, the incremental hash has to follow along
+	std::mt19937 random(3);
+	CPU other = CPU();
+	CPUSnapshot foreign;
+	other.save_snapshot(foreign);
+	for (int round = 0; round < 400; round++) {
+		const int writes = random() % 8;
+		for (int i = 0; i < writes; i++) {
+			cpu.memory_write(random() % MEMORY_SIZE, random());
+		}
+		switch (random() % 8) {
+			case 0:
+				cpu.save_snapshot(start);
+				break;
+			case 1:
+				cpu.restore_snapshot(start);
+				break;
+			case 2:
+				cpu.restore_snapshot((random() % 2 == 0) ? foreign : start);
+				break;
+			case 3:
+				cpu.run_for(500);
+				break;
+			default:
+				break;
+		}
+		if (random() % 3 == 0) {
+			continue;
+		}
+		const uint64_t full = hash_cpu_state(cpu);
+		const uint64_t incremental = cpu.state_hash();
+		if (incremental != full) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": incremental hash " << std::hex << incremental << " differs from " << full
+					  << std::dec << " in round " << round << std::endl;
+			return 0;
+		}
+	}
+
+	cpu.reset_memory_space();
+	if (cpu.state_hash() != hash_cpu_state(cpu)) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": incremental hash stale after clearing the memory space" << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}
+
+int test_state_hash_sensitivity() {
+	CPU cpu = CPU();
+	cpu.load_program(SNAKE_PROGRAM);
+	cpu.reset();
+	// Stored hashes (movies, golden tests) stay valid across builds, with and without SIMD
+	const uint64_t golden = hash_cpu_state(cpu);
+	if (golden != 0xC7F8A230CD6AE92F) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": hash of the reset snake game changed to " << std::hex << golden << std::dec
+				  << std::endl;
+		return 0;
+	}
+
+	// Every single bit of memory and registers counts
+	for (uint32_t addr = 0; addr < MEMORY_SIZE; addr += 97) {
+		cpu.memory[addr] ^= 1 << (addr % 8);
+		const uint64_t flipped = hash_cpu_state(cpu);
+		cpu.memory[addr] ^= 1 << (addr % 8);
+		if (flipped == golden) {
+			std::cout << RED << "[FAIL]: " << DEFAULT
+				      << __FUNCTION__ << ": bit flip at $" << std::hex << addr << std::dec << " not seen" << std::endl;
+			return 0;
+		}
+	}
+	cpu.register_iry ^= 0x80;
+	const bool register_seen = hash_cpu_state(cpu) != golden;
+	cpu.register_iry ^= 0x80;
+
+	// Equal data moved elsewhere in a page, or to another page, changes the hash as well
+	uint8_t stripe[64];
+	std::memcpy(stripe, cpu.memory + 0x0600, sizeof(stripe));
+	std::memmove(cpu.memory + 0x0600, cpu.memory + 0x0640, sizeof(stripe));
+	std::memcpy(cpu.memory + 0x0640, stripe, sizeof(stripe));
+	const bool stripes_seen = hash_cpu_state(cpu) != golden;
+	std::memcpy(cpu.memory + 0x0640, cpu.memory + 0x0600, sizeof(stripe));
+	std::memcpy(cpu.memory + 0x0600, stripe, sizeof(stripe));
+	const std::vector<uint8_t> page(cpu.memory + 0x0400, cpu.memory + 0x0800);
+	std::memcpy(cpu.memory + 0x0800, page.data(), page.size());
+	std::memset(cpu.memory + 0x0400, 0, page.size());
+	const bool pages_seen = hash_cpu_state(cpu) != golden;
+	std::memcpy(cpu.memory + 0x0400, page.data(), page.size());
+	std::memset(cpu.memory + 0x0800, 0, page.size());
+	if (!register_seen || !stripes_seen || !pages_seen || hash_cpu_state(cpu) != golden) {
+		std::cout << RED << "[FAIL]: " << DEFAULT
+			      << __FUNCTION__ << ": register " << register_seen << ", swapped stripes " << stripes_seen
+				  << ", swapped pages " << pages_seen << std::endl;
+		return 0;
+	}
+
+	std::cout << GREEN << "[SUCCESS]: " << DEFAULT
+		      << __FUNCTION__ << ": All tests passed" << std::endl;
+	return 1;
+}